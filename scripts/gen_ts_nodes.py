@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+#
+# Generate src/ts_nodes.h from the tree-sitter-bash grammar.
+#
+# Usage: gen_ts_nodes.py <tree-sitter-bash/src> <ts_symbols.h>
+#
+# Reads node-types.json and grammar.json and emits
+#  - field id constants (tree-sitter numbers fields in sorted order),
+#  - an X-macro listing every named node type and its symbol,
+#  - predicates for the grammar's supertypes (_statement, ...),
+#  - typed field accessors such as ts_while_statement_body(), and
+#  - ts_nodes_check(), which verifies all of the above against the
+#    language that is linked into the shell.
+#
+# Fails if node-types.json names a node type for which ts_symbols.h
+# has no symbol, i.e., if ts_symbols.h is stale.
+#
+import json
+import os
+import re
+import sys
+
+
+def fields_in(rule, acc):
+    if isinstance(rule, dict):
+        if rule.get("type") == "FIELD":
+            acc.add(rule["name"])
+        for v in rule.values():
+            fields_in(v, acc)
+    elif isinstance(rule, list):
+        for v in rule:
+            fields_in(v, acc)
+
+
+def named_aliases(rule, acc):
+    if isinstance(rule, dict):
+        if rule.get("type") == "ALIAS" and rule.get("named"):
+            acc.add(rule["value"])
+        for v in rule.values():
+            named_aliases(v, acc)
+    elif isinstance(rule, list):
+        for v in rule:
+            named_aliases(v, acc)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: %s <tree-sitter-bash/src> <ts_symbols.h>" % sys.argv[0])
+    srcdir, symfile = sys.argv[1], sys.argv[2]
+
+    with open(os.path.join(srcdir, "node-types.json")) as f:
+        node_types = json.load(f)
+    with open(os.path.join(srcdir, "grammar.json")) as f:
+        grammar = json.load(f)
+    with open(symfile) as f:
+        symbols = dict(re.findall(r"^\s*(\w+) = (\d+),", f.read(), re.M))
+    symbol_count = max(int(v) for v in symbols.values()) + 1
+
+    fields = set()
+    fields_in(grammar["rules"], fields)
+    fields = sorted(fields)
+
+    aliases = set()
+    named_aliases(grammar["rules"], aliases)
+
+    supertypes = {n["type"]: [s["type"] for s in n["subtypes"]]
+                  for n in node_types if "subtypes" in n}
+    named = sorted(n["type"] for n in node_types
+                   if n["named"] and "subtypes" not in n)
+
+    with_symbol, alias_only = [], []
+    for t in named:
+        if "sym_" + t in symbols:
+            with_symbol.append(t)
+        elif t in aliases:
+            alias_only.append(t)
+        else:
+            sys.exit("%s: node type `%s' has no symbol in %s; regenerate it"
+                     % (sys.argv[0], t, symfile))
+
+    def members(supertype):
+        out = set()
+        for s in supertypes[supertype]:
+            out |= members(s) if s in supertypes else {s}
+        return out & set(with_symbol)
+
+    out = []
+    w = out.append
+    w("/*")
+    w(" * Generated by scripts/gen_ts_nodes.py from tree-sitter-bash's")
+    w(" * node-types.json and grammar.json.  Do not edit.")
+    w(" *")
+    w(" * Include ts_symbols.h, which has no include guard, before this file.")
+    w(" */")
+    w("#ifndef _TS_NODES_H")
+    w("#define _TS_NODES_H")
+    w("")
+    w("#include <stdbool.h>")
+    w("#include <stdio.h>")
+    w("#include <string.h>")
+    w("#include <tree_sitter/api.h>")
+    w("")
+    w("/* Field ids; tree-sitter numbers fields in sorted order. */")
+    w("enum ts_field_identifiers {")
+    for i, name in enumerate(fields, 1):
+        w("  field_%s = %d," % (name, i))
+    w("};")
+    w("")
+    w("#define TS_FIELD_COUNT %d" % len(fields))
+    w("")
+    w("/* Size of a table indexed by the symbols of ts_symbol_identifiers. */")
+    w("#define TS_SYMBOL_COUNT %d" % symbol_count)
+    w("")
+    w("/* X(type) for every named node type that has a symbol sym_<type>. */")
+    w("#define TS_NAMED_NODE_TYPES(X) \\")
+    for t in with_symbol:
+        w("    X(%s) \\" % t)
+    w("")
+    w("")
+    w("/* X(type) for named node types that only exist as aliases. */")
+    w("#define TS_ALIAS_NODE_TYPES(X) \\")
+    for t in alias_only:
+        w("    X(%s) \\" % t)
+    w("")
+    w("")
+    w("/* X(name) for every field. */")
+    w("#define TS_FIELDS(X) \\")
+    for name in fields:
+        w("    X(%s) \\" % name)
+    w("")
+    w("")
+    for st in sorted(supertypes):
+        pred = "ts_is" + st
+        w("/* Is symbol a subtype of %s? */" % st)
+        w("static inline bool")
+        w("%s(TSSymbol symbol)" % pred)
+        w("{")
+        w("    switch (symbol) {")
+        for t in sorted(members(st)):
+            w("    case sym_%s:" % t)
+        w("        return true;")
+        w("    default:")
+        w("        return false;")
+        w("    }")
+        w("}")
+        w("")
+    w("/* Typed field accessors. */")
+    for n in sorted(node_types, key=lambda n: n["type"]):
+        if not n["named"] or "fields" not in n:
+            continue
+        for name in sorted(n["fields"]):
+            w("static inline TSNode")
+            w("ts_%s_%s(TSNode self)" % (n["type"], name))
+            w("{")
+            w("    return ts_node_child_by_field_id(self, field_%s);" % name)
+            w("}")
+            w("")
+    w("/*")
+    w(" * Verify the constants above against the language linked into")
+    w(" * the program.  Reports each mismatch to stderr.")
+    w(" */")
+    w("static inline bool")
+    w("ts_nodes_check(const TSLanguage *language)")
+    w("{")
+    w("    bool ok = ts_language_field_count(language) == TS_FIELD_COUNT;")
+    w("#define CHECK_FIELD(name) \\")
+    w("    if (ts_language_field_id_for_name(language, #name, strlen(#name)) != field_##name) { \\")
+    w("        fprintf(stderr, \"field `%s' has changed\\n\", #name); \\")
+    w("        ok = false; \\")
+    w("    }")
+    w("#define CHECK_SYMBOL(type) \\")
+    w("    if (ts_language_symbol_for_name(language, #type, strlen(#type), true) != sym_##type) { \\")
+    w("        fprintf(stderr, \"node type `%s' has changed\\n\", #type); \\")
+    w("        ok = false; \\")
+    w("    }")
+    w("#define CHECK_ALIAS(type) \\")
+    w("    if (ts_language_symbol_for_name(language, #type, strlen(#type), true) == 0) { \\")
+    w("        fprintf(stderr, \"node type `%s' is gone\\n\", #type); \\")
+    w("        ok = false; \\")
+    w("    }")
+    w("    TS_FIELDS(CHECK_FIELD)")
+    w("    TS_NAMED_NODE_TYPES(CHECK_SYMBOL)")
+    w("    TS_ALIAS_NODE_TYPES(CHECK_ALIAS)")
+    w("#undef CHECK_FIELD")
+    w("#undef CHECK_SYMBOL")
+    w("#undef CHECK_ALIAS")
+    w("    return ok;")
+    w("}")
+    w("")
+    w("#endif /* _TS_NODES_H */")
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,112 @@
+/*
+ * A bump allocator, see arena.h.
+ *
+ * The chunks form a list in which the chunk currently allocated
+ * from is followed by the chunks that were released, which are
+ * reused before new ones are made.
+ */
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "utils.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+static inline size_t
+align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static void
+use_chunk(struct arena *a, struct arena_chunk *c)
+{
+    a->chunk = c;
+    a->cur = c->data;
+    a->end = c->data + c->size;
+}
+
+/* Continue in the next chunk that can hold size bytes, making one
+ * if necessary. */
+static void
+next_chunk(struct arena *a, size_t size)
+{
+    struct arena_chunk **link = a->chunk != NULL ? &a->chunk->next : &a->first;
+    if (*link != NULL && (*link)->size >= size) {
+        use_chunk(a, *link);
+        return;
+    }
+
+    /* a released chunk that is too small stays after the new one */
+    size_t csize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    struct arena_chunk *c = malloc(sizeof *c + csize);
+    if (c == NULL)
+        utils_fatal_error("Could not allocate arena chunk: ");
+    c->size = csize;
+    c->next = *link;
+    *link = c;
+    use_chunk(a, c);
+}
+
+void *
+arena_alloc(struct arena *a, size_t size)
+{
+    size = align_up(size ? size : 1);
+    if (a->chunk == NULL || (size_t) (a->end - a->cur) < size)
+        next_chunk(a, size);
+    void *p = a->cur;
+    a->cur += size;
+    return p;
+}
+
+void *
+arena_grow(struct arena *a, void *ptr, size_t oldsize, size_t size)
+{
+    if (ptr != NULL && (char *) ptr + align_up(oldsize) == a->cur
+        && (size_t) (a->end - (char *) ptr) >= size) {
+        a->cur = (char *) ptr + align_up(size);
+        return ptr;
+    }
+    void *p = arena_alloc(a, size);
+    if (ptr != NULL)
+        memcpy(p, ptr, oldsize < size ? oldsize : size);
+    return p;
+}
+
+char *
+arena_strndup(struct arena *a, const char *s, size_t len)
+{
+    char *p = arena_alloc(a, len + 1);
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+void
+arena_release(struct arena *a, struct arena_mark mark)
+{
+    a->chunk = mark.chunk;
+    a->cur = mark.cur;
+    a->end = mark.chunk != NULL ? mark.chunk->data + mark.chunk->size : NULL;
+}
+
+void
+arena_done(struct arena *a)
+{
+    while (a->first != NULL) {
+        struct arena_chunk *c = a->first;
+        a->first = c->next;
+        free(c);
+    }
+    a->chunk = NULL;
+    a->cur = a->end = NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+/*
+ * A bump allocator for temporaries whose lifetime is a statement.
+ *
+ * Memory is handed out from large chunks by advancing a pointer.
+ * Nothing is freed individually; instead, arena_mark records the
+ * current position and arena_release returns everything allocated
+ * since, in O(1).  Marks nest, so each statement can release what
+ * it allocated while the statements that contain it keep theirs.
+ * Chunks are kept for reuse, so a loop that allocates the same
+ * amount on each iteration calls malloc only on its first one.
+ */
+#include <stddef.h>
+
+struct arena_chunk;
+
+struct arena {
+    struct arena_chunk *first;  /* all chunks */
+    struct arena_chunk *chunk;  /* the chunk allocated from, NULL if none yet */
+    char *cur, *end;            /* free space in chunk */
+};
+
+/* A position in an arena, see arena_release. */
+struct arena_mark {
+    struct arena_chunk *chunk;
+    char *cur;
+};
+
+/* Return size bytes, aligned for any type. */
+void *arena_alloc(struct arena *a, size_t size);
+
+/*
+ * Resize ptr, the most recent allocation, of oldsize bytes, to size
+ * bytes; it is extended in place if possible.  ptr may be NULL.
+ */
+void *arena_grow(struct arena *a, void *ptr, size_t oldsize, size_t size);
+
+/* Copy len bytes of s into the arena and zero-terminate them. */
+char *arena_strndup(struct arena *a, const char *s, size_t len);
+
+static inline struct arena_mark
+arena_mark(struct arena *a)
+{
+    return (struct arena_mark) { a->chunk, a->cur };
+}
+
+/* Free everything allocated since mark was taken. */
+void arena_release(struct arena *a, struct arena_mark mark);
+
+/* Free all memory of the arena. */
+void arena_done(struct arena *a);
+
+#endif /* __ARENA_H */
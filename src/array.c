@@ -0,0 +1,157 @@
+/*
+ * Indexed arrays, see array.h.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "utils.h"
+
+/* The value that element e, which is not in a text, is the str of. */
+static struct value *
+elem_value(const struct array_elem *e)
+{
+    return (struct value *) (e->str - offsetof(struct value, str));
+}
+
+static void
+elem_clear(struct array_elem *e)
+{
+    if (e->str != NULL && !e->text)
+        value_unref(elem_value(e));
+    *e = (struct array_elem) { 0 };
+}
+
+struct array *
+array_new(void)
+{
+    struct array *a = calloc(1, sizeof *a);
+    if (a == NULL)
+        utils_fatal_error("Could not allocate array: ");
+    return a;
+}
+
+void
+array_free(struct array *a)
+{
+    if (a == NULL)
+        return;
+    for (size_t i = 0; i < a->n; i++)
+        elem_clear(&a->elems[i]);
+    for (size_t i = 0; i < a->ntexts; i++)
+        free(a->texts[i]);
+    free(a->texts);
+    free(a->elems);
+    free(a);
+}
+
+void
+array_reserve(struct array *a, size_t n)
+{
+    if (n <= a->cap)
+        return;
+    size_t cap = a->cap ? 2 * a->cap : 8;
+    if (cap < n)
+        cap = n;
+    if (cap > ARRAY_MAX)
+        cap = ARRAY_MAX;
+    if ((a->elems = realloc(a->elems, cap * sizeof *a->elems)) == NULL)
+        utils_fatal_error("Could not allocate array: ");
+    memset(a->elems + a->cap, 0, (cap - a->cap) * sizeof *a->elems);
+    a->cap = cap;
+}
+
+struct array *
+array_copy(struct array *a)
+{
+    struct array *copy = array_new();
+    array_reserve(copy, a->n);
+    for (size_t i = 0; i < a->n; i++) {
+        const struct array_elem *e = &a->elems[i];
+        if (e->str != NULL)
+            array_set(copy, i, e->text ? value_new(e->str, e->len)
+                                       : value_ref(elem_value(e)));
+    }
+    return copy;
+}
+
+struct value *
+array_value(struct array *a, size_t i)
+{
+    if (array_get(a, i) == NULL)
+        return NULL;
+    struct array_elem *e = &a->elems[i];
+    if (e->text) {
+        e->str = value_new(e->str, e->len)->str;
+        e->text = false;
+    }
+    return elem_value(e);
+}
+
+void
+array_set(struct array *a, size_t i, struct value *val)
+{
+    if (val == NULL) {
+        if (array_get(a, i) == NULL)
+            return;
+        elem_clear(&a->elems[i]);
+        a->nset--;
+        while (a->n > 0 && a->elems[a->n - 1].str == NULL)
+            a->n--;
+        return;
+    }
+
+    array_reserve(a, i + 1);
+    struct array_elem *e = &a->elems[i];
+    if (e->str == NULL)
+        a->nset++;
+    else
+        elem_clear(e);
+    *e = (struct array_elem) { val->str, val->len, false };
+    if (i >= a->n)
+        a->n = i + 1;
+}
+
+size_t
+array_load_lines(struct array *a, size_t origin, char *text, const char *s,
+                 size_t len, char delim, bool trim, size_t skip, size_t max)
+{
+    /* count the lines first, so that the vector grows at most once */
+    const char *end = s + len, *p = s;
+    size_t nlines = 0;
+    while (p < end && (nlines < skip || nlines - skip < max)) {
+        const char *d = memchr(p, delim, end - p);
+        nlines++;
+        p = d != NULL ? d + 1 : end;
+    }
+    size_t n = nlines > skip ? nlines - skip : 0;
+    if (n > ARRAY_MAX - origin)
+        n = ARRAY_MAX - origin;
+    if (n == 0) {
+        free(text);
+        return 0;
+    }
+    array_reserve(a, origin + n);
+    if ((a->texts = realloc(a->texts, (a->ntexts + 1) * sizeof *a->texts)) == NULL)
+        utils_fatal_error("Could not allocate array: ");
+    a->texts[a->ntexts++] = text;
+
+    p = s;
+    for (size_t line = 0; line < skip + n; line++) {
+        const char *d = memchr(p, delim, end - p);
+        const char *next = d != NULL ? d + 1 : end;
+        if (line >= skip) {
+            struct array_elem *e = &a->elems[origin + line - skip];
+            if (e->str == NULL)
+                a->nset++;
+            else
+                elem_clear(e);
+            *e = (struct array_elem) { p, (d != NULL && trim ? d : next) - p, true };
+        }
+        p = next;
+    }
+    if (origin + n > a->n)
+        a->n = origin + n;
+    return n;
+}
@@ -0,0 +1,75 @@
+#ifndef __ARRAY_H
+#define __ARRAY_H
+/*
+ * Indexed arrays, the values of array variables.
+ *
+ * An array is a vector of elements indexed by subscript, up to the
+ * highest subscript set, in which the elements not set are empty.
+ * An element is a view of the bytes of its value: either those of a
+ * value (see value.h) that the element holds a reference to, or a
+ * line of one of the array's texts, the buffers that mapfile reads
+ * whole files into.  Loading a file thus takes one allocation for
+ * its text and one for the vector, however many lines it has.
+ * The bytes of a line are not zero-terminated; an element is turned
+ * into a value of its own the first time one is asked for.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+/* The highest subscript plus one that an array can have. */
+#define ARRAY_MAX   ((size_t) 1 << 27)
+
+struct array_elem {
+    const char *str;        /* NULL if not set */
+    uint32_t len;
+    bool text;              /* str is in one of the array's texts, rather
+                               than the str of a value */
+};
+
+struct array {
+    struct array_elem *elems;
+    size_t n, cap;          /* the highest subscript set plus one */
+    size_t nset;            /* elements set */
+    char **texts;
+    size_t ntexts;
+};
+
+struct array *array_new(void);
+
+void array_free(struct array *a);
+
+/* Return a copy of a, whose elements are values of their own. */
+struct array *array_copy(struct array *a);
+
+/* Return element i of a, or NULL if it is not set. */
+static inline const struct array_elem *
+array_get(const struct array *a, size_t i)
+{
+    return i < a->n && a->elems[i].str != NULL ? &a->elems[i] : NULL;
+}
+
+/* Return element i of a as a value, without taking a reference, or
+ * NULL if it is not set. */
+struct value *array_value(struct array *a, size_t i);
+
+/* Set element i of a, which must be below ARRAY_MAX, to val, passing
+ * on the caller's reference to it, or unset it if val is NULL. */
+void array_set(struct array *a, size_t i, struct value *val);
+
+/* Make room for elements up to n - 1, which must not exceed ARRAY_MAX. */
+void array_reserve(struct array *a, size_t n);
+
+/*
+ * Set elements from origin on to the lines of the len bytes of text
+ * at s, which are ended by delim, skipping the first skip of them and
+ * keeping at most max, removing the delimiters if trim.  The array
+ * takes text, which s points into, and frees it with itself.
+ * Returns the number of lines set, or stops short of ARRAY_MAX.
+ */
+size_t array_load_lines(struct array *a, size_t origin, char *text, const char *s,
+                        size_t len, char delim, bool trim, size_t skip, size_t max);
+
+#endif /* __ARRAY_H */
@@ -0,0 +1,1206 @@
+/*
+ * Builtin commands that need no access to the shell's state:
+ * true, false, :, echo, printf, test, [, and expr.
+ *
+ * They follow bash's behavior, including its diagnostics and
+ * exit statuses.
+ */
+#define _GNU_SOURCE    1
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "builtins.h"
+
+/* All builtins, sorted by name for bsearch. */
+static const struct builtin_name {
+    const char *name;
+    enum ir_builtin id;
+} builtin_names[] = {
+    { ":",          IR_BUILTIN_TRUE },
+    { "[",          IR_BUILTIN_TEST },
+    { "break",      IR_BUILTIN_BREAK },
+    { "continue",   IR_BUILTIN_CONTINUE },
+    { "echo",       IR_BUILTIN_ECHO },
+    { "expr",       IR_BUILTIN_EXPR },
+    { "false",      IR_BUILTIN_FALSE },
+    { "hash",       IR_BUILTIN_HASH },
+    { "let",        IR_BUILTIN_LET },
+    { "mapfile",    IR_BUILTIN_MAPFILE },
+    { "printf",     IR_BUILTIN_PRINTF },
+    { "read",       IR_BUILTIN_READ },
+    { "readarray",  IR_BUILTIN_MAPFILE },
+    { "return",     IR_BUILTIN_RETURN },
+    { "test",       IR_BUILTIN_TEST },
+    { "true",       IR_BUILTIN_TRUE },
+    { "type",       IR_BUILTIN_TYPE },
+    { "wait",       IR_BUILTIN_WAIT },
+};
+
+static int
+compare_builtin_name(const void *key, const void *elem)
+{
+    return strcmp(key, ((const struct builtin_name *) elem)->name);
+}
+
+enum ir_builtin
+builtin_lookup(const char *name)
+{
+    const struct builtin_name *b = bsearch(name, builtin_names,
+        sizeof builtin_names / sizeof builtin_names[0], sizeof builtin_names[0],
+        compare_builtin_name);
+    return b != NULL ? b->id : IR_BUILTIN_NONE;
+}
+
+int
+builtin_true(int argc, char *argv[])
+{
+    return 0;
+}
+
+int
+builtin_false(int argc, char *argv[])
+{
+    return 1;
+}
+
+
+/* Flush stdout on behalf of builtin name; returns false, after
+ * reporting why, if the output could not be written. */
+static bool
+flush_output(const char *name)
+{
+    if (fflush(stdout) == 0 || errno == EPIPE) {
+        clearerr(stdout);
+        return true;
+    }
+    fprintf(stderr, "minibash: %s: write error: %s\n", name, strerror(errno));
+    clearerr(stdout);
+    return false;
+}
+
+/*
+ * Backslash escapes, as understood by echo -e, printf's format,
+ * and printf's %b.  They differ only in how octal escapes look.
+ */
+enum escape_style {
+    ESCAPE_ECHO,        /* \0nnn */
+    ESCAPE_FORMAT,      /* \nnn */
+    ESCAPE_B,           /* \0nnn or \nnn */
+};
+
+static int
+hexval(int c)
+{
+    return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+/* Write code point cp in UTF-8. */
+static void
+put_utf8(uint32_t cp, FILE *out)
+{
+    if (cp < 0x80) {
+        putc(cp, out);
+    } else if (cp < 0x800) {
+        putc(0xc0 | cp >> 6, out);
+        putc(0x80 | (cp & 0x3f), out);
+    } else if (cp < 0x10000) {
+        putc(0xe0 | cp >> 12, out);
+        putc(0x80 | (cp >> 6 & 0x3f), out);
+        putc(0x80 | (cp & 0x3f), out);
+    } else {
+        putc(0xf0 | cp >> 18, out);
+        putc(0x80 | (cp >> 12 & 0x3f), out);
+        putc(0x80 | (cp >> 6 & 0x3f), out);
+        putc(0x80 | (cp & 0x3f), out);
+    }
+}
+
+/*
+ * Write the escape sequence following the backslash at s to out.
+ * Returns the number of characters after the backslash that were
+ * consumed; sets *stop for \c, which ends all output.
+ */
+static size_t
+put_escape(const char *s, enum escape_style style, bool *stop, FILE *out)
+{
+    static const char from[] = "abeEfnrtv\\";
+    static const char to[]   = "\a\b\033\033\f\n\r\t\v\\";
+    const char *e;
+    size_t i = 0;
+    unsigned val = 0;
+
+    if (*s != '\0' && (e = strchr(from, *s)) != NULL) {
+        putc(to[e - from], out);
+        return 1;
+    }
+
+    switch (*s) {
+    case 'c':
+        if (style == ESCAPE_FORMAT)
+            break;
+        *stop = true;
+        return 1;
+    case '"':
+    case '\'':
+        if (style != ESCAPE_FORMAT)
+            break;
+        putc(*s, out);
+        return 1;
+    case 'x':
+        for (i = 1; i < 3 && isxdigit((unsigned char) s[i]); i++)
+            val = val * 16 + hexval(s[i]);
+        if (i == 1)
+            break;
+        putc(val, out);
+        return i;
+    case 'u':
+    case 'U':
+        for (i = 1; i < (*s == 'u' ? 5 : 9) && isxdigit((unsigned char) s[i]); i++)
+            val = val * 16 + hexval(s[i]);
+        if (i == 1)
+            break;
+        put_utf8(val, out);
+        return i;
+    case '0' ... '7':
+        if (style == ESCAPE_ECHO && *s != '0')
+            break;
+        i = (style != ESCAPE_FORMAT && *s == '0') ? 1 : 0;
+        size_t max = i + 3;
+        for (; i < max && s[i] >= '0' && s[i] <= '7'; i++)
+            val = val * 8 + s[i] - '0';
+        putc(val & 0xff, out);
+        return i;
+    }
+
+    /* not an escape sequence */
+    putc('\\', out);
+    if (*s == '\0')
+        return 0;
+    putc(*s, out);
+    return 1;
+}
+
+/* Write s, interpreting backslash escapes.  Returns false after \c. */
+static bool
+put_escaped(const char *s, enum escape_style style, FILE *out)
+{
+    bool stop = false;
+    while (*s != '\0' && !stop) {
+        if (*s == '\\')
+            s += 1 + put_escape(s + 1, style, &stop, out);
+        else
+            putc(*s++, out);
+    }
+    return !stop;
+}
+
+/* echo [-neE] [arg ...] */
+int
+builtin_echo(int argc, char *argv[])
+{
+    bool newline = true, escapes = false;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        if (opt[0] != '-' || opt[1] == '\0'
+            || strspn(opt + 1, "neE") != strlen(opt + 1))
+            break;
+        for (opt++; *opt != '\0'; opt++) {
+            if (*opt == 'n')
+                newline = false;
+            else
+                escapes = *opt == 'e';
+        }
+    }
+
+    for (; i < argc; i++) {
+        if (escapes) {
+            if (!put_escaped(argv[i], ESCAPE_ECHO, stdout))
+                goto out;
+        } else {
+            fputs(argv[i], stdout);
+        }
+        if (i + 1 < argc)
+            putchar(' ');
+    }
+    if (newline)
+        putchar('\n');
+out:
+    return flush_output("echo") ? 0 : 1;
+}
+
+/*
+ * printf
+ */
+
+/* Convert a printf argument to an integer: C integer syntax, or a
+ * quote followed by a character, which yields the character's code. */
+static intmax_t
+printf_number(const char *arg, bool *ok)
+{
+    if (arg[0] == '\'' || arg[0] == '"')
+        return (unsigned char) arg[1];
+
+    char *end;
+    errno = 0;
+    intmax_t n = strtoimax(arg, &end, 0);
+    if (*arg == '\0')
+        return 0;
+    while (isspace((unsigned char) *end))
+        end++;
+    if (end == arg || *end != '\0' || errno == ERANGE) {
+        fprintf(stderr, "minibash: printf: %s: %s\n", arg,
+                errno == ERANGE ? "Numerical result out of range" : "invalid number");
+        *ok = false;
+    }
+    return n;
+}
+
+static long double
+printf_float(const char *arg, bool *ok)
+{
+    if (arg[0] == '\'' || arg[0] == '"')
+        return (unsigned char) arg[1];
+    if (*arg == '\0')
+        return 0;
+
+    char *end;
+    long double d = strtold(arg, &end);
+    if (end == arg || *end != '\0') {
+        fprintf(stderr, "minibash: printf: %s: invalid number\n", arg);
+        *ok = false;
+    }
+    return d;
+}
+
+/* %q of s, which has control characters: $'...', in which they are
+ * escaped. */
+static void
+put_ansi_c_quoted(const char *s, FILE *out)
+{
+    static const char controls[] = "\a\b\033\f\n\r\t\v";
+    static const char letters[] = "abEfnrtv";
+    fputs("$'", out);
+    for (; *s != '\0'; s++) {
+        const char *c = strchr(controls, *s);
+        if (c != NULL)
+            fprintf(out, "\\%c", letters[c - controls]);
+        else if (*s == '\\' || *s == '\'')
+            fprintf(out, "\\%c", *s);
+        else if (iscntrl((unsigned char) *s))
+            fprintf(out, "\\%03o", (unsigned char) *s);
+        else
+            putc(*s, out);
+    }
+    putc('\'', out);
+}
+
+/* %q: quote s so that the shell reads it back as a single word. */
+static void
+put_quoted(const char *s, FILE *out)
+{
+    if (*s == '\0') {
+        fputs("''", out);
+        return;
+    }
+    for (const char *p = s; *p != '\0'; p++)
+        if (iscntrl((unsigned char) *p)) {
+            put_ansi_c_quoted(s, out);
+            return;
+        }
+    for (; *s != '\0'; s++) {
+        if (strchr(" '\"\\|&;()<>{}[]*?$`!#~=%,", *s) != NULL)
+            putc('\\', out);
+        putc(*s, out);
+    }
+}
+
+/*
+ * Write one conversion of the format.  spec is the conversion
+ * specification without the length modifier, e.g., "%-*.*d".
+ */
+static bool
+put_conversion(char *spec, size_t speclen, char conv,
+               bool havewidth, int width, bool haveprec, int prec,
+               const char *arg, bool *ok)
+{
+    char fmt[64];
+    if (speclen + 3 > sizeof fmt) {
+        fprintf(stderr, "minibash: printf: %s: invalid format\n", spec);
+        *ok = false;
+        return true;
+    }
+    memcpy(fmt, spec, speclen);
+
+    /* %b, %q and %c are done in terms of %s */
+    switch (conv) {
+    case 'd': case 'i':
+        strcpy(fmt + speclen, "jd");
+        fmt[speclen + 1] = conv;
+        break;
+    case 'o': case 'u': case 'x': case 'X':
+        fmt[speclen] = 'j';
+        fmt[speclen + 1] = conv;
+        fmt[speclen + 2] = '\0';
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        fmt[speclen] = 'L';
+        fmt[speclen + 1] = conv;
+        fmt[speclen + 2] = '\0';
+        break;
+    default:
+        fmt[speclen] = 's';
+        fmt[speclen + 1] = '\0';
+        break;
+    }
+
+    char *out = NULL;
+    int len;
+    char cbuf[2] = { arg[0], '\0' };
+#define FORMAT(value) \
+    (havewidth && haveprec ? asprintf(&out, fmt, width, prec, value) \
+     : havewidth ? asprintf(&out, fmt, width, value) \
+     : haveprec ? asprintf(&out, fmt, prec, value) \
+     : asprintf(&out, fmt, value))
+
+    switch (conv) {
+    case 'd': case 'i':
+        len = FORMAT(printf_number(arg, ok));
+        break;
+    case 'o': case 'u': case 'x': case 'X':
+        len = FORMAT((uintmax_t) printf_number(arg, ok));
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        len = FORMAT(printf_float(arg, ok));
+        break;
+    case 'c':
+        len = FORMAT(cbuf);
+        break;
+    case 's':
+        len = FORMAT(arg);
+        break;
+    case 'b':
+    case 'q': {
+        /* render into a memory stream, then pad as a string */
+        char *buf;
+        size_t buflen;
+        bool more = true;
+        FILE *mem = open_memstream(&buf, &buflen);
+        if (mem == NULL)
+            return true;
+        if (conv == 'b')
+            more = put_escaped(arg, ESCAPE_B, mem);
+        else
+            put_quoted(arg, mem);
+        fclose(mem);
+        len = FORMAT(buf);
+        free(buf);
+        if (!more) {
+            if (len >= 0)
+                fwrite(out, 1, len, stdout);
+            free(out);
+            return false;
+        }
+        break;
+    }
+    default:
+        fprintf(stderr, "minibash: printf: `%c': invalid format character\n", conv);
+        *ok = false;
+        return false;
+    }
+#undef FORMAT
+
+    if (len >= 0)
+        fwrite(out, 1, len, stdout);
+    free(out);
+    return true;
+}
+
+/* Return the next argument, or "" once they are used up. */
+static const char *
+next_arg(char **args, int nargs, int *used)
+{
+    return *used < nargs ? args[(*used)++] : "";
+}
+
+/*
+ * Write the format once, consuming arguments from args[*used ..).
+ * Returns false if output was ended by \c or an error.
+ */
+static bool
+printf_once(const char *format, char **args, int nargs, int *used, bool *ok)
+{
+    const char *s = format;
+    bool stop = false;
+
+    while (*s != '\0') {
+        if (*s == '\\') {
+            s += 1 + put_escape(s + 1, ESCAPE_FORMAT, &stop, stdout);
+            if (stop)
+                return false;
+            continue;
+        }
+        if (*s != '%') {
+            putchar(*s++);
+            continue;
+        }
+        if (s[1] == '%') {
+            putchar('%');
+            s += 2;
+            continue;
+        }
+
+        /* %[flags][width][.precision][length]conversion */
+        const char *start = s++;
+        bool havewidth = false, haveprec = false;
+        int width = 0, prec = 0;
+
+        s += strspn(s, "-+ #0'");
+        if (*s == '*') {
+            havewidth = true;
+            width = printf_number(next_arg(args, nargs, used), ok);
+            s++;
+        } else {
+            while (isdigit((unsigned char) *s))
+                s++;
+        }
+        if (*s == '.') {
+            s++;
+            if (*s == '*') {
+                haveprec = true;
+                prec = printf_number(next_arg(args, nargs, used), ok);
+                s++;
+            } else {
+                while (isdigit((unsigned char) *s))
+                    s++;
+            }
+        }
+
+        /* length modifiers are accepted and ignored */
+        size_t speclen = s - start;
+        s += strspn(s, "hlLjzt");
+        if (*s == '\0') {
+            fprintf(stderr, "minibash: printf: `%s': missing format character\n", start);
+            *ok = false;
+            return false;
+        }
+
+        char spec[64];
+        snprintf(spec, sizeof spec, "%.*s", (int) speclen, start);
+        char conv = *s++;
+        if (!put_conversion(spec, speclen, conv, havewidth, width,
+                            haveprec, prec, next_arg(args, nargs, used), ok))
+            return false;
+    }
+    return true;
+}
+
+/* printf format [arguments] */
+int
+builtin_printf(int argc, char *argv[])
+{
+    int i = 1;
+    if (i < argc && strcmp(argv[i], "--") == 0)
+        i++;
+    if (i >= argc) {
+        fprintf(stderr, "minibash: printf: usage: printf format [arguments]\n");
+        return 2;
+    }
+
+    const char *format = argv[i++];
+    char **args = argv + i;
+    int nargs = argc - i;
+    int used = 0;
+    bool ok = true;
+
+    /* the format is reused as long as arguments remain */
+    do {
+        int before = used;
+        if (!printf_once(format, args, nargs, &used, &ok) || used == before)
+            break;
+    } while (used < nargs);
+
+    if (!flush_output("printf"))
+        ok = false;
+    return ok ? 0 : 1;
+}
+
+/*
+ * test and [
+ */
+struct test_state {
+    const char *name;   /* test or [ */
+    char **argv;
+    int argc;
+    int pos;
+    bool error;
+};
+
+static void
+test_error(struct test_state *t, const char *arg, const char *msg)
+{
+    if (!t->error) {
+        if (arg != NULL)
+            fprintf(stderr, "minibash: %s: %s: %s\n", t->name, arg, msg);
+        else
+            fprintf(stderr, "minibash: %s: %s\n", t->name, msg);
+    }
+    t->error = true;
+}
+
+/* Parse an integer operand as test does: optional blanks and sign,
+ * then decimal digits. */
+static intmax_t
+test_integer(struct test_state *t, const char *s)
+{
+    const char *p = s;
+    while (isspace((unsigned char) *p))
+        p++;
+    char *end;
+    errno = 0;
+    intmax_t n = strtoimax(p, &end, 10);
+    if (end != p)
+        while (isspace((unsigned char) *end))
+            end++;
+    if (end == p || *end != '\0' || !(isdigit((unsigned char) *p) || *p == '-' || *p == '+')
+        || errno == ERANGE)
+        test_error(t, s, "integer expression expected");
+    return n;
+}
+
+static bool
+is_unary_op(const char *op)
+{
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0'
+        && strchr("abcdefghknoprstuwxzGLNOS", op[1]) != NULL;
+}
+
+static bool
+is_binary_op(const char *op)
+{
+    static const char *const ops[] = {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+        "-nt", "-ot", "-ef", "-a", "-o",
+    };
+    for (size_t i = 0; i < sizeof ops / sizeof ops[0]; i++)
+        if (strcmp(op, ops[i]) == 0)
+            return true;
+    return false;
+}
+
+static bool
+test_unary(struct test_state *t, char op, const char *arg)
+{
+    struct stat st;
+
+    switch (op) {
+    case 'z':
+        return *arg == '\0';
+    case 'n':
+        return *arg != '\0';
+    case 't': {
+        intmax_t fd = test_integer(t, arg);
+        return fd >= 0 && fd <= INT_MAX && isatty(fd);
+    }
+    case 'o':   /* shell options are not supported */
+        return false;
+    case 'r':
+        return access(arg, R_OK) == 0;
+    case 'w':
+        return access(arg, W_OK) == 0;
+    case 'x':
+        return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    }
+
+    if (stat(arg, &st) != 0)
+        return false;
+
+    switch (op) {
+    case 'a':
+    case 'e':
+        return true;
+    case 'b':
+        return S_ISBLK(st.st_mode);
+    case 'c':
+        return S_ISCHR(st.st_mode);
+    case 'd':
+        return S_ISDIR(st.st_mode);
+    case 'f':
+        return S_ISREG(st.st_mode);
+    case 'g':
+        return (st.st_mode & S_ISGID) != 0;
+    case 'k':
+        return (st.st_mode & S_ISVTX) != 0;
+    case 'p':
+        return S_ISFIFO(st.st_mode);
+    case 's':
+        return st.st_size > 0;
+    case 'u':
+        return (st.st_mode & S_ISUID) != 0;
+    case 'G':
+        return st.st_gid == getegid();
+    case 'N':
+        return st.st_mtime > st.st_atime;
+    case 'O':
+        return st.st_uid == geteuid();
+    case 'S':
+        return S_ISSOCK(st.st_mode);
+    }
+    return false;
+}
+
+/* Compare modification times; a missing file is older than any other. */
+static int
+compare_mtime(const char *a, const char *b)
+{
+    struct stat sa, sb;
+    bool hasa = stat(a, &sa) == 0, hasb = stat(b, &sb) == 0;
+    if (!hasa || !hasb)
+        return hasa - hasb;
+    if (sa.st_mtim.tv_sec != sb.st_mtim.tv_sec)
+        return sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ? -1 : 1;
+    if (sa.st_mtim.tv_nsec != sb.st_mtim.tv_nsec)
+        return sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static bool
+test_binary(struct test_state *t, const char *a, const char *op, const char *b)
+{
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(a, b) == 0;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(a, b) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcmp(a, b) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcmp(a, b) > 0;
+    if (strcmp(op, "-a") == 0)
+        return *a != '\0' && *b != '\0';
+    if (strcmp(op, "-o") == 0)
+        return *a != '\0' || *b != '\0';
+    if (strcmp(op, "-nt") == 0)
+        return compare_mtime(a, b) > 0;
+    if (strcmp(op, "-ot") == 0)
+        return compare_mtime(a, b) < 0;
+    if (strcmp(op, "-ef") == 0) {
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0
+            && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    intmax_t x = test_integer(t, a), y = test_integer(t, b);
+    if (strcmp(op, "-eq") == 0)
+        return x == y;
+    if (strcmp(op, "-ne") == 0)
+        return x != y;
+    if (strcmp(op, "-lt") == 0)
+        return x < y;
+    if (strcmp(op, "-le") == 0)
+        return x <= y;
+    if (strcmp(op, "-gt") == 0)
+        return x > y;
+    return x >= y;
+}
+
+static const char *
+test_peek(struct test_state *t, int ahead)
+{
+    return t->pos + ahead < t->argc ? t->argv[t->pos + ahead] : NULL;
+}
+
+static bool test_or(struct test_state *t);
+
+/* primary: ( expr ) | unary-op arg | arg binary-op arg | arg */
+static bool
+test_primary(struct test_state *t)
+{
+    const char *a = test_peek(t, 0);
+    if (a == NULL) {
+        test_error(t, t->pos > 0 ? t->argv[t->pos - 1] : NULL, "argument expected");
+        return false;
+    }
+
+    if (strcmp(a, "(") == 0) {
+        t->pos++;
+        bool v = test_or(t);
+        const char *close = test_peek(t, 0);
+        if (close == NULL || strcmp(close, ")") != 0)
+            test_error(t, NULL, "`)' expected");
+        else
+            t->pos++;
+        return v;
+    }
+
+    const char *op = test_peek(t, 1);
+    if (op != NULL && is_binary_op(op) && strcmp(op, "-a") != 0
+        && strcmp(op, "-o") != 0 && test_peek(t, 2) != NULL) {
+        t->pos += 3;
+        return test_binary(t, a, op, t->argv[t->pos - 1]);
+    }
+
+    if (is_unary_op(a) && op != NULL) {
+        t->pos += 2;
+        return test_unary(t, a[1], op);
+    }
+    if (is_unary_op(a) && op == NULL) {
+        /* a lone operator is a string */
+        t->pos++;
+        return true;
+    }
+
+    t->pos++;
+    return *a != '\0';
+}
+
+static bool
+test_not(struct test_state *t)
+{
+    const char *a = test_peek(t, 0);
+    if (a != NULL && strcmp(a, "!") == 0 && test_peek(t, 1) != NULL) {
+        t->pos++;
+        return !test_not(t);
+    }
+    return test_primary(t);
+}
+
+static bool
+test_and(struct test_state *t)
+{
+    bool v = test_not(t);
+    const char *op;
+    while ((op = test_peek(t, 0)) != NULL && strcmp(op, "-a") == 0) {
+        t->pos++;
+        v = test_not(t) && v;
+    }
+    return v;
+}
+
+static bool
+test_or(struct test_state *t)
+{
+    bool v = test_and(t);
+    const char *op;
+    while ((op = test_peek(t, 0)) != NULL && strcmp(op, "-o") == 0) {
+        t->pos++;
+        v = test_and(t) || v;
+    }
+    return v;
+}
+
+/* Evaluate argv[0 .. argc) with the POSIX rules for up to four
+ * arguments, falling back to the full grammar. */
+static bool
+test_eval(struct test_state *t, char **argv, int argc)
+{
+    t->argv = argv;
+    t->argc = argc;
+    t->pos = 0;
+
+    switch (argc) {
+    case 0:
+        return false;
+    case 1:
+        return argv[0][0] != '\0';
+    case 2:
+        if (strcmp(argv[0], "!") == 0)
+            return argv[1][0] == '\0';
+        if (is_unary_op(argv[0]))
+            return test_unary(t, argv[0][1], argv[1]);
+        test_error(t, argv[0], "unary operator expected");
+        return false;
+    case 3:
+        if (is_binary_op(argv[1]))
+            return test_binary(t, argv[0], argv[1], argv[2]);
+        if (strcmp(argv[0], "!") == 0)
+            return !test_eval(t, argv + 1, 2);
+        if (strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0)
+            return argv[1][0] != '\0';
+        break;
+    case 4:
+        if (strcmp(argv[0], "!") == 0)
+            return !test_eval(t, argv + 1, 3);
+        if (strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0)
+            return test_eval(t, argv + 1, 2);
+        break;
+    }
+
+    t->argv = argv;
+    t->argc = argc;
+    t->pos = 0;
+    bool v = test_or(t);
+    if (t->pos < argc) {
+        test_error(t, argv[t->pos], argc == 3 ? "binary operator expected"
+                                              : "too many arguments");
+    }
+    return v;
+}
+
+/* test expr, [ expr ] */
+int
+builtin_test(int argc, char *argv[])
+{
+    if (strcmp(argv[0], "[") == 0) {
+        if (strcmp(argv[argc - 1], "]") != 0) {
+            fprintf(stderr, "minibash: [: missing `]'\n");
+            return 2;
+        }
+        argc--;
+    }
+
+    struct test_state t = { .name = argv[0] };
+    bool v = test_eval(&t, argv + 1, argc - 1);
+    if (t.error)
+        return 2;
+    return v ? 0 : 1;
+}
+
+/*
+ * expr
+ */
+struct expr_state {
+    char **argv;
+    int argc;
+    int pos;
+    int status;         /* 2 for syntax errors, 3 for others */
+    char **values;      /* all values allocated, freed at the end */
+    int nvalues, capvalues;
+};
+
+static char *
+expr_value(struct expr_state *e, char *v)
+{
+    if (v == NULL) {
+        perror("minibash: expr");
+        exit(3);
+    }
+    if (e->nvalues == e->capvalues) {
+        e->capvalues = e->capvalues ? 2 * e->capvalues : 16;
+        e->values = realloc(e->values, e->capvalues * sizeof *e->values);
+        if (e->values == NULL) {
+            perror("minibash: expr");
+            exit(3);
+        }
+    }
+    e->values[e->nvalues++] = v;
+    return v;
+}
+
+static char *
+expr_int(struct expr_state *e, intmax_t n)
+{
+    char *s;
+    if (asprintf(&s, "%jd", n) == -1)
+        s = NULL;
+    return expr_value(e, s);
+}
+
+static void
+expr_error(struct expr_state *e, int status, const char *fmt, const char *arg)
+{
+    if (e->status == 0) {
+        fputs("minibash: expr: ", stderr);
+        fprintf(stderr, fmt, arg);
+        fputc('\n', stderr);
+        e->status = status;
+    }
+}
+
+/* Is s an integer, and if so, what is its value? */
+static bool
+expr_to_int(const char *s, intmax_t *n)
+{
+    const char *p = s;
+    if (*p == '-')
+        p++;
+    if (*p == '\0' || strspn(p, "0123456789") != strlen(p))
+        return false;
+    errno = 0;
+    *n = strtoimax(s, NULL, 10);
+    return errno == 0;
+}
+
+/* A null value is the empty string or 0. */
+static bool
+expr_null(const char *s)
+{
+    intmax_t n;
+    return *s == '\0' || (expr_to_int(s, &n) && n == 0);
+}
+
+static intmax_t
+expr_need_int(struct expr_state *e, const char *s)
+{
+    intmax_t n = 0;
+    if (!expr_to_int(s, &n))
+        expr_error(e, 2, "%s", "non-integer argument");
+    return n;
+}
+
+static const char *
+expr_peek(struct expr_state *e)
+{
+    return e->pos < e->argc ? e->argv[e->pos] : NULL;
+}
+
+/* Consume the next argument, which must exist. */
+static char *
+expr_next(struct expr_state *e)
+{
+    if (e->pos >= e->argc) {
+        if (e->pos > 0)
+            expr_error(e, 2, "syntax error: missing argument after '%s'",
+                       e->argv[e->pos - 1]);
+        else
+            expr_error(e, 2, "%s", "syntax error: missing argument");
+        return "";
+    }
+    return e->argv[e->pos++];
+}
+
+/* str : regex, anchored at the start of str */
+static char *
+expr_match(struct expr_state *e, const char *str, const char *pattern)
+{
+    regex_t re;
+    regmatch_t m[2];
+    int rc = regcomp(&re, pattern, 0);
+    if (rc != 0) {
+        char msg[256];
+        regerror(rc, &re, msg, sizeof msg);
+        expr_error(e, 2, "%s", msg);
+        return "";
+    }
+
+    char *result;
+    bool matched = regexec(&re, str, 2, m, 0) == 0 && m[0].rm_so == 0;
+    if (re.re_nsub > 0) {
+        if (matched && m[1].rm_so != -1)
+            result = expr_value(e, strndup(str + m[1].rm_so, m[1].rm_eo - m[1].rm_so));
+        else
+            result = "";
+    } else {
+        result = expr_int(e, matched ? (intmax_t) mbstowcs(NULL,
+                          strndupa(str, m[0].rm_eo), 0) : 0);
+    }
+    regfree(&re);
+    return result;
+}
+
+static char *expr_or(struct expr_state *e);
+
+/* ( expr ) | match | substr | index | length | + token | token */
+static char *
+expr_primary(struct expr_state *e)
+{
+    const char *tok = expr_peek(e);
+    if (tok == NULL)
+        return expr_next(e);
+
+    if (strcmp(tok, "(") == 0) {
+        e->pos++;
+        char *v = expr_or(e);
+        const char *close = expr_peek(e);
+        if (close == NULL || strcmp(close, ")") != 0) {
+            if (close == NULL)
+                expr_error(e, 2, "syntax error: expecting ')' after '%s'",
+                           e->argv[e->pos - 1]);
+            else
+                expr_error(e, 2, "syntax error: expecting ')' instead of '%s'", close);
+            return v;
+        }
+        e->pos++;
+        return v;
+    }
+    if (strcmp(tok, "+") == 0) {
+        e->pos++;
+        return expr_next(e);
+    }
+    if (strcmp(tok, "length") == 0) {
+        e->pos++;
+        return expr_int(e, mbstowcs(NULL, expr_next(e), 0));
+    }
+    if (strcmp(tok, "match") == 0) {
+        e->pos++;
+        char *str = expr_next(e);
+        return expr_match(e, str, expr_next(e));
+    }
+    if (strcmp(tok, "index") == 0) {
+        e->pos++;
+        char *str = expr_next(e);
+        char *chars = expr_next(e);
+        size_t i = strcspn(str, chars);
+        return expr_int(e, str[i] != '\0' ? (intmax_t) i + 1 : 0);
+    }
+    if (strcmp(tok, "substr") == 0) {
+        e->pos++;
+        char *str = expr_next(e);
+        char *p = expr_next(e), *l = expr_next(e);
+        intmax_t pos, len;
+        size_t slen = strlen(str);
+        if (!expr_to_int(p, &pos) || !expr_to_int(l, &len)
+            || pos < 1 || len < 1 || (size_t) pos > slen)
+            return "";
+        return expr_value(e, strndup(str + pos - 1, len));
+    }
+
+    e->pos++;
+    return (char *) tok;
+}
+
+/* str : regex */
+static char *
+expr_colon(struct expr_state *e)
+{
+    char *v = expr_primary(e);
+    const char *op;
+    while ((op = expr_peek(e)) != NULL && strcmp(op, ":") == 0) {
+        e->pos++;
+        v = expr_match(e, v, expr_primary(e));
+    }
+    return v;
+}
+
+static char *
+expr_mul(struct expr_state *e)
+{
+    char *v = expr_colon(e);
+    const char *op;
+    while ((op = expr_peek(e)) != NULL
+           && (strcmp(op, "*") == 0 || strcmp(op, "/") == 0 || strcmp(op, "%") == 0)) {
+        e->pos++;
+        char *w = expr_colon(e);
+        intmax_t a = expr_need_int(e, v), b = expr_need_int(e, w);
+        if (e->status != 0)
+            return "";
+        if (*op != '*' && b == 0) {
+            expr_error(e, 2, "%s", "division by zero");
+            return "";
+        }
+        v = expr_int(e, *op == '*' ? a * b : *op == '/' ? a / b : a % b);
+    }
+    return v;
+}
+
+static char *
+expr_add(struct expr_state *e)
+{
+    char *v = expr_mul(e);
+    const char *op;
+    while ((op = expr_peek(e)) != NULL && (strcmp(op, "+") == 0 || strcmp(op, "-") == 0)) {
+        e->pos++;
+        char *w = expr_mul(e);
+        intmax_t a = expr_need_int(e, v), b = expr_need_int(e, w);
+        if (e->status != 0)
+            return "";
+        v = expr_int(e, *op == '+' ? a + b : a - b);
+    }
+    return v;
+}
+
+/* Comparisons are numeric if both sides are integers. */
+static char *
+expr_compare(struct expr_state *e)
+{
+    static const char *const ops[] = { "<", "<=", "=", "==", "!=", ">=", ">" };
+    char *v = expr_add(e);
+    const char *op;
+    for (;;) {
+        size_t i;
+        op = expr_peek(e);
+        for (i = 0; op != NULL && i < sizeof ops / sizeof ops[0]; i++)
+            if (strcmp(op, ops[i]) == 0)
+                break;
+        if (op == NULL || i == sizeof ops / sizeof ops[0])
+            return v;
+
+        e->pos++;
+        char *w = expr_add(e);
+        intmax_t a, b;
+        int cmp;
+        if (expr_to_int(v, &a) && expr_to_int(w, &b))
+            cmp = (a > b) - (a < b);
+        else
+            cmp = strcoll(v, w);
+
+        bool r;
+        switch (i) {
+        case 0: r = cmp < 0; break;
+        case 1: r = cmp <= 0; break;
+        case 2: case 3: r = cmp == 0; break;
+        case 4: r = cmp != 0; break;
+        case 5: r = cmp >= 0; break;
+        default: r = cmp > 0; break;
+        }
+        v = r ? "1" : "0";
+    }
+}
+
+static char *
+expr_and(struct expr_state *e)
+{
+    char *v = expr_compare(e);
+    const char *op;
+    while ((op = expr_peek(e)) != NULL && strcmp(op, "&") == 0) {
+        e->pos++;
+        char *w = expr_compare(e);
+        if (expr_null(v) || expr_null(w))
+            v = "0";
+    }
+    return v;
+}
+
+static char *
+expr_or(struct expr_state *e)
+{
+    char *v = expr_and(e);
+    const char *op;
+    while ((op = expr_peek(e)) != NULL && strcmp(op, "|") == 0) {
+        e->pos++;
+        char *w = expr_and(e);
+        if (expr_null(v))
+            v = expr_null(w) ? "0" : w;
+    }
+    return v;
+}
+
+/* expr expression: exit status 0 if the result is neither null nor 0,
+ * 1 if it is, 2 for invalid expressions */
+int
+builtin_expr(int argc, char *argv[])
+{
+    struct expr_state e = { .argv = argv + 1, .argc = argc - 1 };
+    if (e.argc > 0 && strcmp(e.argv[0], "--") == 0) {
+        e.argv++;
+        e.argc--;
+    }
+
+    char *v = expr_or(&e);
+    if (e.status == 0 && e.pos < e.argc)
+        expr_error(&e, 2, "syntax error: unexpected argument '%s'", e.argv[e.pos]);
+
+    int status = e.status;
+    if (status == 0) {
+        puts(v);
+        status = !flush_output("expr") ? 2 : expr_null(v) ? 1 : 0;
+    }
+
+    for (int i = 0; i < e.nvalues; i++)
+        free(e.values[i]);
+    free(e.values);
+    return status;
+}
@@ -0,0 +1,27 @@
+#ifndef __BUILTINS_H
+#define __BUILTINS_H
+/*
+ * Commands the shell runs in-process rather than spawning them.
+ *
+ * Every builtin has the signature of main() and returns its exit
+ * status.  Builtins write to stdout and stderr through stdio, so
+ * that redirections of file descriptors 1 and 2 apply to them; the
+ * caller must fflush these streams before restoring redirected
+ * descriptors.
+ */
+#include "ir.h"
+
+typedef int builtin_fn(int argc, char *argv[]);
+
+/* Return the builtin called name, or IR_BUILTIN_NONE if there is none. */
+enum ir_builtin builtin_lookup(const char *name);
+
+/* The builtins that need no access to the shell's state. */
+int builtin_true(int argc, char *argv[]);
+int builtin_false(int argc, char *argv[]);
+int builtin_echo(int argc, char *argv[]);
+int builtin_printf(int argc, char *argv[]);
+int builtin_test(int argc, char *argv[]);
+int builtin_expr(int argc, char *argv[]);
+
+#endif /* __BUILTINS_H */
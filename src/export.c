@@ -0,0 +1,162 @@
+/*
+ * The export table, see export.h.
+ *
+ * Entries are kept in the order of their envp slots.  The strings
+ * inherited from the shell's own environment are used as they are
+ * until their variable is first set; strings built since are owned
+ * by the table.  The indices of dirty entries are kept on a stack,
+ * so bringing envp up to date touches only those.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "export.h"
+#include "utils.h"
+
+extern char **environ;
+
+struct export {
+    struct value *name;     /* interned */
+    struct value *val;      /* NULL until set by the shell */
+    bool owned;             /* envp[i] was built here */
+    bool dirty;             /* envp[i] is out of date */
+};
+
+static struct export *entries;
+static char **envp;         /* nentries + nappended + 1 slots */
+static int nentries, cap;
+
+static int *dirty;          /* indices of dirty entries */
+static int ndirty;
+
+/* The overlays of the command being started. */
+struct overlay {
+    int slot;               /* in envp */
+    char *saved;            /* what envp[slot] was */
+    char *str;
+};
+static struct overlay *overlays;
+static int noverlays, capoverlays;
+static int nappended;       /* overlays of names not in the table */
+
+static void *
+xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL)
+        utils_fatal_error("Could not allocate environment: ");
+    return p;
+}
+
+/* Return a malloc'd "name=val". */
+static char *
+format_entry(const struct value *name, const struct value *val)
+{
+    char *s = xrealloc(NULL, name->len + val->len + 2);
+    memcpy(s, name->str, name->len);
+    s[name->len] = '=';
+    memcpy(s + name->len + 1, val->str, val->len + 1);
+    return s;
+}
+
+/* Make room for n more envp slots besides the terminating NULL. */
+static void
+reserve(int n)
+{
+    if (nentries + nappended + n + 1 > cap) {
+        while (nentries + nappended + n + 1 > cap)
+            cap = cap ? 2 * cap : 64;
+        envp = xrealloc(envp, cap * sizeof *envp);
+        entries = xrealloc(entries, cap * sizeof *entries);
+        environ = envp;
+    }
+}
+
+void
+export_init(char **env, void (*define)(struct value *name, const char *val, int entry))
+{
+    for (char **e = env; *e != NULL; e++) {
+        const char *eq = strchr(*e, '=');
+        if (eq == NULL)
+            continue;
+        reserve(1);
+        struct value *name = value_intern(*e, eq - *e);
+        entries[nentries] = (struct export) { .name = name };
+        envp[nentries] = *e;
+        define(name, eq + 1, nentries);
+        nentries++;
+    }
+    reserve(0);
+    envp[nentries] = NULL;
+}
+
+void
+export_set(int entry, struct value *val)
+{
+    struct export *e = &entries[entry];
+    value_unref(e->val);
+    e->val = val;
+    if (!e->dirty) {
+        e->dirty = true;
+        dirty = xrealloc(dirty, (ndirty + 1) * sizeof *dirty);
+        dirty[ndirty++] = entry;
+    }
+}
+
+char **
+export_envp(void)
+{
+    while (ndirty > 0) {
+        int i = dirty[--ndirty];
+        struct export *e = &entries[i];
+        if (e->owned)
+            free(envp[i]);
+        envp[i] = format_entry(e->name, e->val);
+        e->owned = true;
+        e->dirty = false;
+    }
+    /* in case anything replaced environ, e.g., setenv */
+    environ = envp;
+    return envp;
+}
+
+void
+export_overlay(int entry, struct value *name, struct value *val)
+{
+    if (noverlays == capoverlays) {
+        capoverlays = capoverlays ? 2 * capoverlays : 8;
+        overlays = xrealloc(overlays, capoverlays * sizeof *overlays);
+    }
+
+    /* a name set twice is laid over its first overlay */
+    int slot = entry;
+    for (int i = 0; slot == -1 && i < noverlays; i++)
+        if (overlays[i].slot >= nentries
+            && strncmp(overlays[i].str, name->str, name->len) == 0
+            && overlays[i].str[name->len] == '=')
+            slot = overlays[i].slot;
+    if (slot == -1) {
+        reserve(1);
+        slot = nentries + nappended++;
+        envp[slot] = envp[slot + 1] = NULL;
+    }
+
+    struct overlay *o = &overlays[noverlays++];
+    o->slot = slot;
+    o->saved = envp[slot];
+    o->str = format_entry(name, val);
+    envp[slot] = o->str;
+}
+
+void
+export_overlay_done(void)
+{
+    /* in reverse, so that each slot gets back what it had first */
+    while (noverlays > 0) {
+        struct overlay *o = &overlays[--noverlays];
+        envp[o->slot] = o->saved;
+        free(o->str);
+    }
+    nappended = 0;
+    envp[nentries] = NULL;
+}
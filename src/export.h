@@ -0,0 +1,43 @@
+#ifndef __EXPORT_H
+#define __EXPORT_H
+/*
+ * The environment passed to the commands the shell starts.
+ *
+ * The table holds one entry per exported variable and keeps an envp
+ * array of "NAME=value" strings ready to be passed to execve.  Setting
+ * an exported variable only records its new value and marks its entry
+ * dirty; the entry's string is rebuilt the next time envp is asked
+ * for, so a variable assigned many times between commands is
+ * formatted once, and starting a command costs nothing for the
+ * entries that did not change.  environ points to envp as well, but
+ * is just as out of date between commands, so the shell looks up its
+ * own variables, e.g., PATH, rather than calling getenv.
+ *
+ * The NAME=value prefixes of a command are laid over the table for
+ * the duration of that command, replacing or adding the pointers of
+ * the entries they affect, and are then taken off again.
+ */
+#include <stdbool.h>
+
+#include "value.h"
+
+/* Take over the strings of env, calling define for each with the
+ * variable's name and value and the index of its entry. */
+void export_init(char **env, void (*define)(struct value *name, const char *val, int entry));
+
+/* Set the value of the entry, passing on the caller's reference. */
+void export_set(int entry, struct value *val);
+
+/* Return the envp array, bringing it up to date. */
+char **export_envp(void);
+
+/*
+ * Lay name=val over the table until export_overlay_done; entry is
+ * that of name, or -1 if it is not exported.  Must follow export_envp.
+ */
+void export_overlay(int entry, struct value *name, struct value *val);
+
+/* Take the overlays off again. */
+void export_overlay_done(void);
+
+#endif /* __EXPORT_H */
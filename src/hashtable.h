@@ -17,13 +17,13 @@ typedef struct entry {
 } entry;
 
 /* helpers ---------------------------------------------------------------- */
-static tommy_hash_t str_hash(const char *s)
+static inline tommy_hash_t str_hash(const char *s)
 {
     return tommy_hash_u32(0 /*seed*/, s, strlen(s));
 }
 
 /* tommy_search_func: return 0 when *obj* matches *arg* */
-static int str_cmp(const void *arg, const void *obj)
+static inline int str_cmp(const void *arg, const void *obj)
 {
     return strcmp((const char *)arg, ((const entry *)obj)->key);
 }
@@ -39,7 +39,7 @@ static int str_cmp(const void *arg, const void *obj)
  * @param k The key.
  * @param v The value.
  */
-static void
+static inline void
 hash_put(tommy_hashdyn* ht, const char* k, const char* v)
 {
     tommy_hash_t h = str_hash(k);
@@ -68,7 +68,7 @@ hash_put(tommy_hashdyn* ht, const char* k, const char* v)
  * @param k The key.
  * @return The value associated with the key, or NULL if the key is not found.
  */
-static const char *
+static inline const char *
 hash_get(tommy_hashdyn *ht, const char *k)
 {
     entry *e = tommy_hashdyn_search(ht, str_cmp, k, str_hash(k));
@@ -81,7 +81,7 @@ hash_get(tommy_hashdyn *ht, const char *k)
  * @param ht The hash table.
  * @param k The key to delete.
  */
-static void
+static inline void
 hash_del(tommy_hashdyn *ht, const char *k)
 {
     entry *e = tommy_hashdyn_remove(ht, str_cmp, k, str_hash(k));
@@ -97,7 +97,7 @@ hash_del(tommy_hashdyn *ht, const char *k)
  * 
  * @param _e A pointer to the entry to be freed.
  */
-static void
+static inline void
 hash_free(void *_e)
 {
     entry *e = _e;
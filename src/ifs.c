@@ -0,0 +1,95 @@
+/*
+ * Classifying bytes for word splitting, see ifs.h.
+ */
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "ifs.h"
+
+void
+ifs_init(struct ifs *ifs, const char *s, size_t len)
+{
+    memset(ifs->class, 0, sizeof ifs->class);
+    ifs->nchars = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        if (ifs->class[c] != 0)
+            continue;
+        ifs->class[c] = c == ' ' || c == '\t' || c == '\n' ? IFS_SPACE : IFS_DELIM;
+        if (ifs->nchars < IFS_VECTOR_MAX)
+            ifs->chars[ifs->nchars] = c;
+        ifs->nchars++;
+    }
+}
+
+static size_t
+span_scalar(const struct ifs *ifs, const unsigned char *s, size_t i, size_t len)
+{
+    while (i < len && ifs->class[s[i]] == 0)
+        i++;
+    return i;
+}
+
+#if defined(__x86_64__)
+/* SSE2 is part of x86-64, so this needs no check. */
+static size_t
+span_sse2(const struct ifs *ifs, const unsigned char *s, size_t len)
+{
+    __m128i chars[IFS_VECTOR_MAX];
+    for (int k = 0; k < ifs->nchars; k++)
+        chars[k] = _mm_set1_epi8(ifs->chars[k]);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+        __m128i match = _mm_cmpeq_epi8(v, chars[0]);
+        for (int k = 1; k < ifs->nchars; k++)
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(v, chars[k]));
+        unsigned bits = _mm_movemask_epi8(match);
+        if (bits != 0)
+            return i + __builtin_ctz(bits);
+    }
+    return span_scalar(ifs, s, i, len);
+}
+
+__attribute__((target("avx2")))
+static size_t
+span_avx2(const struct ifs *ifs, const unsigned char *s, size_t len)
+{
+    __m256i chars[IFS_VECTOR_MAX];
+    for (int k = 0; k < ifs->nchars; k++)
+        chars[k] = _mm256_set1_epi8(ifs->chars[k]);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (s + i));
+        __m256i match = _mm256_cmpeq_epi8(v, chars[0]);
+        for (int k = 1; k < ifs->nchars; k++)
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(v, chars[k]));
+        unsigned bits = _mm256_movemask_epi8(match);
+        if (bits != 0)
+            return i + __builtin_ctz(bits);
+    }
+    return span_scalar(ifs, s, i, len);
+}
+#endif
+
+size_t
+ifs_span(const struct ifs *ifs, const char *s, size_t len)
+{
+    const unsigned char *u = (const unsigned char *) s;
+    if (ifs->nchars == 0)
+        return len;
+    if (ifs->nchars > IFS_VECTOR_MAX)
+        return span_scalar(ifs, u, 0, len);
+#if defined(__x86_64__)
+    static int avx2 = -1;
+    if (avx2 == -1)
+        avx2 = __builtin_cpu_supports("avx2");
+    return avx2 ? span_avx2(ifs, u, len) : span_sse2(ifs, u, len);
+#else
+    return span_scalar(ifs, u, 0, len);
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef __IFS_H
+#define __IFS_H
+/*
+ * Classifying the bytes of expansion results for word splitting.
+ *
+ * The characters of $IFS are looked up in a table of 256 classes,
+ * built once for each value of IFS.  Finding the next IFS byte in a
+ * long result, the common case when splitting $(cat file), compares
+ * 16 or 32 bytes at a time against each distinct IFS character with
+ * SSE2 or AVX2, whichever the processor supports, and falls back to
+ * the table one byte at a time when IFS has too many characters or
+ * the processor has neither.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IFS_DEFAULT     " \t\n"
+
+/* Byte classes */
+#define IFS_SPACE   1       /* IFS whitespace: space, tab, or newline in IFS */
+#define IFS_DELIM   2       /* any other character of IFS */
+
+/* IFS with more distinct characters than this is scanned byte by byte. */
+#define IFS_VECTOR_MAX 8
+
+struct ifs {
+    uint8_t class[256];     /* IFS_* of each byte, 0 if not in IFS */
+    int nchars;             /* distinct characters in IFS */
+    unsigned char chars[IFS_VECTOR_MAX];    /* the first of them */
+};
+
+/* Build the table for the len bytes of IFS at s. */
+void ifs_init(struct ifs *ifs, const char *s, size_t len);
+
+/* Return the number of bytes at the start of the len bytes at s that
+ * are not in IFS. */
+size_t ifs_span(const struct ifs *ifs, const char *s, size_t len);
+
+/* Is c IFS whitespace? */
+static inline bool
+ifs_space(const struct ifs *ifs, char c)
+{
+    return ifs->class[(unsigned char) c] & IFS_SPACE;
+}
+
+/* Is c a character of IFS other than whitespace? */
+static inline bool
+ifs_delim(const struct ifs *ifs, char c)
+{
+    return ifs->class[(unsigned char) c] & IFS_DELIM;
+}
+
+#endif /* __IFS_H */
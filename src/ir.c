@@ -0,0 +1,3735 @@
+/*
+ * Lowering of the tree-sitter syntax tree into the IR described in ir.h.
+ *
+ * The syntax tree is visited exactly once.  Since the IR requires the
+ * children of a statement (and the parts of a word) to be contiguous,
+ * but lowering them may recursively append to the same arrays (e.g.,
+ * for a $(...) inside an argument), children are first collected into
+ * temporary vectors and then appended as a block.
+ *
+ * Nodes are classified by their symbol and fields by their id, using
+ * the constants in ts_symbols.h and ts_nodes.h, which are generated
+ * from the grammar; no node type names are compared.
+ */
+#define _GNU_SOURCE    1
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+#include "ir.h"
+#include "ts_symbols.h"
+#include "ts_nodes.h"
+#include "builtins.h"
+#include "pattern.h"
+#include "utils.h"
+
+struct builder {
+    struct ir_program *prog;
+    const char *src;
+    uint32_t cap_stmts, cap_kids, cap_words, cap_parts, cap_assigns, cap_redirects,
+             cap_ops, cap_strings;
+};
+
+/* Growable vectors used to collect children before appending them. */
+struct idxvec {
+    uint32_t *v;
+    uint32_t n, cap;
+};
+
+struct wordvec {
+    struct ir_word *v;
+    uint32_t n, cap;
+};
+
+struct assignvec {
+    struct ir_assign *v;
+    uint32_t n, cap;
+};
+
+struct redirvec {
+    struct ir_redirect *v;
+    uint32_t n, cap;
+};
+
+/* A word under construction.  Adjacent literal text with the same
+ * flags is accumulated in `lit` and emitted as a single part. */
+struct wordbuilder {
+    struct ir_part *parts;
+    uint32_t n, cap;
+    char *lit;
+    uint32_t litlen, litcap;
+    uint8_t litflags;
+    bool haslit;
+    bool quoted;        /* some part of the word was quoted */
+    const char *escape; /* for a pattern or regex word, the special characters
+                           of quoted text, see struct ir_word */
+};
+
+static uint32_t lower_stmt(struct builder *b, TSNode node);
+static uint32_t lower_children(struct builder *b, TSNode node);
+static uint32_t lower_children_until(struct builder *b, TSNode node, uint32_t end);
+static void lower_word_into(struct builder *b, struct wordbuilder *wb,
+                            TSNode node, bool quoted);
+static uint32_t lower_arith(struct builder *b, TSNode node, uint32_t *count);
+static uint32_t lower_subscript(struct builder *b, TSNode node);
+
+/* Ensure arr has room for need elements of elsize bytes each. */
+static void *
+grow(void *arr, uint32_t *cap, uint32_t need, size_t elsize)
+{
+    if (need <= *cap)
+        return arr;
+
+    uint32_t ncap = *cap ? *cap : 16;
+    while (ncap < need)
+        ncap *= 2;
+
+    arr = realloc(arr, (size_t) ncap * elsize);
+    if (arr == NULL)
+        utils_fatal_error("Could not grow IR: ");
+    *cap = ncap;
+    return arr;
+}
+
+static void
+idxvec_push(struct idxvec *v, uint32_t idx)
+{
+    v->v = grow(v->v, &v->cap, v->n + 1, sizeof *v->v);
+    v->v[v->n++] = idx;
+}
+
+static void
+wordvec_push(struct wordvec *v, struct ir_word w)
+{
+    v->v = grow(v->v, &v->cap, v->n + 1, sizeof *v->v);
+    v->v[v->n++] = w;
+}
+
+static void
+assignvec_push(struct assignvec *v, struct ir_assign a)
+{
+    v->v = grow(v->v, &v->cap, v->n + 1, sizeof *v->v);
+    v->v[v->n++] = a;
+}
+
+static void
+redirvec_push(struct redirvec *v, struct ir_redirect r)
+{
+    v->v = grow(v->v, &v->cap, v->n + 1, sizeof *v->v);
+    v->v[v->n++] = r;
+}
+
+/* Copy len bytes at s into the string pool, return their offset. */
+static uint32_t
+add_string(struct builder *b, const char *s, size_t len)
+{
+    struct ir_program *p = b->prog;
+    p->strings = grow(p->strings, &b->cap_strings, p->nstrings + len + 1, 1);
+    uint32_t off = p->nstrings;
+    if (len > 0)
+        memcpy(p->strings + off, s, len);
+    p->strings[off + len] = '\0';
+    p->nstrings += len + 1;
+    return off;
+}
+
+/* Copy the source text of node into the string pool. */
+static uint32_t
+add_node_text(struct builder *b, TSNode node)
+{
+    uint32_t start = ts_node_start_byte(node);
+    return add_string(b, b->src + start, ts_node_end_byte(node) - start);
+}
+
+static uint32_t
+add_stmt(struct builder *b, enum ir_kind kind)
+{
+    struct ir_program *p = b->prog;
+    p->stmts = grow(p->stmts, &b->cap_stmts, p->nstmts + 1, sizeof *p->stmts);
+    p->stmts[p->nstmts] = (struct ir_stmt) {
+        .kind = kind, .a = IR_NONE, .b = IR_NONE, .c = IR_NONE
+    };
+    return p->nstmts++;
+}
+
+static uint32_t
+add_word(struct builder *b, struct ir_word w)
+{
+    struct ir_program *p = b->prog;
+    p->words = grow(p->words, &b->cap_words, p->nwords + 1, sizeof *p->words);
+    p->words[p->nwords] = w;
+    return p->nwords++;
+}
+
+/* Append the collected words as a block, return the index of the first. */
+static uint32_t
+add_words(struct builder *b, struct wordvec *v)
+{
+    struct ir_program *p = b->prog;
+    p->words = grow(p->words, &b->cap_words, p->nwords + v->n, sizeof *p->words);
+    uint32_t first = p->nwords;
+    if (v->n > 0)
+        memcpy(p->words + first, v->v, v->n * sizeof *v->v);
+    p->nwords += v->n;
+    free(v->v);
+    return first;
+}
+
+static uint32_t
+add_assigns(struct builder *b, struct assignvec *v)
+{
+    struct ir_program *p = b->prog;
+    p->assigns = grow(p->assigns, &b->cap_assigns, p->nassigns + v->n,
+                      sizeof *p->assigns);
+    uint32_t first = p->nassigns;
+    if (v->n > 0)
+        memcpy(p->assigns + first, v->v, v->n * sizeof *v->v);
+    p->nassigns += v->n;
+    free(v->v);
+    return first;
+}
+
+static uint32_t
+add_redirects(struct builder *b, struct redirvec *v)
+{
+    struct ir_program *p = b->prog;
+    p->redirects = grow(p->redirects, &b->cap_redirects, p->nredirects + v->n,
+                        sizeof *p->redirects);
+    uint32_t first = p->nredirects;
+    if (v->n > 0)
+        memcpy(p->redirects + first, v->v, v->n * sizeof *v->v);
+    p->nredirects += v->n;
+    free(v->v);
+    return first;
+}
+
+/* Record a node the interpreter does not implement. */
+static uint32_t
+add_unsupported(struct builder *b, TSNode node)
+{
+    const char *type = ts_node_type(node);
+    uint32_t s = add_stmt(b, IR_UNSUPPORTED);
+    b->prog->stmts[s].a = add_string(b, type, strlen(type));
+    return s;
+}
+
+/* Turn the collected statements into a single statement. */
+static uint32_t
+make_seq(struct builder *b, struct idxvec *v)
+{
+    if (v->n == 1) {
+        uint32_t s = v->v[0];
+        free(v->v);
+        return s;
+    }
+
+    struct ir_program *p = b->prog;
+    uint32_t s = add_stmt(b, IR_SEQ);
+    p->kids = grow(p->kids, &b->cap_kids, p->nkids + v->n, sizeof *p->kids);
+    if (v->n > 0)
+        memcpy(p->kids + p->nkids, v->v, v->n * sizeof *v->v);
+    p->stmts[s].first = p->nkids;
+    p->stmts[s].count = v->n;
+    p->nkids += v->n;
+    free(v->v);
+    return s;
+}
+
+static void
+push_stmt(struct builder *b, struct idxvec *v, TSNode node)
+{
+    uint32_t s = lower_stmt(b, node);
+    if (s != IR_NONE)
+        idxvec_push(v, s);
+}
+
+/* A `&` terminates the statement collected last; run it in the background. */
+static void
+push_background(struct builder *b, struct idxvec *v)
+{
+    if (v->n == 0)
+        return;
+    uint32_t s = add_stmt(b, IR_BACKGROUND);
+    b->prog->stmts[s].a = v->v[v->n - 1];
+    v->v[v->n - 1] = s;
+}
+
+/*
+ * Can a command substitution whose body includes these run without
+ * a subshell?  Its output is captured from stdout, and variables it
+ * sets are discarded afterwards, so it may not start processes,
+ * redirect descriptors, or change any other state of the shell.
+ */
+static bool
+builtin_runs_in_process(enum ir_builtin builtin)
+{
+    switch (builtin) {
+    case IR_BUILTIN_TRUE:
+    case IR_BUILTIN_FALSE:
+    case IR_BUILTIN_BREAK:
+    case IR_BUILTIN_CONTINUE:
+    case IR_BUILTIN_ECHO:
+    case IR_BUILTIN_PRINTF:
+    case IR_BUILTIN_TEST:
+    case IR_BUILTIN_EXPR:
+    case IR_BUILTIN_TYPE:
+    case IR_BUILTIN_LET:
+        return true;
+    default:            /* e.g., wait and hash, or an external command */
+        return false;
+    }
+}
+
+static bool arith_runs_in_process(struct builder *b, uint32_t op);
+
+static bool
+words_run_in_process(struct builder *b, uint32_t first, uint32_t count)
+{
+    struct ir_program *p = b->prog;
+    for (uint32_t i = first; i < first + count; i++)
+        for (uint32_t j = 0; j < p->words[i].count; j++) {
+            const struct ir_part *part = &p->parts[p->words[i].first + j];
+            if (part->kind == IR_PART_CMDSUBST && !(part->flags & IR_PART_NOFORK))
+                return false;
+            if (part->kind == IR_PART_ARITH && !arith_runs_in_process(b, part->op))
+                return false;
+            if ((part->kind == IR_PART_TRIM_PREFIX || part->kind == IR_PART_TRIM_SUFFIX
+                 || part->kind == IR_PART_ELEMENT
+                 || (part->kind == IR_PART_LENGTH && part->len != IR_NONE))
+                && !words_run_in_process(b, part->len, 1))
+                return false;
+        }
+    return true;
+}
+
+/* The expression starting at op is evaluated from its fallback word,
+ * if it has one, which may contain a $(...). */
+static bool
+arith_runs_in_process(struct builder *b, uint32_t op)
+{
+    uint32_t word = b->prog->ops[op].value;
+    return word == IR_NONE || words_run_in_process(b, word, 1);
+}
+
+static bool
+assign_runs_in_process(struct builder *b, const struct ir_assign *a)
+{
+    uint32_t count = a->flags & IR_ASSIGN_ARRAY ? a->count : 1;
+    return words_run_in_process(b, a->value, count)
+        && (a->subscript == IR_NONE || words_run_in_process(b, a->subscript, 1));
+}
+
+static bool
+stmt_runs_in_process(struct builder *b, uint32_t s)
+{
+    if (s == IR_NONE)
+        return true;
+
+    const struct ir_stmt *stmt = &b->prog->stmts[s];
+    switch (stmt->kind) {
+    case IR_SEQ:
+        for (uint32_t i = 0; i < stmt->count; i++)
+            if (!stmt_runs_in_process(b, b->prog->kids[stmt->first + i]))
+                return false;
+        return true;
+    case IR_COMMAND:
+        /* prefix assignments only matter to external commands */
+        return builtin_runs_in_process(stmt->builtin)
+            && words_run_in_process(b, stmt->first, stmt->count);
+    case IR_ASSIGN:
+        for (uint32_t i = 0; i < stmt->count; i++)
+            if (!assign_runs_in_process(b, &b->prog->assigns[stmt->first + i]))
+                return false;
+        return true;
+    case IR_AND:
+    case IR_OR:
+    case IR_WHILE:
+    case IR_UNTIL:
+        return stmt_runs_in_process(b, stmt->a) && stmt_runs_in_process(b, stmt->b);
+    case IR_NOT:
+        return stmt_runs_in_process(b, stmt->a);
+    case IR_IF:
+    case IR_ARITH_FOR:
+        return stmt_runs_in_process(b, stmt->a) && stmt_runs_in_process(b, stmt->b)
+            && stmt_runs_in_process(b, stmt->c);
+    case IR_FOR:
+        return words_run_in_process(b, stmt->first, stmt->count)
+            && stmt_runs_in_process(b, stmt->b);
+    case IR_ARITH:
+        return arith_runs_in_process(b, stmt->first);
+    case IR_CASE:
+        if (!words_run_in_process(b, stmt->a, 1))
+            return false;
+        for (uint32_t i = 0; i < stmt->count; i++)
+            if (!stmt_runs_in_process(b, b->prog->kids[stmt->first + i]))
+                return false;
+        return true;
+    case IR_CASE_ITEM:
+        return words_run_in_process(b, stmt->first, stmt->count)
+            && stmt_runs_in_process(b, stmt->a);
+    case IR_MATCH:
+        return words_run_in_process(b, stmt->a, 1) && words_run_in_process(b, stmt->b, 1);
+    default:            /* redirections, pipelines, background jobs */
+        return false;
+    }
+}
+
+/*
+ * Word construction.
+ */
+static void
+wb_flush(struct builder *b, struct wordbuilder *wb)
+{
+    if (!wb->haslit)
+        return;
+
+    wb->parts = grow(wb->parts, &wb->cap, wb->n + 1, sizeof *wb->parts);
+    wb->parts[wb->n++] = (struct ir_part) {
+        .kind = IR_PART_LITERAL,
+        .flags = wb->litflags,
+        .str = add_string(b, wb->lit, wb->litlen),
+        .len = wb->litlen
+    };
+    wb->litlen = 0;
+    wb->haslit = false;
+}
+
+/* Append literal text.  An empty literal still counts, e.g. for "". */
+static void
+wb_literal(struct builder *b, struct wordbuilder *wb,
+           const char *s, size_t len, uint8_t flags)
+{
+    if (wb->escape != NULL && (flags & IR_PART_QUOTED)) {
+        /* quoted special characters are escaped instead */
+        wb_literal(b, wb, "", 0, 0);
+        for (size_t i = 0; i < len; i++) {
+            if (s[i] != '\0' && strchr(wb->escape, s[i]) != NULL)
+                wb_literal(b, wb, "\\", 1, 0);
+            wb_literal(b, wb, s + i, 1, 0);
+        }
+        return;
+    }
+    if (wb->haslit && wb->litflags != flags)
+        wb_flush(b, wb);
+
+    if (len > 0) {
+        wb->lit = grow(wb->lit, &wb->litcap, wb->litlen + len, 1);
+        memcpy(wb->lit + wb->litlen, s, len);
+        wb->litlen += len;
+    }
+    wb->litflags = flags;
+    wb->haslit = true;
+}
+
+static void
+wb_part(struct builder *b, struct wordbuilder *wb, struct ir_part part)
+{
+    wb_flush(b, wb);
+    wb->parts = grow(wb->parts, &wb->cap, wb->n + 1, sizeof *wb->parts);
+    wb->parts[wb->n++] = part;
+}
+
+/* Unquoted text: a backslash quotes the next character, and
+ * backslash-newline is removed entirely. */
+static void
+wb_unquoted(struct builder *b, struct wordbuilder *wb, const char *s, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        size_t j = i;
+        while (j < len && s[j] != '\\')
+            j++;
+        if (j > i)
+            wb_literal(b, wb, s + i, j - i, 0);
+        if (j + 1 == len)
+            wb_literal(b, wb, s + j, 1, 0);
+        else if (j + 1 < len && s[j + 1] != '\n') {
+            wb_literal(b, wb, s + j + 1, 1, IR_PART_QUOTED);
+            wb->quoted = true;
+        }
+        i = j + 2;
+    }
+}
+
+/* Text within double quotes: a backslash only quotes $ ` " \ and newline. */
+static void
+wb_dquoted(struct builder *b, struct wordbuilder *wb, const char *s, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        size_t j = i;
+        while (j < len && !(s[j] == '\\' && j + 1 < len
+                            && s[j + 1] != '\0' && strchr("$`\"\\\n", s[j + 1])))
+            j++;
+        if (j > i)
+            wb_literal(b, wb, s + i, j - i, IR_PART_QUOTED);
+        if (j < len && s[j + 1] != '\n')
+            wb_literal(b, wb, s + j + 1, 1, IR_PART_QUOTED);
+        i = j + 2;
+    }
+}
+
+/* Text within $'...': the usual C escapes. */
+static void
+wb_ansi_c(struct builder *b, struct wordbuilder *wb, const char *s, size_t len)
+{
+    static const char from[] = "abefnrtv\\'\"?";
+    static const char to[]   = "\a\b\033\f\n\r\t\v\\'\"?";
+
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (c == '\\' && i + 1 < len) {
+            const char *e = strchr(from, s[i + 1]);
+            if (e != NULL && *e != '\0') {
+                c = to[e - from];
+                i++;
+            }
+        }
+        wb_literal(b, wb, &c, 1, IR_PART_QUOTED);
+    }
+}
+
+/* Source text between the named children of node in [from, to) is
+ * literal; the named children themselves are lowered recursively. */
+static void
+lower_gaps(struct builder *b, struct wordbuilder *wb, TSNode node,
+           uint32_t from, uint32_t to, bool quoted)
+{
+    uint32_t pos = from;
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (!ts_node_is_named(child))
+                continue;
+
+            uint32_t cs = ts_node_start_byte(child);
+            if (cs > pos) {
+                if (quoted)
+                    wb_dquoted(b, wb, b->src + pos, cs - pos);
+                else
+                    wb_unquoted(b, wb, b->src + pos, cs - pos);
+            }
+            lower_word_into(b, wb, child, quoted);
+            pos = ts_node_end_byte(child);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    if (to > pos) {
+        if (quoted)
+            wb_dquoted(b, wb, b->src + pos, to - pos);
+        else
+            wb_unquoted(b, wb, b->src + pos, to - pos);
+    }
+}
+
+/* The parameter whose name is the len bytes at name. */
+static void
+wb_parameter(struct builder *b, struct wordbuilder *wb, const char *name, size_t len,
+             uint8_t flags)
+{
+    if (len == 1 && name[0] == '?') {
+        wb_part(b, wb, (struct ir_part) { .kind = IR_PART_STATUS, .flags = flags });
+        return;
+    }
+    /* $@ and $* are the elements of the positional parameters */
+    if (len == 1 && (name[0] == '@' || name[0] == '*')) {
+        if (name[0] == '*')
+            flags |= IR_PART_JOIN;
+        wb_part(b, wb, (struct ir_part) {
+            .kind = IR_PART_ELEMENTS, .flags = flags, .str = add_string(b, "@", 1)
+        });
+        return;
+    }
+    uint32_t str = add_string(b, name, len);
+    wb_part(b, wb, (struct ir_part) {
+        .kind = IR_PART_VAR, .flags = flags, .str = str, .len = len
+    });
+}
+
+/* $name, ${name}, and the special parameters. */
+static void
+lower_parameter(struct builder *b, struct wordbuilder *wb, TSNode name, uint8_t flags)
+{
+    uint32_t start = ts_node_start_byte(name);
+    wb_parameter(b, wb, b->src + start, ts_node_end_byte(name) - start, flags);
+}
+
+/* The length of the name of the parameter at s[i], after a $ or ${. */
+static size_t
+parameter_length(const char *s, size_t i, size_t len)
+{
+    if (i < len && (isdigit((unsigned char) s[i]) || s[i] == '?'))
+        return 1;
+    size_t n = 0;
+    if (i < len && (isalpha((unsigned char) s[i]) || s[i] == '_'))
+        while (i + n < len && (isalnum((unsigned char) s[i + n]) || s[i + n] == '_'))
+            n++;
+    return n;
+}
+
+/*
+ * Text that the grammar leaves unparsed, as in the regex leaves of
+ * patterns, e.g., those of ${name%.*} and [[ $x == *"."c ]]: quotes,
+ * backslashes, $name and ${name} are handled here.
+ */
+static void
+lower_text(struct builder *b, struct wordbuilder *wb, const char *s, size_t len, bool quoted)
+{
+    size_t i = 0, from = 0;
+    while (i < len) {
+        char c = s[i];
+        size_t skip = 0, n = 0;
+        if (c == '\\') {
+            i += 2;
+            continue;
+        }
+        if (c == '$' && i + 1 < len && s[i + 1] == '{') {
+            n = parameter_length(s, i + 2, len);
+            skip = i + 2 + n < len && s[i + 2 + n] == '}' ? 3 : 0;
+        } else if (c == '$') {
+            n = parameter_length(s, i + 1, len);
+            skip = 1;
+        } else if (!quoted && (c == '"' || c == '\'')) {
+            skip = 1;
+        }
+        if (skip == 0 || (c == '$' && n == 0)) {
+            i++;
+            continue;
+        }
+
+        if (i > from) {
+            if (quoted)
+                wb_dquoted(b, wb, s + from, i - from);
+            else
+                wb_unquoted(b, wb, s + from, i - from);
+        }
+        if (c == '$') {
+            size_t name = i + (skip == 3 ? 2 : 1);
+            wb_parameter(b, wb, s + name, n, quoted ? IR_PART_QUOTED : 0);
+            i = name + n + (skip == 3);
+        } else {
+            /* the matching quote; an unterminated one quotes the rest */
+            size_t end = i + 1;
+            while (end < len && s[end] != c)
+                end += c == '"' && s[end] == '\\' ? 2 : 1;
+            if (end > len)
+                end = len;
+            wb->quoted = true;
+            wb_literal(b, wb, "", 0, IR_PART_QUOTED);
+            if (c == '"')
+                lower_text(b, wb, s + i + 1, end - i - 1, true);
+            else
+                wb_literal(b, wb, s + i + 1, end - i - 1, IR_PART_QUOTED);
+            i = end + 1;
+        }
+        from = i;
+    }
+    if (len > from) {
+        if (quoted)
+            wb_dquoted(b, wb, s + from, len - from);
+        else
+            wb_unquoted(b, wb, s + from, len - from);
+    }
+}
+
+static struct ir_word finish_word(struct builder *b, struct wordbuilder *wb);
+
+/*
+ * ${name#pattern}, ${name##pattern}, ${name%pattern}, and
+ * ${name%%pattern}; returns false for other forms.  The pattern is
+ * whatever follows the operator, as the grammar splits it into
+ * nodes on quotes.
+ */
+static bool
+lower_trim(struct builder *b, struct wordbuilder *wb, TSNode node, uint8_t flags)
+{
+    TSNode name = ts_node_named_child(node, 0);
+    TSNode op = ts_expansion_operator(node);
+    uint32_t n = ts_node_child_count(node);
+    /* ${#name} is a length */
+    if (ts_node_symbol(name) != sym_variable_name || ts_node_is_null(op)
+        || ts_node_start_byte(op) < ts_node_start_byte(name))
+        return false;
+    uint32_t opstart = ts_node_start_byte(op), oplen = ts_node_end_byte(op) - opstart;
+    const char *optext = b->src + opstart;
+    if (oplen == 0 || oplen > 2 || (optext[0] != '#' && optext[0] != '%')
+        || (oplen == 2 && optext[1] != optext[0]))
+        return false;
+
+    struct wordbuilder pb = { .escape = IR_PATTERN_SPECIALS };
+    uint32_t pos = ts_node_end_byte(op), end = ts_node_start_byte(ts_node_child(node, n - 1));
+    for (uint32_t i = 0; i < n - 1; i++) {
+        TSNode child = ts_node_child(node, i);
+        uint32_t cs = ts_node_start_byte(child), ce = ts_node_end_byte(child);
+        if (cs < pos)
+            continue;
+        if (cs > pos)
+            lower_text(b, &pb, b->src + pos, cs - pos, false);
+        if (ts_node_symbol(child) == sym_regex || !ts_node_is_named(child))
+            lower_text(b, &pb, b->src + cs, ce - cs, false);
+        else
+            lower_word_into(b, &pb, child, false);
+        pos = ce;
+    }
+    if (end > pos)
+        lower_text(b, &pb, b->src + pos, end - pos, false);
+    uint32_t pattern = add_word(b, finish_word(b, &pb));
+
+    if (oplen == 2)
+        flags |= IR_PART_LONGEST;
+    wb_part(b, wb, (struct ir_part) {
+        .kind = optext[0] == '#' ? IR_PART_TRIM_PREFIX : IR_PART_TRIM_SUFFIX,
+        .flags = flags,
+        .str = add_node_text(b, name),
+        .len = pattern
+    });
+    return true;
+}
+
+/*
+ * ${name[subscript]}, ${name[@]}, ${!name[@]}, ${#name},
+ * ${#name[subscript]}, and ${#name[@]}, or with * for @; returns
+ * false for other forms.
+ */
+static bool
+lower_element(struct builder *b, struct wordbuilder *wb, TSNode node, uint8_t flags)
+{
+    TSNode op = ts_expansion_operator(node);
+    TSNode target = ts_node_named_child(node, 0);
+    char optext = 0;
+    if (!ts_node_is_null(op)) {
+        if (ts_node_child_count(node) != 4 || ts_node_end_byte(op) != ts_node_start_byte(op) + 1)
+            return false;
+        optext = b->src[ts_node_start_byte(op)];
+    } else if (ts_node_child_count(node) != 3) {
+        return false;
+    }
+
+    TSNode name = target;
+    char all = 0;       /* the @ or * of name[@] or name[*] */
+    if (ts_node_symbol(target) == sym_subscript) {
+        name = ts_subscript_name(target);
+        TSNode index = ts_subscript_index(target);
+        uint32_t at = ts_node_start_byte(index);
+        if (!ts_node_is_null(index) && ts_node_end_byte(index) == at + 1
+            && (b->src[at] == '@' || b->src[at] == '*'))
+            all = b->src[at];
+    } else if (optext != '#') {
+        return false;
+    }
+    if (ts_node_symbol(name) != sym_variable_name || (optext == '!' && !all)
+        || (optext != 0 && optext != '#' && optext != '!'))
+        return false;
+
+    struct ir_part part = { .flags = flags, .str = add_node_text(b, name), .len = IR_NONE };
+    if (optext == '!')
+        part.kind = IR_PART_SUBSCRIPTS;
+    else if (all)
+        part.kind = optext == '#' ? IR_PART_COUNT : IR_PART_ELEMENTS;
+    else
+        part.kind = optext == '#' ? IR_PART_LENGTH : IR_PART_ELEMENT;
+    if (all == '*')
+        part.flags |= IR_PART_JOIN;
+    if (!all && ts_node_symbol(target) == sym_subscript)
+        part.len = lower_subscript(b, target);
+    wb_part(b, wb, part);
+    return true;
+}
+
+/* In a string, the grammar makes the blanks before the $ of an
+ * expansion part of it; lower them, and skip them in *text. */
+static void
+lower_blanks(struct builder *b, struct wordbuilder *wb, const char **text, uint32_t len,
+             bool quoted)
+{
+    uint32_t lead = 0;
+    while (lead < len && (*text)[lead] != '$')
+        lead++;
+    if (lead == 0)
+        return;
+    if (quoted)
+        wb_dquoted(b, wb, *text, lead);
+    else
+        wb_unquoted(b, wb, *text, lead);
+    *text += lead;
+}
+
+static void
+lower_word_into(struct builder *b, struct wordbuilder *wb, TSNode node, bool quoted)
+{
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t end = ts_node_end_byte(node);
+    const char *text = b->src + start;
+    uint8_t flags = quoted ? IR_PART_QUOTED : 0;
+
+    switch (ts_node_symbol(node)) {
+    case sym_word:
+        if (quoted)
+            wb_dquoted(b, wb, text, end - start);
+        else
+            wb_unquoted(b, wb, text, end - start);
+        return;
+    case sym_string_content:
+        wb_dquoted(b, wb, text, end - start);
+        return;
+    case sym_string:
+        /* "" is a quoted empty part, which makes a field when split */
+        wb->quoted = true;
+        wb_literal(b, wb, "", 0, IR_PART_QUOTED);
+        lower_gaps(b, wb, node, start + 1, end - 1, true);
+        return;
+    case sym_raw_string:
+        wb->quoted = true;
+        wb_literal(b, wb, text + 1, end - start - 2, IR_PART_QUOTED);
+        return;
+    case sym_ansi_c_string:
+        wb->quoted = true;
+        wb_ansi_c(b, wb, text + 2, end - start - 3);
+        return;
+    case sym_concatenation:
+    case sym_translated_string:
+        lower_gaps(b, wb, node, start, end, quoted);
+        return;
+    case sym_simple_expansion:
+        lower_blanks(b, wb, &text, end - start, quoted);
+        lower_parameter(b, wb, ts_node_named_child(node, 0), flags);
+        return;
+    case sym_expansion:
+        lower_blanks(b, wb, &text, end - start, quoted);
+        /* the plain ${name} form, whose name is a leaf: either a
+         * variable_name or one of the tokens aliased to
+         * special_variable_name, which have no symbol of their own */
+        if (ts_node_child_count(node) == 3
+            && ts_node_child_count(ts_node_named_child(node, 0)) == 0) {
+            lower_parameter(b, wb, ts_node_named_child(node, 0), flags);
+            return;
+        }
+        if (lower_trim(b, wb, node, flags) || lower_element(b, wb, node, flags))
+            return;
+        break;
+    case sym_regex:
+    case sym_extglob_pattern:
+        lower_text(b, wb, text, end - start, quoted);
+        return;
+    case sym_arithmetic_expansion: {
+        uint32_t count;
+        uint32_t op = lower_arith(b, node, &count);
+        wb_part(b, wb, (struct ir_part) {
+            .kind = IR_PART_ARITH, .flags = flags, .op = op, .len = count
+        });
+        return;
+    }
+    case sym_command_substitution: {
+        uint32_t body = lower_children(b, node);
+        if (stmt_runs_in_process(b, body))
+            flags |= IR_PART_NOFORK;
+        wb_part(b, wb, (struct ir_part) {
+            .kind = IR_PART_CMDSUBST, .flags = flags, .stmt = body
+        });
+        return;
+    }
+    }
+
+    /* not (yet) expanded: numbers, other expansion forms, etc.
+     * are passed on as they appear in the source. */
+    wb_literal(b, wb, text, b->src + end - text, flags);
+}
+
+/* Append the parts of the word under construction to the program.
+ * The word itself is returned to the caller. */
+static struct ir_word
+finish_word(struct builder *b, struct wordbuilder *wb)
+{
+    if (wb->n == 0 && !wb->haslit)
+        wb_literal(b, wb, "", 0, 0);
+    wb_flush(b, wb);
+
+    struct ir_program *p = b->prog;
+    p->parts = grow(p->parts, &b->cap_parts, p->nparts + wb->n, sizeof *p->parts);
+    memcpy(p->parts + p->nparts, wb->parts, wb->n * sizeof *wb->parts);
+
+    struct ir_word w = { .first = p->nparts, .count = wb->n };
+    if (wb->n == 1 && wb->parts[0].kind == IR_PART_LITERAL)
+        w.flags |= IR_WORD_STATIC;
+    if (wb->quoted)
+        w.flags |= IR_WORD_QUOTED;
+    for (uint32_t i = 0; i < wb->n; i++) {
+        const struct ir_part *part = &wb->parts[i];
+        /* "${name[@]}" makes a field of each element */
+        if ((part->kind == IR_PART_ELEMENTS || part->kind == IR_PART_SUBSCRIPTS)
+            && !(part->flags & IR_PART_JOIN))
+            w.flags |= IR_WORD_SPLIT;
+        if (part->flags & IR_PART_QUOTED)
+            continue;
+        if (part->kind != IR_PART_LITERAL)
+            w.flags |= IR_WORD_SPLIT;
+        else if (wb->n == 1 ? pattern_has_magic(ir_str(p, part->str), part->len)
+                 : strpbrk(ir_str(p, part->str), "*?[") != NULL)
+            w.flags |= IR_WORD_GLOB;
+    }
+    p->nparts += wb->n;
+
+    free(wb->parts);
+    free(wb->lit);
+    return w;
+}
+
+/* Lower a word-like node into a word template. */
+static struct ir_word
+lower_word(struct builder *b, TSNode node)
+{
+    struct wordbuilder wb = { 0 };
+    lower_word_into(b, &wb, node, false);
+    return finish_word(b, &wb);
+}
+
+/* Lower a word-like node into a pattern word, or a regex word, as
+ * escape is IR_PATTERN_SPECIALS or IR_REGEX_SPECIALS. */
+static struct ir_word
+lower_pattern(struct builder *b, TSNode node, const char *escape)
+{
+    struct wordbuilder wb = { .escape = escape };
+    lower_word_into(b, &wb, node, false);
+    return finish_word(b, &wb);
+}
+
+/*
+ * Arithmetic expressions.
+ *
+ * The grammar's arithmetic nodes only tell where expressions are;
+ * their text is parsed here, by recursive descent, since the grammar
+ * does not follow bash: it parses 2**3**2 and a=b=1 from the left,
+ * -2**2 as -(2**2), 0x1f as a name, and i++ as a word.  Operators
+ * applied to constants are folded, and so are &&, ||, and ?: whose
+ * outcome is known; the side that is never evaluated is parsed, but
+ * its code is dropped.
+ */
+enum arith_token {
+    TOK_END,
+    TOK_NUMBER,             /* value in num */
+    TOK_NAME,
+    TOK_DOLLAR,
+    TOK_OP,                 /* one of arith_ops, in op */
+};
+
+/* Operators, longer ones first. */
+static const char *const arith_ops[] = {
+    "<<=", ">>=", "**", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "++", "--", "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "|", "^", "!", "~",
+    "?", ":", "=", ",", "(", ")", "[", "]",
+};
+
+/* Left-associative binary operators and their precedence. */
+static const struct arith_binop {
+    const char *token;
+    uint8_t op;
+    uint8_t prec;
+} arith_binops[] = {
+    { "||", IR_OP_OR_JUMP, 1 },
+    { "&&", IR_OP_AND_JUMP, 2 },
+    { "|", IR_OP_BITOR, 3 },
+    { "^", IR_OP_BITXOR, 4 },
+    { "&", IR_OP_BITAND, 5 },
+    { "==", IR_OP_EQ, 6 }, { "!=", IR_OP_NE, 6 },
+    { "<", IR_OP_LT, 7 }, { "<=", IR_OP_LE, 7 }, { ">", IR_OP_GT, 7 }, { ">=", IR_OP_GE, 7 },
+    { "<<", IR_OP_SHL, 8 }, { ">>", IR_OP_SHR, 8 },
+    { "+", IR_OP_ADD, 9 }, { "-", IR_OP_SUB, 9 },
+    { "*", IR_OP_MUL, 10 }, { "/", IR_OP_DIV, 10 }, { "%", IR_OP_MOD, 10 },
+};
+
+/* The binary operators of the compound assignments, as op= */
+static const struct arith_binop arith_assignops[] = {
+    { "*=", IR_OP_MUL }, { "/=", IR_OP_DIV }, { "%=", IR_OP_MOD },
+    { "+=", IR_OP_ADD }, { "-=", IR_OP_SUB }, { "<<=", IR_OP_SHL },
+    { ">>=", IR_OP_SHR }, { "&=", IR_OP_BITAND }, { "^=", IR_OP_BITXOR },
+    { "|=", IR_OP_BITOR },
+};
+
+#define ARITH_MAX_NESTING 1024
+
+struct arith {
+    struct builder *b;
+    const char *s;          /* the text */
+    uint32_t len;
+    uint32_t pos;           /* where the next token starts */
+    enum arith_token tok;   /* the current token */
+    uint32_t start;         /* of the current token */
+    uint32_t prev;          /* of the token before */
+    const char *op;
+    int64_t num;
+    bool dollar;            /* $name may be fetched into a slot */
+    uint32_t first;         /* op of the expression's IR_OP_BEGIN */
+    uint32_t barrier;       /* ops before this one are not folded, as a
+                               jump may land after them */
+    uint32_t element;       /* the last IR_OP_LOAD_ELEMENT, which becomes a
+                               store if it turns out to be assigned */
+    uint32_t element_start; /* the first op of its subscript */
+    int depth, maxdepth;    /* of the stack */
+    int nesting;
+    struct {
+        const char *name;
+        uint32_t len;
+        uint32_t str;
+    } slots[IR_ARITH_SLOTS];
+    int nslots;
+    const char *error;      /* why the text is not an expression */
+    uint32_t errpos;
+};
+
+static void arith_comma(struct arith *a);
+static void arith_assign(struct arith *a);
+static void arith_unary(struct arith *a);
+static void arith_binary(struct arith *a, int prec);
+
+static void
+arith_fail(struct arith *a, const char *error)
+{
+    if (a->error != NULL)
+        return;
+    a->error = error;
+    a->errpos = a->tok == TOK_END ? a->prev : a->start;
+    a->tok = TOK_END;
+}
+
+/* The value of digit c, or 64 if it is none. */
+static int
+digit_value(char c, int base)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + (base <= 36 ? 10 : 36);
+    if (c == '@')
+        return 62;
+    if (c == '_')
+        return 63;
+    return 64;
+}
+
+/* Parse the number of len bytes at s; returns NULL, or why it is none. */
+static const char *
+parse_number(const char *s, size_t len, int64_t *n)
+{
+    uint64_t v = 0;
+    int base = 10;
+    size_t i = 0;
+    const char *hash = memchr(s, '#', len);
+    if (hash != NULL) {
+        for (base = 0; s + i < hash; i++) {
+            if (!isdigit((unsigned char) s[i]) || (base = 10 * base + s[i] - '0') > 64)
+                return "invalid arithmetic base";
+        }
+        if (base < 2)
+            return "invalid arithmetic base";
+        if (++i == len)
+            return "invalid number";
+    } else if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        i = 2;
+    } else if (s[0] == '0') {
+        base = 8;
+    }
+
+    for (; i < len; i++) {
+        int d = digit_value(s[i], base);
+        if (d >= base)
+            return "value too great for base";
+        v = v * base + d;
+    }
+    *n = (int64_t) v;
+    return NULL;
+}
+
+static bool
+is_name_start(char c)
+{
+    return isalpha((unsigned char) c) || c == '_';
+}
+
+static bool
+is_name_char(char c)
+{
+    return isalnum((unsigned char) c) || c == '_';
+}
+
+/* Advance to the next token.  Double quotes are ignored, as in bash. */
+static void
+arith_next(struct arith *a)
+{
+    if (a->error != NULL)
+        return;
+
+    const char *s = a->s;
+    bool operand = a->tok == TOK_NUMBER || a->tok == TOK_DOLLAR
+        || (a->tok == TOK_OP && strcmp(a->op, ")") == 0);
+    while (a->pos < a->len && strchr(" \t\n\r\"", s[a->pos]) != NULL)
+        a->pos++;
+    a->prev = a->start;
+    a->start = a->pos;
+    if (a->pos == a->len) {
+        a->tok = TOK_END;
+        return;
+    }
+
+    char c = s[a->pos];
+    if (isdigit((unsigned char) c)) {
+        while (a->pos < a->len && (is_name_char(s[a->pos]) || s[a->pos] == '@'
+                                   || s[a->pos] == '#'))
+            a->pos++;
+        a->tok = TOK_NUMBER;
+        const char *error = parse_number(s + a->start, a->pos - a->start, &a->num);
+        if (error != NULL)
+            arith_fail(a, error);
+        return;
+    }
+    if (is_name_start(c)) {
+        while (a->pos < a->len && is_name_char(s[a->pos]))
+            a->pos++;
+        a->tok = TOK_NAME;
+        return;
+    }
+    if (c == '$') {
+        a->tok = TOK_DOLLAR;
+        return;
+    }
+    for (size_t i = 0; i < sizeof arith_ops / sizeof *arith_ops; i++) {
+        size_t n = strlen(arith_ops[i]);
+        if (a->len - a->pos >= n && memcmp(s + a->pos, arith_ops[i], n) == 0) {
+            /* 2--1 subtracts -1, as only variables can be decremented */
+            if (operand && (strcmp(arith_ops[i], "++") == 0 || strcmp(arith_ops[i], "--") == 0))
+                continue;
+            a->pos += n;
+            a->tok = TOK_OP;
+            a->op = arith_ops[i];
+            return;
+        }
+    }
+    a->tok = TOK_OP;
+    a->op = "";
+    arith_fail(a, "syntax error: invalid arithmetic operator");
+}
+
+/* Is the current token the operator op? */
+static bool
+arith_is(struct arith *a, const char *op)
+{
+    return a->tok == TOK_OP && strcmp(a->op, op) == 0;
+}
+
+static void
+arith_expect(struct arith *a, const char *op, const char *error)
+{
+    if (arith_is(a, op))
+        arith_next(a);
+    else
+        arith_fail(a, error);
+}
+
+/* How the ops change the depth of the stack; for the conditional
+ * jumps, when they do not jump. */
+static int
+arith_effect(uint8_t op)
+{
+    switch (op) {
+    case IR_OP_CONST:
+    case IR_OP_LOAD:
+    case IR_OP_PREADD:
+    case IR_OP_POSTADD:
+    case IR_OP_FETCH_ELEMENT:
+    case IR_OP_SLOT:
+        return 1;
+    case IR_OP_POP:
+    case IR_OP_STORE_ELEMENT:
+    case IR_OP_JUMP_FALSE:
+    case IR_OP_AND_JUMP:
+    case IR_OP_OR_JUMP:
+        return -1;
+    default:
+        return op >= IR_OP_ADD ? -1 : 0;
+    }
+}
+
+static uint32_t
+arith_emit(struct arith *a, uint8_t op, uint32_t arg, int64_t value)
+{
+    struct ir_program *p = a->b->prog;
+    p->ops = grow(p->ops, &a->b->cap_ops, p->nops + 1, sizeof *p->ops);
+    p->ops[p->nops] = (struct ir_op) { .op = op, .arg = arg, .value = value };
+    a->depth += arith_effect(op);
+    if (a->depth > a->maxdepth)
+        a->maxdepth = a->depth;
+    return p->nops++;
+}
+
+/* Drop the ops from mark on. */
+static void
+arith_truncate(struct arith *a, uint32_t mark)
+{
+    struct ir_program *p = a->b->prog;
+    while (p->nops > mark)
+        a->depth -= arith_effect(p->ops[--p->nops].op);
+}
+
+/* Is the op back ops from the end a constant that may be folded? */
+static bool
+arith_const(struct arith *a, uint32_t back, int64_t *value)
+{
+    struct ir_program *p = a->b->prog;
+    if (p->nops < a->barrier + back || p->ops[p->nops - back].op != IR_OP_CONST)
+        return false;
+    *value = p->ops[p->nops - back].value;
+    return true;
+}
+
+/* Make the jump at op j land at the next op. */
+static void
+arith_land(struct arith *a, uint32_t j)
+{
+    struct ir_program *p = a->b->prog;
+    p->ops[j].arg = p->nops - a->first;
+    a->barrier = p->nops;
+}
+
+static void
+arith_unop(struct arith *a, uint8_t op)
+{
+    int64_t v;
+    if (!arith_const(a, 1, &v)) {
+        arith_emit(a, op, 0, 0);
+        return;
+    }
+    struct ir_op *c = &a->b->prog->ops[a->b->prog->nops - 1];
+    switch (op) {
+    case IR_OP_NEG:
+        c->value = (int64_t) (0 - (uint64_t) v);
+        break;
+    case IR_OP_NOT:
+        c->value = !v;
+        break;
+    case IR_OP_BITNOT:
+        c->value = ~v;
+        break;
+    case IR_OP_BOOL:
+        c->value = v != 0;
+        break;
+    }
+}
+
+/* Errors such as a division by 0 are left to the evaluation, which
+ * may never happen. */
+static void
+arith_binop(struct arith *a, uint8_t op)
+{
+    int64_t l, r, v;
+    if (arith_const(a, 2, &l) && arith_const(a, 1, &r)
+        && ir_arith_binary(op, l, r, &v) == NULL) {
+        arith_truncate(a, a->b->prog->nops - 2);
+        arith_emit(a, IR_OP_CONST, 0, v);
+    } else {
+        arith_emit(a, op, 0, 0);
+    }
+}
+
+/* Emit a reference to the variable of the current token, a name. */
+static uint32_t
+arith_name(struct arith *a)
+{
+    return add_string(a->b, a->s + a->start, a->pos - a->start);
+}
+
+/* $name, ${name}, $1, or a nested $((...)) */
+static void
+arith_dollar(struct arith *a)
+{
+    const char *s = a->s;
+    uint32_t p = a->start + 1, n = 0;
+    bool braced = p < a->len && s[p] == '{';
+    if (!a->dollar) {
+        arith_fail(a, "syntax error: operand expected");
+        return;
+    }
+    if (a->len - p >= 2 && s[p] == '(' && s[p + 1] == '(') {
+        a->pos = p + 2;
+        arith_next(a);
+        arith_comma(a);
+        arith_expect(a, ")", "missing `)'");
+        arith_expect(a, ")", "missing `)'");
+        return;
+    }
+
+    p += braced;
+    if (p < a->len && isdigit((unsigned char) s[p]))
+        n = 1;
+    else if (p < a->len && is_name_start(s[p]))
+        while (p + n < a->len && is_name_char(s[p + n]))
+            n++;
+    if (n == 0 || (braced && (p + n == a->len || s[p + n] != '}'))) {
+        arith_fail(a, "syntax error: operand expected");
+        return;
+    }
+
+    int slot = 0;
+    while (slot < a->nslots && !(a->slots[slot].len == n
+                                 && memcmp(a->slots[slot].name, s + p, n) == 0))
+        slot++;
+    if (slot == IR_ARITH_SLOTS) {
+        arith_fail(a, "too many expansions");
+        return;
+    }
+    if (slot == a->nslots) {
+        a->slots[slot].name = s + p;
+        a->slots[slot].len = n;
+        a->slots[slot].str = add_string(a->b, s + p, n);
+        a->nslots++;
+    }
+    arith_emit(a, IR_OP_SLOT, 0, slot);
+    a->pos = p + n + braced;
+    arith_next(a);
+}
+
+/* The [expression] of an array element, whose value is left on the stack. */
+static void
+arith_subscript(struct arith *a)
+{
+    arith_next(a);
+    arith_comma(a);
+    arith_expect(a, "]", "missing `]'");
+}
+
+/* Numbers, names, array elements, parentheses, and names and
+ * elements followed by ++ or --. */
+static void
+arith_primary(struct arith *a)
+{
+    switch (a->tok) {
+    case TOK_NUMBER:
+        arith_emit(a, IR_OP_CONST, 0, a->num);
+        arith_next(a);
+        return;
+    case TOK_NAME: {
+        uint32_t name = arith_name(a);
+        arith_next(a);
+        if (arith_is(a, "[")) {
+            uint32_t start = a->b->prog->nops;
+            arith_subscript(a);
+            if (arith_is(a, "++") || arith_is(a, "--")) {
+                arith_emit(a, IR_OP_POSTADD_ELEMENT, name, arith_is(a, "++") ? 1 : -1);
+                arith_next(a);
+            } else {
+                a->element = arith_emit(a, IR_OP_LOAD_ELEMENT, name, 0);
+                a->element_start = start;
+            }
+        } else if (arith_is(a, "++") || arith_is(a, "--")) {
+            arith_emit(a, IR_OP_POSTADD, name, arith_is(a, "++") ? 1 : -1);
+            arith_next(a);
+        } else {
+            arith_emit(a, IR_OP_LOAD, name, 0);
+        }
+        return;
+    }
+    case TOK_DOLLAR:
+        arith_dollar(a);
+        return;
+    default:
+        if (arith_is(a, "(")) {
+            arith_next(a);
+            arith_comma(a);
+            arith_expect(a, ")", "missing `)'");
+            return;
+        }
+        arith_fail(a, "syntax error: operand expected");
+    }
+}
+
+/* Unary operators, which bind more tightly than ** in bash. */
+static void
+arith_unary(struct arith *a)
+{
+    if (++a->nesting > ARITH_MAX_NESTING) {
+        arith_fail(a, "expression recursion level exceeded");
+        return;
+    }
+    if (arith_is(a, "++") || arith_is(a, "--")) {
+        int64_t delta = arith_is(a, "++") ? 1 : -1;
+        arith_next(a);
+        if (a->tok == TOK_NAME) {
+            uint32_t name = arith_name(a);
+            arith_next(a);
+            if (arith_is(a, "[")) {
+                arith_subscript(a);
+                arith_emit(a, IR_OP_PREADD_ELEMENT, name, delta);
+            } else {
+                arith_emit(a, IR_OP_PREADD, name, delta);
+            }
+        } else {
+            /* not an increment, but two signs, which cancel */
+            arith_unary(a);
+        }
+    } else if (arith_is(a, "-") || arith_is(a, "+") || arith_is(a, "!") || arith_is(a, "~")) {
+        char op = *a->op;
+        arith_next(a);
+        arith_unary(a);
+        if (op != '+')
+            arith_unop(a, op == '-' ? IR_OP_NEG : op == '!' ? IR_OP_NOT : IR_OP_BITNOT);
+    } else {
+        arith_primary(a);
+    }
+    a->nesting--;
+}
+
+/* ** is right-associative. */
+static void
+arith_power(struct arith *a)
+{
+    arith_unary(a);
+    if (arith_is(a, "**")) {
+        arith_next(a);
+        arith_power(a);
+        arith_binop(a, IR_OP_POW);
+    }
+}
+
+static const struct arith_binop *
+arith_binop_of(struct arith *a)
+{
+    if (a->tok != TOK_OP)
+        return NULL;
+    for (size_t i = 0; i < sizeof arith_binops / sizeof *arith_binops; i++)
+        if (strcmp(a->op, arith_binops[i].token) == 0)
+            return &arith_binops[i];
+    return NULL;
+}
+
+/* a && b and a || b, whose left side was just compiled. */
+static void
+arith_logical(struct arith *a, uint8_t op, int prec)
+{
+    struct ir_program *p = a->b->prog;
+    int64_t v;
+    if (arith_const(a, 1, &v)) {
+        if ((v != 0) == (op == IR_OP_OR_JUMP)) {
+            /* decided by the left side; the right is never evaluated */
+            p->ops[p->nops - 1].value = v != 0;
+            uint32_t mark = p->nops;
+            int depth = a->depth;
+            arith_binary(a, prec + 1);
+            arith_truncate(a, mark);
+            a->depth = depth;
+        } else {
+            arith_truncate(a, p->nops - 1);
+            arith_binary(a, prec + 1);
+            arith_unop(a, IR_OP_BOOL);
+        }
+        return;
+    }
+    uint32_t j = arith_emit(a, op, 0, 0);
+    arith_binary(a, prec + 1);
+    arith_unop(a, IR_OP_BOOL);
+    arith_land(a, j);
+}
+
+/* Binary operators of precedence prec or higher, by precedence climbing. */
+static void
+arith_binary(struct arith *a, int prec)
+{
+    arith_power(a);
+    const struct arith_binop *bin;
+    while ((bin = arith_binop_of(a)) != NULL && bin->prec >= prec) {
+        arith_next(a);
+        if (bin->op == IR_OP_AND_JUMP || bin->op == IR_OP_OR_JUMP) {
+            arith_logical(a, bin->op, bin->prec);
+        } else {
+            arith_binary(a, bin->prec + 1);
+            arith_binop(a, bin->op);
+        }
+    }
+}
+
+/* cond ? expr : expr */
+static void
+arith_ternary(struct arith *a)
+{
+    struct ir_program *p = a->b->prog;
+    arith_binary(a, 1);
+    if (!arith_is(a, "?"))
+        return;
+    arith_next(a);
+
+    int64_t v;
+    if (arith_const(a, 1, &v)) {
+        arith_truncate(a, p->nops - 1);
+        int depth = a->depth;
+        uint32_t mark = p->nops;
+        arith_comma(a);
+        if (v == 0)
+            arith_truncate(a, mark);
+        arith_expect(a, ":", "`:' expected for conditional expression");
+        a->depth = depth;
+        mark = p->nops;
+        arith_ternary(a);
+        if (v != 0) {
+            arith_truncate(a, mark);
+            a->depth = depth + 1;
+        }
+        return;
+    }
+
+    uint32_t jfalse = arith_emit(a, IR_OP_JUMP_FALSE, 0, 0);
+    int depth = a->depth;
+    arith_comma(a);
+    uint32_t jend = arith_emit(a, IR_OP_JUMP, 0, 0);
+    arith_expect(a, ":", "`:' expected for conditional expression");
+    a->depth = depth;
+    arith_land(a, jfalse);
+    arith_ternary(a);
+    arith_land(a, jend);
+}
+
+/* NAME = expr and NAME op= expr, which are right-associative, and
+ * likewise with NAME[subscript]. */
+static void
+arith_assign(struct arith *a)
+{
+    struct ir_program *p = a->b->prog;
+    uint32_t start = p->nops;
+    arith_ternary(a);
+    if (a->tok != TOK_OP)
+        return;
+
+    const struct arith_binop *assign = NULL;
+    for (size_t i = 0; i < sizeof arith_assignops / sizeof *arith_assignops; i++)
+        if (strcmp(a->op, arith_assignops[i].token) == 0)
+            assign = &arith_assignops[i];
+    if (assign == NULL && strcmp(a->op, "=") != 0)
+        return;
+
+    if (p->nops > start && a->element == p->nops - 1 && a->element_start == start) {
+        /* the subscript stays on the stack for the store */
+        uint32_t name = p->ops[a->element].arg;
+        arith_truncate(a, a->element);
+        if (assign != NULL)
+            arith_emit(a, IR_OP_FETCH_ELEMENT, name, 0);
+        arith_next(a);
+        arith_assign(a);
+        if (assign != NULL)
+            arith_emit(a, assign->op, 0, 0);
+        arith_emit(a, IR_OP_STORE_ELEMENT, name, 0);
+        return;
+    }
+    if (p->nops != start + 1 || p->ops[start].op != IR_OP_LOAD) {
+        arith_fail(a, "attempted assignment to non-variable");
+        return;
+    }
+    uint32_t name = p->ops[start].arg;
+    if (assign == NULL)
+        arith_truncate(a, start);
+    arith_next(a);
+    arith_assign(a);
+    if (assign != NULL)
+        arith_emit(a, assign->op, 0, 0);
+    arith_emit(a, IR_OP_STORE, name, 0);
+}
+
+static void
+arith_comma(struct arith *a)
+{
+    arith_assign(a);
+    while (arith_is(a, ",")) {
+        arith_next(a);
+        arith_emit(a, IR_OP_POP, 0, 0);
+        arith_assign(a);
+    }
+}
+
+/*
+ * Compile the expression text, of len bytes, and return the index of
+ * its IR_OP_BEGIN.  If dollar, $names are fetched into slots, and
+ * text that cannot be compiled ahead but contains $ or ` is left to
+ * be evaluated once expanded; *fallback is set if the caller must
+ * supply the word to expand.
+ */
+static uint32_t
+compile_arith(struct builder *b, const char *text, uint32_t len, bool dollar,
+              bool *fallback)
+{
+    struct ir_program *p = b->prog;
+    struct arith a = { .b = b, .s = text, .len = len, .dollar = dollar, .element = IR_NONE };
+    a.first = arith_emit(&a, IR_OP_BEGIN, add_string(b, text, len), IR_NONE);
+    a.barrier = p->nops;
+    arith_next(&a);
+    if (a.tok != TOK_END)
+        arith_comma(&a);        /* else the expression is empty, and 0 */
+    if (a.tok != TOK_END)
+        arith_fail(&a, "syntax error in expression");
+    if (a.error == NULL && a.maxdepth > IR_ARITH_STACK) {
+        a.errpos = 0;
+        a.error = "expression too complex";
+    }
+    *fallback = false;
+
+    if (a.error != NULL) {
+        arith_truncate(&a, a.first + 1);
+        if (dollar && (memchr(text, '$', len) != NULL || memchr(text, '`', len) != NULL)) {
+            arith_emit(&a, IR_OP_EVAL, 0, 0);
+            *fallback = true;
+        } else {
+            char *msg;
+            if (asprintf(&msg, "%s (error token is \"%.*s\")", a.error,
+                         (int) (len - a.errpos), text + a.errpos) == -1)
+                utils_fatal_error("Could not format error: ");
+            arith_emit(&a, IR_OP_ERROR, add_string(b, msg, strlen(msg)), 0);
+            free(msg);
+        }
+        return a.first;
+    }
+
+    if (a.nslots > 0) {
+        /* fetch the $names first, shifting the code after them */
+        uint32_t n = a.nslots, body = a.first + 1;
+        p->ops = grow(p->ops, &b->cap_ops, p->nops + n, sizeof *p->ops);
+        memmove(p->ops + body + n, p->ops + body, (p->nops - body) * sizeof *p->ops);
+        p->nops += n;
+        for (uint32_t i = 0; i < n; i++)
+            p->ops[body + i] = (struct ir_op) {
+                .op = IR_OP_SUBST, .arg = a.slots[i].str, .value = i
+            };
+        for (uint32_t i = body + n; i < p->nops; i++)
+            if (p->ops[i].op >= IR_OP_JUMP && p->ops[i].op <= IR_OP_OR_JUMP)
+                p->ops[i].arg += n;
+        *fallback = true;
+    }
+    return a.first;
+}
+
+/* The text of an expression within node, from..to, as a word whose
+ * expansions are those of the text, for evaluating it once expanded.
+ * The grammar's nodes between are only searched for expansions. */
+static void
+lower_arith_word(struct builder *b, struct wordbuilder *wb, TSNode node,
+                 uint32_t from, uint32_t to)
+{
+    uint32_t pos = from;
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            uint32_t cs = ts_node_start_byte(child), ce = ts_node_end_byte(child);
+            if (!ts_node_is_named(child) || cs < from || ce > to)
+                continue;
+            if (cs > pos)
+                wb_literal(b, wb, b->src + pos, cs - pos, 0);
+            switch (ts_node_symbol(child)) {
+            case sym_simple_expansion:
+            case sym_expansion:
+            case sym_command_substitution:
+            case sym_arithmetic_expansion:
+            case sym_string:
+            case sym_raw_string:
+                lower_word_into(b, wb, child, false);
+                break;
+            default:
+                lower_arith_word(b, wb, child, cs, ce);
+                break;
+            }
+            pos = ce;
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    if (to > pos)
+        wb_literal(b, wb, b->src + pos, to - pos, 0);
+}
+
+/* Compile the expression at bytes [start, end) of node and return
+ * the index of its first op, storing the number of its ops in *count;
+ * the ops of the expressions in its fallback word follow them. */
+static uint32_t
+lower_arith_range(struct builder *b, TSNode node, uint32_t start, uint32_t end,
+                  uint32_t *count)
+{
+    bool fallback;
+    uint32_t first = compile_arith(b, b->src + start, end - start, true, &fallback);
+    *count = b->prog->nops - first;
+    if (fallback) {
+        struct wordbuilder wb = { 0 };
+        lower_arith_word(b, &wb, node, start, end);
+        uint32_t word = add_word(b, finish_word(b, &wb));
+        b->prog->ops[first].value = word;
+    }
+    return first;
+}
+
+/* The subscript of node, a subscript, name[expression], as a word. */
+static uint32_t
+lower_subscript(struct builder *b, TSNode node)
+{
+    TSNode index = ts_subscript_index(node);
+    uint32_t start = ts_node_is_null(index) ? ts_node_end_byte(node) : ts_node_start_byte(index);
+    uint32_t end = ts_node_is_null(index) ? start : ts_node_end_byte(index);
+    uint32_t count;
+    uint32_t first = lower_arith_range(b, node, start, end, &count);
+    struct wordbuilder wb = { 0 };
+    wb_part(b, &wb, (struct ir_part) {
+        .kind = IR_PART_ARITH, .op = first, .len = count
+    });
+    return add_word(b, finish_word(b, &wb));
+}
+
+/*
+ * Compile the expression within node, which is delimited by its
+ * first and last child, e.g., $(( and )), and return the index of
+ * its first op, storing the number of ops in *count.
+ */
+static uint32_t
+lower_arith(struct builder *b, TSNode node, uint32_t *count)
+{
+    uint32_t n = ts_node_child_count(node);
+    uint32_t start = ts_node_end_byte(ts_node_child(node, 0));
+    uint32_t end = n > 1 ? ts_node_start_byte(ts_node_child(node, n - 1)) : start;
+    if (end < start)
+        end = start;
+
+    return lower_arith_range(b, node, start, end, count);
+}
+
+/* An expression that is only known once word is expanded. */
+static uint32_t
+compile_arith_word(struct builder *b, uint32_t word)
+{
+    struct arith a = { .b = b };
+    a.first = arith_emit(&a, IR_OP_BEGIN, add_string(b, "", 0), word);
+    arith_emit(&a, IR_OP_EVAL, 0, 0);
+    return a.first;
+}
+
+struct ir_program *
+ir_compile_arith(const char *text, size_t len)
+{
+    struct ir_program *prog = calloc(1, sizeof *prog);
+    if (prog == NULL)
+        utils_fatal_error("Could not allocate IR: ");
+
+    struct builder b = { .prog = prog, .src = text };
+    bool fallback;
+    compile_arith(&b, text, len, false, &fallback);
+    return prog;
+}
+
+const char *
+ir_arith_binary(uint8_t op, int64_t l, int64_t r, int64_t *result)
+{
+    uint64_t ul = l, ur = r;
+    switch (op) {
+    case IR_OP_ADD:
+        *result = (int64_t) (ul + ur);
+        break;
+    case IR_OP_SUB:
+        *result = (int64_t) (ul - ur);
+        break;
+    case IR_OP_MUL:
+        *result = (int64_t) (ul * ur);
+        break;
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        if (r == 0)
+            return "division by 0";
+        if (r == -1)    /* INT64_MIN / -1 overflows */
+            *result = op == IR_OP_DIV ? (int64_t) (0 - ul) : 0;
+        else
+            *result = op == IR_OP_DIV ? l / r : l % r;
+        break;
+    case IR_OP_POW: {
+        if (r < 0)
+            return "exponent less than 0";
+        uint64_t v = 1;
+        for (; ur != 0; ur >>= 1, ul *= ul)
+            if (ur & 1)
+                v *= ul;
+        *result = (int64_t) v;
+        break;
+    }
+    case IR_OP_SHL:
+        *result = (int64_t) (ul << (r & 63));
+        break;
+    case IR_OP_SHR:
+        *result = l >> (r & 63);
+        break;
+    case IR_OP_LT:
+        *result = l < r;
+        break;
+    case IR_OP_LE:
+        *result = l <= r;
+        break;
+    case IR_OP_GT:
+        *result = l > r;
+        break;
+    case IR_OP_GE:
+        *result = l >= r;
+        break;
+    case IR_OP_EQ:
+        *result = l == r;
+        break;
+    case IR_OP_NE:
+        *result = l != r;
+        break;
+    case IR_OP_BITAND:
+        *result = l & r;
+        break;
+    case IR_OP_BITXOR:
+        *result = l ^ r;
+        break;
+    case IR_OP_BITOR:
+        *result = l | r;
+        break;
+    default:
+        abort();
+    }
+    return NULL;
+}
+
+bool
+ir_arith_number(const char *s, size_t len, int64_t *n)
+{
+    while (len > 0 && isblank((unsigned char) s[len - 1]))
+        len--;
+    size_t i = 0;
+    while (i < len && isblank((unsigned char) s[i]))
+        i++;
+    bool negative = i < len && s[i] == '-';
+    if (i < len && (s[i] == '-' || s[i] == '+'))
+        i++;
+    if (i == len || !isdigit((unsigned char) s[i]))
+        return false;
+    for (size_t j = i; j < len; j++)
+        if (!is_name_char(s[j]) && s[j] != '@' && s[j] != '#')
+            return false;
+    if (parse_number(s + i, len - i, n) != NULL)
+        return false;
+    if (negative)
+        *n = (int64_t) (0 - (uint64_t) *n);
+    return true;
+}
+
+/* The words of NAME=(value ...); returns false for forms not
+ * supported, e.g., NAME=([subscript]=value). */
+static bool
+lower_array(struct builder *b, TSNode node, struct ir_assign *a)
+{
+    struct wordvec words = { 0 };
+    uint32_t n = ts_node_named_child_count(node);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        if (ts_node_symbol(child) == sym_comment)
+            continue;
+        if (b->src[ts_node_start_byte(child)] == '[') {
+            free(words.v);
+            return false;
+        }
+        wordvec_push(&words, lower_word(b, child));
+    }
+    a->flags |= IR_ASSIGN_ARRAY;
+    a->count = words.n;
+    a->value = add_words(b, &words);
+    return true;
+}
+
+/* Lower NAME=value, NAME[subscript]=value, and NAME=(value ...).
+ * Returns false for forms not supported. */
+static bool
+lower_assign(struct builder *b, TSNode node, struct ir_assign *a)
+{
+    TSNode name = ts_variable_assignment_name(node);
+    *a = (struct ir_assign) { .subscript = IR_NONE };
+    if (ts_node_symbol(name) == sym_subscript) {
+        TSNode base = ts_subscript_name(name);
+        if (ts_node_symbol(base) != sym_variable_name)
+            return false;
+        a->name = add_node_text(b, base);
+        a->subscript = lower_subscript(b, name);
+    } else if (ts_node_symbol(name) == sym_variable_name) {
+        a->name = add_node_text(b, name);
+    } else {
+        return false;
+    }
+
+    TSNode op = ts_node_next_sibling(name);
+    if (!ts_node_is_null(op) && ts_node_symbol(op) == anon_sym_PLUS_EQ)
+        a->flags = IR_ASSIGN_APPEND;
+    TSNode value = ts_variable_assignment_value(node);
+    if (ts_node_is_null(value)) {
+        /* NAME= has no value node */
+        struct wordbuilder wb = { 0 };
+        a->value = add_word(b, finish_word(b, &wb));
+    } else if (ts_node_symbol(value) == sym_array) {
+        /* NAME[subscript]=(value ...) is an error */
+        return a->subscript == IR_NONE && lower_array(b, value, a);
+    } else {
+        a->value = add_word(b, lower_word(b, value));
+    }
+    return true;
+}
+
+/* The value of node, a file descriptor number.  The source need not
+ * be zero-terminated, so atoi cannot be used. */
+static int
+node_number(struct builder *b, TSNode node)
+{
+    int n = 0;
+    for (uint32_t i = ts_node_start_byte(node); i < ts_node_end_byte(node); i++)
+        if (isdigit((unsigned char) b->src[i]))
+            n = 10 * n + b->src[i] - '0';
+    return n;
+}
+
+/* Is w a literal number, as required for the target of <& and >&? */
+static bool
+word_is_number(struct builder *b, struct ir_word w)
+{
+    if (!(w.flags & IR_WORD_STATIC))
+        return false;
+    const char *s = ir_str(b->prog, b->prog->parts[w.first].str);
+    return *s != '\0' && strspn(s, "0123456789") == strlen(s);
+}
+
+/* [n]<word, [n]>word, etc.  Destinations after the first one are
+ * arguments of the command and are added to words. */
+static bool
+lower_file_redirect(struct builder *b, TSNode node, struct redirvec *redirs,
+                    struct wordvec *words)
+{
+    struct ir_redirect r = { .fd = -1, .word = IR_NONE };
+    struct ir_word target = { 0 };
+    bool hastarget = false, supported = true;
+    TSSymbol op = 0;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSFieldId field = ts_tree_cursor_current_field_id(&c);
+            if (field == field_descriptor) {
+                r.fd = node_number(b, child);
+            } else if (field == field_destination) {
+                if (hastarget)
+                    wordvec_push(words, lower_word(b, child));
+                else
+                    target = lower_word(b, child);
+                hastarget = true;
+            } else if (ts_node_is_named(child)) {
+                supported = false;      /* e.g., ERROR */
+            } else {
+                op = ts_node_symbol(child);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    switch (op) {
+    case anon_sym_LT:
+        r.op = IR_REDIR_IN;
+        break;
+    case anon_sym_GT:
+    case anon_sym_GT_PIPE:
+        r.op = IR_REDIR_OUT;
+        break;
+    case anon_sym_GT_GT:
+        r.op = IR_REDIR_APPEND;
+        break;
+    case anon_sym_AMP_GT:
+        r.op = IR_REDIR_OUT_ERR;
+        break;
+    case anon_sym_AMP_GT_GT:
+        r.op = IR_REDIR_APPEND_ERR;
+        break;
+    case anon_sym_LT_AMP:
+    case anon_sym_GT_AMP:
+        r.op = IR_REDIR_DUP;
+        if (target.flags & IR_WORD_STATIC) {
+            const char *s = ir_str(b->prog, b->prog->parts[target.first].str);
+            if (strcmp(s, "-") == 0)
+                r.op = IR_REDIR_CLOSE;
+            else if (!word_is_number(b, target) && op == anon_sym_GT_AMP && r.fd == -1)
+                r.op = IR_REDIR_OUT_ERR;        /* >&file */
+        }
+        break;
+    case anon_sym_LT_AMP_DASH:
+    case anon_sym_GT_AMP_DASH:
+        r.op = IR_REDIR_CLOSE;
+        break;
+    default:
+        supported = false;
+        break;
+    }
+
+    if (r.fd == -1)
+        r.fd = op == anon_sym_LT || op == anon_sym_LT_AMP || op == anon_sym_LT_AMP_DASH
+               ? STDIN_FILENO : STDOUT_FILENO;
+    if (r.op != IR_REDIR_CLOSE) {
+        if (!hastarget)
+            supported = false;
+        else
+            r.word = add_word(b, target);
+    }
+    if (supported)
+        redirvec_push(redirs, r);
+    return supported;
+}
+
+/* [n]<<< word */
+static bool
+lower_herestring(struct builder *b, TSNode node, struct redirvec *redirs)
+{
+    struct ir_redirect r = { .op = IR_REDIR_STRING, .flags = IR_REDIR_NEWLINE,
+                             .fd = 0, .word = IR_NONE };
+    uint32_t n = ts_node_named_child_count(node);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        if (ts_node_symbol(child) == sym_file_descriptor)
+            r.fd = node_number(b, child);
+        else
+            r.word = add_word(b, lower_word(b, child));
+    }
+    if (r.word == IR_NONE)
+        return false;
+    redirvec_push(redirs, r);
+    return true;
+}
+
+/* [n]<<DELIMITER or [n]<<-DELIMITER.  The body is expanded unless
+ * any part of the delimiter is quoted. */
+static bool
+lower_heredoc(struct builder *b, TSNode node, struct redirvec *redirs)
+{
+    struct ir_redirect r = { .op = IR_REDIR_STRING, .fd = 0, .word = IR_NONE };
+    TSNode body = { 0 };
+    bool hasbody = false, quoted = false;
+
+    uint32_t n = ts_node_child_count(node);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_child(node, i);
+        switch (ts_node_symbol(child)) {
+        case anon_sym_LT_LT_DASH:
+            r.flags |= IR_REDIR_STRIP_TABS;
+            break;
+        case sym_heredoc_start: {
+            uint32_t start = ts_node_start_byte(child);
+            uint32_t len = ts_node_end_byte(child) - start;
+            quoted = memchr(b->src + start, '\'', len) != NULL
+                  || memchr(b->src + start, '"', len) != NULL
+                  || memchr(b->src + start, '\\', len) != NULL;
+            break;
+        }
+        case sym_file_descriptor:
+            r.fd = node_number(b, child);
+            break;
+        case sym_heredoc_body:
+            body = child;
+            hasbody = true;
+            break;
+        case anon_sym_LT_LT:
+        case sym_heredoc_end:
+            break;
+        default:
+            return false;       /* e.g., cat <<EOF | cmd */
+        }
+    }
+
+    struct wordbuilder wb = { 0 };
+    if (hasbody) {
+        uint32_t start = ts_node_start_byte(body);
+        uint32_t end = ts_node_end_byte(body);
+        if (quoted)
+            wb_literal(b, &wb, b->src + start, end - start, IR_PART_QUOTED);
+        else
+            lower_gaps(b, &wb, body, start, end, true);
+    }
+    wb.quoted = true;
+    r.word = add_word(b, finish_word(b, &wb));
+    redirvec_push(redirs, r);
+    return true;
+}
+
+static bool
+lower_redirect(struct builder *b, TSNode node, struct redirvec *redirs,
+               struct wordvec *words)
+{
+    switch (ts_node_symbol(node)) {
+    case sym_file_redirect:
+        return lower_file_redirect(b, node, redirs, words);
+    case sym_herestring_redirect:
+        return lower_herestring(b, node, redirs);
+    case sym_heredoc_redirect:
+        return lower_heredoc(b, node, redirs);
+    default:
+        return false;
+    }
+}
+
+/* Wrap stmt, which may be IR_NONE, into the collected redirections. */
+static uint32_t
+make_redirect(struct builder *b, uint32_t stmt, struct redirvec *redirs)
+{
+    if (redirs->n == 0) {
+        free(redirs->v);
+        return stmt;
+    }
+
+    uint32_t n = redirs->n;
+    uint32_t first = add_redirects(b, redirs);
+    uint32_t s = add_stmt(b, IR_REDIRECT);
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n;
+    b->prog->stmts[s].a = stmt;
+    return s;
+}
+
+static uint32_t
+add_arith_stmt(struct builder *b, uint32_t first, uint32_t count, uint16_t flags)
+{
+    uint32_t s = add_stmt(b, IR_ARITH);
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = count;
+    b->prog->stmts[s].flags = flags;
+    return s;
+}
+
+/* (( expression )), which the grammar makes either a test_command or
+ * a command named by an arithmetic_expansion. */
+static uint32_t
+lower_arith_command(struct builder *b, TSNode node)
+{
+    uint32_t count;
+    uint32_t first = lower_arith(b, node, &count);
+    return add_arith_stmt(b, first, count, 0);
+}
+
+/* let arg ..., whose arguments are expressions evaluated in turn.
+ * Literal ones are compiled now, the others once expanded. */
+static uint32_t
+lower_let(struct builder *b, struct wordvec *words)
+{
+    struct ir_program *p = b->prog;
+    struct idxvec v = { 0 };
+    for (uint32_t i = 1; i < words->n; i++) {
+        struct ir_word w = words->v[i];
+        uint32_t first;
+        if (w.flags & IR_WORD_STATIC) {
+            /* the pool moves as the expression adds to it */
+            char *text = strdup(ir_str(p, p->parts[w.first].str));
+            if (text == NULL)
+                utils_fatal_error("Could not copy expression: ");
+            bool fallback;
+            first = compile_arith(b, text, strlen(text), false, &fallback);
+            free(text);
+        } else {
+            first = compile_arith_word(b, add_word(b, w));
+        }
+        idxvec_push(&v, add_arith_stmt(b, first, p->nops - first, IR_ARITH_LET));
+    }
+    free(words->v);
+    return make_seq(b, &v);
+}
+
+/*
+ * A simple command.  If it is the body of a redirected_statement,
+ * `redirected` is that statement, whose redirections (and any
+ * words that follow their targets) belong to the command.
+ */
+static uint32_t
+lower_simple_command(struct builder *b, TSNode node, TSNode redirected)
+{
+    struct wordvec words = { 0 };
+    struct assignvec assigns = { 0 };
+    struct redirvec redirs = { 0 };
+    bool supported = true;
+    TSNode arith = { 0 };
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (!ts_node_is_named(child))
+                continue;
+
+            switch (ts_node_symbol(child)) {
+            case sym_comment:
+                break;
+            case sym_command_name: {
+                TSNode name = ts_node_named_child(child, 0);
+                if (ts_node_symbol(name) == sym_arithmetic_expansion
+                    && ts_node_symbol(ts_node_child(name, 0)) == anon_sym_LPAREN_LPAREN)
+                    arith = name;       /* (( expression )) */
+                else
+                    wordvec_push(&words, lower_word(b, name));
+                break;
+            }
+            case sym_variable_assignment: {
+                /* arrays cannot be passed in the environment */
+                struct ir_assign a;
+                if (lower_assign(b, child, &a) && a.subscript == IR_NONE
+                    && !(a.flags & IR_ASSIGN_ARRAY))
+                    assignvec_push(&assigns, a);
+                else
+                    supported = false;
+                break;
+            }
+            case sym_file_redirect:
+            case sym_herestring_redirect:
+            case sym_heredoc_redirect:
+                if (!lower_redirect(b, child, &redirs, &words))
+                    supported = false;
+                break;
+            case sym_subshell:
+                supported = false;
+                break;
+            default:
+                wordvec_push(&words, lower_word(b, child));
+                break;
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    if (!ts_node_is_null(redirected)) {
+        c = ts_tree_cursor_new(redirected);
+        if (ts_tree_cursor_goto_first_child(&c)) {
+            do {
+                if (ts_tree_cursor_current_field_id(&c) == field_redirect
+                    && !lower_redirect(b, ts_tree_cursor_current_node(&c),
+                                       &redirs, &words))
+                    supported = false;
+            } while (ts_tree_cursor_goto_next_sibling(&c));
+        }
+        ts_tree_cursor_delete(&c);
+    }
+
+    if (!ts_node_is_null(arith)) {
+        if (supported && words.n == 0 && assigns.n == 0) {
+            free(words.v);
+            free(assigns.v);
+            return make_redirect(b, lower_arith_command(b, arith), &redirs);
+        }
+        supported = false;
+    }
+
+    if (!supported || words.n == 0) {
+        free(words.v);
+        free(assigns.v);
+        free(redirs.v);
+        return add_unsupported(b, ts_node_is_null(redirected) ? node : redirected);
+    }
+
+    struct ir_program *p = b->prog;
+    enum ir_builtin builtin = IR_BUILTIN_NONE;
+    if (words.v[0].flags & IR_WORD_STATIC)
+        builtin = builtin_lookup(ir_str(p, p->parts[words.v[0].first].str));
+    if (builtin == IR_BUILTIN_LET && assigns.n == 0 && words.n > 1) {
+        free(assigns.v);
+        return make_redirect(b, lower_let(b, &words), &redirs);
+    }
+
+    uint32_t nwords = words.n, nassigns = assigns.n;
+    uint32_t firstword = add_words(b, &words);
+    uint32_t firstassign = add_assigns(b, &assigns);
+
+    uint32_t s = add_stmt(b, IR_COMMAND);
+    p->stmts[s].builtin = builtin;
+    p->stmts[s].first = firstword;
+    p->stmts[s].count = nwords;
+    p->stmts[s].a = firstassign;
+    p->stmts[s].b = nassigns;
+    return make_redirect(b, s, &redirs);
+}
+
+static uint32_t
+lower_command(struct builder *b, TSNode node)
+{
+    return lower_simple_command(b, node, (TSNode) { 0 });
+}
+
+/* Collect the redirections of a redirected_statement.  Returns false
+ * if one is not supported or is followed by words. */
+static bool
+lower_statement_redirects(struct builder *b, TSNode node, struct redirvec *redirs)
+{
+    struct wordvec extra = { 0 };
+    bool supported = true;
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            if (ts_tree_cursor_current_field_id(&c) == field_redirect
+                && !lower_redirect(b, ts_tree_cursor_current_node(&c), redirs, &extra))
+                supported = false;
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    free(extra.v);
+    return supported && extra.n == 0;
+}
+
+/* Is node a pipeline followed by redirections? */
+static bool
+is_redirected_pipeline(TSNode node)
+{
+    if (ts_node_symbol(node) != sym_redirected_statement)
+        return false;
+    TSNode body = ts_redirected_statement_body(node);
+    return !ts_node_is_null(body) && ts_node_symbol(body) == sym_pipeline;
+}
+
+/* Make stage's standard error go where its output goes, for |&.
+ * Like bash, this happens after the stage's own redirections. */
+static uint32_t
+redirect_stderr(struct builder *b, uint32_t stage)
+{
+    struct ir_program *p = b->prog;
+    uint32_t parent = IR_NONE, s = stage;
+    while (p->stmts[s].kind == IR_REDIRECT && p->stmts[s].a != IR_NONE) {
+        parent = s;
+        s = p->stmts[s].a;
+    }
+
+    struct wordbuilder wb = { 0 };
+    wb_literal(b, &wb, "1", 1, 0);
+    struct redirvec redirs = { 0 };
+    redirvec_push(&redirs, (struct ir_redirect) {
+        .op = IR_REDIR_DUP, .fd = STDERR_FILENO,
+        .word = add_word(b, finish_word(b, &wb))
+    });
+    s = make_redirect(b, s, &redirs);
+    if (parent == IR_NONE)
+        return s;
+    p->stmts[parent].a = s;
+    return stage;
+}
+
+/*
+ * Collect the stages of a pipeline, or of a pipeline followed by
+ * redirections.  The grammar makes `a | b > f` a redirected pipeline
+ * and nests it into any pipeline that continues after it; both the
+ * redirections and the nesting belong to the last stage, b.
+ */
+static bool
+lower_stages(struct builder *b, TSNode node, struct idxvec *stages, bool *negated)
+{
+    if (ts_node_symbol(node) == sym_redirected_statement) {
+        struct redirvec redirs = { 0 };
+        if (!lower_stages(b, ts_redirected_statement_body(node), stages, negated)
+            || !lower_statement_redirects(b, node, &redirs)) {
+            free(redirs.v);
+            return false;
+        }
+        stages->v[stages->n - 1] = make_redirect(b, stages->v[stages->n - 1], &redirs);
+        return true;
+    }
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    bool supported = true;
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (!ts_node_is_named(child)) {
+                if (ts_node_symbol(child) == anon_sym_PIPE_AMP && stages->n > 0)
+                    stages->v[stages->n - 1] = redirect_stderr(b, stages->v[stages->n - 1]);
+            } else if (ts_node_symbol(child) == sym_pipeline || is_redirected_pipeline(child)) {
+                supported = lower_stages(b, child, stages, negated) && supported;
+            } else if (ts_node_symbol(child) == sym_negated_command && stages->n == 0) {
+                /* the grammar binds ! to the first stage, bash to the pipeline */
+                *negated = true;
+                idxvec_push(stages, lower_stmt(b, ts_node_named_child(child, 0)));
+            } else if (ts_node_symbol(child) != sym_comment) {
+                idxvec_push(stages, lower_stmt(b, child));
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    return supported && stages->n > 0;
+}
+
+/* a | b | ..., possibly followed by redirections of its last stage. */
+static uint32_t
+lower_pipeline(struct builder *b, TSNode node)
+{
+    struct idxvec stages = { 0 };
+    bool negated = false;
+    if (!lower_stages(b, node, &stages, &negated)) {
+        free(stages.v);
+        return add_unsupported(b, node);
+    }
+
+    struct ir_program *p = b->prog;
+    uint32_t s = add_stmt(b, IR_PIPELINE);
+    p->kids = grow(p->kids, &b->cap_kids, p->nkids + stages.n, sizeof *p->kids);
+    memcpy(p->kids + p->nkids, stages.v, stages.n * sizeof *stages.v);
+    p->stmts[s].first = p->nkids;
+    p->stmts[s].count = stages.n;
+    p->nkids += stages.n;
+    free(stages.v);
+    if (!negated)
+        return s;
+
+    uint32_t not = add_stmt(b, IR_NOT);
+    p->stmts[not].a = s;
+    return not;
+}
+
+/* A statement followed by redirections, or redirections alone. */
+static uint32_t
+lower_redirected_statement(struct builder *b, TSNode node)
+{
+    TSNode body = ts_redirected_statement_body(node);
+    if (!ts_node_is_null(body) && ts_node_symbol(body) == sym_command)
+        return lower_simple_command(b, body, node);
+    if (is_redirected_pipeline(node))
+        return lower_pipeline(b, node);
+
+    struct redirvec redirs = { 0 };
+    if (!lower_statement_redirects(b, node, &redirs)) {
+        free(redirs.v);
+        return add_unsupported(b, node);
+    }
+    uint32_t stmt = ts_node_is_null(body) ? IR_NONE : lower_stmt(b, body);
+    return make_redirect(b, stmt, &redirs);
+}
+
+/* Expression nodes within [ ... ] whose tokens become separate arguments. */
+static bool
+is_test_expression(TSSymbol symbol)
+{
+    return symbol == sym_binary_expression
+        || symbol == sym_unary_expression
+        || symbol == sym_parenthesized_expression
+        || symbol == sym_negated_command;
+}
+
+/* Flatten a test expression back into the words of a `[` command. */
+static void
+lower_test_operands(struct builder *b, TSNode node, struct wordvec *words)
+{
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSSymbol symbol = ts_node_symbol(child);
+            if (ts_node_is_missing(child)) {
+                /* inserted by error recovery, e.g., the ] of [ -d / ] */
+                continue;
+            } else if (is_test_expression(symbol)) {
+                lower_test_operands(b, child, words);
+            } else if (!ts_node_is_named(child)) {
+                /* operators such as =, !=, -a, (, ) */
+                struct wordbuilder wb = { 0 };
+                wb_literal(b, &wb, b->src + ts_node_start_byte(child),
+                           ts_node_end_byte(child) - ts_node_start_byte(child), 0);
+                wordvec_push(words, finish_word(b, &wb));
+            } else if (symbol != sym_comment) {
+                wordvec_push(words, lower_word(b, child));
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+}
+
+/* Is the source text of node s? */
+static bool
+node_is(struct builder *b, TSNode node, const char *s)
+{
+    uint32_t start = ts_node_start_byte(node);
+    return ts_node_end_byte(node) - start == strlen(s)
+        && memcmp(b->src + start, s, strlen(s)) == 0;
+}
+
+/* An operand of [[ ]], which is neither split nor subject to pathname
+ * expansion, and is an argument even if empty. */
+static struct ir_word
+lower_cond_word(struct builder *b, TSNode node)
+{
+    struct ir_word w = lower_word(b, node);
+    w.flags &= ~(IR_WORD_SPLIT | IR_WORD_GLOB);
+    w.flags |= IR_WORD_QUOTED;
+    return w;
+}
+
+/* Run the operands of a [[ ]] primary, but for `==`, with test. */
+static uint32_t
+lower_cond_test(struct builder *b, TSNode *operands, uint32_t n)
+{
+    struct wordvec words = { 0 };
+    struct wordbuilder name = { 0 };
+    wb_literal(b, &name, "test", 4, 0);
+    wordvec_push(&words, finish_word(b, &name));
+    for (uint32_t i = 0; i < n; i++) {
+        if (ts_node_is_named(operands[i]) && ts_node_symbol(operands[i]) != sym_test_operator) {
+            wordvec_push(&words, lower_cond_word(b, operands[i]));
+            continue;
+        }
+        /* operators such as -f, -eq, <, and > */
+        struct wordbuilder wb = { 0 };
+        uint32_t start = ts_node_start_byte(operands[i]);
+        wb_literal(b, &wb, b->src + start, ts_node_end_byte(operands[i]) - start, 0);
+        wordvec_push(&words, finish_word(b, &wb));
+    }
+
+    uint32_t first = add_words(b, &words);
+    uint32_t s = add_stmt(b, IR_COMMAND);
+    b->prog->stmts[s].builtin = IR_BUILTIN_TEST;
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n + 1;
+    b->prog->stmts[s].a = b->prog->nassigns;
+    b->prog->stmts[s].b = 0;
+    return s;
+}
+
+static uint32_t lower_cond(struct builder *b, TSNode node);
+
+/* left op right, where op is neither && nor ||. */
+static uint32_t
+lower_cond_binary(struct builder *b, TSNode left, TSNode op, TSNode right)
+{
+    /* the grammar binds ! tighter than the operator, unlike bash */
+    if (ts_node_symbol(left) == sym_unary_expression && node_is(b, ts_node_child(left, 0), "!")) {
+        uint32_t a = lower_cond_binary(b, ts_node_named_child(left, 0), op, right);
+        uint32_t s = add_stmt(b, IR_NOT);
+        b->prog->stmts[s].a = a;
+        return s;
+    }
+    bool regex = node_is(b, op, "=~");
+    if (regex || node_is(b, op, "==") || node_is(b, op, "=") || node_is(b, op, "!=")) {
+        uint32_t subject = add_word(b, lower_cond_word(b, left));
+        uint32_t pattern = add_word(b, lower_pattern(b, right, regex ? IR_REGEX_SPECIALS
+                                                                    : IR_PATTERN_SPECIALS));
+        uint32_t s = add_stmt(b, IR_MATCH);
+        b->prog->stmts[s].a = subject;
+        b->prog->stmts[s].b = pattern;
+        b->prog->stmts[s].flags = regex ? IR_MATCH_REGEX
+                                : node_is(b, op, "!=") ? IR_MATCH_NEGATE : 0;
+        return s;
+    }
+    TSNode operands[3] = { left, op, right };
+    return lower_cond_test(b, operands, 3);
+}
+
+/*
+ * A conditional expression within [[ ]].  && || and ! become the
+ * statements for them, == and != an IR_MATCH with a pattern word, =~
+ * one with a regex word, and the other primaries test commands.
+ */
+static uint32_t
+lower_cond(struct builder *b, TSNode node)
+{
+    switch (ts_node_symbol(node)) {
+    case sym_parenthesized_expression:
+        return lower_cond(b, ts_node_named_child(node, 0));
+    case sym_unary_expression: {
+        TSNode op = ts_node_child(node, 0);
+        if (node_is(b, op, "!")) {
+            uint32_t a = lower_cond(b, ts_node_named_child(node, ts_node_named_child_count(node) - 1));
+            uint32_t s = add_stmt(b, IR_NOT);
+            b->prog->stmts[s].a = a;
+            return s;
+        }
+        TSNode operands[2] = { op, ts_node_child(node, 1) };
+        return lower_cond_test(b, operands, 2);
+    }
+    case sym_binary_expression: {
+        TSNode left = ts_binary_expression_left(node);
+        TSNode op = ts_binary_expression_operator(node);
+        TSNode right = ts_binary_expression_right(node);
+        if (ts_node_is_null(left) || ts_node_is_null(op) || ts_node_is_null(right))
+            return add_unsupported(b, node);
+        if (node_is(b, op, "&&") || node_is(b, op, "||")) {
+            uint32_t l = lower_cond(b, left);
+            uint32_t r = lower_cond(b, right);
+            uint32_t s = add_stmt(b, node_is(b, op, "&&") ? IR_AND : IR_OR);
+            b->prog->stmts[s].a = l;
+            b->prog->stmts[s].b = r;
+            return s;
+        }
+        return lower_cond_binary(b, left, op, right);
+    }
+    default:
+        return lower_cond_test(b, &node, 1);
+    }
+}
+
+/* [ expression ] is run as the command `[` with the expression's
+ * tokens as arguments; [[ expression ]] is lowered by lower_cond. */
+static uint32_t
+lower_test_command(struct builder *b, TSNode node)
+{
+    if (ts_node_symbol(ts_node_child(node, 0)) == anon_sym_LPAREN_LPAREN)
+        return lower_arith_command(b, node);
+    if (ts_node_symbol(ts_node_child(node, 0)) == anon_sym_LBRACK_LBRACK) {
+        if (ts_node_named_child_count(node) != 1)
+            return add_unsupported(b, node);
+        return lower_cond(b, ts_node_named_child(node, 0));
+    }
+    if (ts_node_symbol(ts_node_child(node, 0)) != anon_sym_LBRACK)
+        return add_unsupported(b, node);
+
+    struct wordvec words = { 0 };
+    lower_test_operands(b, node, &words);
+
+    uint32_t n = words.n;
+    uint32_t first = add_words(b, &words);
+    uint32_t s = add_stmt(b, IR_COMMAND);
+    b->prog->stmts[s].builtin = IR_BUILTIN_TEST;
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n;
+    b->prog->stmts[s].a = b->prog->nassigns;
+    b->prog->stmts[s].b = 0;
+    return s;
+}
+
+/* A statement consisting of one or more assignments. */
+static uint32_t
+lower_assignments(struct builder *b, TSNode node)
+{
+    struct assignvec assigns = { 0 };
+    struct ir_assign a;
+
+    if (ts_node_symbol(node) == sym_variable_assignment) {
+        if (lower_assign(b, node, &a))
+            assignvec_push(&assigns, a);
+        else
+            goto unsupported;
+    } else {
+        uint32_t n = ts_node_named_child_count(node);
+        for (uint32_t i = 0; i < n; i++) {
+            TSNode child = ts_node_named_child(node, i);
+            if (ts_node_symbol(child) == sym_comment)
+                continue;
+            if (!lower_assign(b, child, &a))
+                goto unsupported;
+            assignvec_push(&assigns, a);
+        }
+    }
+
+    uint32_t n = assigns.n;
+    uint32_t first = add_assigns(b, &assigns);
+    uint32_t s = add_stmt(b, IR_ASSIGN);
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n;
+    return s;
+
+unsupported:
+    free(assigns.v);
+    return add_unsupported(b, node);
+}
+
+/* declare, typeset, and local NAME[=value] ...; the only options
+ * supported are -i and -a, other declaration commands are not. */
+static uint32_t
+lower_declaration(struct builder *b, TSNode node)
+{
+    uint16_t flags = 0;
+    switch (ts_node_symbol(ts_node_child(node, 0))) {
+    case anon_sym_local:
+        flags |= IR_DECLARE_LOCAL;
+        break;
+    case anon_sym_declare:
+    case anon_sym_typeset:
+        break;
+    default:            /* export, readonly */
+        return add_unsupported(b, node);
+    }
+
+    struct assignvec assigns = { 0 };
+    struct ir_assign a;
+    uint32_t n = ts_node_named_child_count(node);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        switch (ts_node_symbol(child)) {
+        case sym_comment:
+            continue;
+        case sym_variable_assignment:
+            if (!lower_assign(b, child, &a))
+                goto unsupported;
+            break;
+        case sym_variable_name:
+            a = (struct ir_assign) {
+                .name = add_node_text(b, child), .value = IR_NONE, .subscript = IR_NONE
+            };
+            break;
+        case sym_word: {
+            const char *opt = b->src + ts_node_start_byte(child);
+            uint32_t len = ts_node_end_byte(child) - ts_node_start_byte(child);
+            if (len < 2 || opt[0] != '-' || strspn(opt + 1, "ia") < len - 1)
+                goto unsupported;
+            if (memchr(opt, 'i', len) != NULL)
+                flags |= IR_DECLARE_INTEGER;
+            if (memchr(opt, 'a', len) != NULL)
+                flags |= IR_DECLARE_ARRAY;
+            continue;
+        }
+        default:
+            goto unsupported;
+        }
+        assignvec_push(&assigns, a);
+    }
+    /* without names, declare lists variables */
+    if (assigns.n == 0 && !(flags & IR_DECLARE_LOCAL))
+        goto unsupported;
+
+    uint32_t count = assigns.n;
+    uint32_t first = add_assigns(b, &assigns);
+    uint32_t s = add_stmt(b, IR_DECLARE);
+    b->prog->stmts[s].flags = flags;
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = count;
+    return s;
+
+unsupported:
+    free(assigns.v);
+    return add_unsupported(b, node);
+}
+
+/* name() body and function name body.  The body is lowered in place;
+ * the interpreter keeps the program alive for as long as the
+ * function is defined. */
+static uint32_t
+lower_function(struct builder *b, TSNode node)
+{
+    TSNode name = ts_function_definition_name(node);
+    TSNode body = ts_function_definition_body(node);
+    if (ts_node_symbol(name) != sym_word || ts_node_is_null(body)
+        || !ts_node_is_null(ts_function_definition_redirect(node)))
+        return add_unsupported(b, node);
+
+    uint32_t a = add_node_text(b, name);
+    uint32_t body_stmt = lower_stmt(b, body);
+    uint32_t s = add_stmt(b, IR_FUNCTION);
+    b->prog->stmts[s].a = a;
+    b->prog->stmts[s].b = body_stmt;
+    return s;
+}
+
+/* All named children of node form a sequence of statements. */
+static uint32_t
+lower_children(struct builder *b, TSNode node)
+{
+    return lower_children_until(b, node, UINT32_MAX);
+}
+
+/* The children of node that end at or before byte end, run in order. */
+static uint32_t
+lower_children_until(struct builder *b, TSNode node, uint32_t end)
+{
+    struct idxvec v = { 0 };
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (ts_node_end_byte(child) > end)
+                break;
+            if (ts_node_is_named(child))
+                push_stmt(b, &v, child);
+            else if (ts_node_symbol(child) == anon_sym_AMP)
+                push_background(b, &v);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    return make_seq(b, &v);
+}
+
+/* a && b, a || b; lists nest to the left. */
+static uint32_t
+lower_list(struct builder *b, TSNode node)
+{
+    enum ir_kind kind = IR_AND;
+    uint32_t n = ts_node_child_count(node);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_child(node, i);
+        if (!ts_node_is_named(child)) {
+            kind = ts_node_symbol(child) == anon_sym_PIPE_PIPE ? IR_OR : IR_AND;
+            break;
+        }
+    }
+
+    uint32_t left = lower_stmt(b, ts_node_named_child(node, 0));
+    uint32_t right = lower_stmt(b, ts_node_named_child(node, 1));
+    uint32_t s = add_stmt(b, kind);
+    b->prog->stmts[s].a = left;
+    b->prog->stmts[s].b = right;
+    return s;
+}
+
+/* Statements before `then` are the condition, those after it the body.
+ * For an if_statement, elif and else clauses are chained through c. */
+static uint32_t
+lower_if(struct builder *b, TSNode node)
+{
+    struct ir_program *p = b->prog;
+    struct idxvec cond = { 0 }, body = { 0 };
+    bool inbody = false;
+    uint32_t s = add_stmt(b, IR_IF);
+    uint32_t tail = IR_NONE;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSSymbol symbol = ts_node_symbol(child);
+            if (!ts_node_is_named(child)) {
+                if (symbol == anon_sym_then)
+                    inbody = true;
+                else if (symbol == anon_sym_AMP)
+                    push_background(b, inbody ? &body : &cond);
+                continue;
+            }
+
+            bool iselif = symbol == sym_elif_clause;
+            if (iselif || symbol == sym_else_clause) {
+                if (tail == IR_NONE) {
+                    uint32_t a = make_seq(b, &cond);
+                    uint32_t t = make_seq(b, &body);
+                    p->stmts[s].a = a;
+                    p->stmts[s].b = t;
+                    tail = s;
+                }
+                uint32_t next = iselif ? lower_if(b, child) : lower_children(b, child);
+                p->stmts[tail].c = next;
+                if (iselif)
+                    tail = next;
+            } else {
+                push_stmt(b, inbody ? &body : &cond, child);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    if (tail == IR_NONE) {
+        uint32_t a = make_seq(b, &cond);
+        uint32_t t = make_seq(b, &body);
+        p->stmts[s].a = a;
+        p->stmts[s].b = t;
+    }
+    return s;
+}
+
+/* while/until; every named child other than the body is part of
+ * the condition. */
+static uint32_t
+lower_while(struct builder *b, TSNode node)
+{
+    struct idxvec cond = { 0 };
+    uint32_t body = IR_NONE;
+    enum ir_kind kind = IR_WHILE;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (!ts_node_is_named(child)) {
+                if (ts_node_symbol(child) == anon_sym_until)
+                    kind = IR_UNTIL;
+                continue;
+            }
+            if (ts_tree_cursor_current_field_id(&c) == field_body)
+                body = lower_stmt(b, child);
+            else
+                push_stmt(b, &cond, child);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    uint32_t a = make_seq(b, &cond);
+    uint32_t s = add_stmt(b, kind);
+    b->prog->stmts[s].a = a;
+    b->prog->stmts[s].b = body;
+    return s;
+}
+
+/* for NAME [in words]; do ...; done */
+static uint32_t
+lower_for(struct builder *b, TSNode node)
+{
+    if (ts_node_symbol(ts_node_child(node, 0)) != anon_sym_for)
+        return add_unsupported(b, node);        /* select */
+
+    struct wordvec words = { 0 };
+    uint32_t name = IR_NONE, body = IR_NONE;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSFieldId field = ts_tree_cursor_current_field_id(&c);
+            if (field == field_variable)
+                name = add_node_text(b, child);
+            else if (field == field_value)
+                wordvec_push(&words, lower_word(b, child));
+            else if (field == field_body)
+                body = lower_stmt(b, child);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    uint32_t n = words.n;
+    uint32_t first = add_words(b, &words);
+    uint32_t s = add_stmt(b, IR_FOR);
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n;
+    b->prog->stmts[s].a = name;
+    b->prog->stmts[s].b = body;
+    return s;
+}
+
+/*
+ * for ((init; condition; update)); do ...; done.  The sections are
+ * delimited by the tokens around them, as the grammar's nodes for
+ * them are unreliable; see compile_arith.  An empty condition is
+ * true.
+ */
+static uint32_t
+lower_c_style_for(struct builder *b, TSNode node)
+{
+    uint32_t delims[4], ndelims = 0, body = IR_NONE;
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSSymbol sym = ts_node_symbol(child);
+            if (ndelims == 0 && sym == anon_sym_LPAREN_LPAREN)
+                delims[ndelims++] = ts_node_end_byte(child);
+            else if (ndelims > 0 && ndelims < 3 && sym == anon_sym_SEMI)
+                delims[ndelims++] = ts_node_start_byte(child);
+            else if (ndelims == 3 && sym == anon_sym_RPAREN_RPAREN)
+                delims[ndelims++] = ts_node_start_byte(child);
+            else if (ts_tree_cursor_current_field_id(&c) == field_body)
+                body = lower_stmt(b, child);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    if (ndelims != 4)
+        return add_unsupported(b, node);
+
+    uint32_t section[3];
+    for (int i = 0; i < 3; i++) {
+        uint32_t start = delims[i] + (i > 0), end = delims[i + 1];
+        while (start < end && isspace((unsigned char) b->src[start]))
+            start++;
+        section[i] = IR_NONE;
+        if (start < end) {
+            uint32_t count;
+            uint32_t first = lower_arith_range(b, node, start, end, &count);
+            section[i] = add_arith_stmt(b, first, count, 0);
+        }
+    }
+
+    uint32_t s = add_stmt(b, IR_ARITH_FOR);
+    b->prog->stmts[s].a = section[1];
+    b->prog->stmts[s].b = body;
+    b->prog->stmts[s].c = section[2];
+    if (section[0] == IR_NONE)
+        return s;
+    struct idxvec v = { 0 };
+    idxvec_push(&v, section[0]);
+    idxvec_push(&v, s);
+    return make_seq(b, &v);
+}
+
+/* pattern | pattern ) commands ;; */
+static uint32_t
+lower_case_item(struct builder *b, TSNode node)
+{
+    struct wordvec patterns = { 0 };
+    struct idxvec body = { 0 };
+    uint16_t flags = 0;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            TSFieldId field = ts_tree_cursor_current_field_id(&c);
+            if (field == field_value)
+                wordvec_push(&patterns, lower_pattern(b, child, IR_PATTERN_SPECIALS));
+            else if (field == field_fallthrough)
+                flags = node_is(b, child, ";&") ? IR_CASE_FALLTHROUGH : IR_CASE_CONTINUE;
+            else if (ts_node_is_named(child) && field != field_termination)
+                push_stmt(b, &body, child);
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+
+    uint32_t n = patterns.n;
+    uint32_t first = add_words(b, &patterns);
+    uint32_t a = body.n > 0 ? make_seq(b, &body) : IR_NONE;
+    if (body.n == 0)
+        free(body.v);
+    uint32_t s = add_stmt(b, IR_CASE_ITEM);
+    b->prog->stmts[s].flags = flags;
+    b->prog->stmts[s].first = first;
+    b->prog->stmts[s].count = n;
+    b->prog->stmts[s].a = a;
+    return s;
+}
+
+/* case word in items esac */
+static uint32_t
+lower_case(struct builder *b, TSNode node)
+{
+    struct idxvec items = { 0 };
+    uint32_t subject = IR_NONE;
+
+    TSTreeCursor c = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&c)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&c);
+            if (ts_tree_cursor_current_field_id(&c) == field_value)
+                subject = add_word(b, lower_cond_word(b, child));
+            else if (ts_node_symbol(child) == sym_case_item)
+                idxvec_push(&items, lower_case_item(b, child));
+        } while (ts_tree_cursor_goto_next_sibling(&c));
+    }
+    ts_tree_cursor_delete(&c);
+    if (subject == IR_NONE) {
+        free(items.v);
+        return add_unsupported(b, node);
+    }
+
+    struct ir_program *p = b->prog;
+    uint32_t s = add_stmt(b, IR_CASE);
+    p->kids = grow(p->kids, &b->cap_kids, p->nkids + items.n, sizeof *p->kids);
+    if (items.n > 0)
+        memcpy(p->kids + p->nkids, items.v, items.n * sizeof *items.v);
+    p->stmts[s].first = p->nkids;
+    p->stmts[s].count = items.n;
+    p->stmts[s].a = subject;
+    p->nkids += items.n;
+    free(items.v);
+    return s;
+}
+
+static uint32_t
+lower_comment(struct builder *b, TSNode node)
+{
+    return IR_NONE;
+}
+
+static uint32_t
+lower_negated_command(struct builder *b, TSNode node)
+{
+    uint32_t a = lower_stmt(b, ts_node_named_child(node, 0));
+    uint32_t s = add_stmt(b, IR_NOT);
+    b->prog->stmts[s].a = a;
+    return s;
+}
+
+typedef uint32_t lower_fn(struct builder *b, TSNode node);
+
+/* How to lower each kind of statement, indexed by symbol.  Symbols
+ * without an entry are reported as unsupported. */
+static lower_fn *const stmt_lowerers[TS_SYMBOL_COUNT] = {
+    [sym_comment]               = lower_comment,
+    [sym_command]               = lower_command,
+    [sym_redirected_statement]  = lower_redirected_statement,
+    [sym_variable_assignment]   = lower_assignments,
+    [sym_variable_assignments]  = lower_assignments,
+    [sym_test_command]          = lower_test_command,
+    [sym_list]                  = lower_list,
+    [sym_negated_command]       = lower_negated_command,
+    [sym_pipeline]              = lower_pipeline,
+    [sym_if_statement]          = lower_if,
+    [sym_while_statement]       = lower_while,
+    [sym_for_statement]         = lower_for,
+    [sym_c_style_for_statement] = lower_c_style_for,
+    [sym_case_statement]        = lower_case,
+    [sym_function_definition]   = lower_function,
+    [sym_declaration_command]   = lower_declaration,
+    [sym_program]               = lower_children,
+    [sym_compound_statement]    = lower_children,
+    [sym_do_group]              = lower_children,
+};
+
+/* Lower a statement; returns IR_NONE for nodes that need no code. */
+static uint32_t
+lower_stmt(struct builder *b, TSNode node)
+{
+    TSSymbol symbol = ts_node_symbol(node);
+    if (symbol < TS_SYMBOL_COUNT && stmt_lowerers[symbol] != NULL)
+        return stmt_lowerers[symbol](b, node);
+
+    return add_unsupported(b, node);
+}
+
+struct ir_program *
+ir_compile(TSNode program, const char *source)
+{
+    struct ir_program *prog = calloc(1, sizeof *prog);
+    if (prog == NULL)
+        utils_fatal_error("Could not allocate IR: ");
+
+    struct builder b = { .prog = prog, .src = source };
+    prog->root = lower_stmt(&b, program);
+    return prog;
+}
+
+struct ir_program *
+ir_compile_prefix(TSNode program, const char *source, uint32_t end)
+{
+    struct ir_program *prog = calloc(1, sizeof *prog);
+    if (prog == NULL)
+        utils_fatal_error("Could not allocate IR: ");
+
+    struct builder b = { .prog = prog, .src = source };
+    prog->root = lower_children_until(&b, program, end);
+    return prog;
+}
+
+void
+ir_free(struct ir_program *prog)
+{
+    if (prog->borrowed) {
+        free(prog);
+        return;
+    }
+    free(prog->stmts);
+    free(prog->kids);
+    free(prog->words);
+    free(prog->parts);
+    free(prog->assigns);
+    free(prog->redirects);
+    free(prog->ops);
+    free(prog->strings);
+    free(prog);
+}
+
+/*
+ * Images.  An image is a header followed by the arrays of a program,
+ * in the order of IR_ARRAYS, each padded to a multiple of 8 bytes.
+ */
+#define IR_ARRAYS(X) \
+    X(stmts, nstmts) \
+    X(kids, nkids) \
+    X(words, nwords) \
+    X(parts, nparts) \
+    X(assigns, nassigns) \
+    X(redirects, nredirects) \
+    X(ops, nops) \
+    X(strings, nstrings)
+
+#define IR_IMAGE_MAGIC 0x5249424d      /* "MBIR" */
+
+struct ir_image_header {
+    uint32_t magic;
+    uint32_t version;       /* IR_VERSION */
+    uint64_t size;          /* of the image, including this header */
+#define COUNT_FIELD(array, count) uint32_t count;
+    IR_ARRAYS(COUNT_FIELD)
+#undef COUNT_FIELD
+    uint32_t root;
+};
+
+static size_t
+pad8(size_t n)
+{
+    return (n + 7) & ~(size_t) 7;
+}
+
+static size_t
+image_size(const struct ir_image_header *h)
+{
+    size_t size = pad8(sizeof *h);
+#define ADD_SIZE(array, count) \
+    size += pad8((size_t) h->count * sizeof *((struct ir_program *) 0)->array);
+    IR_ARRAYS(ADD_SIZE)
+#undef ADD_SIZE
+    return size;
+}
+
+void *
+ir_image(const struct ir_program *prog, size_t *size)
+{
+    struct ir_image_header h = {
+        .magic = IR_IMAGE_MAGIC, .version = IR_VERSION, .root = prog->root,
+#define COPY_COUNT(array, count) .count = prog->count,
+        IR_ARRAYS(COPY_COUNT)
+#undef COPY_COUNT
+    };
+    h.size = image_size(&h);
+
+    char *image = calloc(1, h.size);
+    if (image == NULL)
+        utils_fatal_error("Could not allocate IR image: ");
+    memcpy(image, &h, sizeof h);
+    size_t off = pad8(sizeof h);
+#define COPY_ARRAY(array, count) \
+    if (prog->count > 0) \
+        memcpy(image + off, prog->array, prog->count * sizeof *prog->array); \
+    off += pad8(prog->count * sizeof *prog->array);
+    IR_ARRAYS(COPY_ARRAY)
+#undef COPY_ARRAY
+
+    *size = h.size;
+    return image;
+}
+
+/*
+ * Checking loaded programs.  An image comes from a file that may have
+ * been truncated or tampered with, so before it runs, every index in
+ * it is checked against the array it indexes, every string offset
+ * against the pool, and the stack use of every expression against
+ * IR_ARITH_STACK.  Statements and words refer to each other, e.g., a
+ * word to the body of its $(...); lowering makes these references a
+ * tree, and they are checked to have no cycle, through which running
+ * the program would never end.
+ */
+struct checker {
+    const struct ir_program *p;
+    uint32_t *edges;        /* the nodes each node refers to, by node */
+    uint32_t *nedges;       /* per node, the number of its edges while
+                               counting, else the end of its edges */
+    bool counting;
+};
+
+/* The nodes of the reference graph: statements, then words. */
+#define STMT_NODE(s)    (s)
+#define WORD_NODE(c, w) ((c)->p->nstmts + (w))
+
+static bool
+check_string(const struct checker *c, uint32_t off)
+{
+    return off < c->p->nstrings;
+}
+
+static bool
+check_range(uint32_t first, uint32_t count, uint32_t n)
+{
+    return first <= n && count <= n - first;
+}
+
+static bool
+check_word_index(const struct checker *c, uint32_t w)
+{
+    return w < c->p->nwords;
+}
+
+/* A subscript word: a lone IR_PART_ARITH. */
+static bool
+check_subscript(const struct checker *c, uint32_t w)
+{
+    if (!check_word_index(c, w))
+        return false;
+    const struct ir_word *word = &c->p->words[w];
+    return word->count == 1 && c->p->parts[word->first].kind == IR_PART_ARITH;
+}
+
+static bool
+check_stmt_index(const struct checker *c, uint32_t s, int kind)
+{
+    return s < c->p->nstmts && (kind == -1 || c->p->stmts[s].kind == kind);
+}
+
+/*
+ * Check the expression ops[first .. first+count): its ops, their
+ * operands, and that its stack neither underflows nor exceeds
+ * IR_ARITH_STACK on any path.  Jumps only go forward, so a single
+ * pass suffices, recording the depth at each jump target.
+ */
+static bool
+check_arith(const struct checker *c, uint32_t first, uint32_t count)
+{
+    const struct ir_program *p = c->p;
+    if (count == 0 || !check_range(first, count, p->nops))
+        return false;
+    const struct ir_op *ops = &p->ops[first];
+    if (ops[0].op != IR_OP_BEGIN || !check_string(c, ops[0].arg)
+        || (ops[0].value != IR_NONE && (ops[0].value < 0 || ops[0].value >= p->nwords)))
+        return false;
+
+    int *depths = malloc(count * sizeof *depths);
+    if (depths == NULL)
+        utils_fatal_error("Could not allocate IR check: ");
+    for (uint32_t i = 0; i < count; i++)
+        depths[i] = -1;
+    int d = 0;                  /* -1 where no path leads */
+    bool ok = true;
+    for (uint32_t pc = 1; ok && pc < count; pc++) {
+        const struct ir_op *op = &ops[pc];
+        if (depths[pc] != -1) {
+            ok = d == -1 || d == depths[pc];
+            d = depths[pc];
+        }
+        int pops = 0, pushes = 0;
+        uint32_t target = IR_NONE;
+        switch (op->op) {
+        case IR_OP_LOAD:
+        case IR_OP_PREADD:
+        case IR_OP_POSTADD:
+            ok = ok && check_string(c, op->arg);
+            pushes = 1;
+            break;
+        case IR_OP_STORE:
+        case IR_OP_LOAD_ELEMENT:
+        case IR_OP_PREADD_ELEMENT:
+        case IR_OP_POSTADD_ELEMENT:
+            ok = ok && check_string(c, op->arg);
+            pops = pushes = 1;
+            break;
+        case IR_OP_FETCH_ELEMENT:
+            ok = ok && check_string(c, op->arg);
+            pops = 1;
+            pushes = 2;
+            break;
+        case IR_OP_STORE_ELEMENT:
+            ok = ok && check_string(c, op->arg);
+            pops = 2;
+            pushes = 1;
+            break;
+        case IR_OP_CONST:
+            pushes = 1;
+            break;
+        case IR_OP_SUBST:
+            ok = ok && check_string(c, op->arg) && ops[0].value != IR_NONE
+                && op->value >= 0 && op->value < IR_ARITH_SLOTS;
+            break;
+        case IR_OP_SLOT:
+            ok = ok && op->value >= 0 && op->value < IR_ARITH_SLOTS;
+            pushes = 1;
+            break;
+        case IR_OP_EVAL:
+            ok = ok && ops[0].value != IR_NONE;
+            break;
+        case IR_OP_ERROR:
+            ok = ok && check_string(c, op->arg);
+            break;
+        case IR_OP_POP:
+            pops = 1;
+            break;
+        case IR_OP_JUMP:
+            target = op->arg;
+            break;
+        case IR_OP_JUMP_FALSE:
+        case IR_OP_AND_JUMP:
+        case IR_OP_OR_JUMP:
+            pops = 1;
+            target = op->arg;
+            break;
+        case IR_OP_BOOL:
+        case IR_OP_NEG:
+        case IR_OP_NOT:
+        case IR_OP_BITNOT:
+            pops = pushes = 1;
+            break;
+        default:
+            ok = ok && op->op >= IR_OP_ADD && op->op <= IR_OP_BITOR;
+            pops = 2;
+            pushes = 1;
+            break;
+        }
+        if (!ok || d == -1)
+            continue;
+        if (d < pops) {
+            ok = false;
+            continue;
+        }
+        if (target != IR_NONE) {
+            /* && and || leave their left operand where they jump to */
+            int at = op->op == IR_OP_AND_JUMP || op->op == IR_OP_OR_JUMP ? d : d - pops;
+            if (target <= pc || target > count) {
+                ok = false;
+            } else if (target < count) {
+                ok = depths[target] == -1 || depths[target] == at;
+                depths[target] = at;
+            }
+        }
+        d += pushes - pops;
+        if (d > IR_ARITH_STACK)
+            ok = false;
+        if (op->op == IR_OP_JUMP || op->op == IR_OP_EVAL || op->op == IR_OP_ERROR)
+            d = -1;
+    }
+    free(depths);
+    return ok;
+}
+
+/* The fallback word of the expression at op, or IR_NONE. */
+static uint32_t
+arith_fallback(const struct checker *c, uint32_t op)
+{
+    int64_t word = c->p->ops[op].value;
+    return word == IR_NONE ? IR_NONE : (uint32_t) word;
+}
+
+static bool
+check_part(const struct checker *c, const struct ir_part *part)
+{
+    const struct ir_program *p = c->p;
+    switch (part->kind) {
+    case IR_PART_LITERAL:
+        return check_string(c, part->str) && part->len < p->nstrings - part->str;
+    case IR_PART_STATUS:
+        return true;
+    case IR_PART_VAR:
+    case IR_PART_ELEMENTS:
+    case IR_PART_SUBSCRIPTS:
+    case IR_PART_COUNT:
+        return check_string(c, part->str);
+    case IR_PART_CMDSUBST:
+        return check_stmt_index(c, part->stmt, -1);
+    case IR_PART_ARITH:
+        return check_arith(c, part->op, part->len);
+    case IR_PART_TRIM_PREFIX:
+    case IR_PART_TRIM_SUFFIX:
+        return check_string(c, part->str) && check_word_index(c, part->len);
+    case IR_PART_ELEMENT:
+        return check_string(c, part->str) && check_subscript(c, part->len);
+    case IR_PART_LENGTH:
+        return check_string(c, part->str)
+            && (part->len == IR_NONE || check_subscript(c, part->len));
+    default:
+        return false;
+    }
+}
+
+/* Check the assignments assigns[first .. first+count); declare allows
+ * assignments without a value. */
+static bool
+check_assigns(const struct checker *c, uint32_t first, uint32_t count, bool declare)
+{
+    const struct ir_program *p = c->p;
+    if (!check_range(first, count, p->nassigns))
+        return false;
+    for (uint32_t i = 0; i < count; i++) {
+        const struct ir_assign *a = &p->assigns[first + i];
+        if (!check_string(c, a->name)
+            || (a->subscript != IR_NONE && !check_subscript(c, a->subscript)))
+            return false;
+        if (a->flags & IR_ASSIGN_ARRAY) {
+            if (!check_range(a->value, a->count, p->nwords))
+                return false;
+        } else if (a->value != IR_NONE || !declare) {
+            if (!check_word_index(c, a->value))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool
+check_kids(const struct checker *c, uint32_t first, uint32_t count, int kind)
+{
+    if (!check_range(first, count, c->p->nkids))
+        return false;
+    for (uint32_t i = 0; i < count; i++)
+        if (!check_stmt_index(c, c->p->kids[first + i], kind))
+            return false;
+    return true;
+}
+
+static bool
+check_stmt(const struct checker *c, const struct ir_stmt *st)
+{
+    const struct ir_program *p = c->p;
+    switch (st->kind) {
+    case IR_SEQ:
+    case IR_PIPELINE:
+        return check_kids(c, st->first, st->count, -1);
+    case IR_COMMAND:
+        return st->builtin < IR_NBUILTINS && check_range(st->first, st->count, p->nwords)
+            && check_assigns(c, st->a, st->b, false);
+    case IR_ASSIGN:
+        return check_assigns(c, st->first, st->count, false);
+    case IR_DECLARE:
+        return check_assigns(c, st->first, st->count, true);
+    case IR_AND:
+    case IR_OR:
+    case IR_WHILE:
+    case IR_UNTIL:
+        return check_stmt_index(c, st->a, -1) && check_stmt_index(c, st->b, -1);
+    case IR_NOT:
+    case IR_BACKGROUND:
+        return check_stmt_index(c, st->a, -1);
+    case IR_REDIRECT:
+        if ((st->a != IR_NONE && !check_stmt_index(c, st->a, -1))
+            || !check_range(st->first, st->count, p->nredirects))
+            return false;
+        for (uint32_t i = 0; i < st->count; i++) {
+            const struct ir_redirect *r = &p->redirects[st->first + i];
+            if (r->op > IR_REDIR_STRING
+                || (r->op == IR_REDIR_CLOSE ? r->word != IR_NONE : !check_word_index(c, r->word)))
+                return false;
+        }
+        return true;
+    case IR_IF:
+        return check_stmt_index(c, st->a, -1) && check_stmt_index(c, st->b, -1)
+            && (st->c == IR_NONE || check_stmt_index(c, st->c, -1));
+    case IR_FOR:
+        return check_string(c, st->a) && check_range(st->first, st->count, p->nwords)
+            && check_stmt_index(c, st->b, -1);
+    case IR_FUNCTION:
+        return check_string(c, st->a) && check_stmt_index(c, st->b, -1);
+    case IR_ARITH:
+        return check_arith(c, st->first, st->count);
+    case IR_ARITH_FOR:
+        return (st->a == IR_NONE || check_stmt_index(c, st->a, IR_ARITH))
+            && check_stmt_index(c, st->b, -1)
+            && (st->c == IR_NONE || check_stmt_index(c, st->c, IR_ARITH));
+    case IR_CASE:
+        return check_word_index(c, st->a) && check_kids(c, st->first, st->count, IR_CASE_ITEM);
+    case IR_CASE_ITEM:
+        return check_range(st->first, st->count, p->nwords)
+            && (st->a == IR_NONE || check_stmt_index(c, st->a, -1));
+    case IR_MATCH:
+        return check_word_index(c, st->a) && check_word_index(c, st->b);
+    case IR_UNSUPPORTED:
+        return check_string(c, st->a);
+    default:
+        return false;
+    }
+}
+
+/* Record that node refers to node to, unless to is IR_NONE: count
+ * the edge, or store it at the end of node's edges. */
+static void
+add_edge(struct checker *c, uint32_t node, uint32_t to)
+{
+    if (to == IR_NONE)
+        return;
+    if (c->counting)
+        c->nedges[node]++;
+    else
+        c->edges[c->nedges[node]++] = to;
+}
+
+static void
+add_word_edges(struct checker *c, uint32_t node, uint32_t first, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+        add_edge(c, node, WORD_NODE(c, first + i));
+}
+
+static void
+add_assign_edges(struct checker *c, uint32_t node, uint32_t first, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        const struct ir_assign *a = &c->p->assigns[first + i];
+        if (a->subscript != IR_NONE)
+            add_edge(c, node, WORD_NODE(c, a->subscript));
+        if (a->flags & IR_ASSIGN_ARRAY)
+            add_word_edges(c, node, a->value, a->count);
+        else if (a->value != IR_NONE)
+            add_edge(c, node, WORD_NODE(c, a->value));
+    }
+}
+
+/* Record the references of statement s, which is valid. */
+static void
+add_stmt_edges(struct checker *c, uint32_t s)
+{
+    const struct ir_program *p = c->p;
+    const struct ir_stmt *st = &p->stmts[s];
+    uint32_t node = STMT_NODE(s);
+    switch (st->kind) {
+    case IR_SEQ:
+    case IR_PIPELINE:
+    case IR_CASE:
+        for (uint32_t i = 0; i < st->count; i++)
+            add_edge(c, node, STMT_NODE(p->kids[st->first + i]));
+        if (st->kind == IR_CASE)
+            add_edge(c, node, WORD_NODE(c, st->a));
+        break;
+    case IR_COMMAND:
+        add_word_edges(c, node, st->first, st->count);
+        add_assign_edges(c, node, st->a, st->b);
+        break;
+    case IR_ASSIGN:
+    case IR_DECLARE:
+        add_assign_edges(c, node, st->first, st->count);
+        break;
+    case IR_REDIRECT:
+        for (uint32_t i = 0; i < st->count; i++) {
+            uint32_t w = p->redirects[st->first + i].word;
+            add_edge(c, node, w == IR_NONE ? IR_NONE : WORD_NODE(c, w));
+        }
+        add_edge(c, node, st->a);
+        break;
+    case IR_NOT:
+    case IR_BACKGROUND:
+        add_edge(c, node, st->a);
+        break;
+    case IR_AND:
+    case IR_OR:
+    case IR_WHILE:
+    case IR_UNTIL:
+        add_edge(c, node, st->a);
+        add_edge(c, node, st->b);
+        break;
+    case IR_IF:
+    case IR_ARITH_FOR:
+        add_edge(c, node, st->a);
+        add_edge(c, node, st->b);
+        add_edge(c, node, st->c);
+        break;
+    case IR_FOR:
+    case IR_CASE_ITEM:
+        add_word_edges(c, node, st->first, st->count);
+        add_edge(c, node, st->kind == IR_FOR ? st->b : st->a);
+        break;
+    case IR_FUNCTION:
+        add_edge(c, node, st->b);
+        break;
+    case IR_ARITH: {
+        uint32_t w = arith_fallback(c, st->first);
+        add_edge(c, node, w == IR_NONE ? IR_NONE : WORD_NODE(c, w));
+        break;
+    }
+    case IR_MATCH:
+        add_edge(c, node, WORD_NODE(c, st->a));
+        add_edge(c, node, WORD_NODE(c, st->b));
+        break;
+    }
+}
+
+/* Record the references of the parts of word w, which is valid. */
+static void
+add_word_part_edges(struct checker *c, uint32_t w)
+{
+    const struct ir_word *word = &c->p->words[w];
+    uint32_t node = WORD_NODE(c, w);
+    for (uint32_t i = 0; i < word->count; i++) {
+        const struct ir_part *part = &c->p->parts[word->first + i];
+        uint32_t to = IR_NONE;
+        switch (part->kind) {
+        case IR_PART_CMDSUBST:
+            add_edge(c, node, STMT_NODE(part->stmt));
+            break;
+        case IR_PART_ARITH:
+            to = arith_fallback(c, part->op);
+            break;
+        case IR_PART_TRIM_PREFIX:
+        case IR_PART_TRIM_SUFFIX:
+        case IR_PART_ELEMENT:
+        case IR_PART_LENGTH:
+            to = part->len;
+            break;
+        }
+        add_edge(c, node, to == IR_NONE ? IR_NONE : WORD_NODE(c, to));
+    }
+}
+
+static void
+add_edges(struct checker *c)
+{
+    for (uint32_t s = 0; s < c->p->nstmts; s++)
+        add_stmt_edges(c, s);
+    for (uint32_t w = 0; w < c->p->nwords; w++)
+        add_word_part_edges(c, w);
+}
+
+/* Is the reference graph free of cycles?  Nodes that nothing refers
+ * to are removed, along with their references, until none is left,
+ * which is only possible if there is no cycle. */
+static bool
+check_acyclic(struct checker *c)
+{
+    uint32_t n = c->p->nstmts + c->p->nwords;
+    c->nedges = calloc(n + 1, sizeof *c->nedges);
+    uint32_t *refs = calloc(n + 1, sizeof *refs);      /* per node, its referrers */
+    if (c->nedges == NULL || refs == NULL)
+        utils_fatal_error("Could not allocate IR check: ");
+    c->counting = true;
+    add_edges(c);
+
+    /* turn the counts into starts; storing the edges moves each start
+     * to the end, the next node's start */
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t k = c->nedges[i];
+        c->nedges[i] = total;
+        total += k;
+    }
+    c->edges = malloc((total + 1) * sizeof *c->edges);
+    uint32_t *queue = malloc((n + 1) * sizeof *queue);
+    if (c->edges == NULL || queue == NULL)
+        utils_fatal_error("Could not allocate IR check: ");
+    c->counting = false;
+    add_edges(c);
+
+    for (uint32_t i = 0; i < total; i++)
+        refs[c->edges[i]]++;
+    uint32_t head = 0, tail = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (refs[i] == 0)
+            queue[tail++] = i;
+    while (head < tail) {
+        uint32_t i = queue[head++];
+        for (uint32_t e = i > 0 ? c->nedges[i - 1] : 0; e < c->nedges[i]; e++)
+            if (--refs[c->edges[e]] == 0)
+                queue[tail++] = c->edges[e];
+    }
+
+    free(queue);
+    free(refs);
+    free(c->edges);
+    free(c->nedges);
+    return tail == n;
+}
+
+/* Is every index in prog, whose arrays are an image's, valid? */
+static bool
+check_program(const struct ir_program *prog)
+{
+    /* every offset into the pool must find a terminating zero */
+    if (prog->nstrings > 0 && prog->strings[prog->nstrings - 1] != '\0')
+        return false;
+    if (prog->nstmts > IR_NONE - prog->nwords)
+        return false;
+
+    struct checker c = { .p = prog };
+    for (uint32_t w = 0; w < prog->nwords; w++) {
+        const struct ir_word *word = &prog->words[w];
+        if (!check_range(word->first, word->count, prog->nparts)
+            || ((word->flags & IR_WORD_STATIC)
+                && (word->count != 1 || prog->parts[word->first].kind != IR_PART_LITERAL)))
+            return false;
+    }
+    /* the words are in bounds now, so subscript words can be looked at */
+    for (uint32_t i = 0; i < prog->nparts; i++)
+        if (!check_part(&c, &prog->parts[i]))
+            return false;
+    for (uint32_t s = 0; s < prog->nstmts; s++)
+        if (!check_stmt(&c, &prog->stmts[s]))
+            return false;
+    return check_acyclic(&c);
+}
+
+struct ir_program *
+ir_load(const void *image, size_t avail, size_t *size)
+{
+    struct ir_image_header h;
+    if (avail < sizeof h)
+        return NULL;
+    memcpy(&h, image, sizeof h);
+    if (h.magic != IR_IMAGE_MAGIC || h.version != IR_VERSION
+        || h.size > avail || h.size != image_size(&h) || h.root >= h.nstmts)
+        return NULL;
+
+    struct ir_program *prog = calloc(1, sizeof *prog);
+    if (prog == NULL)
+        utils_fatal_error("Could not allocate IR: ");
+    prog->root = h.root;
+    prog->borrowed = true;
+    size_t off = pad8(sizeof h);
+#define SET_ARRAY(array, count) \
+    prog->count = h.count; \
+    prog->array = (void *) ((const char *) image + off); \
+    off += pad8(h.count * sizeof *prog->array);
+    IR_ARRAYS(SET_ARRAY)
+#undef SET_ARRAY
+
+    if (!check_program(prog)) {
+        free(prog);
+        return NULL;
+    }
+    *size = h.size;
+    return prog;
+}
@@ -0,0 +1,359 @@
+#ifndef __IR_H
+#define __IR_H
+/*
+ * A compact, executable intermediate representation (IR) of a script.
+ *
+ * The tree-sitter syntax tree is lowered once, before execution, into
+ * a handful of flat arrays: statements, words, word parts, and
+ * assignments, plus the stack code of arithmetic expressions.  Node
+ * kinds are resolved at lowering time, and all
+ * literal text is copied (with quotes and escapes already removed)
+ * into a single string pool, so the interpreter never navigates
+ * the syntax tree or compares node type names.
+ *
+ * All cross references are 32-bit indices into these arrays rather
+ * than pointers, and every string in the pool is zero-terminated
+ * so that it can be placed directly into an argv vector.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <tree_sitter/api.h>
+
+/* The version of the layout of programs, which is part of their images
+ * (see ir_image); increment it whenever anything below changes, or
+ * how a script is split into the programs that are cached, see
+ * complete_prefix in minibash.c. */
+#define IR_VERSION 14
+
+/* Marks an absent statement index, e.g., an if statement without else. */
+#define IR_NONE UINT32_MAX
+
+/* Statement kinds. */
+enum ir_kind {
+    IR_SEQ,         /* run kids[first .. first+count) in order */
+    IR_COMMAND,     /* simple command; argv words are words[first .. first+count),
+                       prefix assignments are assigns[a .. a+b) */
+    IR_ASSIGN,      /* assignments assigns[first .. first+count) */
+    IR_AND,         /* a && b */
+    IR_OR,          /* a || b */
+    IR_NOT,         /* ! a */
+    IR_BACKGROUND,  /* a & */
+    IR_REDIRECT,    /* run a (or nothing if IR_NONE) with the redirections
+                       redirects[first .. first+count) in effect */
+    IR_IF,          /* if a; then b; else c; fi (c may be IR_NONE) */
+    IR_WHILE,       /* while a; do b; done */
+    IR_UNTIL,       /* until a; do b; done */
+    IR_FOR,         /* for <name at string a> in words[first .. first+count);
+                       do b; done */
+    IR_PIPELINE,    /* kids[first .. first+count) connected by pipes; the
+                       stage before a |& is wrapped into a 2>&1 redirection */
+    IR_FUNCTION,    /* define the function named by string a, whose body is b */
+    IR_DECLARE,     /* declare, typeset, or local with assigns[first ..
+                       first+count), whose flags are IR_DECLARE_*; an
+                       assign whose value is IR_NONE only declares its name */
+    IR_ARITH,       /* evaluate the expression ops[first .. first+count),
+                       succeeding if it is not 0; flags are IR_ARITH_* */
+    IR_ARITH_FOR,   /* for ((; a; c)); do b; done, where a and c are IR_ARITH
+                       statements or IR_NONE; the initializer runs before */
+    IR_CASE,        /* case <word a> in, with the IR_CASE_ITEMs kids[first ..
+                       first+count); esac */
+    IR_CASE_ITEM,   /* patterns words[first .. first+count) ) a (or IR_NONE),
+                       ended by ;; unless flags are IR_CASE_* */
+    IR_MATCH,       /* [[ <word a> == <pattern word b> ]], or =~ <regex word b>;
+                       flags are IR_MATCH_* */
+    IR_UNSUPPORTED, /* node type not (yet) implemented; its name is string a */
+};
+
+/* Commands the interpreter handles itself, resolved at lowering time
+ * whenever the command name is a literal. */
+enum ir_builtin {
+    IR_BUILTIN_NONE,
+    IR_BUILTIN_TRUE,
+    IR_BUILTIN_FALSE,
+    IR_BUILTIN_BREAK,
+    IR_BUILTIN_CONTINUE,
+    IR_BUILTIN_WAIT,
+    IR_BUILTIN_ECHO,
+    IR_BUILTIN_PRINTF,
+    IR_BUILTIN_TEST,
+    IR_BUILTIN_EXPR,
+    IR_BUILTIN_HASH,
+    IR_BUILTIN_TYPE,
+    IR_BUILTIN_RETURN,
+    IR_BUILTIN_LET,
+    IR_BUILTIN_READ,
+    IR_BUILTIN_MAPFILE,
+    IR_NBUILTINS,           /* the number of enum ir_builtin values */
+};
+
+struct ir_stmt {
+    uint8_t  kind;          /* enum ir_kind */
+    uint8_t  builtin;       /* enum ir_builtin, for IR_COMMAND */
+    uint16_t flags;
+    uint32_t first, count;  /* a range of kids, words, or assigns */
+    uint32_t a, b, c;       /* kind-specific operands, see enum ir_kind */
+};
+
+/* IR_DECLARE flags */
+#define IR_DECLARE_LOCAL    1   /* local, which only works in functions */
+#define IR_DECLARE_INTEGER  2   /* -i */
+#define IR_DECLARE_ARRAY    4   /* -a */
+
+/* IR_ARITH flags */
+#define IR_ARITH_LET        1   /* an argument of let rather than (( )) */
+
+/* IR_CASE_ITEM flags */
+#define IR_CASE_FALLTHROUGH 1   /* ;& runs the next item's commands as well */
+#define IR_CASE_CONTINUE    2   /* ;;& goes on testing the next items */
+
+/* IR_MATCH flags */
+#define IR_MATCH_NEGATE     1   /* != */
+#define IR_MATCH_REGEX      2   /* =~ */
+
+/* Word part kinds. */
+enum ir_part_kind {
+    IR_PART_LITERAL,        /* literal text, string str of length len */
+    IR_PART_STATUS,         /* $? */
+    IR_PART_VAR,            /* $name or ${name}, name is string str */
+    IR_PART_CMDSUBST,       /* $(...), body is statement stmt */
+    IR_PART_ARITH,          /* $((...)), the expression ops[op .. op+len) */
+    IR_PART_TRIM_PREFIX,    /* ${name#pattern}, name is string str, and len
+                               the index of the pattern word */
+    IR_PART_TRIM_SUFFIX,    /* ${name%pattern}, likewise */
+    IR_PART_ELEMENT,        /* ${name[subscript]}, name is string str, and len
+                               the index of the subscript word */
+    IR_PART_ELEMENTS,       /* ${name[@]}, or ${name[*]} if IR_PART_JOIN;
+                               name is string str, which is "@" for $@
+                               and $*, the positional parameters */
+    IR_PART_SUBSCRIPTS,     /* ${!name[@]}, or ${!name[*]} if IR_PART_JOIN */
+    IR_PART_LENGTH,         /* ${#name}, or ${#name[subscript]} if len is not
+                               IR_NONE but the index of the subscript word */
+    IR_PART_COUNT,          /* ${#name[@]} */
+};
+
+/* Part flags */
+#define IR_PART_QUOTED  1   /* part appeared inside double quotes */
+#define IR_PART_NOFORK  2   /* a $(...) whose body can run in the shell itself,
+                               as it only runs builtins that write to stdout
+                               and only sets variables */
+#define IR_PART_LONGEST 4   /* ${name##pattern} or ${name%%pattern} */
+#define IR_PART_JOIN    8   /* ${name[*]}: the elements make one field, even
+                               when quoted */
+
+struct ir_part {
+    uint8_t  kind;          /* enum ir_part_kind */
+    uint8_t  flags;
+    uint16_t pad;
+    union {
+        uint32_t str;       /* string pool offset */
+        uint32_t stmt;      /* statement index */
+        uint32_t op;        /* op index */
+    };
+    uint32_t len;           /* length of str in bytes, number of ops, or a word */
+};
+
+/* Word flags */
+#define IR_WORD_STATIC  1   /* a single literal part, needs no expansion */
+#define IR_WORD_QUOTED  2   /* contains quotes, never expands to nothing */
+#define IR_WORD_SPLIT   4   /* has unquoted expansions, whose results are
+                               split into fields on IFS */
+#define IR_WORD_GLOB    8   /* has unquoted pattern characters, so it is
+                               subject to pathname expansion */
+
+/*
+ * A word is a template whose parts are concatenated upon expansion.
+ * In a pattern (regex) word, the literal parts are pattern (regex)
+ * text, in which quoted special characters are escaped with a
+ * backslash; the results of quoted expansions are escaped when they
+ * are expanded.  A subscript word is a lone IR_PART_ARITH.
+ */
+#define IR_PATTERN_SPECIALS "*?[]\\"
+#define IR_REGEX_SPECIALS   "\\.[]()*+?{}|^$"
+
+struct ir_word {
+    uint16_t flags;
+    uint16_t pad;
+    uint32_t first, count;  /* parts[first .. first+count) */
+};
+
+/* Redirection operators */
+enum ir_redirect_op {
+    IR_REDIR_IN,            /* [n]<word */
+    IR_REDIR_OUT,           /* [n]>word, [n]>|word */
+    IR_REDIR_APPEND,        /* [n]>>word */
+    IR_REDIR_OUT_ERR,       /* &>word, >&word */
+    IR_REDIR_APPEND_ERR,    /* &>>word */
+    IR_REDIR_DUP,           /* [n]<&word, [n]>&word */
+    IR_REDIR_CLOSE,         /* [n]<&-, [n]>&- */
+    IR_REDIR_STRING,        /* [n]<<<word, and here-documents whose body is word */
+};
+
+/* Redirection flags */
+#define IR_REDIR_NEWLINE    1   /* append a newline to the string, for <<< */
+#define IR_REDIR_STRIP_TABS 2   /* strip leading tabs from each line, for <<- */
+
+struct ir_redirect {
+    uint8_t  op;            /* enum ir_redirect_op */
+    uint8_t  flags;
+    uint16_t pad;
+    int32_t  fd;            /* the descriptor redirected */
+    uint32_t word;          /* word index of the target, IR_NONE for IR_REDIR_CLOSE */
+};
+
+/* NAME=value, where value is a word index (IR_NONE for local NAME). */
+struct ir_assign {
+    uint32_t name;          /* string pool offset */
+    uint32_t value;         /* word index */
+    uint32_t flags;         /* IR_ASSIGN_* */
+    uint32_t subscript;     /* NAME[subscript]=value: the subscript word's
+                               index, else IR_NONE */
+    uint32_t count;         /* NAME=(words[value .. value+count)), if
+                               IR_ASSIGN_ARRAY */
+};
+
+#define IR_ASSIGN_APPEND    1   /* NAME+=value */
+#define IR_ASSIGN_ARRAY     2   /* NAME=(value ...) */
+
+/*
+ * Arithmetic expressions are compiled into code for a stack machine.
+ * An expression is a range of ops whose first is an IR_OP_BEGIN;
+ * jump targets are relative to it.  Variables are named by string
+ * pool offsets.
+ *
+ * A $name in an expression stands for the variable's text, not its
+ * value, which makes a difference unless the text is a number; the
+ * values of the $names are therefore fetched before anything else
+ * is evaluated, into slots, and if one is not a number the
+ * expression is evaluated from the text of its fallback word
+ * instead, as are expressions that cannot be compiled ahead, e.g.,
+ * because they contain a $(...).
+ */
+enum ir_op_kind {
+    IR_OP_BEGIN,            /* arg is the source text, value the index of the
+                               fallback word, or IR_NONE */
+    IR_OP_CONST,            /* push value */
+    IR_OP_LOAD,             /* push variable arg */
+    IR_OP_STORE,            /* assign the top to variable arg, leaving it */
+    IR_OP_PREADD,           /* add value to variable arg, push the result */
+    IR_OP_POSTADD,          /* push variable arg, then add value to it */
+    IR_OP_LOAD_ELEMENT,     /* replace the top, a subscript, by that element
+                               of array arg */
+    IR_OP_FETCH_ELEMENT,    /* push the element of array arg whose subscript
+                               is the top, leaving it */
+    IR_OP_STORE_ELEMENT,    /* pop a value, and assign it to the element of
+                               array arg whose subscript is the top, which
+                               it replaces */
+    IR_OP_PREADD_ELEMENT,   /* add value to the element of array arg whose
+                               subscript is the top, and replace it by the
+                               result */
+    IR_OP_POSTADD_ELEMENT,  /* likewise, but replace it by the element */
+    IR_OP_SUBST,            /* slot value = $arg, if a number */
+    IR_OP_SLOT,             /* push slot value */
+    IR_OP_EVAL,             /* evaluate the fallback word's text instead */
+    IR_OP_ERROR,            /* fail with the message at string arg */
+    IR_OP_POP,
+    IR_OP_JUMP,             /* to arg */
+    IR_OP_JUMP_FALSE,       /* pop, and jump to arg if 0 */
+    IR_OP_AND_JUMP,         /* jump to arg if the top is 0, else pop */
+    IR_OP_OR_JUMP,          /* jump to arg if the top is not 0, leaving 1,
+                               else pop */
+    IR_OP_BOOL,             /* top = top != 0 */
+    IR_OP_NEG,              /* unary operators on the top */
+    IR_OP_NOT,
+    IR_OP_BITNOT,
+    IR_OP_ADD,              /* binary operators, see ir_arith_binary */
+    IR_OP_SUB,
+    IR_OP_MUL,
+    IR_OP_DIV,
+    IR_OP_MOD,
+    IR_OP_POW,
+    IR_OP_SHL,
+    IR_OP_SHR,
+    IR_OP_LT,
+    IR_OP_LE,
+    IR_OP_GT,
+    IR_OP_GE,
+    IR_OP_EQ,
+    IR_OP_NE,
+    IR_OP_BITAND,
+    IR_OP_BITXOR,
+    IR_OP_BITOR,
+};
+
+#define IR_ARITH_STACK  64      /* the most values an expression stacks */
+#define IR_ARITH_SLOTS  8       /* the most $names an expression fetches */
+
+struct ir_op {
+    uint8_t  op;            /* enum ir_op_kind */
+    uint8_t  pad[3];
+    uint32_t arg;
+    int64_t  value;
+};
+
+struct ir_program {
+    struct ir_stmt   *stmts;
+    uint32_t         *kids;
+    struct ir_word   *words;
+    struct ir_part   *parts;
+    struct ir_assign *assigns;
+    struct ir_redirect *redirects;
+    struct ir_op     *ops;
+    char             *strings;
+    uint32_t nstmts, nkids, nwords, nparts, nassigns, nredirects, nops, nstrings;
+    uint32_t root;          /* index of the top-level statement */
+    bool borrowed;          /* the arrays belong to an image, see ir_load */
+};
+
+/* Lower the tree rooted at `program`, whose text is `source`. */
+struct ir_program *ir_compile(TSNode program, const char *source);
+
+/* Lower only the top-level statements of `program` that end at or
+ * before byte `end` of source, e.g., those of a script read so far.
+ * source need not be zero-terminated; all text is copied. */
+struct ir_program *ir_compile_prefix(TSNode program, const char *source, uint32_t end);
+
+/* Compile the arithmetic expression text, of len bytes, into a program
+ * whose ops are that expression alone; text that is not an expression
+ * compiles into an IR_OP_ERROR.  Names are not expanded: a $ is an
+ * error, as it is in bash once expansions were performed. */
+struct ir_program *ir_compile_arith(const char *text, size_t len);
+
+/* Apply binary operator op to l and r, storing the result in *result.
+ * Arithmetic wraps around, as in bash.  Returns NULL, or why op
+ * cannot be applied, e.g., "division by 0". */
+const char *ir_arith_binary(uint8_t op, int64_t l, int64_t r, int64_t *result);
+
+/* If the len bytes at s are a number, with an optional sign and blanks
+ * around it, store its value in *n and return true.  Numbers are
+ * written as in C, or as base#digits. */
+bool ir_arith_number(const char *s, size_t len, int64_t *n);
+
+/* Free a program returned by ir_compile, ir_compile_prefix, or
+ * ir_compile_arith. */
+void ir_free(struct ir_program *prog);
+
+/*
+ * Return a malloc'd image of prog, a position-independent copy of
+ * it, whose length is stored in *size.  Since the IR has no
+ * pointers, an image can be written to a file and later executed
+ * straight from a mapping of that file.
+ */
+void *ir_image(const struct ir_program *prog, size_t *size);
+
+/*
+ * Return the program whose image is at the start of the avail bytes
+ * at image, storing the image's length in *size, or NULL if there
+ * is no valid image, e.g., one with an index out of bounds, as every
+ * index is checked.  The program's arrays point into the image,
+ * which must outlive it.
+ */
+struct ir_program *ir_load(const void *image, size_t avail, size_t *size);
+
+/* Return the zero-terminated pool string at offset off. */
+static inline char *
+ir_str(const struct ir_program *prog, uint32_t off)
+{
+    return prog->strings + off;
+}
+
+#endif /* __IR_H */
@@ -9,47 +9,72 @@
 #include <readline/readline.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <assert.h>
 
 #include <tree_sitter/api.h>
 #include "tree_sitter/tree-sitter-bash.h"
 #include "ts_symbols.h"
+#include "ts_nodes.h"
 /* Since the handed out code contains a number of unused functions. */
 #pragma GCC diagnostic ignored "-Wunused-function"
 
 #include "hashtable.h"
+#include "tommyds/tommyhashlin.h"
+#include "tommyds/tommyalloc.h"
 #include "signal_support.h"
 #include "utils.h"
 #include "list.h"
 #include "ts_helpers.h"
-#include <spawn.h>
+#include "ir.h"
+#include "reaper.h"
+#include "builtins.h"
+#include "pathcache.h"
+#include "arena.h"
+#include "scriptcache.h"
+#include "spawn.h"
+#include "value.h"
+#include "export.h"
+#include "ifs.h"
+#include "pathexp.h"
+#include "pattern.h"
+#include "regcache.h"
+#include "readbuf.h"
+#include "array.h"
+#include <stdalign.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <sys/stat.h>
 
-/* These are field ids suitable for use in ts_node_child_by_field_id for certain rules. 
-   e.g., to obtain the body of a while loop, you can use:
-    TSNode body = ts_node_child_by_field_id(child, bodyId);
-*/
-static TSFieldId bodyId, redirectId, destinationId, valueId, nameId, conditionId;
-static TSFieldId variableId;
-static TSFieldId leftId, operatorId, rightId;
-
-static char *input;         // to avoid passing the current input around
 static TSParser *parser;    // a singleton parser instance 
 static tommy_hashdyn shell_vars;        // a hash table containing the internal shell variables
+static struct ir_program *prog;         // the program being executed
+static struct arena scratch;            // temporaries of the statements being run
+static pid_t job_pgid;                  // process group commands join, 0 for their own
+static const char *cache_dir;           // of compiled scripts, see scriptcache.h
 
 static void handle_child_status(pid_t pid, int status);
-static char *read_script_from_fd(int readfd);
 static void execute_script(char *script);
 
 extern char **environ;
-static void execute_command(TSNode command_node);
+static void run_stmt(uint32_t stmt);
 static int last_exit_status = 0;  // Track exit status of last command
+static int loop_depth;            // number of loops currently executing
+static int breaking, continuing;  // levels of a pending break or continue
+static bool ran_cmdsubst;         // a command substitution set last_exit_status
+static bool exits_after;          // the process exits once the next statement run
+                                  // finishes, so its last command may replace it
+static bool aborting;             // an expansion failed; as in bash, the rest of
+                                  // the top-level command it is in is abandoned
 
 
 
@@ -57,8 +82,14 @@ static int last_exit_status = 0;  // Track exit status of last command
 static void
 usage(char *progname)
 {
-    printf("Usage: %s -h\n"
-        " -h            print this help\n",
+    printf("Usage: %s [-hSB] [script]\n"
+        " -h            print this help\n"
+        " -S            print the hits and misses of the script cache\n"
+        " -B            measure the cost of spawning commands and exit\n"
+        "\n"
+        "If MINIBASH_CACHE names a directory, compiled scripts are cached there.\n"
+        "MINIBASH_SPAWN selects how commands are started: posix (the default),\n"
+        "clone, fork, or zygote.\n",
         progname);
 
     exit(EXIT_SUCCESS);
@@ -94,49 +125,114 @@ struct job {
     int  num_processes_alive;   /* The number of processes that we know to be alive */
 
     /* Add additional fields here as needed. */
+    struct job_process *processes;  /* most recently added first */
+};
+
+/* A process that belongs to a job. */
+struct job_process {
+    tommy_node node;            /* Link element for pid2process. */
+    pid_t pid;
+    bool alive;                 /* not yet reaped */
+    int status;                 /* exit status as seen by $?, once reaped */
+    struct job *job;
+    struct job_process *next;   /* next older process of the same job */
 };
 
 /* Utility functions for job list management.
- * We use 2 data structures: 
+ * We use 3 data structures: 
  * (a) an array jid2job to quickly find a job based on its id
  * (b) a linked list to support iteration
+ * (c) a hash table pid2process to find the job of a child in
+ *     O(1) when it is reaped; it holds only processes that are alive.
+ * Unused job ids are kept on a stack, so that allocating one does
+ * not require a search.  Jobs and processes come from fixed-size
+ * allocators that recycle their memory.
  */
 #define MAXJOBS (1<<16)
 static struct list job_list;
 
 static struct job *jid2job[MAXJOBS];
+static int free_jids[MAXJOBS];  /* stack of released job ids */
+static int nfree_jids;
+static int next_jid = 1;        /* smallest job id never handed out */
+static tommy_hashlin pid2process;
+static tommy_allocator job_allocator, process_allocator;
 
 /* Return job corresponding to jid */
 static struct job *
 get_job_from_jid(int jid)
 {
-    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
+    if (jid > 0 && jid < next_jid && jid2job[jid] != NULL)
         return jid2job[jid];
 
     return NULL;
 }
 
+static void reap_finished_jobs(void);
+
 /* Allocate a new job, optionally adding it to the job list. */
 static struct job *
 allocate_job(bool includeinjoblist)
 {
-    struct job * job = malloc(sizeof *job);
+    struct job * job = tommy_allocator_alloc(&job_allocator);
     job->num_processes_alive = 0;
+    job->processes = NULL;
     job->jid = -1;
     if (!includeinjoblist)
         return job;
 
-    list_push_back(&job_list, &job->elem);
-    for (int i = 1; i < MAXJOBS; i++) {
-        if (jid2job[i] == NULL) {
-            jid2job[i] = job;
-            job->jid = i;
-            return job;
-        }
+    /* finished background jobs are kept until waited for, reclaim
+     * their ids only when they are needed */
+    if (nfree_jids == 0 && next_jid == MAXJOBS)
+        reap_finished_jobs();
+
+    if (nfree_jids > 0)
+        job->jid = free_jids[--nfree_jids];
+    else if (next_jid < MAXJOBS)
+        job->jid = next_jid++;
+    else {
+        fprintf(stderr, "Maximum number of jobs exceeded\n");
+        abort();
     }
-    fprintf(stderr, "Maximum number of jobs exceeded\n");
-    abort();
-    return NULL;
+    jid2job[job->jid] = job;
+    list_push_back(&job_list, &job->elem);
+    return job;
+}
+
+/* Record that process pid, which was just started, belongs to job. */
+static void
+add_process(struct job *job, pid_t pid)
+{
+    struct job_process *p = tommy_allocator_alloc(&process_allocator);
+    p->pid = pid;
+    p->alive = true;
+    p->status = 0;
+    p->job = job;
+    p->next = job->processes;
+    job->processes = p;
+    job->num_processes_alive++;
+    tommy_hashlin_insert(&pid2process, &p->node, p, tommy_inthash_u32(pid));
+}
+
+static int
+process_has_pid(const void *arg, const void *obj)
+{
+    return *(const pid_t *) arg != ((const struct job_process *) obj)->pid;
+}
+
+/* Return the live process with this pid, or NULL if there is none. */
+static struct job_process *
+get_process_from_pid(pid_t pid)
+{
+    return tommy_hashlin_search(&pid2process, process_has_pid, &pid,
+                                tommy_inthash_u32(pid));
+}
+
+/* The exit status of a job is that of its last process. */
+static int
+job_exit_status(struct job *job)
+{
+    return job->processes != NULL ? job->processes->status : 0;
 }
 
 /* Delete a job.
@@ -152,44 +248,36 @@ delete_job(struct job *job, bool removeFromJobList)
         assert(jid2job[jid] == job);
         jid2job[jid]->jid = -1;
         jid2job[jid] = NULL;
+        free_jids[nfree_jids++] = jid;
+        list_remove(&job->elem);
     } else {
         assert(job->jid == -1);
     }
     /* add any other job cleanup here. */
-    free(job);
+    while (job->processes != NULL) {
+        struct job_process *p = job->processes;
+        job->processes = p->next;
+        if (p->alive)   /* e.g., stopped */
+            tommy_hashlin_remove_existing(&pid2process, &p->node);
+        tommy_allocator_free(&process_allocator, p);
+    }
+    tommy_allocator_free(&job_allocator, job);
 }
 
-
-/*
- * Suggested SIGCHLD handler.
- *
- * Call waitpid() to learn about any child processes that
- * have exited or changed status (been stopped, needed the
- * terminal, etc.)
- * Just record the information by updating the job list
- * data structures.  Since the call may be spurious (e.g.
- * an already pending SIGCHLD is delivered even though
- * a foreground process was already reaped), ignore when
- * waitpid returns -1.
- * Use a loop with WNOHANG since only a single SIGCHLD 
- * signal may be delivered for multiple children that have 
- * exited. All of them need to be reaped.
- */
+/* A child process does not own the jobs of its parent; start over
+ * without them.  Their memory is the parent's, do not free it. */
 static void
-sigchld_handler(int sig, siginfo_t *info, void *_ctxt)
+forget_jobs(void)
 {
-    pid_t child;
-    int status;
-
-    assert(sig == SIGCHLD);
-
-    while ((child = waitpid(-1, &status, WUNTRACED|WNOHANG)) > 0) {
-        handle_child_status(child, status);
-    }
+    list_init(&job_list);
+    tommy_hashlin_init(&pid2process);
+    nfree_jids = 0;
+    next_jid = 1;
+    spawn_forget_zygote();
 }
 
 /* Wait for all processes in this job to complete, or for
- * the job no longer to be in the foreground.
+ * the job to be stopped.
  *
  * You should call this function from where you wait for
  * jobs started without the &; you would only use this function
@@ -211,334 +299,3835 @@ sigchld_handler(int sig, siginfo_t *info, void *_ctxt)
  * The code below relies on `job->status` having been set to FOREGROUND
  * and `job->num_processes_alive` having been set to the number of
  * processes successfully forked for this job.
+ *
+ * Children are reaped by the reaper's event loop, which reports
+ * every child that changed state, of this or any other job, to
+ * handle_child_status.
  */
 static void
 wait_for_job(struct job *job)
 {
     assert(signal_is_blocked(SIGCHLD));
 
-    while (job->status == FOREGROUND && job->num_processes_alive > 0) {
-        int status;
-
-        pid_t child = waitpid(-1, &status, WUNTRACED);
-
-        // When called here, any error returned by waitpid indicates a logic
-        // bug in the shell.
-        // In particular, ECHILD "No child process" means that there has
-        // already been a successful waitpid() call that reaped the child, so
-        // there's likely a bug in handle_child_status where it failed to update
-        // the "job" status and/or num_processes_alive fields in the required
-        // fashion.
-        // Since SIGCHLD is blocked, there cannot be races where a child's exit
-        // was handled via the SIGCHLD signal handler.
-        if (child != -1)
-            handle_child_status(child, status);
-        else
-            utils_fatal_error("waitpid failed, see code for explanation");
+    while ((job->status == FOREGROUND || job->status == BACKGROUND)
+           && job->num_processes_alive > 0)
+        reaper_wait(-1);
+}
+
+
+/* A growable string buffer, used to build the result of expansions.
+ * It lives in the scratch arena, where it usually grows in place. */
+struct strbuf {
+    char *buf;
+    size_t len, cap;
+};
+
+static void
+strbuf_append(struct strbuf *sb, const char *s, size_t len)
+{
+    if (sb->len + len + 1 > sb->cap) {
+        size_t cap = sb->cap ? sb->cap : 64;
+        while (sb->len + len + 1 > cap)
+            cap *= 2;
+        sb->buf = arena_grow(&scratch, sb->buf, sb->cap, cap);
+        sb->cap = cap;
+    }
+    memcpy(sb->buf + sb->len, s, len);
+    sb->len += len;
+    sb->buf[sb->len] = '\0';
+}
+
+/* Return the buffer's zero-terminated content. */
+static char *
+strbuf_finish(struct strbuf *sb)
+{
+    if (sb->buf == NULL)
+        return arena_strndup(&scratch, "", 0);
+    return sb->buf;
+}
+
+/* An argv vector under construction, in the scratch arena. */
+struct argvec {
+    char **argv;
+    int argc, cap;
+};
+
+static void
+argvec_push(struct argvec *av, char *arg)
+{
+    if (av->argc + 2 > av->cap) {
+        int cap = av->cap ? 2 * av->cap : 8;
+        av->argv = arena_grow(&scratch, av->argv, av->cap * sizeof *av->argv,
+                              cap * sizeof *av->argv);
+        av->cap = cap;
     }
+    av->argv[av->argc++] = arg;
+    av->argv[av->argc] = NULL;
 }
 
+/*
+ * Shell variables.  Every name is interned (see value.h) and has a
+ * struct var in shell_vars, set or not, that lives as long as the
+ * shell; the names in a program are resolved to theirs once, through
+ * its resolved array, so that running a statement hashes no names.
+ * Values are shared, not copied, between variables and argv vectors.
+ * A variable that arithmetic sets holds a number, which is turned
+ * into a string only once one is needed, see var_value.  An array
+ * variable holds its elements instead, see array.h, and its value is
+ * element 0.  A struct var also records the function of the same
+ * name, if any.
+ */
+struct var {
+    tommy_node node;
+    struct value *name;     /* interned */
+    struct value *val;      /* NULL if unset, an array, or not yet made
+                               from num */
+    struct array *array;    /* the elements, if an array, else NULL */
+    int64_t num;            /* the value as a number, if has_num */
+    bool has_num;
+    bool integer;           /* declare -i: assignments are evaluated */
+    int export;             /* its entry in the export table, -1 if none */
+    int local_depth;        /* function_depth when it was last made local */
+    struct function *function;
+};
+
+/*
+ * A copy-on-write layer over the shell variables.  While a command
+ * substitution runs in the shell itself, the variables it sets go
+ * into a scope of its own, which shadows the variables outside and
+ * is discarded when the substitution finishes, as if it had run in
+ * a subshell.  A scope holds a struct var of its own for each
+ * variable set in it.
+ */
+struct var_scope {
+    tommy_hashdyn vars;
+    struct var_scope *parent;
+};
+static struct var_scope *var_scope;     // innermost scope, NULL if none
+
+/* What the pool strings of a program stand for, by offset. */
+struct resolved {
+    struct var *var;        /* the variable the string names */
+    struct value *literal;  /* the string itself, as a value */
+    struct ir_program *arith;   /* the string, compiled as an expression */
+    struct pathexp *glob;       /* the string, compiled as a pathname pattern */
+    struct pattern *pattern;    /* the string, compiled as a pattern */
+    struct regex *regex;        /* the string, compiled as a regex */
+};
+
+/* A program being run, or kept alive by the functions it defined. */
+struct program {
+    struct ir_program *ir;
+    struct resolved *resolved;  /* NULL until needed */
+    unsigned refs;
+};
+static struct program *running;         // the program whose ir is prog
+
+/*
+ * Functions.  A function is a statement of the program that defined
+ * it, which it keeps alive, and is called with the program switched.
+ */
+struct function {
+    struct program *program;
+    uint32_t body;
+};
 
-/**
- * Execute a simple command using posix_spawn.
- * Handles both absolute paths and PATH lookup.
+/*
+ * Local variables.  However many functions make a variable local, it
+ * keeps its single struct var, so that looking it up remains a single
+ * probe, or none: a function that makes a variable local saves its
+ * value in the undo log, and returning restores what the function
+ * saved.  Calls and returns thus cost as much as the locals and the
+ * positional parameters they set, not as many variables as there are.
  */
-static void execute_command(TSNode command_node)
+struct undo {
+    struct var *var;
+    struct value *val;      /* the value to restore */
+    struct array *array;
+    int64_t num;            /* and the rest of the var's state */
+    bool has_num;
+    bool integer;
+    int local_depth;
+};
+static struct undo *undo_log;
+static size_t nundo, capundo;
+static int function_depth;              // functions currently executing
+static bool returning;                  // a return is pending
+static int nparams;                     // positional parameters set, $1 .. $nparams
+static struct var **param_vars;         // the variables 1, 2, ..., by number
+static int nparam_vars;
+
+/* Values that the argv vectors of the statements being run point
+ * into, released along with their scratch memory. */
+static struct value **pins;
+static size_t npins, cappins;
+
+/* Keep v, whose reference the caller passes on, until the statement
+ * being run finishes, and return its string. */
+static char *
+pin(struct value *v)
 {
-    TSNode name_node = ts_node_child_by_field_id(command_node, nameId);
-    if (ts_node_is_null(name_node)) {
-        name_node = ts_node_named_child(command_node, 0);
+    if (npins == cappins) {
+        cappins = cappins ? 2 * cappins : 64;
+        pins = realloc(pins, cappins * sizeof *pins);
+        if (pins == NULL)
+            utils_fatal_error("Could not allocate pins: ");
     }
-    
-    if (ts_node_is_null(name_node)) {
-        fprintf(stderr, "Error: No command name found\n");
-        return;
+    pins[npins++] = v;
+    return v->str;
+}
+
+static void
+unpin(size_t n)
+{
+    while (npins > n)
+        value_unref(pins[--npins]);
+}
+
+static int
+compare_var(const void *arg, const void *obj)
+{
+    return ((const struct var *) obj)->name != arg;
+}
+
+static struct var *
+find_var(tommy_hashdyn *vars, struct value *name)
+{
+    return tommy_hashdyn_search(vars, compare_var, name, value_hash(name));
+}
+
+static struct var *
+insert_var(tommy_hashdyn *vars, struct value *name)
+{
+    struct var *v = calloc(1, sizeof *v);
+    if (v == NULL)
+        utils_fatal_error("Could not allocate variable: ");
+    v->name = name;
+    v->export = -1;
+    tommy_hashdyn_insert(vars, &v->node, v, value_hash(name));
+    return v;
+}
+
+static void program_unref(struct program *p);
+
+static void
+free_var(void *obj)
+{
+    struct var *v = obj;
+    value_unref(v->val);
+    array_free(v->array);
+    if (v->function != NULL) {
+        program_unref(v->function->program);
+        free(v->function);
     }
-    
-    char *cmd_name = ts_extract_node_text(input, name_node);
+    free(v);
+}
+
+/* Return the variable called name, which need not be set. */
+static struct var *
+lookup_var(const char *name, size_t len)
+{
+    struct value *interned = value_intern(name, len);
+    struct var *v = find_var(&shell_vars, interned);
+    return v != NULL ? v : insert_var(&shell_vars, interned);
+}
+
+/* Return what the strings of the running program resolved to. */
+static struct resolved *
+running_resolved(void)
+{
+    if (running->resolved == NULL
+        && (running->resolved = calloc(prog->nstrings, sizeof *running->resolved)) == NULL)
+        utils_fatal_error("Could not allocate names: ");
+    return running->resolved;
+}
+
+/* Return the variable named by the string at off in the program. */
+static struct var *
+program_var(uint32_t off)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->var == NULL)
+        r->var = lookup_var(ir_str(prog, off), strlen(ir_str(prog, off)));
+    return r->var;
+}
+
+/* Return the string at off, of len bytes, as a value, with a new reference. */
+static struct value *
+program_literal(uint32_t off, uint32_t len)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->literal == NULL)
+        r->literal = value_new(ir_str(prog, off), len);
+    return value_ref(r->literal);
+}
 
-    
-    uint32_t child_count = ts_node_named_child_count(command_node);
-    char **argv = calloc(child_count + 1, sizeof(char*));
-    if (!argv) {
-        fprintf(stderr, "Memory allocation failed\n");
-        free(cmd_name);
+/* Return the string at off, of len bytes, compiled as an expression. */
+static struct ir_program *
+program_arith(uint32_t off, uint32_t len)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->arith == NULL)
+        r->arith = ir_compile_arith(ir_str(prog, off), len);
+    return r->arith;
+}
+
+static void
+program_unref(struct program *p)
+{
+    if (--p->refs > 0)
         return;
-    }
-    
-    argv[0] = cmd_name;
-    int argv_index = 1;
-    
-    
-    for (uint32_t i = 1; i < child_count; i++) {
-        TSNode child = ts_node_named_child(command_node, i);
-        const char *type = ts_node_type(child);
-        
-        
-        char *arg_text = NULL;
-        
-        if (strcmp(type, "word") == 0) {
-            arg_text = ts_extract_node_text(input, child);
-        }
-        else if (strcmp(type, "string") == 0) {
-            uint32_t string_child_count = ts_node_child_count(child);
-            for (uint32_t j = 0; j < string_child_count; j++) {
-                TSNode string_child = ts_node_child(child, j);
-                if (strcmp(ts_node_type(string_child), "string_content") == 0) {
-                    arg_text = ts_extract_node_text(input, string_child);
-                    break;
-                }
-            }
-            if (arg_text == NULL) {
-                arg_text = strdup(""); 
-            }
-        }
-        else if (strcmp(type, "raw_string") == 0) {
-            char *with_quotes = ts_extract_node_text(input, child);
-            size_t len = strlen(with_quotes);
-            if (len >= 2) {
-                arg_text = strndup(with_quotes + 1, len - 2);
-            } else {
-                arg_text = strdup("");
-            }
-            free(with_quotes);
-        }
-        else if (strcmp(type, "number") == 0) {
-            arg_text = ts_extract_node_text(input, child);
-        }
-else if (strcmp(type, "simple_expansion") == 0) {
-    // Handle $? and other special variables
-    // The structure: simple_expansion -> $ -> special_variable_name
-    TSNode var_node = ts_node_child(child, 1);
-    
-    if (!ts_node_is_null(var_node)) {
-        const char *var_type = ts_node_type(var_node);
-        
-        if (strcmp(var_type, "special_variable_name") == 0) {
-            char *var_text = ts_extract_node_text(input, var_node);
-            if (strcmp(var_text, "?") == 0) {
-                arg_text = malloc(12);
-                snprintf(arg_text, 12, "%d", last_exit_status);
-            }
-            free(var_text);
+    if (p->resolved != NULL) {
+        for (uint32_t i = 0; i < p->ir->nstrings; i++) {
+            value_unref(p->resolved[i].literal);
+            if (p->resolved[i].arith != NULL)
+                ir_free(p->resolved[i].arith);
+            pathexp_free(p->resolved[i].glob);
+            pattern_free(p->resolved[i].pattern);
+            regex_free(p->resolved[i].regex);
         }
+        free(p->resolved);
+    }
+    ir_free(p->ir);
+    free(p);
+}
+
+/* Return the string at off, of len bytes, compiled as a pathname
+ * pattern, or NULL if it has no pattern characters. */
+static struct pathexp *
+program_glob(uint32_t off, uint32_t len)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->glob == NULL)
+        r->glob = pathexp_compile(ir_str(prog, off), len);
+    return r->glob;
+}
+
+/* Return the string at off, of len bytes, compiled as a pattern. */
+static struct pattern *
+program_pattern(uint32_t off, uint32_t len)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->pattern == NULL)
+        r->pattern = pattern_compile(ir_str(prog, off), len, 0);
+    return r->pattern;
+}
+
+/* Return the string at off, of len bytes, compiled as a regex. */
+static struct regex *
+program_regex(uint32_t off, uint32_t len)
+{
+    struct resolved *r = &running_resolved()[off];
+    if (r->regex == NULL)
+        r->regex = regex_compile(ir_str(prog, off), len);
+    return r->regex;
+}
+
+/* Return n as a new value. */
+static struct value *
+number_value(int64_t n)
+{
+    char num[24];
+    int len = snprintf(num, sizeof num, "%" PRId64, n);
+    return value_new(num, len);
+}
+
+/* Return the struct var that holds what v is in the innermost scope
+ * that set it, or v itself. */
+static struct var *
+visible_var(struct var *v)
+{
+    for (struct var_scope *s = var_scope; s != NULL; s = s->parent) {
+        struct var *shadow = find_var(&s->vars, v->name);
+        if (shadow != NULL)
+            return shadow;
     }
-    if (arg_text == NULL) {
-        arg_text = ts_extract_node_text(input, child);
+    return v;
+}
+
+/* Return the value of v, or NULL if it is unset, without taking a
+ * reference. */
+static struct value *
+var_value(struct var *v)
+{
+    struct var *shown = var_scope != NULL ? visible_var(v) : v;
+    if (shown->array != NULL)
+        return array_value(shown->array, 0);
+    if (shown->val == NULL && shown->has_num)
+        shown->val = number_value(shown->num);
+    return shown->val;
+}
+
+/* Return the elements of v, or NULL if it is not an array. */
+static struct array *
+var_array(struct var *v)
+{
+    return (var_scope != NULL ? visible_var(v) : v)->array;
+}
+
+/* Return the struct var in the innermost scope for setting v, which
+ * starts out as a copy of what v is outside. */
+static struct var *
+scope_var(struct var *v)
+{
+    struct var *shadow = find_var(&var_scope->vars, v->name);
+    if (shadow != NULL)
+        return shadow;
+    struct var *outside = visible_var(v);
+    struct value *val = var_value(v);
+    shadow = insert_var(&var_scope->vars, v->name);
+    if (outside->array != NULL)
+        shadow->array = array_copy(outside->array);
+    else
+        shadow->val = val != NULL ? value_ref(val) : NULL;
+    return shadow;
+}
+
+/* Return the elements of v for changing them, making v an array
+ * whose element 0 is its value if it is not one. */
+static struct array *
+writable_array(struct var *v)
+{
+    struct var *w = var_scope != NULL ? scope_var(v) : v;
+    if (w->array == NULL) {
+        struct value *val = var_value(w);
+        w->array = array_new();
+        if (val != NULL)
+            array_set(w->array, 0, value_ref(val));
+        value_unref(w->val);
+        w->val = NULL;
+        w->has_num = false;
     }
+    return w->array;
 }
-        if (arg_text != NULL) {
-            argv[argv_index++] = arg_text;
-        }
-    } 
-    
-    argv[argv_index] = NULL;
-    
-    if (strcmp(cmd_name, "true") == 0) {
-        last_exit_status = 0;
-        for (int i = 0; i < argv_index; i++) {
-            free(argv[i]);
+
+/* Make v an array whose elements are those of a, which it takes. */
+static void
+assign_array(struct var *v, struct array *a)
+{
+    struct var *w = v;
+    if (var_scope != NULL && (w = find_var(&var_scope->vars, v->name)) == NULL)
+        w = insert_var(&var_scope->vars, v->name);
+    value_unref(w->val);
+    w->val = NULL;
+    w->has_num = false;
+    array_free(w->array);
+    w->array = a;
+}
+
+/* Set v to val, passing on the caller's reference to val; for an
+ * array, element 0. */
+static void
+assign_var(struct var *v, struct value *val)
+{
+    if (var_scope != NULL) {
+        /* nothing runs in a scope that could see the environment */
+        struct var *shadow = find_var(&var_scope->vars, v->name);
+        if (shadow == NULL && var_array(v) != NULL)
+            shadow = scope_var(v);
+        else if (shadow == NULL)
+            shadow = insert_var(&var_scope->vars, v->name);
+        if (shadow->array != NULL) {
+            array_set(shadow->array, 0, val);
+            return;
         }
-        free(argv);
+        value_unref(shadow->val);
+        shadow->val = val;
         return;
     }
-    if (strcmp(cmd_name, "false") == 0) {
-        last_exit_status = 1;
-        for (int i = 0; i < argv_index; i++) {
-            free(argv[i]);
-        }
-        free(argv);
+    if (v->array != NULL) {
+        array_set(v->array, 0, val);
         return;
     }
-    
-    struct job *job = allocate_job(true);
-    job->status = FOREGROUND;
-    job->num_processes_alive = 1;
-    
-    pid_t pid;
-    posix_spawnattr_t attr;
-    posix_spawnattr_init(&attr);
-    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
-    posix_spawnattr_setpgroup(&attr, 0);
-    
-    int spawn_result;
-    if (cmd_name[0] == '/') {
-        spawn_result = posix_spawn(&pid, cmd_name, NULL, &attr, argv, environ);
-    } else {
-        spawn_result = posix_spawnp(&pid, cmd_name, NULL, &attr, argv, environ);
-    }
-    
-    posix_spawnattr_destroy(&attr);
-    
-    if (spawn_result != 0) {
-        fprintf(stderr, "minibash: %s: command not found\n", cmd_name);
-        last_exit_status = 127;
-        job->status = TERMINATED_VIA_EXIT;
-        job->num_processes_alive = 0;
-        delete_job(job, true);
-    } else {
-        wait_for_job(job);
-        delete_job(job, true);
-    }
-    
-    for (int i = 0; i < argv_index; i++) {
-        free(argv[i]);
+    value_unref(v->val);
+    v->val = val;
+    v->has_num = false;
+    if (v->export != -1)
+        export_set(v->export, value_ref(val));
+}
+
+/* Save the value of v in the undo log and unset it, unless the
+ * function running has already done so. */
+static void
+make_local(struct var *v)
+{
+    if (v->local_depth == function_depth)
+        return;
+    if (nundo == capundo) {
+        capundo = capundo ? 2 * capundo : 64;
+        undo_log = realloc(undo_log, capundo * sizeof *undo_log);
+        if (undo_log == NULL)
+            utils_fatal_error("Could not allocate local variable: ");
     }
-    free(argv);
-} 
+    undo_log[nundo++] = (struct undo) {
+        v, v->val, v->array, v->num, v->has_num, v->integer, v->local_depth
+    };
+    v->val = NULL;
+    v->array = NULL;
+    v->has_num = v->integer = false;
+    v->local_depth = function_depth;
+}
 
+/* Restore the variables saved since the undo log had mark entries. */
 static void
-handle_child_status(pid_t pid, int status)
+undo_locals(size_t mark)
 {
-    assert(signal_is_blocked(SIGCHLD));
+    while (nundo > mark) {
+        struct undo *u = &undo_log[--nundo];
+        value_unref(u->var->val);
+        array_free(u->var->array);
+        u->var->val = u->val;
+        u->var->array = u->array;
+        u->var->num = u->num;
+        u->var->has_num = u->has_num;
+        u->var->integer = u->integer;
+        u->var->local_depth = u->local_depth;
+        if (u->var->export != -1 && u->val != NULL)
+            export_set(u->var->export, value_ref(u->val));
+    }
+}
 
-    /* To be implemented. 
-     * Step 1. Given the pid, determine which job this pid is a part of
-     *         (how to do this is not part of the provided code.)
-     * Step 2. Determine what status change occurred using the
-     *         WIF*() macros.
-     * Step 3. Update the job status accordingly, and adjust 
-     *         num_processes_alive if appropriate.
-     *         If a process was stopped, save the terminal state.
-     */
-    // todo 9/19:
-    // 1. Find which job this pid belongs to
-    // 2. Update that specific job's status
-    // 3. Decrement num_processes_alive
-    
-    assert(signal_is_blocked(SIGCHLD));
-    
-    struct list_elem *e;
-    for (e = list_begin(&job_list); e != list_end(&job_list); e = list_next(e)) {
-        struct job *job = list_entry(e, struct job, elem);
-        
-        if (job->status == FOREGROUND) {
-            if (WIFEXITED(status)) {
-                last_exit_status = WEXITSTATUS(status);
-                job->status = TERMINATED_VIA_EXIT;
-                job->num_processes_alive--;
-            } else if (WIFSIGNALED(status)) {
-                last_exit_status = 128 + WTERMSIG(status);
-                job->status = TERMINATED_VIA_SIGNAL;
-                job->num_processes_alive--;
-            } else if (WIFSTOPPED(status)) {
-                job->status = STOPPED;
-            }
-            break;
-        }
+/* Return the variable of positional parameter n. */
+static struct var *
+param_var(int n)
+{
+    while (n >= nparam_vars) {
+        param_vars = realloc(param_vars, (nparam_vars + 1) * sizeof *param_vars);
+        if (param_vars == NULL)
+            utils_fatal_error("Could not allocate parameters: ");
+        char name[12];
+        int len = snprintf(name, sizeof name, "%d", nparam_vars);
+        param_vars[nparam_vars++] = lookup_var(name, len);
     }
+    return param_vars[n];
 }
 
+/* Define a variable inherited from the environment, which stays
+ * exported. */
+static void
+import_variable(struct value *name, const char *val, int entry)
+{
+    struct var *v = find_var(&shell_vars, name);
+    if (v == NULL)
+        v = insert_var(&shell_vars, name);
+    value_unref(v->val);
+    v->val = value_new(val, strlen(val));
+    v->has_num = false;
+    v->export = entry;
+}
 
-/*
- * Run a program.
- *
- * A program's named children are various types of statements which 
- * you can start implementing here.
- */
-static void 
-run_program(TSNode program)
+static void
+set_variable(const char *name, const char *val)
 {
-    uint32_t n = ts_node_named_child_count(program);
-    for (uint32_t i = 0; i < n; i++) {
-        TSNode child = ts_node_named_child(program, i);
-        const char *type = ts_node_type(child);
-        
-        if (strcmp(type, "command") == 0) {
-            execute_command(child);
-        } else if (strcmp(type, "comment") == 0) {
-            continue;
-        } else {
-            printf("node type `%s` not implemented\n", type);
-        }
-    }
+    assign_var(lookup_var(name, strlen(name)), value_new(val, strlen(val)));
 }
+
 /*
- * Read a script from this (already opened) file descriptor,
- * return a newly allocated buffer.
+ * Run the statement `stmt`, which runs only builtins, in the shell
+ * itself, capturing its output in a memory stream and its variables
+ * in a scope of its own, and append its output to sb.
  */
-static char *
-read_script_from_fd(int readfd)
+static void
+capture_in_process(uint32_t stmt, struct strbuf *sb)
 {
-    struct stat st;
-    if (fstat(readfd, &st) != 0) {
-        utils_error("Could not fstat input");
-        return NULL;
+    char *out = NULL;
+    size_t len = 0;
+    FILE *capture = open_memstream(&out, &len);
+    if (capture == NULL) {
+        utils_error("Could not capture command output: ");
+        last_exit_status = 1;
+        return;
     }
 
-    char *userinput = malloc(st.st_size+1);
-    if (read(readfd, userinput, st.st_size) != st.st_size) {
-        utils_error("Could not read input");
-        free(userinput);
-        return NULL;
-    }
-    userinput[st.st_size] = 0;
-    return userinput;
-}
+    struct var_scope scope = { .parent = var_scope };
+    tommy_hashdyn_init(&scope.vars);
+    var_scope = &scope;
+    FILE *saved_stdout = stdout;
+    stdout = capture;
 
-/* 
- * Execute the script whose content is provided in `script`
- */
-static void 
-execute_script(char *script)
-{
-    input = script;
-    TSTree *tree = ts_parser_parse_string(parser, NULL, input, strlen(input));
-    TSNode  program = ts_tree_root_node(tree);
-    signal_block(SIGCHLD);
-    run_program(program);
-    signal_unblock(SIGCHLD);
-    ts_tree_delete(tree);
+    run_stmt(stmt);
+
+    /* a break in the body ends the body, as it would end a subshell,
+     * but not the loops around the substitution, and neither does a
+     * failed expansion */
+    breaking = continuing = 0;
+    aborting = false;
+    stdout = saved_stdout;
+    var_scope = scope.parent;
+    tommy_hashdyn_foreach(&scope.vars, free_var);
+    tommy_hashdyn_done(&scope.vars);
+
+    fclose(capture);
+    strbuf_append(sb, out, len);
+    free(out);
 }
 
-int
-main(int ac, char *av[])
+/* Run the statement `stmt` in a child process and append its output
+ * to sb. */
+static void
+capture_forked(uint32_t stmt, struct strbuf *sb)
 {
-    int opt;
-    tommy_hashdyn_init(&shell_vars);
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
+        utils_error("Could not create pipe: ");
+        return;
+    }
 
-    /* Process command-line arguments. See getopt(3) */
-    while ((opt = getopt(ac, av, "h")) > 0) {
-        switch (opt) {
-        case 'h':
-            usage(av[0]);
+    fflush(stdout);
+    readbuf_sync_all();
+    pid_t pid = fork();
+    if (pid == -1) {
+        utils_error("Could not fork: ");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return;
+    }
+    if (pid == 0) {
+        forget_jobs();
+        dup2(pipefd[1], STDOUT_FILENO);
+        exits_after = true;
+        run_stmt(stmt);
+        readbuf_sync_all();
+        fflush(stdout);
+        _exit(last_exit_status);
+    }
+
+    struct job *job = allocate_job(true);
+    job->status = FOREGROUND;
+    add_process(job, pid);
+    close(pipefd[1]);
+
+    /* reap children, e.g., those of a pipeline, while reading */
+    char buf[4096];
+    for (;;) {
+        if (!reaper_wait(pipefd[0]))
+            continue;
+        ssize_t n = read(pipefd[0], buf, sizeof buf);
+        if (n == 0)
+            break;
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            utils_error("Could not read command output: ");
             break;
         }
+        strbuf_append(sb, buf, n);
     }
+    close(pipefd[0]);
 
-    parser = ts_parser_new();
-    const TSLanguage *bash = tree_sitter_bash();
-#define DEFINE_FIELD_ID(name) \
-    name##Id = ts_language_field_id_for_name(bash, #name, strlen(#name))
-    DEFINE_FIELD_ID(body);
-    DEFINE_FIELD_ID(condition);
-    DEFINE_FIELD_ID(name);
-    DEFINE_FIELD_ID(right);
-    DEFINE_FIELD_ID(left);
-    DEFINE_FIELD_ID(operator);
-    DEFINE_FIELD_ID(value);
-    DEFINE_FIELD_ID(redirect);
-    DEFINE_FIELD_ID(destination);
-    DEFINE_FIELD_ID(variable);
-    ts_parser_set_language(parser, bash);
+    wait_for_job(job);
+    last_exit_status = job_exit_status(job);
+    delete_job(job, true);
+}
 
-    list_init(&job_list);
-    signal_set_handler(SIGCHLD, sigchld_handler);
+/*
+ * Run the statement `stmt` as a command substitution and append its
+ * output, minus trailing newlines, to sb.  Unless nofork says that
+ * it can run in the shell itself, it runs in a child process.  Sets
+ * last_exit_status to its exit status.
+ */
+static void
+command_substitution(uint32_t stmt, bool nofork, struct strbuf *sb)
+{
+    size_t start = sb->len;
+    if (nofork)
+        capture_in_process(stmt, sb);
+    else
+        capture_forked(stmt, sb);
 
+    while (sb->len > start && sb->buf[sb->len - 1] == '\n')
+        sb->buf[--sb->len] = '\0';
+    ran_cmdsubst = true;
+}
 
-    /* Read/eval loop. */
-    bool shouldexit = false;
-    for (;;) {
-        if (shouldexit)
-            break;
+static bool arith_eval(const struct ir_program *p, uint32_t first, uint32_t count,
+                       const char *who, int64_t *result);
 
-        /* If you fail this assertion, you were about to enter readline()
-         * while SIGCHLD is blocked.  This means that your shell would be
-         * unable to receive SIGCHLD signals, and thus would be unable to
-         * wait for background jobs that may finish while the
-         * shell is sitting at the prompt waiting for user input.
-         */
-        assert(!signal_is_blocked(SIGCHLD));
+/* An expansion failed, after reporting why. */
+static void
+expansion_failed(void)
+{
+    aborting = true;
+    last_exit_status = 1;
+}
+
+static struct pattern *expand_pattern(const struct ir_word *w, bool *temporary);
+
+/*
+ * Array elements.  A subscript below 0 counts back from the end of
+ * the array.  A variable that is not an array is one of a single
+ * element, its value, if it is set.
+ */
+
+/* Store in *i the element of v that subscript n stands for.  One
+ * that is out of range is reported, and is an element that is not
+ * set, unless store, in which case false is returned. */
+static bool
+element_index(struct var *v, int64_t n, bool store, size_t *i)
+{
+    int64_t at = n;
+    if (at < 0) {
+        struct array *a = var_array(v);
+        at += a != NULL ? (int64_t) a->n : var_value(v) != NULL;
+    }
+    if (at < 0 || (store && (uint64_t) at >= ARRAY_MAX)) {
+        fprintf(stderr, "minibash: %s[%" PRId64 "]: bad array subscript\n", v->name->str, n);
+        *i = SIZE_MAX;
+        return !store;
+    }
+    *i = at;
+    return true;
+}
+
+/* Evaluate subscript word `word` of v into *i, as element_index. */
+static bool
+eval_subscript(struct var *v, uint32_t word, bool store, size_t *i)
+{
+    const struct ir_part *part = &prog->parts[prog->words[word].first];
+    int64_t n;
+    return arith_eval(prog, part->op, part->len, NULL, &n) && element_index(v, n, store, i);
+}
+
+/* Point *s at the bytes of element i of v and return their number,
+ * or -1 if it is not set. */
+static ssize_t
+element_text(struct var *v, size_t i, const char **s)
+{
+    struct array *a = var_array(v);
+    if (a != NULL) {
+        const struct array_elem *e = array_get(a, i);
+        if (e == NULL)
+            return -1;
+        *s = e->str;
+        return e->len;
+    }
+    struct value *val = i == 0 ? var_value(v) : NULL;
+    if (val == NULL)
+        return -1;
+    *s = val->str;
+    return val->len;
+}
+
+/* Return element i of v, or NULL if it is not set, without taking a
+ * reference. */
+static struct value *
+element_value(struct var *v, size_t i)
+{
+    struct array *a = var_array(v);
+    if (a != NULL)
+        return array_value(a, i);
+    return i == 0 ? var_value(v) : NULL;
+}
+
+/* Set element i of v, which becomes an array, to val, passing on the
+ * caller's reference to val. */
+static void
+assign_element(struct var *v, size_t i, struct value *val)
+{
+    array_set(writable_array(v), i, val);
+}
+
+/* The elements of ${name[@]}, or their subscripts for ${!name[@]},
+ * or the positional parameters for $@. */
+struct elements {
+    struct array *array;    /* NULL if the variable is not an array */
+    struct value *scalar;   /* else its value, the only element if set */
+    size_t next;            /* the subscript to look at next */
+    bool subscripts;
+    bool params;
+    char num[24];
+};
+
+static void
+elements_start(struct elements *it, const struct ir_part *part)
+{
+    struct var *v = program_var(part->str);
+    *it = (struct elements) {
+        .subscripts = part->kind == IR_PART_SUBSCRIPTS,
+        .params = v->name->len == 1 && v->name->str[0] == '@'
+    };
+    if (it->params)
+        return;
+    it->array = var_array(v);
+    if (it->array == NULL)
+        it->scalar = var_value(v);
+}
+
+/* Point *s at the next element, or subscript, and return its length,
+ * or -1 past the last one. */
+static ssize_t
+elements_next(struct elements *it, const char **s)
+{
+    size_t i = it->next;
+    if (it->params) {
+        if (i >= (size_t) nparams)
+            return -1;
+        it->next = i + 1;
+        struct value *val = var_value(param_var(i + 1));
+        *s = val != NULL ? val->str : "";
+        return val != NULL ? val->len : 0;
+    }
+    if (it->array != NULL) {
+        while (i < it->array->n && it->array->elems[i].str == NULL)
+            i++;
+        if (i == it->array->n)
+            return -1;
+    } else if (i > 0 || it->scalar == NULL) {
+        return -1;
+    }
+    it->next = i + 1;
+    if (it->subscripts) {
+        *s = it->num;
+        return snprintf(it->num, sizeof it->num, "%zu", i);
+    }
+    if (it->array != NULL) {
+        *s = it->array->elems[i].str;
+        return it->array->elems[i].len;
+    }
+    *s = it->scalar->str;
+    return it->scalar->len;
+}
+
+static bool ifs_joiner(char *c);
+
+/* ${name[@]} where it makes a single string: the elements joined by
+ * spaces, or for ${name[*]}, by the first character of IFS. */
+static void
+expand_joined(const struct ir_part *part, struct strbuf *sb)
+{
+    char sep = ' ';
+    bool separated = !(part->flags & IR_PART_JOIN) || ifs_joiner(&sep);
+    struct elements it;
+    elements_start(&it, part);
+    const char *s;
+    ssize_t len;
+    for (int k = 0; (len = elements_next(&it, &s)) >= 0; k++) {
+        if (k > 0 && separated)
+            strbuf_append(sb, &sep, 1);
+        strbuf_append(sb, s, len);
+    }
+}
+
+/* ${#name}, ${#name[subscript]}, and ${#name[@]}. */
+static void
+expand_length(const struct ir_part *part, struct strbuf *sb)
+{
+    struct var *v = program_var(part->str);
+    size_t n = 0, i = 0;
+    if (part->kind == IR_PART_COUNT) {
+        struct array *a = var_array(v);
+        n = a != NULL ? a->nset : var_value(v) != NULL;
+    } else if (part->len == IR_NONE || eval_subscript(v, part->len, false, &i)) {
+        const char *s;
+        ssize_t len = element_text(v, i, &s);
+        n = len > 0 ? len : 0;
+    } else {
+        expansion_failed();
+        return;
+    }
+    char num[24];
+    int len = snprintf(num, sizeof num, "%zu", n);
+    strbuf_append(sb, num, len);
+}
+
+/* ${name#pattern} and the like. */
+static void
+expand_trim(const struct ir_part *part, struct strbuf *sb)
+{
+    bool temporary;
+    struct pattern *pat = expand_pattern(&prog->words[part->len], &temporary);
+    struct value *val = var_value(program_var(part->str));
+    if (aborting || val == NULL) {
+        if (temporary)
+            pattern_free(pat);
+        return;
+    }
+
+    bool longest = part->flags & IR_PART_LONGEST;
+    size_t n;
+    if (part->kind == IR_PART_TRIM_PREFIX) {
+        if (!pattern_prefix(pat, val->str, val->len, longest, &n))
+            n = 0;
+        strbuf_append(sb, val->str + n, val->len - n);
+    } else {
+        if (!pattern_suffix(pat, val->str, val->len, longest, &n))
+            n = 0;
+        strbuf_append(sb, val->str, val->len - n);
+    }
+    if (temporary)
+        pattern_free(pat);
+}
+
+static void
+expand_part(const struct ir_part *part, struct strbuf *sb)
+{
+    switch (part->kind) {
+    case IR_PART_LITERAL:
+        strbuf_append(sb, ir_str(prog, part->str), part->len);
+        break;
+    case IR_PART_STATUS: {
+        char num[12];
+        int len = snprintf(num, sizeof num, "%d", last_exit_status);
+        strbuf_append(sb, num, len);
+        break;
+    }
+    case IR_PART_VAR: {
+        struct value *val = var_value(program_var(part->str));
+        if (val != NULL)
+            strbuf_append(sb, val->str, val->len);
+        break;
+    }
+    case IR_PART_CMDSUBST:
+        command_substitution(part->stmt, part->flags & IR_PART_NOFORK, sb);
+        break;
+    case IR_PART_ARITH: {
+        int64_t n;
+        if (!arith_eval(prog, part->op, part->len, NULL, &n)) {
+            expansion_failed();
+            break;
+        }
+        char num[24];
+        int len = snprintf(num, sizeof num, "%" PRId64, n);
+        strbuf_append(sb, num, len);
+        break;
+    }
+    case IR_PART_TRIM_PREFIX:
+    case IR_PART_TRIM_SUFFIX:
+        expand_trim(part, sb);
+        break;
+    case IR_PART_ELEMENT: {
+        struct var *v = program_var(part->str);
+        size_t i;
+        const char *s;
+        if (!eval_subscript(v, part->len, false, &i)) {
+            expansion_failed();
+            break;
+        }
+        ssize_t len = element_text(v, i, &s);
+        if (len > 0)
+            strbuf_append(sb, s, len);
+        break;
+    }
+    case IR_PART_ELEMENTS:
+    case IR_PART_SUBSCRIPTS:
+        expand_joined(part, sb);
+        break;
+    case IR_PART_LENGTH:
+    case IR_PART_COUNT:
+        expand_length(part, sb);
+        break;
+    }
+}
+
+/* If w is a lone $name, store the variable's value, NULL if unset,
+ * in *val and return true. */
+static bool
+lone_variable(const struct ir_word *w, struct value **val)
+{
+    if (w->count != 1 || prog->parts[w->first].kind != IR_PART_VAR)
+        return false;
+    *val = var_value(program_var(prog->parts[w->first].str));
+    return true;
+}
+
+/*
+ * Expand a word.  Literal words are returned straight from the
+ * program's string pool, and a lone $name is the variable's value,
+ * pinned; others are built in the scratch arena.  Returns NULL if an
+ * unquoted word expanded to nothing, in which case it does not
+ * produce an argument.
+ */
+static char *
+expand_word(const struct ir_word *w)
+{
+    if (w->flags & IR_WORD_STATIC)
+        return ir_str(prog, prog->parts[w->first].str);
+
+    struct value *val;
+    if (lone_variable(w, &val)) {
+        if (val == NULL || val->len == 0)
+            return w->flags & IR_WORD_QUOTED ? "" : NULL;
+        return pin(value_ref(val));
+    }
+
+    struct strbuf sb = { 0 };
+    for (uint32_t i = 0; i < w->count && !aborting; i++)
+        expand_part(&prog->parts[w->first + i], &sb);
+
+    if (sb.len == 0 && !(w->flags & IR_WORD_QUOTED))
+        return NULL;
+    return strbuf_finish(&sb);
+}
+
+/* Expand a word into a value with a reference of its own, or NULL
+ * as expand_word; literals and lone variables are not copied. */
+static struct value *
+expand_value(const struct ir_word *w)
+{
+    const struct ir_part *part = &prog->parts[w->first];
+    if (w->flags & IR_WORD_STATIC)
+        return program_literal(part->str, part->len);
+
+    struct value *val;
+    if (!lone_variable(w, &val)) {
+        char *s = expand_word(w);
+        return s != NULL ? value_new(s, strlen(s)) : NULL;
+    }
+    if (val == NULL || val->len == 0)
+        return w->flags & IR_WORD_QUOTED ? value_intern("", 0) : NULL;
+    return value_ref(val);
+}
+
+/*
+ * Patterns and regexes.  A static pattern or regex word is compiled
+ * once, at its first use, and kept with the program.  Other patterns
+ * are compiled whenever they are expanded, and other regexes are
+ * looked up in the cache of recent ones.
+ */
+
+/* Expand pattern or regex word w into sb, escaping the characters of
+ * escape in the results of quoted expansions. */
+static void
+expand_escaped(const struct ir_word *w, const char *escape, struct strbuf *sb)
+{
+    for (uint32_t i = 0; i < w->count && !aborting; i++) {
+        const struct ir_part *part = &prog->parts[w->first + i];
+        if (part->kind == IR_PART_LITERAL || !(part->flags & IR_PART_QUOTED)) {
+            expand_part(part, sb);
+            continue;
+        }
+        /* the result of a quoted expansion matches itself */
+        struct strbuf text = { 0 };
+        expand_part(part, &text);
+        for (size_t k = 0; k < text.len; k++) {
+            if (strchr(escape, text.buf[k]) != NULL)
+                strbuf_append(sb, "\\", 1);
+            strbuf_append(sb, text.buf + k, 1);
+        }
+    }
+}
+
+/* Expand pattern word w and return it compiled; *temporary is set if
+ * the caller must free it. */
+static struct pattern *
+expand_pattern(const struct ir_word *w, bool *temporary)
+{
+    const struct ir_part *part = &prog->parts[w->first];
+    *temporary = !(w->flags & IR_WORD_STATIC);
+    if (!*temporary)
+        return program_pattern(part->str, part->len);
+
+    struct strbuf sb = { 0 };
+    expand_escaped(w, IR_PATTERN_SPECIALS, &sb);
+    return pattern_compile(sb.len > 0 ? sb.buf : "", sb.len, 0);
+}
+
+static struct var *rematch_var;         // BASH_REMATCH
+
+/*
+ * [[ subject =~ regex ]]: returns 0 if regex word w matches subject,
+ * and 1 if not, or 2 if w is not a valid regex.  BASH_REMATCH is set
+ * to an array of what the regex and its groups matched, or of no
+ * elements if it did not match.
+ */
+static int
+regex_matches(const struct ir_word *w, struct value *subject)
+{
+    const struct ir_part *part = &prog->parts[w->first];
+    const struct regex *re;
+    if (w->flags & IR_WORD_STATIC) {
+        re = program_regex(part->str, part->len);
+    } else {
+        struct strbuf sb = { 0 };
+        expand_escaped(w, IR_REGEX_SPECIALS, &sb);
+        if (aborting)
+            return 1;
+        re = regex_cached(sb.len > 0 ? sb.buf : "", sb.len);
+    }
+    if (!re->valid)
+        return 2;
+
+    if (rematch_var == NULL)
+        rematch_var = lookup_var("BASH_REMATCH", 12);
+    regmatch_t *m = arena_alloc(&scratch, (re->nsub + 1) * sizeof *m);
+    struct array *groups = array_new();
+    if (regexec(&re->re, subject->str, re->nsub + 1, m, 0) != 0) {
+        assign_array(rematch_var, groups);
+        return 1;
+    }
+    array_reserve(groups, re->nsub + 1);
+    for (size_t i = 0; i <= re->nsub; i++) {
+        /* a group that did not take part matched nothing */
+        size_t start = m[i].rm_so != -1 ? m[i].rm_so : 0;
+        size_t end = m[i].rm_so != -1 ? m[i].rm_eo : 0;
+        /* a match of all of the subject shares its value */
+        array_set(groups, i, start == 0 && end == subject->len ? value_ref(subject)
+                             : value_new(subject->str + start, end - start));
+    }
+    assign_array(rematch_var, groups);
+    return 0;
+}
+
+/* Does pattern word w match the len bytes at s? */
+static bool
+pattern_matches(const struct ir_word *w, const char *s, size_t len)
+{
+    bool temporary;
+    struct pattern *pat = expand_pattern(w, &temporary);
+    bool matched = !aborting && pattern_match(pat, s, len);
+    if (temporary)
+        pattern_free(pat);
+    return matched;
+}
+
+/*
+ * Word splitting.  The results of unquoted expansions are split into
+ * fields on the characters of IFS: runs of IFS whitespace separate
+ * fields and are otherwise dropped, and every other IFS character
+ * ends a field, even an empty one.  A word is expanded into a single
+ * buffer, and each result is split right where it was expanded, by
+ * ending its fields with zero bytes, so the fields of a long $(...)
+ * are copied once and not allocated one by one.
+ */
+static struct var *ifs_var;             // IFS
+static struct value *ifs_value;         // the value ifs was built for, NULL if unset
+static bool ifs_built;
+static struct ifs ifs;
+
+/* Return the table for the current value of IFS, rebuilding it only
+ * if the value changed. */
+static const struct ifs *
+current_ifs(void)
+{
+    if (ifs_var == NULL)
+        ifs_var = lookup_var("IFS", 3);
+    struct value *val = var_value(ifs_var);
+    if (!ifs_built || val != ifs_value) {
+        if (val != NULL)
+            ifs_init(&ifs, val->str, val->len);
+        else
+            ifs_init(&ifs, IFS_DEFAULT, strlen(IFS_DEFAULT));
+        /* the reference keeps another value from reusing the address */
+        value_unref(ifs_value);
+        ifs_value = val != NULL ? value_ref(val) : NULL;
+        ifs_built = true;
+    }
+    return &ifs;
+}
+
+/* Store the first character of IFS, which joins the elements of
+ * "${name[*]}", in *c; returns false if IFS is empty. */
+static bool
+ifs_joiner(char *c)
+{
+    if (ifs_var == NULL)
+        ifs_var = lookup_var("IFS", 3);
+    struct value *val = var_value(ifs_var);
+    if (val == NULL)
+        *c = IFS_DEFAULT[0];
+    else if (val->len > 0)
+        *c = val->str[0];
+    return val == NULL || val->len > 0;
+}
+
+/* A word being split into fields. */
+struct splitter {
+    const struct ifs *ifs;
+    struct strbuf sb;       /* the fields, each ended by a zero byte */
+    int nfields;            /* ended so far */
+    bool field;             /* the current field exists, even if empty */
+    bool spaced;            /* the last field ended at IFS whitespace, which
+                               absorbs an IFS delimiter that follows */
+    size_t *quoted;         /* the bounds of the quoted text in sb that has
+                               pattern characters, which match themselves */
+    int nquoted, capquoted;
+};
+
+/*
+ * Pathname expansion.  A field with unquoted pattern characters is
+ * replaced by the names of the files it matches, if any.  Pattern
+ * characters that were quoted are escaped with a backslash before the
+ * field is compiled as a pattern.
+ */
+
+/* Record that sb[from .. sp->sb.len) was quoted, if it matters. */
+static void
+splitter_quoted(struct splitter *sp, size_t from)
+{
+    size_t len = sp->sb.len - from;
+    if (strcspn(sp->sb.buf + from, "*?[]\\") >= len)
+        return;
+    if (sp->nquoted + 2 > sp->capquoted) {
+        int cap = sp->capquoted ? 2 * sp->capquoted : 8;
+        sp->quoted = arena_grow(&scratch, sp->quoted, sp->capquoted * sizeof *sp->quoted,
+                                cap * sizeof *sp->quoted);
+        sp->capquoted = cap;
+    }
+    sp->quoted[sp->nquoted++] = from;
+    sp->quoted[sp->nquoted++] = sp->sb.len;
+}
+
+/* Expand pattern pe into av; returns false if nothing matched. */
+static bool
+glob_into(const struct pathexp *pe, struct argvec *av)
+{
+    char **names;
+    size_t n = pathexp_expand(pe, &scratch, &names);
+    for (size_t i = 0; i < n; i++)
+        argvec_push(av, names[i]);
+    return n > 0;
+}
+
+/* Expand the field of sp at off into av, unless it is no pattern or
+ * matches nothing; returns whether it did.  *q is the first quoted
+ * bound at or after off. */
+static bool
+glob_field(struct splitter *sp, size_t off, size_t len, int *q, struct argvec *av)
+{
+    const char *field = sp->sb.buf + off;
+    while (*q < sp->nquoted && sp->quoted[*q + 1] <= off)
+        *q += 2;
+    if (strpbrk(field, "*?[") == NULL)
+        return false;
+
+    /* escape the quoted pattern characters */
+    char *pat = arena_alloc(&scratch, 2 * len + 1), *p = pat;
+    int k = *q;
+    for (size_t i = 0; i < len; i++) {
+        size_t at = off + i;
+        while (k < sp->nquoted && sp->quoted[k + 1] <= at)
+            k += 2;
+        if (k < sp->nquoted && sp->quoted[k] <= at && strchr("*?[]\\", field[i]) != NULL)
+            *p++ = '\\';
+        *p++ = field[i];
+    }
+    struct pathexp *pe = pathexp_compile(pat, p - pat);
+    if (pe == NULL)
+        return false;
+    bool matched = glob_into(pe, av);
+    pathexp_free(pe);
+    return matched;
+}
+
+/* Split the text appended to sp->sb at from, in place. */
+static void
+split_fields(struct splitter *sp, size_t from)
+{
+    char *s = sp->sb.buf;
+    size_t r = from, w = from, end = sp->sb.len;
+    while (r < end) {
+        size_t n = ifs_span(sp->ifs, s + r, end - r);
+        if (n > 0) {
+            if (w != r)
+                memmove(s + w, s + r, n);
+            w += n;
+            r += n;
+            sp->field = true;
+            sp->spaced = false;
+            continue;
+        }
+
+        /* IFS whitespace around at most one other IFS character */
+        bool delim = false;
+        while (r < end && ifs_space(sp->ifs, s[r]))
+            r++;
+        if (r < end && ifs_delim(sp->ifs, s[r])) {
+            delim = true;
+            r++;
+            while (r < end && ifs_space(sp->ifs, s[r]))
+                r++;
+        }
+        if (sp->field || (delim && !sp->spaced)) {
+            s[w++] = '\0';
+            sp->nfields++;
+            sp->field = false;
+            sp->spaced = !delim;
+        } else if (delim) {
+            sp->spaced = false;
+        }
+    }
+    sp->sb.len = w;
+}
+
+/* Append the elements of ${name[@]} or ${!name[@]} to sp.  Each one
+ * ends the field before it: quoted, an element is a field, except
+ * that the first and last join the text around them, and unquoted,
+ * it is split in turn. */
+static void
+split_elements(struct splitter *sp, const struct ir_part *part)
+{
+    bool quoted = part->flags & IR_PART_QUOTED;
+    struct elements it;
+    elements_start(&it, part);
+    const char *s;
+    ssize_t len;
+    for (int k = 0; (len = elements_next(&it, &s)) >= 0; k++) {
+        if (k > 0 && sp->field) {
+            strbuf_append(&sp->sb, "", 1);
+            sp->nfields++;
+            sp->field = false;
+        }
+        sp->spaced = false;
+        size_t from = sp->sb.len;
+        strbuf_append(&sp->sb, s, len);
+        if (quoted) {
+            sp->field = true;
+            splitter_quoted(sp, from);
+        } else {
+            split_fields(sp, from);
+        }
+    }
+}
+
+/* Expand w, which has unquoted expansions, pattern characters, or
+ * "${name[@]}", appending its fields, or the pathnames they match,
+ * to av. */
+static void
+split_word(const struct ir_word *w, struct argvec *av)
+{
+    if (w->flags & IR_WORD_STATIC) {
+        const struct ir_part *part = &prog->parts[w->first];
+        struct pathexp *pe = program_glob(part->str, part->len);
+        if (pe == NULL || !glob_into(pe, av))
+            argvec_push(av, ir_str(prog, part->str));
+        return;
+    }
+
+    const struct ifs *ifs = current_ifs();
+    struct value *val;
+    if (lone_variable(w, &val)) {
+        if (val == NULL || val->len == 0)
+            return;
+        /* a value that needs no splitting or expanding is not copied */
+        if (ifs_span(ifs, val->str, val->len) == val->len && strpbrk(val->str, "*?[") == NULL) {
+            argvec_push(av, pin(value_ref(val)));
+            return;
+        }
+    }
+
+    struct splitter sp = { .ifs = ifs };
+    uint32_t i = 0;
+    /* "${name[@]}" makes no field at all if there are no elements,
+     * unlike the "" it starts with */
+    const struct ir_part *parts = &prog->parts[w->first];
+    if (w->count == 2 && parts[0].kind == IR_PART_LITERAL && parts[0].len == 0
+        && (parts[1].kind == IR_PART_ELEMENTS || parts[1].kind == IR_PART_SUBSCRIPTS)
+        && !(parts[1].flags & IR_PART_JOIN))
+        i = 1;
+    for (; i < w->count && !aborting; i++) {
+        const struct ir_part *part = &prog->parts[w->first + i];
+        if ((part->kind == IR_PART_ELEMENTS || part->kind == IR_PART_SUBSCRIPTS)
+            && (part->flags & (IR_PART_QUOTED | IR_PART_JOIN)) != (IR_PART_QUOTED | IR_PART_JOIN)) {
+            split_elements(&sp, part);
+            continue;
+        }
+        size_t from = sp.sb.len;
+        expand_part(part, &sp.sb);
+        if (part->kind != IR_PART_LITERAL && !(part->flags & IR_PART_QUOTED)) {
+            split_fields(&sp, from);
+        } else if (sp.sb.len > from) {
+            sp.field = true;
+            sp.spaced = false;
+            if (part->flags & IR_PART_QUOTED)
+                splitter_quoted(&sp, from);
+        } else if (part->flags & IR_PART_QUOTED) {
+            sp.field = true;
+        }
+    }
+    if (aborting)
+        return;
+    if (sp.field) {
+        strbuf_append(&sp.sb, "", 1);
+        sp.nfields++;
+    }
+
+    size_t off = 0;
+    int q = 0;
+    for (int i = 0; i < sp.nfields; i++) {
+        size_t len = strlen(sp.sb.buf + off);
+        if (!glob_field(&sp, off, len, &q, av))
+            argvec_push(av, sp.sb.buf + off);
+        off += len + 1;
+    }
+}
+
+/* Expand count words starting at first, appending their fields to av. */
+static void
+expand_words(uint32_t first, uint32_t count, struct argvec *av)
+{
+    pathexp_next_command();
+    for (uint32_t i = 0; i < count && !aborting; i++) {
+        const struct ir_word *w = &prog->words[first + i];
+        if (w->flags & (IR_WORD_SPLIT | IR_WORD_GLOB)) {
+            split_word(w, av);
+            continue;
+        }
+        char *arg = expand_word(w);
+        if (arg != NULL)
+            argvec_push(av, arg);
+    }
+}
+
+/*
+ * Arithmetic.  An expression is evaluated by running its code, see
+ * struct ir_op, on a stack.  Variables that arithmetic assigns hold
+ * numbers; a variable whose value is a string is converted when
+ * arithmetic reads it, and the number is kept until the string
+ * changes.  A string that is not a number is evaluated as an
+ * expression in turn.
+ */
+#define ARITH_MAX_DEPTH 1024
+static int arith_depth;                 // expressions being evaluated
+
+/* Return the variable named by the string at off in p. */
+static struct var *
+arith_var(const struct ir_program *p, uint32_t off)
+{
+    if (p == prog)
+        return program_var(off);
+    return lookup_var(ir_str(p, off), strlen(ir_str(p, off)));
+}
+
+/* Report why expression text failed, for builtin who unless NULL. */
+static void
+arith_report(const char *who, const char *text, const char *why)
+{
+    if (who != NULL)
+        fprintf(stderr, "minibash: %s: %s: %s\n", who, text, why);
+    else
+        fprintf(stderr, "minibash: %s: %s\n", text, why);
+}
+
+/* Evaluate the len bytes at text as an expression. */
+static bool
+arith_eval_text(const char *text, size_t len, const char *who, int64_t *result)
+{
+    struct ir_program *p = ir_compile_arith(text, len);
+    bool ok = arith_eval(p, 0, p->nops, who, result);
+    ir_free(p);
+    return ok;
+}
+
+/* Evaluate the text that the fallback word of an expression of the
+ * running program expands to. */
+static bool
+arith_eval_word(uint32_t word, const char *who, int64_t *result)
+{
+    char *text = expand_word(&prog->words[word]);
+    if (aborting)
+        return false;
+    if (text == NULL)
+        text = "";
+    return arith_eval_text(text, strlen(text), who, result);
+}
+
+/* Store val, NULL if unset, as a number in *n. */
+static bool
+arith_value(struct value *val, const char *who, int64_t *n)
+{
+    if (val == NULL || val->len == 0) {
+        *n = 0;
+        return true;
+    }
+    if (ir_arith_number(val->str, val->len, n))
+        return true;
+    /* the expression may assign the variable val is the value of */
+    value_ref(val);
+    bool ok = arith_eval_text(val->str, val->len, who, n);
+    value_unref(val);
+    return ok;
+}
+
+/* Store the value of v, as a number, in *n. */
+static bool
+arith_load(struct var *v, const char *who, int64_t *n)
+{
+    if (v->has_num && var_scope == NULL) {
+        *n = v->num;
+        return true;
+    }
+    struct value *val = var_value(v);
+    if (val != NULL && val == v->val && ir_arith_number(val->str, val->len, n)) {
+        /* rather than a scope's, or an element */
+        v->num = *n;
+        v->has_num = true;
+        return true;
+    }
+    return arith_value(val, who, n);
+}
+
+/* Set v to n; it becomes a string only once one is needed, unless it
+ * is exported, set in a scope, or an array. */
+static void
+arith_store(struct var *v, int64_t n)
+{
+    if (var_scope != NULL || v->export != -1 || v->array != NULL) {
+        assign_var(v, number_value(n));
+        if (var_scope != NULL || v->array != NULL)
+            return;
+    } else {
+        value_unref(v->val);
+        v->val = NULL;
+    }
+    v->num = n;
+    v->has_num = true;
+}
+
+/* Is the value of $name, which replaces it in the text of an
+ * expression, a number?  A sign would combine with what precedes. */
+static bool
+subst_number(struct var *v, int64_t *n)
+{
+    struct value *val = var_value(v);
+    if (val == NULL)
+        return false;
+    const char *s = val->str;
+    while (isblank((unsigned char) *s))
+        s++;
+    return isdigit((unsigned char) *s) && ir_arith_number(val->str, val->len, n);
+}
+
+/*
+ * Evaluate the expression ops[first .. first+count) of p into
+ * *result.  Returns false, after reporting why, with the name of
+ * builtin who unless it is NULL, if the evaluation failed.
+ */
+static bool
+arith_eval(const struct ir_program *p, uint32_t first, uint32_t count, const char *who,
+           int64_t *result)
+{
+    const struct ir_op *ops = &p->ops[first];
+    const char *text = ir_str(p, ops[0].arg);
+    if (arith_depth == ARITH_MAX_DEPTH) {
+        arith_report(who, text, "expression recursion level exceeded");
+        return false;
+    }
+
+    int64_t stack[IR_ARITH_STACK], slots[IR_ARITH_SLOTS];
+    int sp = 0;
+    bool ok = false;
+    arith_depth++;
+    for (uint32_t pc = 1; pc < count; pc++) {
+        const struct ir_op *op = &ops[pc];
+        switch (op->op) {
+        case IR_OP_CONST:
+            stack[sp++] = op->value;
+            break;
+        case IR_OP_LOAD:
+            if (!arith_load(arith_var(p, op->arg), who, &stack[sp++]))
+                goto out;
+            break;
+        case IR_OP_STORE:
+            arith_store(arith_var(p, op->arg), stack[sp - 1]);
+            break;
+        case IR_OP_PREADD:
+        case IR_OP_POSTADD: {
+            struct var *v = arith_var(p, op->arg);
+            int64_t n;
+            if (!arith_load(v, who, &n))
+                goto out;
+            int64_t sum = (int64_t) ((uint64_t) n + (uint64_t) op->value);
+            arith_store(v, sum);
+            stack[sp++] = op->op == IR_OP_PREADD ? sum : n;
+            break;
+        }
+        case IR_OP_LOAD_ELEMENT:
+        case IR_OP_FETCH_ELEMENT: {
+            struct var *v = arith_var(p, op->arg);
+            size_t i;
+            int64_t n;
+            if (!element_index(v, stack[sp - 1], false, &i)
+                || !arith_value(element_value(v, i), who, &n))
+                goto out;
+            if (op->op == IR_OP_LOAD_ELEMENT)
+                stack[sp - 1] = n;
+            else
+                stack[sp++] = n;
+            break;
+        }
+        case IR_OP_STORE_ELEMENT: {
+            struct var *v = arith_var(p, op->arg);
+            size_t i;
+            sp--;
+            if (!element_index(v, stack[sp - 1], true, &i))
+                goto out;
+            assign_element(v, i, number_value(stack[sp]));
+            stack[sp - 1] = stack[sp];
+            break;
+        }
+        case IR_OP_PREADD_ELEMENT:
+        case IR_OP_POSTADD_ELEMENT: {
+            struct var *v = arith_var(p, op->arg);
+            size_t i;
+            int64_t n;
+            if (!element_index(v, stack[sp - 1], true, &i)
+                || !arith_value(element_value(v, i), who, &n))
+                goto out;
+            int64_t sum = (int64_t) ((uint64_t) n + (uint64_t) op->value);
+            assign_element(v, i, number_value(sum));
+            stack[sp - 1] = op->op == IR_OP_PREADD_ELEMENT ? sum : n;
+            break;
+        }
+        case IR_OP_SUBST:
+            if (!subst_number(arith_var(p, op->arg), &slots[op->value])) {
+                ok = arith_eval_word(ops[0].value, who, result);
+                goto out;
+            }
+            break;
+        case IR_OP_SLOT:
+            stack[sp++] = slots[op->value];
+            break;
+        case IR_OP_EVAL:
+            ok = arith_eval_word(ops[0].value, who, result);
+            goto out;
+        case IR_OP_ERROR:
+            arith_report(who, text, ir_str(p, op->arg));
+            goto out;
+        case IR_OP_POP:
+            sp--;
+            break;
+        case IR_OP_JUMP:
+            pc = op->arg - 1;
+            break;
+        case IR_OP_JUMP_FALSE:
+            if (stack[--sp] == 0)
+                pc = op->arg - 1;
+            break;
+        case IR_OP_AND_JUMP:
+            if (stack[sp - 1] == 0)
+                pc = op->arg - 1;
+            else
+                sp--;
+            break;
+        case IR_OP_OR_JUMP:
+            if (stack[sp - 1] != 0) {
+                stack[sp - 1] = 1;
+                pc = op->arg - 1;
+            } else {
+                sp--;
+            }
+            break;
+        case IR_OP_BOOL:
+            stack[sp - 1] = stack[sp - 1] != 0;
+            break;
+        case IR_OP_NEG:
+            stack[sp - 1] = (int64_t) (0 - (uint64_t) stack[sp - 1]);
+            break;
+        case IR_OP_NOT:
+            stack[sp - 1] = !stack[sp - 1];
+            break;
+        case IR_OP_BITNOT:
+            stack[sp - 1] = ~stack[sp - 1];
+            break;
+        default: {
+            sp--;
+            const char *why = ir_arith_binary(op->op, stack[sp - 1], stack[sp],
+                                              &stack[sp - 1]);
+            if (why != NULL) {
+                arith_report(who, text, why);
+                goto out;
+            }
+        }
+        }
+    }
+    *result = sp > 0 ? stack[sp - 1] : 0;
+    ok = true;
+out:
+    arith_depth--;
+    return ok;
+}
+
+/* (( expression )) and the arguments of let succeed unless 0.
+ * Returns false if the evaluation failed. */
+static bool
+run_arith(const struct ir_stmt *stmt)
+{
+    int64_t n;
+    const char *who = stmt->flags & IR_ARITH_LET ? "let" : "((";
+    if (!arith_eval(prog, stmt->first, stmt->count, who, &n)) {
+        last_exit_status = 1;
+        return false;
+    }
+    last_exit_status = n == 0;
+    return true;
+}
+
+/* let arg ..., when the command name is the result of an expansion */
+static int
+builtin_let(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "minibash: let: expression expected\n");
+        return 1;
+    }
+    int64_t n = 0;
+    for (int i = 1; i < argc; i++)
+        if (!arith_eval_text(argv[i], strlen(argv[i]), "let", &n))
+            return 1;
+    return n == 0;
+}
+
+/*
+ * Set v to the value of word w as an expression, or add it to v if
+ * append, as is done for variables declared -i.  A lone $((...)) is
+ * evaluated the same way, without turning the number into a string
+ * and back.  Returns false, after reporting why, if the evaluation
+ * failed.
+ */
+static bool
+assign_arith(struct var *v, const struct ir_word *w, bool append)
+{
+    const struct ir_part *part = &prog->parts[w->first];
+    int64_t n;
+    bool ok;
+    if (w->count == 1 && part->kind == IR_PART_ARITH) {
+        ok = arith_eval(prog, part->op, part->len, NULL, &n);
+    } else if (w->flags & IR_WORD_STATIC) {
+        struct ir_program *p = program_arith(part->str, part->len);
+        ok = arith_eval(p, 0, p->nops, NULL, &n);
+    } else {
+        char *s = expand_word(w);
+        if (aborting)
+            return false;
+        if (s == NULL)
+            s = "";
+        ok = arith_eval_text(s, strlen(s), NULL, &n);
+    }
+    int64_t old = 0;
+    if (ok && append)
+        ok = arith_load(v, NULL, &old);
+    if (!ok) {
+        expansion_failed();
+        return false;
+    }
+    arith_store(v, (int64_t) ((uint64_t) old + (uint64_t) n));
+    return true;
+}
+
+/* The value old, NULL if unset, with val, which it consumes, appended. */
+static struct value *
+append_value(struct value *old, struct value *val)
+{
+    if (old == NULL || old->len == 0)
+        return val;
+    if (val == NULL)
+        return value_ref(old);
+    struct strbuf sb = { 0 };
+    strbuf_append(&sb, old->str, old->len);
+    strbuf_append(&sb, val->str, val->len);
+    value_unref(val);
+    return value_new(sb.buf, sb.len);
+}
+
+/* Make the fields in av the elements of v, or append them to its
+ * elements; returns false, after reporting why, if there are too
+ * many. */
+static bool
+store_elements(struct var *v, bool append, const struct argvec *av)
+{
+    struct array *a = append ? writable_array(v) : array_new();
+    size_t origin = append ? a->n : 0;
+    if ((size_t) av->argc > ARRAY_MAX - origin) {
+        fprintf(stderr, "minibash: %s: too many array elements\n", v->name->str);
+        if (!append)
+            array_free(a);
+        return false;
+    }
+    array_reserve(a, origin + av->argc);
+    for (int k = 0; k < av->argc; k++)
+        array_set(a, origin + k, value_new(av->argv[k], strlen(av->argv[k])));
+    if (!append)
+        assign_array(v, a);
+    return true;
+}
+
+/* NAME[subscript]=value and NAME[subscript]+=value. */
+static bool
+assign_subscripted(struct var *v, const struct ir_assign *a)
+{
+    size_t i;
+    if (!eval_subscript(v, a->subscript, true, &i)) {
+        expansion_failed();
+        return false;
+    }
+    struct value *val = expand_value(&prog->words[a->value]);
+    if (aborting) {
+        value_unref(val);
+        return false;
+    }
+    if (a->flags & IR_ASSIGN_APPEND)
+        val = append_value(element_value(v, i), val);
+    assign_element(v, i, val != NULL ? val : value_intern("", 0));
+    return true;
+}
+
+/* NAME=(value ...) and NAME+=(value ...): the fields the words expand
+ * to become the elements of v, or are appended to them. */
+static bool
+assign_elements(struct var *v, const struct ir_assign *a)
+{
+    struct argvec av = { 0 };
+    expand_words(a->value, a->count, &av);
+    if (aborting)
+        return false;
+    if (!store_elements(v, a->flags & IR_ASSIGN_APPEND, &av)) {
+        expansion_failed();
+        return false;
+    }
+    return true;
+}
+
+/* Perform count assignments starting at first. */
+static void
+run_assignments(uint32_t first, uint32_t count)
+{
+    ran_cmdsubst = false;
+    for (uint32_t i = 0; i < count; i++) {
+        const struct ir_assign *a = &prog->assigns[first + i];
+        const struct ir_word *w = &prog->words[a->value];
+        struct var *v = program_var(a->name);
+        bool append = a->flags & IR_ASSIGN_APPEND;
+        if (a->subscript != IR_NONE) {
+            if (!assign_subscripted(v, a))
+                return;
+            continue;
+        }
+        if (a->flags & IR_ASSIGN_ARRAY) {
+            if (!assign_elements(v, a))
+                return;
+            continue;
+        }
+        if (v->integer
+            || (!append && w->count == 1 && prog->parts[w->first].kind == IR_PART_ARITH)) {
+            if (!assign_arith(v, w, append))
+                return;
+            continue;
+        }
+        struct value *val = expand_value(w);
+        if (aborting) {
+            value_unref(val);
+            return;
+        }
+        if (append)
+            val = append_value(var_value(v), val);
+        assign_var(v, val != NULL ? val : value_intern("", 0));
+    }
+    /* the status is that of the last command substitution, if any */
+    if (!ran_cmdsubst)
+        last_exit_status = 0;
+}
+
+/* Define the function stmt names, replacing any previous definition. */
+static void
+define_function(const struct ir_stmt *stmt)
+{
+    struct var *v = program_var(stmt->a);
+    if (v->function == NULL) {
+        v->function = malloc(sizeof *v->function);
+        if (v->function == NULL)
+            utils_fatal_error("Could not allocate function: ");
+    } else {
+        program_unref(v->function->program);
+    }
+    v->function->program = running;
+    v->function->body = stmt->b;
+    running->refs++;
+    last_exit_status = 0;
+}
+
+/* declare, typeset, and local NAME[=value] ..., and the same with
+ * NAME[subscript]=value and NAME=(value ...); in a function, all of
+ * them make the variables local. */
+static void
+run_declare(const struct ir_stmt *stmt)
+{
+    if ((stmt->flags & IR_DECLARE_LOCAL) && function_depth == 0) {
+        fprintf(stderr, "minibash: local: can only be used in a function\n");
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+    for (uint32_t i = 0; i < stmt->count; i++) {
+        const struct ir_assign *a = &prog->assigns[stmt->first + i];
+        /* local x=$x and local a=("${a[@]}") see the value outside */
+        struct value *val = NULL;
+        struct argvec elems = { 0 };
+        if (a->flags & IR_ASSIGN_ARRAY) {
+            expand_words(a->value, a->count, &elems);
+            if (aborting)
+                return;
+        } else if (a->value != IR_NONE && a->subscript == IR_NONE) {
+            val = expand_value(&prog->words[a->value]);
+            if (aborting) {
+                value_unref(val);
+                return;
+            }
+            if (val == NULL)
+                val = value_intern("", 0);
+        }
+        struct var *v = program_var(a->name);
+        if (function_depth > 0)
+            make_local(v);
+        if (stmt->flags & IR_DECLARE_INTEGER)
+            v->integer = true;
+        if ((stmt->flags & IR_DECLARE_ARRAY) && var_array(v) == NULL)
+            writable_array(v);
+        if ((a->flags & IR_ASSIGN_ARRAY) && !store_elements(v, a->flags & IR_ASSIGN_APPEND, &elems)) {
+            last_exit_status = 1;
+            return;
+        }
+        if (a->subscript != IR_NONE && !assign_subscripted(v, a))
+            return;
+        if (val == NULL)
+            continue;
+        if (!v->integer) {
+            assign_var(v, val);
+            continue;
+        }
+
+        /* but local -i x=x+1 sees the local x */
+        int64_t n;
+        bool ok = arith_eval_text(val->str, val->len, NULL, &n);
+        value_unref(val);
+        if (!ok) {
+            last_exit_status = 1;
+            return;
+        }
+        arith_store(v, n);
+    }
+}
+
+/* Return the function that command cmd, whose name is name, calls,
+ * or NULL.  Builtins resolved when the program was lowered take
+ * precedence over functions. */
+static struct function *
+command_function(const struct ir_stmt *cmd, const char *name)
+{
+    const struct ir_word *w = &prog->words[cmd->first];
+    if (w->flags & IR_WORD_STATIC)
+        return program_var(prog->parts[w->first].str)->function;
+    return lookup_var(name, strlen(name))->function;
+}
+
+/* Make positional parameter n local, setting it to s, or unsetting
+ * it if s is NULL. */
+static void
+set_param(struct var *v, const char *s)
+{
+    make_local(v);
+    if (s != NULL)
+        assign_var(v, value_new(s, strlen(s)));
+}
+
+/*
+ * Call function f with the arguments argv[1 .. argc) as its
+ * positional parameters and the NAME=value prefixes of cmd as local
+ * variables.  If last, the process exits when the function returns.
+ */
+static void
+call_function(struct function *f, const struct ir_stmt *cmd, int argc, char **argv,
+              bool last)
+{
+    struct value **vals = arena_alloc(&scratch, cmd->b * sizeof *vals);
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        vals[i] = expand_value(&prog->words[prog->assigns[cmd->a + i].value]);
+        if (vals[i] == NULL)
+            vals[i] = value_intern("", 0);
+    }
+
+    size_t mark = nundo;
+    int saved_nparams = nparams;
+    function_depth++;
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        struct var *v = program_var(prog->assigns[cmd->a + i].name);
+        make_local(v);
+        assign_var(v, vals[i]);
+    }
+
+    /* unset the caller's parameters beyond the callee's */
+    for (int i = 1; i < argc || i <= nparams; i++)
+        set_param(param_var(i), i < argc ? argv[i] : NULL);
+    nparams = argc - 1;
+    char count[12];
+    snprintf(count, sizeof count, "%d", nparams);
+    set_param(lookup_var("#", 1), count);
+
+    struct program *saved_running = running;
+    struct program *callee = f->program;
+    callee->refs++;
+    running = callee;
+    prog = callee->ir;
+    exits_after = last;
+    run_stmt(f->body);
+    running = saved_running;
+    prog = saved_running->ir;
+    program_unref(callee);
+
+    returning = false;
+    function_depth--;
+    undo_locals(mark);
+    nparams = saved_nparams;
+}
+
+/* return [n] */
+static int
+builtin_return(int argc, char *argv[])
+{
+    if (function_depth == 0) {
+        fprintf(stderr, "minibash: return: can only `return' from a function or sourced script\n");
+        return 1;
+    }
+    returning = true;
+    return argc > 1 ? atoi(argv[1]) & 0xff : last_exit_status;
+}
+
+/* break [n] and continue [n]; sets *pending to the number of loops
+ * to leave. */
+static int
+loop_control(int *pending, int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1;
+    if (n < 1) {
+        fprintf(stderr, "minibash: %s: %s: loop count out of range\n",
+                argv[0], argv[1]);
+        return 1;
+    }
+    if (loop_depth == 0)
+        return 0;
+    if (n > loop_depth)
+        n = loop_depth;
+    *pending = n;
+    return 0;
+}
+
+static int
+builtin_break(int argc, char *argv[])
+{
+    return loop_control(&breaking, argc, argv);
+}
+
+static int
+builtin_continue(int argc, char *argv[])
+{
+    return loop_control(&continuing, argc, argv);
+}
+
+/* Reap any children that have exited and delete the background
+ * jobs that have finished. */
+static void
+reap_finished_jobs(void)
+{
+    reaper_poll();
+
+    struct list_elem *e = list_begin(&job_list);
+    while (e != list_end(&job_list)) {
+        struct job *job = list_entry(e, struct job, elem);
+        e = list_next(e);
+        if (job->num_processes_alive == 0
+            && (job->status == TERMINATED_VIA_EXIT
+                || job->status == TERMINATED_VIA_SIGNAL))
+            delete_job(job, true);
+    }
+}
+
+/*
+ * Run stmt asynchronously, in a child process of its own process
+ * group, whose standard input is /dev/null.
+ */
+static void
+run_background(uint32_t stmt)
+{
+    fflush(stdout);
+    readbuf_sync_all();
+    pid_t pid = fork();
+    if (pid == -1) {
+        utils_error("Could not fork: ");
+        last_exit_status = 1;
+        return;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        job_pgid = getpid();
+        forget_jobs();
+        int fd = open("/dev/null", O_RDONLY);
+        if (fd != -1) {
+            dup2(fd, STDIN_FILENO);
+            close(fd);
+        }
+        exits_after = true;
+        run_stmt(stmt);
+        readbuf_sync_all();
+        fflush(stdout);
+        _exit(last_exit_status);
+    }
+    setpgid(pid, pid);
+
+    struct job *job = allocate_job(true);
+    job->status = BACKGROUND;
+    add_process(job, pid);
+
+    char num[12];
+    snprintf(num, sizeof num, "%d", pid);
+    set_variable("!", num);
+    last_exit_status = 0;
+}
+
+/* Wait for the background job to finish, then forget it. */
+static int
+wait_for_background_job(struct job *job)
+{
+    wait_for_job(job);
+    int status = job_exit_status(job);
+    if (job->status != STOPPED)
+        delete_job(job, true);
+    return status;
+}
+
+/* Return the job, running or not, that process pid belongs to. */
+static struct job *
+find_job_by_pid(pid_t pid)
+{
+    struct job_process *p = get_process_from_pid(pid);
+    if (p != NULL)
+        return p->job;
+
+    /* a job that has finished but was not yet waited for */
+    for (struct list_elem *e = list_begin(&job_list);
+         e != list_end(&job_list); e = list_next(e)) {
+        struct job *job = list_entry(e, struct job, elem);
+        for (p = job->processes; p != NULL; p = p->next)
+            if (p->pid == pid)
+                return job;
+    }
+    return NULL;
+}
+
+/* wait [pid | %jid ...] */
+static int
+builtin_wait(int argc, char *argv[])
+{
+    int status = 0;
+    if (argc == 1) {
+        struct list_elem *e = list_begin(&job_list);
+        while (e != list_end(&job_list)) {
+            struct job *job = list_entry(e, struct job, elem);
+            e = list_next(e);
+            if (job->status != FOREGROUND)
+                wait_for_background_job(job);
+        }
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *num = arg[0] == '%' ? arg + 1 : arg;
+        char *end;
+        long n = strtol(num, &end, 10);
+        struct job *job = arg[0] == '%' ? get_job_from_jid(n) : find_job_by_pid(n);
+
+        if (end == num || *end != '\0') {
+            fprintf(stderr, "minibash: wait: `%s': not a pid or valid job spec\n", arg);
+            status = 2;
+        } else if (job == NULL || job->status == FOREGROUND) {
+            if (arg[0] == '%')
+                fprintf(stderr, "minibash: wait: %s: no such job\n", arg);
+            else
+                fprintf(stderr, "minibash: wait: pid %s is not a child of this shell\n", arg);
+            status = 127;
+        } else {
+            status = wait_for_background_job(job);
+        }
+    }
+    return status;
+}
+
+/* Is s a valid variable name? */
+static bool
+is_identifier(const char *s)
+{
+    if (!isalpha((unsigned char) *s) && *s != '_')
+        return false;
+    while (*++s != '\0')
+        if (!isalnum((unsigned char) *s) && *s != '_')
+            return false;
+    return true;
+}
+
+/* The class, as for ifs_span, of byte i of a line read, which is not
+ * in IFS if it was escaped. */
+static int
+read_class(const struct ifs *ifs, const char *line, const char *quoted, size_t i)
+{
+    if (quoted != NULL && quoted[i])
+        return 0;
+    return ifs->class[(unsigned char) line[i]];
+}
+
+/*
+ * Assign the fields of the len bytes of line to the nnames variables
+ * names, as read does: each but the last gets a field, and the last
+ * the rest of the line, with the IFS whitespace around it removed,
+ * and a single trailing delimiter too if only one field is left.
+ * Unless elems is NULL, the fields are its elements instead, one
+ * each.  Bytes whose quoted entry is set were escaped and are not in
+ * IFS.
+ */
+static void
+assign_fields(char **names, int nnames, struct array *elems, const char *line,
+              const char *quoted, size_t len)
+{
+    const struct ifs *ifs = current_ifs();
+    size_t i = 0;
+    while (i < len && read_class(ifs, line, quoted, i) == IFS_SPACE)
+        i++;
+    for (int v = 0; elems != NULL ? i < len && v < (int) ARRAY_MAX : v < nnames; v++) {
+        size_t start = i, end;
+        while (i < len && read_class(ifs, line, quoted, i) == 0)
+            i++;
+        end = i;
+        while (i < len && read_class(ifs, line, quoted, i) == IFS_SPACE)
+            i++;
+        if (i < len && read_class(ifs, line, quoted, i) == IFS_DELIM) {
+            i++;
+            while (i < len && read_class(ifs, line, quoted, i) == IFS_SPACE)
+                i++;
+        }
+        if (elems != NULL) {
+            array_set(elems, v, value_new(line + start, end - start));
+            continue;
+        }
+        if (v + 1 == nnames && i < len) {
+            end = len;
+            while (end > start && read_class(ifs, line, quoted, end - 1) == IFS_SPACE)
+                end--;
+        }
+        assign_var(lookup_var(names[v], strlen(names[v])), value_new(line + start, end - start));
+    }
+}
+
+/*
+ * Read from fd into line up to delim, which is consumed but not
+ * stored, or max bytes, for builtin who.  Unless raw, a backslash escapes the byte
+ * after it, which is marked in quoted, and a backslash-newline pair
+ * is removed; quoted is left empty if no byte was escaped.  Returns
+ * 0, 1 at end of file, or 2 if the read failed.
+ */
+static int
+read_line(const char *who, int fd, char delim, size_t max, bool raw, struct strbuf *line,
+          struct strbuf *quoted)
+{
+    bool escape = false;
+    while (line->len < max) {
+        const char *p;
+        ssize_t n = readbuf_peek(fd, &p);
+        if (n == -1) {
+            fprintf(stderr, "minibash: %s: read error: %d: %s\n", who, fd, strerror(errno));
+            return 2;
+        }
+        if (n == 0)
+            return 1;
+
+        if (escape) {
+            escape = false;
+            readbuf_consume(fd, 1);
+            if (*p == '\n')
+                continue;
+            if (quoted->len < line->len) {
+                size_t from = quoted->len;
+                strbuf_append(quoted, line->buf + from, line->len - from);
+                memset(quoted->buf + from, 0, line->len - from);
+            }
+            strbuf_append(line, p, 1);
+            strbuf_append(quoted, "\1", 1);
+            continue;
+        }
+
+        size_t limit = (size_t) n < max - line->len ? (size_t) n : max - line->len;
+        const char *d = memchr(p, delim, limit);
+        size_t len = d != NULL ? (size_t) (d - p) : limit;
+        const char *backslash = raw ? NULL : memchr(p, '\\', len);
+        if (backslash != NULL) {
+            len = backslash - p;
+            escape = true;
+        }
+        strbuf_append(line, p, len);
+        if (quoted->len > 0) {
+            strbuf_append(quoted, p, len);
+            memset(quoted->buf + quoted->len - len, 0, len);
+        }
+        readbuf_consume(fd, len + (escape || d != NULL));
+        if (!escape && d != NULL)
+            return 0;
+    }
+    return 0;
+}
+
+/* read [-r] [-a array] [-d delim] [-n nchars] [-u fd] [name ...] */
+static int
+builtin_read(int argc, char *argv[])
+{
+    bool raw = false;
+    const char *array = NULL;
+    char delim = '\n';
+    size_t max = SIZE_MAX;
+    int fd = STDIN_FILENO;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *o = argv[i] + 1; *o; o++) {
+            if (*o == 'r') {
+                raw = true;
+                continue;
+            }
+            if (strchr("adnu", *o) == NULL) {
+                fprintf(stderr, "minibash: read: -%c: invalid option\n", *o);
+                goto usage;
+            }
+            const char *arg;
+            if (o[1] != '\0') {
+                arg = o + 1;
+            } else if (i + 1 < argc) {
+                arg = argv[++i];
+            } else {
+                fprintf(stderr, "minibash: read: -%c: option requires an argument\n", *o);
+                goto usage;
+            }
+            char *end;
+            long n = 0;
+            if (*o == 'n' || *o == 'u') {
+                errno = 0;
+                n = strtol(arg, &end, 10);
+                if (*arg == '\0' || *end != '\0' || n < 0 || n > INT_MAX || errno != 0) {
+                    fprintf(stderr, "minibash: read: %s: invalid %s\n", arg,
+                            *o == 'n' ? "number" : "file descriptor specification");
+                    return 1;
+                }
+            }
+            switch (*o) {
+            case 'a':
+                array = arg;
+                break;
+            case 'd':
+                delim = *arg;
+                break;
+            case 'n':
+                max = n;
+                break;
+            case 'u':
+                if (fcntl(n, F_GETFD) == -1) {
+                    fprintf(stderr, "minibash: read: %ld: invalid file descriptor: %s\n",
+                            n, strerror(errno));
+                    return 1;
+                }
+                fd = n;
+                break;
+            }
+            o += strlen(o) - 1;     /* the rest of the word was the argument */
+        }
+    }
+    if (array != NULL && !is_identifier(array)) {
+        fprintf(stderr, "minibash: read: `%s': not a valid identifier\n", array);
+        return 1;
+    }
+    for (int j = i; j < argc; j++) {
+        if (!is_identifier(argv[j])) {
+            fprintf(stderr, "minibash: read: `%s': not a valid identifier\n", argv[j]);
+            return 1;
+        }
+    }
+
+    struct strbuf line = { 0 }, quoted = { 0 };
+    int status = read_line("read", fd, delim, max, raw, &line, &quoted);
+    if (status == 2)
+        return 1;
+    if (array != NULL) {
+        /* the names after it are ignored */
+        struct array *elems = array_new();
+        assign_fields(NULL, 0, elems, strbuf_finish(&line),
+                      quoted.len > 0 ? quoted.buf : NULL, line.len);
+        assign_array(lookup_var(array, strlen(array)), elems);
+    } else if (i == argc) {
+        assign_var(lookup_var("REPLY", 5), value_new(strbuf_finish(&line), line.len));
+    } else {
+        assign_fields(argv + i, argc - i, NULL, strbuf_finish(&line),
+                      quoted.len > 0 ? quoted.buf : NULL, line.len);
+    }
+    return status;
+
+usage:
+    fprintf(stderr, "read: usage: read [-r] [-a array] [-d delim] [-n nchars] [-u fd] "
+            "[name ...]\n");
+    return 2;
+}
+
+/* Set the elements of elems from origin on to at most count lines
+ * read from fd, after skipping skip lines, for mapfile -n.  Returns
+ * mapfile's status. */
+static int
+map_lines(int fd, struct array *elems, size_t origin, char delim, bool trim, size_t skip,
+          size_t count)
+{
+    for (size_t k = 0; k < skip + count && origin < ARRAY_MAX; k++) {
+        struct strbuf line = { 0 }, quoted = { 0 };
+        int status = read_line("mapfile", fd, delim, SIZE_MAX, true, &line, &quoted);
+        if (status == 2)
+            return 1;
+        if (status == 1 && line.len == 0)
+            break;
+        if (k >= skip) {
+            if (status == 0 && !trim)
+                strbuf_append(&line, &delim, 1);
+            array_set(elems, origin++, value_new(strbuf_finish(&line), line.len));
+        }
+        if (status == 1)
+            break;
+    }
+    return 0;
+}
+
+/*
+ * mapfile [-t] [-d delim] [-n count] [-O origin] [-s count] [-u fd]
+ * [array], also called readarray.  Without -n, all that is left to
+ * read is read at once, and its lines become views into the text
+ * read, see array_load_lines.
+ */
+static int
+builtin_mapfile(int argc, char *argv[])
+{
+    bool trim = false, origin_set = false;
+    char delim = '\n';
+    size_t count = 0, origin = 0, skip = 0;
+    int fd = STDIN_FILENO;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *o = argv[i] + 1; *o; o++) {
+            if (*o == 't') {
+                trim = true;
+                continue;
+            }
+            if (strchr("dnOsu", *o) == NULL) {
+                fprintf(stderr, "minibash: mapfile: -%c: invalid option\n", *o);
+                goto usage;
+            }
+            const char *arg;
+            if (o[1] != '\0') {
+                arg = o + 1;
+            } else if (i + 1 < argc) {
+                arg = argv[++i];
+            } else {
+                fprintf(stderr, "minibash: mapfile: -%c: option requires an argument\n", *o);
+                goto usage;
+            }
+            char *end;
+            long n = 0;
+            if (*o != 'd') {
+                errno = 0;
+                n = strtol(arg, &end, 10);
+                if (*arg == '\0' || *end != '\0' || n < 0 || n > INT_MAX || errno != 0) {
+                    fprintf(stderr, "minibash: mapfile: %s: invalid %s\n", arg,
+                            *o == 'u' ? "file descriptor specification"
+                            : *o == 'O' ? "array origin" : "line count");
+                    return 1;
+                }
+            }
+            switch (*o) {
+            case 'd':
+                delim = *arg;
+                break;
+            case 'n':
+                count = n;
+                break;
+            case 'O':
+                origin = n;
+                origin_set = true;
+                break;
+            case 's':
+                skip = n;
+                break;
+            case 'u':
+                if (fcntl(n, F_GETFD) == -1) {
+                    fprintf(stderr, "minibash: mapfile: %ld: invalid file descriptor: %s\n",
+                            n, strerror(errno));
+                    return 1;
+                }
+                fd = n;
+                break;
+            }
+            o += strlen(o) - 1;     /* the rest of the word was the argument */
+        }
+    }
+    const char *name = i < argc ? argv[i] : "MAPFILE";
+    if (!is_identifier(name)) {
+        fprintf(stderr, "minibash: mapfile: `%s': not a valid identifier\n", name);
+        return 1;
+    }
+    if (origin >= ARRAY_MAX) {
+        fprintf(stderr, "minibash: mapfile: %zu: invalid array origin\n", origin);
+        return 1;
+    }
+
+    /* without -O, the array is replaced once the lines are read */
+    struct var *v = lookup_var(name, strlen(name));
+    struct array *elems = origin_set ? writable_array(v) : array_new();
+    int status = 0;
+    if (count > 0) {
+        status = map_lines(fd, elems, origin, delim, trim, skip, count);
+    } else {
+        size_t len;
+        char *text = readbuf_slurp(fd, &len);
+        if (text != NULL) {
+            array_load_lines(elems, origin, text, text, len, delim, trim, skip, SIZE_MAX);
+        } else {
+            fprintf(stderr, "minibash: mapfile: read error: %d: %s\n", fd, strerror(errno));
+            status = 1;
+        }
+    }
+    if (!origin_set)
+        assign_array(v, elems);
+    return status;
+
+usage:
+    fprintf(stderr, "mapfile: usage: mapfile [-t] [-d delim] [-n count] [-O origin] "
+            "[-s count] [-u fd] [array]\n");
+    return 2;
+}
+
+/* The builtins, indexed by enum ir_builtin. */
+static builtin_fn *const builtin_table[IR_NBUILTINS] = {
+    [IR_BUILTIN_TRUE]       = builtin_true,
+    [IR_BUILTIN_FALSE]      = builtin_false,
+    [IR_BUILTIN_BREAK]      = builtin_break,
+    [IR_BUILTIN_CONTINUE]   = builtin_continue,
+    [IR_BUILTIN_WAIT]       = builtin_wait,
+    [IR_BUILTIN_ECHO]       = builtin_echo,
+    [IR_BUILTIN_PRINTF]     = builtin_printf,
+    [IR_BUILTIN_TEST]       = builtin_test,
+    [IR_BUILTIN_EXPR]       = builtin_expr,
+    [IR_BUILTIN_HASH]       = builtin_hash,
+    [IR_BUILTIN_TYPE]       = builtin_type,
+    [IR_BUILTIN_RETURN]     = builtin_return,
+    [IR_BUILTIN_LET]        = builtin_let,
+    [IR_BUILTIN_READ]       = builtin_read,
+    [IR_BUILTIN_MAPFILE]    = builtin_mapfile,
+};
+
+/* Report that command name could not be run because of error err. */
+static void
+report_spawn_error(const char *name, int err)
+{
+    if (err == ENOENT)
+        fprintf(stderr, "minibash: %s: command not found\n", name);
+    else
+        fprintf(stderr, "minibash: %s: %s\n", name, strerror(err));
+}
+
+static struct var *path_var;            // PATH
+static struct value *prefix_path;       // a PATH= prefix of the command being started
+
+/* Return the $PATH that commands are looked up in: that of the shell,
+ * or that of the command being started if it has a PATH= prefix. */
+static const char *
+current_path(void)
+{
+    if (prefix_path != NULL)
+        return prefix_path->str;
+    if (path_var == NULL)
+        path_var = lookup_var("PATH", 4);
+    struct value *val = var_value(path_var);
+    return val != NULL ? val->str : NULL;
+}
+
+/*
+ * Return the environment of the external command cmd: that of the
+ * shell, with cmd's NAME=value prefixes laid over it until
+ * export_overlay_done.  The prefixes are expanded first, so that
+ * none of them sees another.
+ */
+static char **
+prefix_environment(const struct ir_stmt *cmd)
+{
+    struct value **vals = arena_alloc(&scratch, cmd->b * sizeof *vals);
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        struct value *val = expand_value(&prog->words[prog->assigns[cmd->a + i].value]);
+        vals[i] = val != NULL ? val : value_intern("", 0);
+        pin(vals[i]);
+    }
+
+    char **envp = export_envp();
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        struct var *v = program_var(prog->assigns[cmd->a + i].name);
+        export_overlay(v->export, v->name, vals[i]);
+        if (v->name->len == 4 && memcmp(v->name->str, "PATH", 4) == 0)
+            prefix_path = vals[i];
+    }
+    return envp;
+}
+
+/*
+ * Start the external command cmd, whose expanded words are argv,
+ * performing the nactions file actions first.  The command joins
+ * process group job_pgid, or starts one of its own.  Returns false,
+ * after reporting why, if it could not be started.
+ */
+static bool
+spawn_command(const struct ir_stmt *cmd, char **argv,
+              const struct spawn_action *actions, int nactions, pid_t *pid)
+{
+    char **envp = prefix_environment(cmd);
+    const char *file = strchr(argv[0], '/') != NULL ? argv[0] : path_cache_lookup(argv[0]);
+    prefix_path = NULL;
+    int spawn_result = ENOENT;
+    readbuf_sync_all();
+    if (file != NULL) {
+        struct spawn_request req = {
+            .file = file, .argv = argv, .envp = envp, .pgid = job_pgid,
+            .actions = actions, .nactions = nactions,
+        };
+        spawn_result = spawn(&req, pid);
+    }
+    export_overlay_done();
+
+    if (spawn_result != 0)
+        report_spawn_error(argv[0], spawn_result);
+    return spawn_result == 0;
+}
+
+/*
+ * Replace this process, a child that has nothing left to do but run
+ * the external command cmd, whose expanded words are argv, by it.
+ * This saves the fork and wait that starting it would otherwise cost.
+ */
+static void
+exec_command(const struct ir_stmt *cmd, char **argv)
+{
+    char **envp = prefix_environment(cmd);
+    const char *file = strchr(argv[0], '/') != NULL ? argv[0] : path_cache_lookup(argv[0]);
+    prefix_path = NULL;
+    readbuf_sync_all();
+    fflush(stdout);
+    fflush(stderr);
+    /* the shell keeps SIGCHLD blocked, commands must not */
+    sigset_t nomask;
+    sigemptyset(&nomask);
+    sigprocmask(SIG_SETMASK, &nomask, NULL);
+    if (file != NULL)
+        execve(file, argv, envp);
+
+    report_spawn_error(argv[0], file != NULL ? errno : ENOENT);
+    _exit(127);
+}
+
+/*
+ * Run builtin with the arguments argv, and the NAME=value prefixes of
+ * cmd, e.g., IFS for read, in effect while it runs.  They are saved
+ * and restored the way a function's locals are, but for return's,
+ * which would then see a function where there is none.
+ */
+static int
+run_builtin(enum ir_builtin builtin, const struct ir_stmt *cmd, int argc, char **argv)
+{
+    if (cmd->b == 0 || builtin == IR_BUILTIN_RETURN)
+        return builtin_table[builtin](argc, argv);
+
+    struct value **vals = arena_alloc(&scratch, cmd->b * sizeof *vals);
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        vals[i] = expand_value(&prog->words[prog->assigns[cmd->a + i].value]);
+        if (vals[i] == NULL)
+            vals[i] = value_intern("", 0);
+    }
+    size_t mark = nundo;
+    function_depth++;
+    for (uint32_t i = 0; i < cmd->b; i++) {
+        struct var *v = program_var(prog->assigns[cmd->a + i].name);
+        make_local(v);
+        assign_var(v, vals[i]);
+    }
+    int status = builtin_table[builtin](argc, argv);
+    function_depth--;
+    undo_locals(mark);
+    return status;
+}
+
+/*
+ * Execute a simple command by spawning it (see spawn.h), or, if it is the last
+ * thing this process does, by replacing the process.
+ * Commands without a slash are located through the path cache.
+ */
+static void
+execute_command(const struct ir_stmt *cmd, bool last)
+{
+    struct argvec av = { 0 };
+    ran_cmdsubst = false;
+    expand_words(cmd->first, cmd->count, &av);
+    if (aborting)
+        return;
+
+    if (av.argc == 0) {
+        /* e.g., an unset $CMD; only a command substitution sets a status */
+        if (!ran_cmdsubst)
+            last_exit_status = 0;
+        return;
+    }
+
+    /* builtins are resolved when the program is lowered, unless
+     * the command name is the result of an expansion */
+    enum ir_builtin builtin = cmd->builtin;
+    if (builtin == IR_BUILTIN_NONE && !(prog->words[cmd->first].flags & IR_WORD_STATIC))
+        builtin = builtin_lookup(av.argv[0]);
+    if (builtin != IR_BUILTIN_NONE) {
+        last_exit_status = run_builtin(builtin, cmd, av.argc, av.argv);
+        return;
+    }
+    struct function *f = command_function(cmd, av.argv[0]);
+    if (f != NULL) {
+        call_function(f, cmd, av.argc, av.argv, last);
+        return;
+    }
+
+    if (last)
+        exec_command(cmd, av.argv);
+
+    pid_t pid;
+    if (spawn_command(cmd, av.argv, NULL, 0, &pid)) {
+        struct job *job = allocate_job(true);
+        job->status = FOREGROUND;
+        add_process(job, pid);
+        wait_for_job(job);
+        last_exit_status = job_exit_status(job);
+        delete_job(job, true);
+    } else {
+        last_exit_status = 127;
+    }
+}
+
+static void
+handle_child_status(pid_t pid, int status)
+{
+    assert(signal_is_blocked(SIGCHLD));
+
+    struct job_process *p = get_process_from_pid(pid);
+    if (p == NULL)
+        return;         /* not started by this shell, see forget_jobs */
+
+    struct job *job = p->job;
+    if (WIFSTOPPED(status)) {
+        job->status = STOPPED;
+        return;
+    }
+    if (WIFEXITED(status))
+        p->status = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        p->status = 128 + WTERMSIG(status);
+    else
+        return;
+
+    tommy_hashlin_remove_existing(&pid2process, &p->node);
+    p->alive = false;
+    if (--job->num_processes_alive == 0)
+        job->status = WIFSIGNALED(status) ? TERMINATED_VIA_SIGNAL
+                                          : TERMINATED_VIA_EXIT;
+}
+
+/* A descriptor replaced by a redirection, and a copy of its
+ * original, or -1 if it was not open. */
+struct saved_fd {
+    int fd;
+    int copy;
+};
+
+/* Remember fd before it is redirected, giving back what read buffered
+ * from it. */
+static void
+save_fd(int fd, struct saved_fd *saved, int *nsaved)
+{
+    readbuf_sync(fd);
+    int copy = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    if (copy == -1 && errno != EBADF)
+        utils_error("Could not save descriptor %d: ", fd);
+    saved[*nsaved].fd = fd;
+    saved[*nsaved].copy = copy;
+    (*nsaved)++;
+}
+
+/* Make fd refer to what newfd refers to, closing newfd. */
+static void
+move_fd(int newfd, int fd)
+{
+    if (newfd != fd) {
+        dup2(newfd, fd);
+        close(newfd);
+    }
+}
+
+/* Return a descriptor from which the string s, of length len, can
+ * be read, with leading tabs removed from every line if stripTabs. */
+static int
+string_fd(const char *s, size_t len, bool stripTabs)
+{
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    bool atstart = true;
+    size_t i = 0;
+    while (i < len) {
+        size_t j = i;
+        if (stripTabs && atstart)
+            while (j < len && s[j] == '\t')
+                j++;
+        const char *nl = memchr(s + j, '\n', len - j);
+        size_t end = nl != NULL ? nl - s + 1 : len;
+        if (write(fd, s + j, end - j) != (ssize_t) (end - j)) {
+            close(fd);
+            return -1;
+        }
+        atstart = nl != NULL;
+        i = end;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/* Expand the target of redirection r; returns NULL, after reporting
+ * why, if it is ambiguous. */
+static char *
+redirect_target(const struct ir_redirect *r)
+{
+    char *target = expand_word(&prog->words[r->word]);
+    if (aborting)
+        return NULL;
+    if (target == NULL)
+        fprintf(stderr, "minibash: ambiguous redirect\n");
+    return target;
+}
+
+/*
+ * Open the file or string that redirection r, other than a dup or
+ * close, reads or writes, whose expanded target is target.  Returns
+ * a close-on-exec descriptor, or -1 after reporting why it failed.
+ */
+static int
+open_target(const struct ir_redirect *r, const char *target)
+{
+    int flags = O_CLOEXEC, fd;
+    switch (r->op) {
+    case IR_REDIR_IN:
+        flags |= O_RDONLY;
+        break;
+    case IR_REDIR_OUT:
+    case IR_REDIR_OUT_ERR:
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+    case IR_REDIR_APPEND:
+    case IR_REDIR_APPEND_ERR:
+        flags |= O_WRONLY | O_CREAT | O_APPEND;
+        break;
+    case IR_REDIR_STRING: {
+        struct strbuf sb = { 0 };
+        strbuf_append(&sb, target, strlen(target));
+        if (r->flags & IR_REDIR_NEWLINE)
+            strbuf_append(&sb, "\n", 1);
+        fd = string_fd(sb.buf, sb.len, r->flags & IR_REDIR_STRIP_TABS);
+        if (fd == -1)
+            utils_error("Could not create here-document: ");
+        return fd;
+    }
+    default:
+        abort();
+    }
+
+    fd = open(target, flags, 0666);
+    if (fd == -1)
+        fprintf(stderr, "minibash: %s: %s\n", target, strerror(errno));
+    return fd;
+}
+
+/* The descriptor a dup redirection with target copies, or -1 after
+ * reporting why there is none. */
+static int
+dup_source(const char *target)
+{
+    char *end;
+    long src = strtol(target, &end, 10);
+    if (*target == '\0' || *end != '\0' || src < 0 || src > INT_MAX) {
+        fprintf(stderr, "minibash: %s: ambiguous redirect\n", target);
+        return -1;
+    }
+    return src;
+}
+
+/* Perform a redirection; returns false, after reporting why, if it failed. */
+static bool
+redirect(const struct ir_redirect *r, struct saved_fd *saved, int *nsaved)
+{
+    char *target = NULL;
+    if (r->word != IR_NONE && (target = redirect_target(r)) == NULL)
+        return false;
+
+    int newfd;
+    switch (r->op) {
+    case IR_REDIR_DUP:
+        if (strcmp(target, "-") == 0) {
+            save_fd(r->fd, saved, nsaved);
+            close(r->fd);
+            break;
+        }
+        newfd = dup_source(target);
+        if (newfd == -1)
+            return false;
+        if (fcntl(newfd, F_GETFD) == -1) {
+            fprintf(stderr, "minibash: %d: %s\n", newfd, strerror(errno));
+            return false;
+        }
+        if (newfd != r->fd) {
+            save_fd(r->fd, saved, nsaved);
+            dup2(newfd, r->fd);
+        }
+        break;
+    case IR_REDIR_CLOSE:
+        save_fd(r->fd, saved, nsaved);
+        close(r->fd);
+        break;
+    case IR_REDIR_OUT_ERR:
+    case IR_REDIR_APPEND_ERR:
+        save_fd(STDOUT_FILENO, saved, nsaved);
+        save_fd(STDERR_FILENO, saved, nsaved);
+        newfd = open_target(r, target);
+        if (newfd == -1)
+            return false;
+        dup2(newfd, STDERR_FILENO);
+        move_fd(newfd, STDOUT_FILENO);
+        break;
+    default:
+        save_fd(r->fd, saved, nsaved);
+        newfd = open_target(r, target);
+        if (newfd == -1)
+            return false;
+        move_fd(newfd, r->fd);
+        break;
+    }
+    return true;
+}
+
+/* Run a statement with its redirections, then undo them, unless
+ * the process exits after it. */
+static void
+run_redirected(const struct ir_stmt *stmt, bool last)
+{
+    /* anything buffered belongs to the old descriptors */
+    fflush(stdout);
+    fflush(stderr);
+
+    struct saved_fd saved[2 * stmt->count];
+    int nsaved = 0;
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < stmt->count; i++)
+        ok = redirect(&prog->redirects[stmt->first + i], saved, &nsaved);
+
+    if (!ok) {
+        last_exit_status = 1;
+    } else if (stmt->a != IR_NONE) {
+        exits_after = last;
+        run_stmt(stmt->a);
+    } else {
+        last_exit_status = 0;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    while (nsaved-- > 0) {
+        readbuf_sync(saved[nsaved].fd);
+        if (saved[nsaved].copy == -1) {
+            close(saved[nsaved].fd);
+        } else {
+            dup2(saved[nsaved].copy, saved[nsaved].fd);
+            close(saved[nsaved].copy);
+        }
+    }
+}
+
+/*
+ * Turn the redirections of a pipeline stage into file actions, which
+ * the child performs after connecting the stage to its pipes, and
+ * append them to actions.  Files are opened here, so that failures
+ * are reported as usual; the descriptors are close-on-exec and added
+ * to opened.  Returns false, after reporting why, if a redirection
+ * failed.
+ */
+static bool
+redirect_actions(const struct ir_stmt *stmt, struct spawn_action *actions, int *nactions,
+                 int *opened, int *nopened)
+{
+    for (uint32_t i = 0; i < stmt->count; i++) {
+        const struct ir_redirect *r = &prog->redirects[stmt->first + i];
+        char *target = NULL;
+        if (r->word != IR_NONE && (target = redirect_target(r)) == NULL)
+            return false;
+
+        int fd;
+        switch (r->op) {
+        case IR_REDIR_DUP:
+            if (strcmp(target, "-") == 0) {
+                actions[(*nactions)++] = (struct spawn_action) { -1, r->fd };
+                break;
+            }
+            fd = dup_source(target);
+            if (fd == -1)
+                return false;
+            /* descriptors 0 to 2 may be what earlier actions made them */
+            if (fd > STDERR_FILENO && fcntl(fd, F_GETFD) == -1) {
+                fprintf(stderr, "minibash: %d: %s\n", fd, strerror(errno));
+                return false;
+            }
+            if (fd != r->fd)
+                actions[(*nactions)++] = (struct spawn_action) { fd, r->fd };
+            break;
+        case IR_REDIR_CLOSE:
+            actions[(*nactions)++] = (struct spawn_action) { -1, r->fd };
+            break;
+        default:
+            fd = open_target(r, target);
+            if (fd == -1)
+                return false;
+            opened[(*nopened)++] = fd;
+            if (r->op == IR_REDIR_OUT_ERR || r->op == IR_REDIR_APPEND_ERR) {
+                actions[(*nactions)++] = (struct spawn_action) { fd, STDOUT_FILENO };
+                actions[(*nactions)++] = (struct spawn_action) { fd, STDERR_FILENO };
+            } else {
+                actions[(*nactions)++] = (struct spawn_action) { fd, r->fd };
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+/*
+ * Start stage s of a pipeline, whose standard input and output are
+ * in and out unless -1, in process group job_pgid.  An external
+ * command is spawned with the pipes and its redirections wired up by
+ * the spawn's file actions; any other stage runs in a forked copy of the shell,
+ * which must close next, the read end of the stage's output pipe.
+ * Returns the stage's pid, or -1 after setting *status if it could
+ * not be started.
+ */
+static pid_t
+start_stage(uint32_t s, int in, int out, int next, int *status)
+{
+    /* the redirections around a command, outermost first */
+    const struct ir_stmt *cmd = &prog->stmts[s];
+    uint32_t nredirs = 0;
+    for (; cmd->kind == IR_REDIRECT && cmd->a != IR_NONE; cmd = &prog->stmts[cmd->a])
+        nredirs += cmd->count;
+
+    /* a command name that needs expansion may name a builtin */
+    if (cmd->kind == IR_COMMAND && cmd->builtin == IR_BUILTIN_NONE
+        && (prog->words[cmd->first].flags & IR_WORD_STATIC)
+        && command_function(cmd, NULL) == NULL) {
+        struct argvec av = { 0 };
+        expand_words(cmd->first, cmd->count, &av);
+        if (aborting) {
+            *status = 1;
+            return -1;
+        }
+
+        struct spawn_action actions[2 + 2 * nredirs];
+        int nactions = 0;
+        if (in != -1)
+            actions[nactions++] = (struct spawn_action) { in, STDIN_FILENO };
+        if (out != -1)
+            actions[nactions++] = (struct spawn_action) { out, STDOUT_FILENO };
+
+        int opened[nredirs + 1], nopened = 0;
+        bool ok = true;
+        for (const struct ir_stmt *r = &prog->stmts[s]; ok && r != cmd; r = &prog->stmts[r->a])
+            ok = redirect_actions(r, actions, &nactions, opened, &nopened);
+
+        pid_t pid = -1;
+        if (!ok)
+            *status = 1;
+        else if (!spawn_command(cmd, av.argv, actions, nactions, &pid))
+            *status = 127;
+        while (nopened > 0)
+            close(opened[--nopened]);
+        return pid;
+    }
+
+    readbuf_sync_all();
+    pid_t pid = fork();
+    if (pid == -1) {
+        utils_error("Could not fork: ");
+        *status = 1;
+        return -1;
+    }
+    if (pid == 0) {
+        setpgid(0, job_pgid);
+        job_pgid = getpgrp();
+        forget_jobs();
+        if (next != -1)
+            close(next);
+        if (in != -1)
+            move_fd(in, STDIN_FILENO);
+        if (out != -1)
+            move_fd(out, STDOUT_FILENO);
+        exits_after = true;
+        run_stmt(s);
+        readbuf_sync_all();
+        fflush(stdout);
+        _exit(last_exit_status);
+    }
+    setpgid(pid, job_pgid != 0 ? job_pgid : pid);
+    return pid;
+}
+
+/*
+ * Run the stages of a pipeline concurrently, each connected to the
+ * next by a pipe, as one job whose processes share a process group.
+ * The shell only creates the pipes and starts the stages; its status
+ * is that of the last stage.
+ */
+static void
+run_pipeline(const struct ir_stmt *pipeline)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    struct job *job = allocate_job(true);
+    job->status = FOREGROUND;
+    pid_t saved_pgid = job_pgid;
+    int in = -1, status = 0;
+    pid_t pid = -1;
+    for (uint32_t i = 0; i < pipeline->count; i++) {
+        int pipefd[2] = { -1, -1 };
+        if (i + 1 < pipeline->count && pipe2(pipefd, O_CLOEXEC) == -1) {
+            utils_error("Could not create pipe: ");
+            pid = -1;
+            status = 1;
+            break;
+        }
+
+        pid = start_stage(prog->kids[pipeline->first + i], in, pipefd[1], pipefd[0],
+                          &status);
+        if (pid != -1) {
+            /* the first stage leads the group; the others join it */
+            if (job_pgid == 0)
+                job_pgid = pid;
+            add_process(job, pid);
+        }
+        if (in != -1)
+            close(in);
+        if (pipefd[1] != -1)
+            close(pipefd[1]);
+        in = pipefd[0];
+    }
+    if (in != -1)
+        close(in);
+    job_pgid = saved_pgid;
+
+    wait_for_job(job);
+    last_exit_status = pid != -1 ? job_exit_status(job) : status;
+    delete_job(job, true);
+}
+
+/*
+ * Run the body (or condition) of a loop.
+ * Returns true if a pending break, continue, or return requires
+ * leaving the loop.
+ */
+static bool
+run_loop_body(uint32_t body)
+{
+    run_stmt(body);
+    if (returning || aborting)
+        return true;
+    if (breaking) {
+        breaking--;
+        return true;
+    }
+    if (continuing)
+        return --continuing > 0;
+    return false;
+}
+
+/* while and until loops */
+static void
+run_while(const struct ir_stmt *loop)
+{
+    int status = 0;
+    loop_depth++;
+    for (;;) {
+        if (run_loop_body(loop->a))
+            break;
+        if ((last_exit_status == 0) != (loop->kind == IR_WHILE))
+            break;
+        bool leave = run_loop_body(loop->b);
+        status = last_exit_status;
+        if (leave)
+            break;
+    }
+    loop_depth--;
+    if (!returning)
+        last_exit_status = status;
+}
+
+/*
+ * case: the items are tried in turn, and the commands of the first
+ * whose pattern matches are run, and then those of the next item
+ * after a ;&, or of the next matching item after a ;;&.  last is set
+ * if the shell exits after the statement.
+ */
+static void
+run_case(const struct ir_stmt *stmt, bool last)
+{
+    const char *s = expand_word(&prog->words[stmt->a]);
+    if (aborting)
+        return;
+    if (s == NULL)
+        s = "";
+    size_t len = strlen(s);
+    bool matched = false, ran = false;
+    for (uint32_t i = 0; i < stmt->count; i++) {
+        const struct ir_stmt *item = &prog->stmts[prog->kids[stmt->first + i]];
+        for (uint32_t k = 0; k < item->count && !matched && !aborting; k++)
+            matched = pattern_matches(&prog->words[item->first + k], s, len);
+        if (aborting)
+            return;
+        if (!matched)
+            continue;
+
+        ran = true;
+        if (item->a != IR_NONE) {
+            exits_after = last && (item->flags == 0 || i + 1 == stmt->count);
+            run_stmt(item->a);
+        } else {
+            last_exit_status = 0;
+        }
+        if (breaking || continuing || returning || aborting)
+            return;
+        if (item->flags == 0)
+            return;
+        if (item->flags & IR_CASE_CONTINUE)
+            matched = false;
+    }
+    if (!ran)
+        last_exit_status = 0;
+}
+
+/* for ((; condition; update)) loops; the initializer ran before */
+static void
+run_arith_for(const struct ir_stmt *loop)
+{
+    int status = 0;
+    bool failed = false;        /* evaluating an expression failed */
+    loop_depth++;
+    for (;;) {
+        if (loop->a != IR_NONE) {
+            failed = !run_arith(&prog->stmts[loop->a]);
+            if (last_exit_status != 0)
+                break;
+        }
+        bool leave = run_loop_body(loop->b);
+        status = last_exit_status;
+        if (leave)
+            break;
+        if (loop->c != IR_NONE && !run_arith(&prog->stmts[loop->c])) {
+            failed = true;
+            break;
+        }
+    }
+    loop_depth--;
+    if (!returning)
+        last_exit_status = failed ? 1 : status;
+}
+
+static void
+run_for(const struct ir_stmt *loop)
+{
+    /* the words are expanded before the loop runs; they stay pinned */
+    struct value **vals = NULL;
+    uint32_t nvals = 0, cap = 0;
+    pathexp_next_command();
+    for (uint32_t i = 0; i < loop->count && !aborting; i++) {
+        const struct ir_word *w = &prog->words[loop->first + i];
+        struct argvec fields = { 0 };
+        struct value *val = NULL;
+        if (w->flags & (IR_WORD_SPLIT | IR_WORD_GLOB))
+            split_word(w, &fields);
+        else if ((val = expand_value(w)) == NULL)
+            continue;
+        uint32_t n = val != NULL ? 1 : fields.argc;
+        if (nvals + n > cap) {
+            uint32_t newcap = cap ? 2 * cap : 8;
+            while (nvals + n > newcap)
+                newcap *= 2;
+            vals = arena_grow(&scratch, vals, cap * sizeof *vals, newcap * sizeof *vals);
+            cap = newcap;
+        }
+        if (val != NULL)
+            vals[nvals++] = val;
+        for (int j = 0; j < fields.argc; j++)
+            vals[nvals++] = value_new(fields.argv[j], strlen(fields.argv[j]));
+    }
+    for (uint32_t i = 0; i < nvals; i++)
+        pin(vals[i]);
+    if (aborting)
+        return;
+
+    struct var *var = program_var(loop->a);
+    int status = 0;
+    loop_depth++;
+    for (uint32_t i = 0; i < nvals; i++) {
+        assign_var(var, value_ref(vals[i]));
+        bool leave = run_loop_body(loop->b);
+        status = last_exit_status;
+        if (leave)
+            break;
+    }
+    loop_depth--;
+    if (!returning)
+        last_exit_status = status;
+}
+
+/*
+ * Run a statement of the current program.
+ */
+static void 
+run_stmt(uint32_t s)
+{
+    const struct ir_stmt *stmt = &prog->stmts[s];
+    /* the temporaries of a statement die with it */
+    struct arena_mark mark = arena_mark(&scratch);
+    size_t pinned = npins;
+    /* only statements in tail position inherit exits_after */
+    bool last = exits_after;
+    exits_after = false;
+
+    switch (stmt->kind) {
+    case IR_SEQ:
+        for (uint32_t i = 0; i < stmt->count; i++) {
+            exits_after = last && i + 1 == stmt->count;
+            run_stmt(prog->kids[stmt->first + i]);
+            if (breaking || continuing || returning || aborting)
+                break;
+        }
+        break;
+    case IR_COMMAND:
+        execute_command(stmt, last);
+        break;
+    case IR_ASSIGN:
+        run_assignments(stmt->first, stmt->count);
+        break;
+    case IR_AND:
+    case IR_OR:
+        run_stmt(stmt->a);
+        if (breaking || continuing || returning || aborting)
+            break;
+        if ((last_exit_status == 0) == (stmt->kind == IR_AND)) {
+            exits_after = last;
+            run_stmt(stmt->b);
+        }
+        break;
+    case IR_NOT:
+        run_stmt(stmt->a);
+        last_exit_status = !last_exit_status;
+        break;
+    case IR_BACKGROUND:
+        run_background(stmt->a);
+        break;
+    case IR_REDIRECT:
+        run_redirected(stmt, last);
+        break;
+    case IR_IF:
+        run_stmt(stmt->a);
+        if (breaking || continuing || returning || aborting)
+            break;
+        exits_after = last;
+        if (last_exit_status == 0)
+            run_stmt(stmt->b);
+        else if (stmt->c != IR_NONE)
+            run_stmt(stmt->c);
+        else
+            last_exit_status = 0;
+        break;
+    case IR_WHILE:
+    case IR_UNTIL:
+        run_while(stmt);
+        break;
+    case IR_FOR:
+        run_for(stmt);
+        break;
+    case IR_PIPELINE:
+        run_pipeline(stmt);
+        break;
+    case IR_FUNCTION:
+        define_function(stmt);
+        break;
+    case IR_DECLARE:
+        run_declare(stmt);
+        break;
+    case IR_ARITH:
+        run_arith(stmt);
+        break;
+    case IR_ARITH_FOR:
+        run_arith_for(stmt);
+        break;
+    case IR_CASE:
+        run_case(stmt, last);
+        break;
+    case IR_CASE_ITEM:
+        break;
+    case IR_MATCH: {
+        if (stmt->flags & IR_MATCH_REGEX) {
+            struct value *subject = expand_value(&prog->words[stmt->a]);
+            if (subject == NULL)
+                subject = value_intern("", 0);
+            int status = aborting ? 1 : regex_matches(&prog->words[stmt->b], subject);
+            value_unref(subject);
+            if (!aborting)
+                last_exit_status = status;
+            break;
+        }
+        const char *s = expand_word(&prog->words[stmt->a]);
+        if (aborting)
+            break;
+        if (s == NULL)
+            s = "";
+        bool matched = pattern_matches(&prog->words[stmt->b], s, strlen(s));
+        if (!aborting)
+            last_exit_status = matched == !(stmt->flags & IR_MATCH_NEGATE) ? 0 : 1;
+        break;
+    }
+    case IR_UNSUPPORTED:
+        printf("node type `%s` not implemented\n", ir_str(prog, stmt->a));
+        break;
+    }
+    unpin(pinned);
+    arena_release(&scratch, mark);
+}
+
+/* Run a lowered program, then free it unless it defined functions. */
+static void
+run_program(struct ir_program *ir)
+{
+    struct program *p = calloc(1, sizeof *p);
+    if (p == NULL)
+        utils_fatal_error("Could not allocate program: ");
+    p->ir = ir;
+    p->refs = 1;
+    running = p;
+    prog = ir;
+    /* background jobs that finished while the last program ran */
+    reaper_poll();
+    const struct ir_stmt *root = &prog->stmts[prog->root];
+    if (root->kind == IR_SEQ) {
+        for (uint32_t i = 0; i < root->count; i++) {
+            run_stmt(prog->kids[root->first + i]);
+            aborting = false;
+        }
+    } else {
+        run_stmt(prog->root);
+        aborting = false;
+    }
+    running = NULL;
+    prog = NULL;
+    program_unref(p);
+}
+
+/* 
+ * Execute the script whose content is provided in `script`
+ */
+static void 
+execute_script(char *script)
+{
+    TSTree *tree = ts_parser_parse_string(parser, NULL, script, strlen(script));
+    struct ir_program *p = ir_compile(ts_tree_root_node(tree), script);
+    ts_tree_delete(tree);
+    run_program(p);
+}
+
+/*
+ * A script that is read from a file descriptor while it runs.
+ * text holds the len bytes that have been read but not yet executed;
+ * tree-sitter reads them through a TSInput.
+ *
+ * A regular file is mapped rather than read, and text is a window
+ * into the mapping that moves forward through it; pipes and other
+ * descriptors are read into buf, and text is buf.
+ */
+struct script_input {
+    int fd;
+    const char *text;
+    uint32_t len;
+    bool eof;
+    char *buf;              /* if read */
+    uint32_t cap;
+    char *map;              /* if mapped */
+    size_t mapsize;
+    size_t released;        /* bytes at the start of map given back */
+};
+
+#define SCRIPT_READ_SIZE (64 * 1024)
+#define SCRIPT_RELEASE_SIZE (1024 * 1024)
+
+static const char *
+script_input_read(void *payload, uint32_t byte, TSPoint position, uint32_t *bytes_read)
+{
+    struct script_input *in = payload;
+    *bytes_read = byte < in->len ? in->len - byte : 0;
+    return in->text + (byte < in->len ? byte : in->len);
+}
+
+/* Map fd if it is a regular file, so that its text is not copied
+ * and can be shared through the page cache. */
+static void
+script_input_open(struct script_input *in, int fd)
+{
+    *in = (struct script_input) { .fd = fd };
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    in->map = map;
+    in->mapsize = st.st_size;
+    in->text = in->map;
+}
+
+static void
+script_input_close(struct script_input *in)
+{
+    if (in->map != NULL)
+        munmap(in->map, in->mapsize);
+    else
+        free(in->buf);
+}
+
+/* Forget the first n bytes of the text, which were executed. */
+static void
+script_input_consume(struct script_input *in, uint32_t n)
+{
+    in->len -= n;
+    if (in->map == NULL) {
+        memmove(in->buf, in->buf + n, in->len);
+        return;
+    }
+
+    /* the pages of the mapping that were executed are not needed */
+    in->text += n;
+    size_t done = in->text - in->map;
+    if (done - in->released >= SCRIPT_RELEASE_SIZE) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t upto = done / page * page;
+        madvise(in->map + in->released, upto - in->released, MADV_DONTNEED);
+        in->released = upto;
+    }
+}
+
+/* Read once from the script; returns false at its end. */
+static bool
+script_input_read_once(struct script_input *in)
+{
+    if (in->cap - in->len < SCRIPT_READ_SIZE) {
+        in->cap = in->cap ? 2 * in->cap : 2 * SCRIPT_READ_SIZE;
+        while (in->cap - in->len < SCRIPT_READ_SIZE)
+            in->cap *= 2;
+        in->text = in->buf = realloc(in->buf, in->cap);
+        if (in->buf == NULL)
+            utils_fatal_error("Could not grow script buffer: ");
+    }
+
+    ssize_t n;
+    do
+        n = read(in->fd, in->buf + in->len, in->cap - in->len);
+    while (n == -1 && errno == EINTR);
+    if (n == -1)
+        utils_error("Could not read script: ");
+    if (n <= 0) {
+        in->eof = true;
+        return false;
+    }
+    in->len += n;
+    return true;
+}
+
+/*
+ * Append what can be read from the script without waiting, blocking
+ * only if nothing can be read yet.  At most about as much as is
+ * buffered already is read, so that a long statement is parsed a
+ * logarithmic rather than linear number of times, while a slow
+ * writer's statements still run as soon as they arrive.
+ */
+static void
+script_input_fill(struct script_input *in)
+{
+    uint32_t limit = in->len + (in->len > SCRIPT_READ_SIZE ? in->len : SCRIPT_READ_SIZE);
+    if (in->map != NULL) {
+        /* widen the window into the mapping instead */
+        size_t left = in->mapsize - (in->text + in->len - in->map);
+        in->len = left > limit - in->len ? limit : in->len + left;
+        in->eof = in->text + in->len == in->map + in->mapsize;
+        return;
+    }
+
+    struct pollfd pfd = { .fd = in->fd, .events = POLLIN };
+    while (script_input_read_once(in) && in->len < limit
+           && poll(&pfd, 1, 0) == 1)
+        ;
+}
+
+/* The position reached after text s of length len, starting at p. */
+static TSPoint
+advance_point(TSPoint p, const char *s, uint32_t len)
+{
+    for (const char *nl; (nl = memchr(s, '\n', len)) != NULL; ) {
+        p.row++;
+        p.column = 0;
+        len -= nl + 1 - s;
+        s = nl + 1;
+    }
+    p.column += len;
+    return p;
+}
+
+/* Is the statement that ends at byte i followed by a newline, a
+ * comment, or a ; or & that more text cannot turn into another
+ * operator such as && or &>? */
+static bool
+is_terminated(const struct script_input *in, uint32_t i)
+{
+    const char *s = in->text;
+    while (i < in->len && (s[i] == ' ' || s[i] == '\t'))
+        i++;
+    if (i + 1 >= in->len)
+        return i < in->len && s[i] == '\n';
+
+    switch (s[i]) {
+    case '\n':
+    case '#':
+        return true;
+    case ';':
+        return s[i + 1] != ';' && s[i + 1] != '&';
+    case '&':
+        return s[i + 1] != '&' && s[i + 1] != '>';
+    default:
+        return false;
+    }
+}
+
+/* Is node a ;, & or newline between top-level statements? */
+static bool
+is_terminator(TSNode node)
+{
+    TSSymbol sym = ts_node_symbol(node);
+    return sym == anon_sym_SEMI || sym == anon_sym_AMP
+        || strcmp(ts_node_type(node), "\n") == 0;
+}
+
+/*
+ * Return the length of the longest prefix of the input that consists
+ * of complete top-level statements.  A statement is complete if text
+ * that is still to come cannot change it: it is free of errors and
+ * terminated, so it cannot gain arguments, operators, or the body
+ * of a here-document.  Where statements end is not known unless the
+ * text read so far parses as a program, which it does not when it
+ * stops within, e.g., an if statement; then none is complete.
+ */
+static uint32_t
+complete_prefix(TSNode root, const struct script_input *in)
+{
+    if (in->eof)
+        return in->len;
+    if (ts_node_symbol(root) != sym_program)
+        return 0;
+
+    uint32_t end = 0;
+    uint32_t n = ts_node_child_count(root);
+    for (uint32_t i = 0; i < n; i++) {
+        TSNode child = ts_node_child(root, i);
+        if (ts_node_is_error(child) || ts_node_is_missing(child))
+            break;
+        if (!ts_node_is_named(child)) {
+            if (!is_terminator(child))
+                break;
+            end = ts_node_end_byte(child);
+            continue;
+        }
+        if (ts_node_symbol(child) == sym_comment)
+            continue;
+        if (ts_node_has_error(child) || !is_terminated(in, ts_node_end_byte(child)))
+            break;
+        end = ts_node_end_byte(child);
+    }
+    return end;
+}
+
+/*
+ * Return a descriptor for reading the script from standard input.
+ * As when the script was read in full before it ran, the commands
+ * it runs find their standard input at its end rather than at some
+ * point within the script.
+ */
+static int
+stdin_script(void)
+{
+    int fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+    int null = open("/dev/null", O_RDONLY);
+    if (fd == -1 || null == -1)
+        utils_fatal_error("Could not set up standard input: ");
+    dup2(null, STDIN_FILENO);
+    close(null);
+    return fd;
+}
+
+/*
+ * Execute a script as it is read from fd, statement by statement,
+ * so that it starts running before it has been read in full and
+ * only the text of statements that are not complete yet is kept.
+ */
+static void
+execute_stream(int fd)
+{
+    struct script_input in;
+    script_input_open(&in, fd);
+
+    /* only a mapped file can be hashed before it runs */
+    struct script_cache *cache = NULL;
+    if (cache_dir != NULL && in.map != NULL)
+        cache = script_cache_open(cache_dir, ts_parser_language(parser), in.map, in.mapsize);
+    if (cache != NULL && script_cache_hit(cache)) {
+        struct ir_program *p;
+        while ((p = script_cache_next(cache)) != NULL)
+            run_program(p);
+        script_cache_close(cache, true);
+        script_input_close(&in);
+        return;
+    }
+
+    TSInput input = { &in, script_input_read, TSInputEncodingUTF8 };
+    TSTree *tree = NULL;
+    TSPoint parsed = { 0, 0 };      /* end of the text tree was parsed from */
+    uint32_t parsed_len = 0;
+
+    do {
+        script_input_fill(&in);
+        if (tree != NULL) {
+            /* reuse the tree of the incomplete statements read so far */
+            TSPoint p = advance_point(parsed, in.text + parsed_len, in.len - parsed_len);
+            ts_tree_edit(tree, &(TSInputEdit) {
+                .start_byte = parsed_len, .old_end_byte = parsed_len,
+                .new_end_byte = in.len, .start_point = parsed,
+                .old_end_point = parsed, .new_end_point = p,
+            });
+            parsed = p;
+        } else {
+            parsed = advance_point((TSPoint) { 0, 0 }, in.text, in.len);
+        }
+        parsed_len = in.len;
+
+        TSTree *newtree = ts_parser_parse(parser, tree, input);
+        ts_tree_delete(tree);
+        tree = newtree;
+
+        TSNode root = ts_tree_root_node(tree);
+        uint32_t end = complete_prefix(root, &in);
+        if (end == 0)
+            continue;
+
+        struct ir_program *p = ir_compile_prefix(root, in.text, end);
+        if (cache != NULL)
+            script_cache_add(cache, p);
+        run_program(p);
+
+        /* forget the text that was executed */
+        ts_tree_delete(tree);
+        tree = NULL;
+        script_input_consume(&in, end);
+    } while (!in.eof);
+
+    ts_tree_delete(tree);
+    if (cache != NULL)
+        script_cache_close(cache, true);
+    script_input_close(&in);
+}
+
+int
+main(int ac, char *av[])
+{
+    int opt;
+    tommy_hashdyn_init(&shell_vars);
+    export_init(environ, import_variable);
+    tommy_hashlin_init(&pid2process);
+    tommy_allocator_init(&job_allocator, sizeof(struct job), alignof(struct job));
+    tommy_allocator_init(&process_allocator, sizeof(struct job_process),
+                         alignof(struct job_process));
+
+    /* Process command-line arguments. See getopt(3) */
+    cache_dir = getenv("MINIBASH_CACHE");
+    if (cache_dir != NULL && *cache_dir == '\0')
+        cache_dir = NULL;
+    const char *backend = getenv("MINIBASH_SPAWN");
+    if (backend != NULL && *backend != '\0') {
+        int b = spawn_backend_by_name(backend);
+        if (b == -1)
+            fprintf(stderr, "minibash: MINIBASH_SPAWN: %s: unknown spawn backend\n", backend);
+        else
+            spawn_set_backend(b);
+    }
+    while ((opt = getopt(ac, av, "hSB")) > 0) {
+        switch (opt) {
+        case 'h':
+            usage(av[0]);
+            break;
+        case 'B':
+            spawn_benchmark("/bin/true", stdout);
+            exit(EXIT_SUCCESS);
+        case 'S': {
+            uint64_t hits = 0, misses = 0;
+            if (cache_dir != NULL)
+                script_cache_stats(cache_dir, &hits, &misses);
+            printf("hits\t%llu\nmisses\t%llu\n",
+                   (unsigned long long) hits, (unsigned long long) misses);
+            exit(EXIT_SUCCESS);
+        }
+        }
+    }
+
+    parser = ts_parser_new();
+    const TSLanguage *bash = tree_sitter_bash();
+    if (!ts_nodes_check(bash)) {
+        fprintf(stderr, "ts_nodes.h does not match the bash grammar, rebuild\n");
+        exit(EXIT_FAILURE);
+    }
+    ts_parser_set_language(parser, bash);
+
+    set_variable("#", "0");
+    set_variable("IFS", IFS_DEFAULT);
+    list_init(&job_list);
+    /* children are reaped only through the reaper's signalfd, so
+     * SIGCHLD stays blocked for the life of the shell */
+    signal_block(SIGCHLD);
+    reaper_init(handle_child_status);
+    path_cache_init(current_path);
+
+
+    /* Read/eval loop. */
+    bool shouldexit = false;
+    for (;;) {
+        if (shouldexit)
+            break;
+
+        /* background jobs that finished while the last input ran */
+        reaper_poll();
 
         char *userinput = NULL;
         /* Do not output a prompt unless shell's stdin is a terminal */
@@ -548,19 +4137,21 @@ main(int ac, char *av[])
             free (prompt);
             if (userinput == NULL)
                 break;
+            execute_script(userinput);
+            free(userinput);
         } else {
             int readfd = 0;
             if (av[optind] != NULL)
-                readfd = open(av[optind], O_RDONLY);
+                readfd = open(av[optind], O_RDONLY | O_CLOEXEC);
+            else
+                readfd = stdin_script();
+            if (readfd == -1)
+                utils_fatal_error("Could not open %s: ", av[optind]);
 
-            userinput = read_script_from_fd(readfd);
+            execute_stream(readfd);
             close(readfd);
-            if (userinput == NULL)
-                utils_fatal_error("Could not read input");
             shouldexit = true;
         }
-        execute_script(userinput);
-        free(userinput);
     }
 
     /* 
@@ -568,9 +4159,13 @@ main(int ac, char *av[])
      * reclamation, we free all allocated data structure prior to exiting
      * so that we can use valgrind's leak checker.
      */
+    readbuf_sync_all();
     ts_parser_delete(parser);
-    tommy_hashdyn_foreach(&shell_vars, hash_free);
+    tommy_hashdyn_foreach(&shell_vars, free_var);
     tommy_hashdyn_done(&shell_vars);
+    value_done();
+    free(pins);
+    arena_done(&scratch);
     return EXIT_SUCCESS;
 }
 
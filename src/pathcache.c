@@ -0,0 +1,418 @@
+/*
+ * The command location cache and the hash and type builtins.
+ *
+ * Entries live in a tommy_hashdyn keyed by command name, using the
+ * helpers in hashtable.h.  Along with its location, an entry records
+ * the index of the $PATH directory it was found in.  For each $PATH
+ * directory the cache remembers its modification time as of the
+ * last search; a lookup that hits checks the directories up to and
+ * including the entry's, since adding a file to an earlier directory
+ * or removing the file from its own changes which file is run.
+ */
+#define _GNU_SOURCE    1
+#include <errno.h>
+#include <paths.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pathcache.h"
+#include "builtins.h"
+#include "hashtable.h"
+
+struct cached_command {
+    entry e;            /* key is the name, val the file; must be first */
+    int dir;            /* index into dirs, -1 if set with hash -p */
+    unsigned hits;
+    unsigned seq;       /* insertion order, for listing */
+};
+
+/* A $PATH directory and its modification time when last searched. */
+struct path_dir {
+    char *name;
+    struct timespec mtime;
+    bool known;         /* mtime is valid */
+};
+
+static tommy_hashdyn commands;
+static bool initialized;
+static unsigned next_seq;
+
+static const char *(*get_path)(void);
+static char *path;      /* the $PATH value dirs was made from */
+static struct path_dir *dirs;
+static int ndirs;
+
+void
+path_cache_clear(void)
+{
+    if (initialized) {
+        tommy_hashdyn_foreach(&commands, hash_free);
+        tommy_hashdyn_done(&commands);
+    }
+    tommy_hashdyn_init(&commands);
+    initialized = true;
+    for (int i = 0; i < ndirs; i++)
+        dirs[i].known = false;
+}
+
+void
+path_cache_init(const char *(*path)(void))
+{
+    get_path = path;
+}
+
+/* Split $PATH into dirs if it changed since the last call, which
+ * invalidates every entry. */
+static void
+sync_path(void)
+{
+    const char *value = get_path();
+    if (value == NULL)
+        value = _PATH_DEFPATH;
+    if (initialized && path != NULL && strcmp(path, value) == 0)
+        return;
+
+    for (int i = 0; i < ndirs; i++)
+        free(dirs[i].name);
+    free(dirs);
+    free(path);
+    path = strdup(value);
+
+    ndirs = 1;
+    for (const char *p = value; *p; p++)
+        ndirs += *p == ':';
+    dirs = calloc(ndirs, sizeof *dirs);
+
+    const char *s = value;
+    for (int i = 0; i < ndirs; i++) {
+        const char *colon = strchrnul(s, ':');
+        /* an empty component stands for the current directory */
+        dirs[i].name = colon == s ? strdup(".") : strndup(s, colon - s);
+        s = colon + 1;
+    }
+    path_cache_clear();
+}
+
+/* Has dirs[i] not been modified since it was last searched? */
+static bool
+dir_unchanged(int i)
+{
+    struct stat st;
+    if (stat(dirs[i].name, &st) == -1)
+        st.st_mtim = (struct timespec) { 0 };
+
+    bool unchanged = dirs[i].known
+        && dirs[i].mtime.tv_sec == st.st_mtim.tv_sec
+        && dirs[i].mtime.tv_nsec == st.st_mtim.tv_nsec;
+    dirs[i].mtime = st.st_mtim;
+    dirs[i].known = true;
+    return unchanged;
+}
+
+/* Can file be run? */
+static bool
+is_executable(const char *file)
+{
+    struct stat st;
+    return stat(file, &st) == 0 && S_ISREG(st.st_mode) && access(file, X_OK) == 0;
+}
+
+/* Search $PATH for name, returning a malloc'd file name and its
+ * directory's index, or NULL. */
+static char *
+search_path(const char *name, int *dir)
+{
+    for (int i = 0; i < ndirs; i++) {
+        dir_unchanged(i);       /* remember its time as of this search */
+        char *file;
+        if (asprintf(&file, "%s/%s", dirs[i].name, name) == -1)
+            return NULL;
+        if (is_executable(file)) {
+            *dir = i;
+            return file;
+        }
+        free(file);
+    }
+    return NULL;
+}
+
+static struct cached_command *
+find_cached(const char *name)
+{
+    return tommy_hashdyn_search(&commands, str_cmp, name, str_hash(name));
+}
+
+/* Return the valid entry for name, if any, dropping a stale one. */
+static struct cached_command *
+lookup_valid(const char *name)
+{
+    sync_path();
+    struct cached_command *c = find_cached(name);
+    if (c == NULL || c->dir == -1)
+        return c;
+
+    bool valid = true;
+    for (int i = 0; valid && i <= c->dir; i++)
+        valid = dir_unchanged(i);
+    if (!valid) {
+        /* entries found in later directories may be shadowed now */
+        path_cache_clear();
+        return NULL;
+    }
+    return c;
+}
+
+static struct cached_command *
+add_cached(const char *name, char *file, int dir)
+{
+    struct cached_command *c = find_cached(name);
+    if (c != NULL) {
+        free(c->e.val);
+    } else {
+        c = malloc(sizeof *c);
+        c->e.key = strdup(name);
+        c->seq = next_seq++;
+        tommy_hashdyn_insert(&commands, &c->e.node, c, str_hash(name));
+    }
+    c->e.val = file;
+    c->dir = dir;
+    c->hits = 0;
+    return c;
+}
+
+/* Find name, adding it to the cache if it was not there. */
+static struct cached_command *
+lookup_or_add(const char *name)
+{
+    struct cached_command *c = lookup_valid(name);
+    if (c == NULL) {
+        int dir;
+        char *file = search_path(name, &dir);
+        if (file != NULL)
+            c = add_cached(name, file, dir);
+    }
+    return c;
+}
+
+const char *
+path_cache_lookup(const char *name)
+{
+    struct cached_command *c = lookup_or_add(name);
+    if (c == NULL)
+        return NULL;
+    c->hits++;
+    return c->e.val;
+}
+
+/* Collect all entries in the order in which they were added. */
+static struct cached_command **all_collected;
+static size_t ncollected;
+
+static void
+collect(void *obj)
+{
+    all_collected[ncollected++] = obj;
+}
+
+static int
+compare_seq(const void *a, const void *b)
+{
+    const struct cached_command *ca = *(struct cached_command *const *) a;
+    const struct cached_command *cb = *(struct cached_command *const *) b;
+    return ca->seq < cb->seq ? -1 : ca->seq > cb->seq;
+}
+
+static void
+list_commands(bool reusable)
+{
+    all_collected = malloc(tommy_hashdyn_count(&commands) * sizeof *all_collected);
+    ncollected = 0;
+    tommy_hashdyn_foreach(&commands, collect);
+    qsort(all_collected, ncollected, sizeof *all_collected, compare_seq);
+
+    if (!reusable)
+        printf("hits\tcommand\n");
+    for (size_t i = 0; i < ncollected; i++) {
+        struct cached_command *c = all_collected[i];
+        if (reusable)
+            printf("builtin hash -p %s %s\n", c->e.val, c->e.key);
+        else
+            printf("%4u\t%s\n", c->hits, c->e.val);
+    }
+    free(all_collected);
+}
+
+int
+builtin_hash(int argc, char *argv[])
+{
+    bool clear = false, delete = false, print = false, reusable = false;
+    const char *pathname = NULL;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *o = argv[i] + 1; *o; o++) {
+            switch (*o) {
+            case 'r': clear = true; break;
+            case 'd': delete = true; break;
+            case 't': print = true; break;
+            case 'l': reusable = true; break;
+            case 'p':
+                if (o[1] != '\0') {
+                    pathname = o + 1;
+                } else if (i + 1 < argc) {
+                    pathname = argv[++i];
+                } else {
+                    fprintf(stderr, "minibash: hash: -p: option requires an argument\n");
+                    goto usage;
+                }
+                o += strlen(o) - 1;     /* the rest of the word was it */
+                break;
+            default:
+                fprintf(stderr, "minibash: hash: -%c: invalid option\n", *o);
+            usage:
+                fprintf(stderr, "hash: usage: hash [-lr] [-p pathname] [-dt] [name ...]\n");
+                return 2;
+            }
+        }
+    }
+
+    sync_path();
+    if (clear)
+        path_cache_clear();
+
+    if (i == argc) {
+        if (clear)
+            return 0;
+        if (print) {
+            fprintf(stderr, "minibash: hash: -t: option requires an argument\n");
+            return 1;
+        }
+        if (tommy_hashdyn_count(&commands) == 0)
+            printf("hash: hash table empty\n");
+        else
+            list_commands(reusable);
+        fflush(stdout);
+        return 0;
+    }
+
+    int status = 0;
+    bool several = argc - i > 1;
+    for (; i < argc; i++) {
+        const char *name = argv[i];
+        if (pathname != NULL) {
+            add_cached(name, strdup(pathname), -1);
+            continue;
+        }
+
+        struct cached_command *c;
+        if (delete) {
+            c = tommy_hashdyn_remove(&commands, str_cmp, name, str_hash(name));
+            if (c == NULL) {
+                fprintf(stderr, "minibash: hash: %s: not found\n", name);
+                status = 1;
+            } else {
+                hash_free(c);
+            }
+        } else if (print) {
+            c = lookup_valid(name);
+            if (c == NULL) {
+                fprintf(stderr, "minibash: hash: %s: not found\n", name);
+                status = 1;
+            } else if (several) {
+                printf("%s\t%s\n", name, c->e.val);
+            } else {
+                printf("%s\n", c->e.val);
+            }
+        } else if (strchr(name, '/') == NULL && builtin_lookup(name) == IR_BUILTIN_NONE) {
+            /* search afresh, like bash, which also resets the hits */
+            int dir;
+            char *file = search_path(name, &dir);
+            if (file == NULL) {
+                fprintf(stderr, "minibash: hash: %s: not found\n", name);
+                status = 1;
+            } else {
+                add_cached(name, file, dir);
+            }
+        }
+    }
+    fflush(stdout);
+    return status;
+}
+
+int
+builtin_type(int argc, char *argv[])
+{
+    bool path_only = false, force_path = false, terse = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *o = argv[i] + 1; *o; o++) {
+            switch (*o) {
+            case 'p': path_only = true; break;
+            case 'P': force_path = true; break;
+            case 't': terse = true; break;
+            default:
+                fprintf(stderr, "minibash: type: -%c: invalid option\n", *o);
+                fprintf(stderr, "type: usage: type [-ptP] name [name ...]\n");
+                return 2;
+            }
+        }
+    }
+
+    int status = 0;
+    for (; i < argc; i++) {
+        const char *name = argv[i];
+        if (!force_path && builtin_lookup(name) != IR_BUILTIN_NONE) {
+            if (terse)
+                printf("builtin\n");
+            else if (!path_only)
+                printf("%s is a shell builtin\n", name);
+            continue;
+        }
+
+        /* like bash, report a hashed location without searching */
+        char *file = NULL;
+        bool hashed = false;
+        if (strchr(name, '/') != NULL) {
+            if (is_executable(name))
+                file = strdup(name);
+        } else {
+            struct cached_command *c = lookup_valid(name);
+            if (c != NULL) {
+                file = strdup(c->e.val);
+                hashed = true;
+            } else {
+                int dir;
+                file = search_path(name, &dir);
+            }
+        }
+
+        if (file == NULL) {
+            fflush(stdout);
+            if (!terse && !path_only && !force_path)
+                fprintf(stderr, "minibash: type: %s: not found\n", name);
+            status = 1;
+        } else if (terse) {
+            printf("file\n");
+        } else if (path_only || force_path) {
+            printf("%s\n", file);
+        } else if (hashed) {
+            printf("%s is hashed (%s)\n", name, file);
+        } else {
+            printf("%s is %s\n", name, file);
+        }
+        free(file);
+    }
+    fflush(stdout);
+    return status;
+}
@@ -0,0 +1,32 @@
+#ifndef __PATHCACHE_H
+#define __PATHCACHE_H
+/*
+ * A cache of the locations of commands found by searching $PATH,
+ * like bash's hash table of commands.
+ *
+ * An entry is used only while $PATH is unchanged and while neither
+ * the directory in which the command was found nor any directory
+ * searched before it has been modified since, so a cached location
+ * is never stale, and running a cached command costs a single
+ * execve rather than one probe per $PATH directory.
+ */
+
+/* Search the $PATH that path returns, NULL if it is unset.  It is
+ * called on every lookup, to see whether $PATH changed. */
+void path_cache_init(const char *(*path)(void));
+
+/* Return the file run for command name, or NULL if $PATH has no such
+ * executable file.  The string remains valid until the next call into
+ * this module.  Each call counts as a hit on the entry for name. */
+const char *path_cache_lookup(const char *name);
+
+/* Forget all cached locations. */
+void path_cache_clear(void);
+
+/* hash [-lr] [-p pathname] [-dt] [name ...] */
+int builtin_hash(int argc, char *argv[]);
+
+/* type [-ptP] name [name ...] */
+int builtin_type(int argc, char *argv[]);
+
+#endif /* __PATHCACHE_H */
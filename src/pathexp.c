@@ -0,0 +1,372 @@
+/*
+ * Pathname expansion, see pathexp.h.
+ *
+ * Listings live in a tommy_hashdyn keyed by the path the directory
+ * was opened with.  A listing holds the names of the directory, but
+ * for . and .., in one buffer, sorted, along with their file types.
+ * A listing is reused after the command that read it only if it is
+ * stable: the directory's modification time is an unreliable witness
+ * for changes made within the granularity of the file system's clock,
+ * so a directory modified shortly before it was read is read again.
+ */
+#define _GNU_SOURCE    1
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pathexp.h"
+#include "pattern.h"
+#include "utils.h"
+#include "tommyds/tommyhashdyn.h"
+#include "tommyds/tommyhash.h"
+
+/* A component of a pattern, between slashes. */
+struct component {
+    struct pattern *pat;    /* NULL for a literal name */
+    char *name;             /* the literal, with quoting removed */
+    size_t len;
+};
+
+struct pathexp {
+    struct component *comps;
+    size_t ncomps;
+};
+
+struct dir_entry {
+    uint32_t name;          /* offset in names */
+    uint32_t len;
+    uint8_t type;           /* DT_* */
+};
+
+struct listing {
+    tommy_node node;
+    char *path;             /* key */
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;  /* when read */
+    bool stable;            /* modified well before it was read */
+    unsigned command;       /* the command it was last read or checked in */
+    char *names;
+    struct dir_entry *entries;
+    size_t nentries;
+};
+
+#define DENTS_BUFSIZE       (256 * 1024)
+#define CACHE_MAX_ENTRIES   (1 << 20)   /* names kept before the cache is emptied */
+#define STABLE_AFTER        2           /* seconds between a modification and the
+                                           reading of a listing that can be reused */
+
+static tommy_hashdyn listings;
+static bool initialized;
+static size_t cached_entries;
+static unsigned command = 1;
+static char *dents;                     /* buffer for getdents64 */
+
+static int
+compare_listing(const void *arg, const void *obj)
+{
+    return strcmp(arg, ((const struct listing *) obj)->path);
+}
+
+static int
+compare_entries(const void *a, const void *b, void *names)
+{
+    return strcmp((char *) names + ((const struct dir_entry *) a)->name,
+                  (char *) names + ((const struct dir_entry *) b)->name);
+}
+
+static void
+free_listing(void *obj)
+{
+    struct listing *l = obj;
+    cached_entries -= l->nentries;
+    free(l->path);
+    free(l->names);
+    free(l->entries);
+    free(l);
+}
+
+/* Read the directory at path into a new listing, or return NULL if it
+ * cannot be read. */
+static struct listing *
+read_listing(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    struct timespec now;
+    if (fstat(fd, &st) == -1 || clock_gettime(CLOCK_REALTIME, &now) == -1) {
+        close(fd);
+        return NULL;
+    }
+    if (dents == NULL && (dents = malloc(DENTS_BUFSIZE)) == NULL)
+        utils_fatal_error("Could not allocate directory buffer: ");
+
+    struct listing *l = calloc(1, sizeof *l);
+    if (l == NULL || (l->path = strdup(path)) == NULL)
+        utils_fatal_error("Could not allocate directory listing: ");
+    l->dev = st.st_dev;
+    l->ino = st.st_ino;
+    l->mtime = st.st_mtim;
+    l->stable = st.st_mtim.tv_sec + STABLE_AFTER <= now.tv_sec;
+
+    size_t nbytes = 0, capbytes = 0, cap = 0;
+    ssize_t n;
+    while ((n = getdents64(fd, dents, DENTS_BUFSIZE)) > 0) {
+        for (ssize_t off = 0; off < n; ) {
+            struct dirent64 *d = (struct dirent64 *) (dents + off);
+            off += d->d_reclen;
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            size_t len = strlen(name);
+            if (nbytes + len + 1 > capbytes) {
+                capbytes = capbytes ? 2 * capbytes : 4096;
+                while (nbytes + len + 1 > capbytes)
+                    capbytes *= 2;
+                l->names = realloc(l->names, capbytes);
+            }
+            if (l->nentries == cap) {
+                cap = cap ? 2 * cap : 64;
+                l->entries = realloc(l->entries, cap * sizeof *l->entries);
+            }
+            if (l->names == NULL || l->entries == NULL)
+                utils_fatal_error("Could not allocate directory listing: ");
+            memcpy(l->names + nbytes, name, len + 1);
+            l->entries[l->nentries++] = (struct dir_entry) { nbytes, len, d->d_type };
+            nbytes += len + 1;
+        }
+    }
+    close(fd);
+
+    if (l->nentries > 0)
+        qsort_r(l->entries, l->nentries, sizeof *l->entries, compare_entries, l->names);
+    return l;
+}
+
+/* Return the listing of the directory at path, reading it unless a
+ * valid one is cached, or NULL if it cannot be read. */
+static struct listing *
+get_listing(const char *path)
+{
+    if (!initialized) {
+        tommy_hashdyn_init(&listings);
+        initialized = true;
+    }
+    tommy_hash_t hash = tommy_hash_u32(0, path, strlen(path));
+    struct listing *l = tommy_hashdyn_search(&listings, compare_listing, path, hash);
+    if (l != NULL) {
+        if (l->command == command)
+            return l;
+        struct stat st;
+        if (l->stable && stat(path, &st) == 0 && st.st_dev == l->dev && st.st_ino == l->ino
+            && st.st_mtim.tv_sec == l->mtime.tv_sec && st.st_mtim.tv_nsec == l->mtime.tv_nsec) {
+            l->command = command;
+            return l;
+        }
+        tommy_hashdyn_remove_existing(&listings, &l->node);
+        free_listing(l);
+    }
+
+    l = read_listing(path);
+    if (l != NULL) {
+        l->command = command;
+        cached_entries += l->nentries;
+        tommy_hashdyn_insert(&listings, &l->node, l, hash);
+    }
+    return l;
+}
+
+void
+pathexp_next_command(void)
+{
+    command++;
+    if (cached_entries > CACHE_MAX_ENTRIES) {
+        tommy_hashdyn_foreach(&listings, free_listing);
+        tommy_hashdyn_done(&listings);
+        tommy_hashdyn_init(&listings);
+    }
+}
+
+struct pathexp *
+pathexp_compile(const char *s, size_t len)
+{
+    if (!pattern_has_magic(s, len))
+        return NULL;
+
+    struct pathexp *pe = calloc(1, sizeof *pe);
+    size_t n = 1;
+    for (size_t i = 0; i < len; i++)
+        n += s[i] == '/';
+    if (pe == NULL || (pe->comps = calloc(n, sizeof *pe->comps)) == NULL)
+        utils_fatal_error("Could not compile pattern: ");
+    pe->ncomps = n;
+
+    const char *c = s, *end = s + len;
+    for (size_t i = 0; i < n; i++) {
+        const char *slash = memchr(c, '/', end - c);
+        if (slash == NULL)
+            slash = end;
+        struct component *comp = &pe->comps[i];
+        if (pattern_has_magic(c, slash - c)) {
+            comp->pat = pattern_compile(c, slash - c, PATTERN_PERIOD);
+        } else {
+            if ((comp->name = malloc(slash - c + 1)) == NULL)
+                utils_fatal_error("Could not compile pattern: ");
+            comp->len = pattern_unquote(c, slash - c, comp->name);
+            comp->name[comp->len] = '\0';
+        }
+        c = slash + 1;
+    }
+    return pe;
+}
+
+void
+pathexp_free(struct pathexp *pe)
+{
+    if (pe == NULL)
+        return;
+    for (size_t i = 0; i < pe->ncomps; i++) {
+        pattern_free(pe->comps[i].pat);
+        free(pe->comps[i].name);
+    }
+    free(pe->comps);
+    free(pe);
+}
+
+/* An expansion in progress. */
+struct walk {
+    const struct pathexp *pe;
+    struct arena *arena;
+    char *path;             /* the pathname being built */
+    size_t cap;
+    char **names;           /* those found */
+    size_t nnames, capnames;
+};
+
+/* Store the len bytes at s at path[at], zero-terminating them. */
+static void
+path_set(struct walk *w, size_t at, const char *s, size_t len)
+{
+    if (at + len + 1 > w->cap) {
+        w->cap = 2 * (at + len + 1);
+        if ((w->path = realloc(w->path, w->cap)) == NULL)
+            utils_fatal_error("Could not allocate pathname: ");
+    }
+    memcpy(w->path + at, s, len);
+    w->path[at + len] = '\0';
+}
+
+static void
+found(struct walk *w, size_t len)
+{
+    if (w->nnames == w->capnames) {
+        w->capnames = w->capnames ? 2 * w->capnames : 16;
+        if ((w->names = realloc(w->names, w->capnames * sizeof *w->names)) == NULL)
+            utils_fatal_error("Could not allocate pathnames: ");
+    }
+    w->names[w->nnames++] = arena_strndup(w->arena, w->path, len);
+}
+
+/* The directory for path[0 .. len), which is empty or ends in /. */
+static char *
+dir_of(struct walk *w, size_t len)
+{
+    if (len == 0)
+        return ".";
+    if (len == 1)
+        return "/";
+    w->path[len - 1] = '\0';
+    return w->path;
+}
+
+/* Is the file at path, whose directory entry has type, a directory,
+ * or a symbolic link to one? */
+static bool
+is_dir(const char *path, uint8_t type)
+{
+    if (type != DT_LNK && type != DT_UNKNOWN)
+        return type == DT_DIR;
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* Expand the components from level on, below path[0 .. len), which
+ * is empty or ends in /. */
+static void
+walk(struct walk *w, size_t level, size_t len)
+{
+    const struct component *c = &w->pe->comps[level];
+    bool last = level + 1 == w->pe->ncomps;
+    if (c->pat == NULL) {
+        path_set(w, len, c->name, c->len);
+        if (!last) {
+            path_set(w, len + c->len, "/", 1);
+            walk(w, level + 1, len + c->len + 1);
+            return;
+        }
+        /* a trailing / follows only names matched as directories */
+        struct stat st;
+        if (c->len == 0 || lstat(w->path, &st) == 0)
+            found(w, len + c->len);
+        return;
+    }
+
+    const struct listing *l = get_listing(dir_of(w, len));
+    if (len > 1)
+        w->path[len - 1] = '/';
+    if (l == NULL)
+        return;
+    for (size_t i = 0; i < l->nentries; i++) {
+        const struct dir_entry *e = &l->entries[i];
+        if (!pattern_match(c->pat, l->names + e->name, e->len))
+            continue;
+        path_set(w, len, l->names + e->name, e->len);
+        if (last) {
+            found(w, len + e->len);
+            continue;
+        }
+        /* only directories have names below them */
+        if (!is_dir(w->path, e->type))
+            continue;
+        path_set(w, len + e->len, "/", 1);
+        walk(w, level + 1, len + e->len + 1);
+    }
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+size_t
+pathexp_expand(const struct pathexp *pe, struct arena *arena, char ***names)
+{
+    struct walk w = { .pe = pe, .arena = arena };
+    path_set(&w, 0, "", 0);
+    walk(&w, 0, 0);
+    free(w.path);
+
+    /* names come out sorted unless a pattern is followed by more components */
+    for (size_t i = 1; i < w.nnames; i++) {
+        if (strcmp(w.names[i - 1], w.names[i]) > 0) {
+            qsort(w.names, w.nnames, sizeof *w.names, compare_names);
+            break;
+        }
+    }
+    *names = arena_alloc(arena, (w.nnames + 1) * sizeof **names);
+    if (w.nnames > 0)
+        memcpy(*names, w.names, w.nnames * sizeof *w.names);
+    (*names)[w.nnames] = NULL;
+    free(w.names);
+    return w.nnames;
+}
@@ -0,0 +1,39 @@
+#ifndef __PATHEXP_H
+#define __PATHEXP_H
+/*
+ * Pathname expansion.
+ *
+ * A pattern is compiled once into its components, each either a
+ * literal name or a compiled pattern (see pattern.h).  Expanding it
+ * reads each directory that a pattern component applies to with
+ * getdents64, into a cache of directory listings.  Within a command,
+ * a listing is read at most once and used without a stat; a later
+ * command reuses it only if the directory, checked with one stat, is
+ * still the same and unmodified.  The file types in the listings
+ * tell directories from other files, so only symbolic links, and
+ * files on file systems that do not report types, are stat'ed.
+ */
+#include <stddef.h>
+
+#include "arena.h"
+
+struct pathexp;
+
+/* Compile the len bytes of pattern at s, in which backslashes quote
+ * characters, or return NULL if s has no pattern characters. */
+struct pathexp *pathexp_compile(const char *s, size_t len);
+
+void pathexp_free(struct pathexp *pe);
+
+/*
+ * Store in *names the pathnames that match pe, sorted, and return
+ * their number, which is 0 if none match.  The names and the vector
+ * of them are allocated in arena.
+ */
+size_t pathexp_expand(const struct pathexp *pe, struct arena *arena, char ***names);
+
+/* Start a new command: listings read before are checked before they
+ * are used again. */
+void pathexp_next_command(void);
+
+#endif /* __PATHEXP_H */
@@ -0,0 +1,423 @@
+/*
+ * Shell patterns, see pattern.h.
+ *
+ * Every element other than * matches one byte per position, a literal
+ * run one per byte.  A pattern of at most 64 positions is matched bit
+ * parallel, as in the Shift-And algorithm: bit i of the state is set
+ * if the bytes read so far are matched by the positions up to i, so
+ * each byte costs a table lookup and a few word operations, whatever
+ * the stars.  Longer patterns walk the elements and the string
+ * together; when an element fails to match, it suffices to let the
+ * most recent * absorb one more byte and resume after it, as earlier
+ * stars need never be revisited.
+ */
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pattern.h"
+#include "utils.h"
+
+enum elem_kind {
+    ELEM_LITERAL,           /* lit[arg .. arg+len) */
+    ELEM_ANY,               /* ? */
+    ELEM_STAR,              /* * */
+    ELEM_SET,               /* sets[arg] */
+};
+
+struct elem {
+    uint8_t kind;           /* enum elem_kind */
+    uint32_t arg;
+    uint32_t len;
+};
+
+struct byteset {
+    uint64_t bits[4];
+};
+
+#define SHIFT_AND_MAX   64      /* positions matched bit parallel */
+
+/* The bit-parallel matcher of a pattern, or of its reverse. */
+struct shift_and {
+    uint64_t masks[256];    /* bit i is set if position i accepts the byte */
+    uint64_t loops;         /* the positions followed by a *, which stay
+                               matched whatever follows */
+    bool lead;              /* the pattern starts with a * */
+};
+
+struct pattern {
+    int flags;
+    struct elem *elems;
+    size_t nelems;
+    char *lit;              /* the literal runs */
+    struct byteset *sets;
+    size_t nsets;
+    size_t npos;
+    struct shift_and *sa;   /* forward and reverse, NULL if too many positions */
+};
+
+static void
+set_add(struct byteset *set, unsigned char c)
+{
+    set->bits[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+static bool
+set_has(const struct byteset *set, unsigned char c)
+{
+    return set->bits[c >> 6] >> (c & 63) & 1;
+}
+
+static const struct {
+    const char *name;
+    int (*is)(int c);
+} classes[] = {
+    { "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+    { "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+    { "lower", islower }, { "print", isprint }, { "punct", ispunct },
+    { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+};
+
+/*
+ * Parse the bracket expression at s[i], which is a [, into set.
+ * Returns the index after its closing ], or 0 if it has none, in
+ * which case the [ is an ordinary character.
+ */
+static size_t
+parse_set(const char *s, size_t len, size_t i, struct byteset *set)
+{
+    memset(set, 0, sizeof *set);
+    i++;
+    bool negate = i < len && (s[i] == '!' || s[i] == '^');
+    i += negate;
+    for (size_t first = i; i < len; i++) {
+        if (s[i] == ']' && i > first)
+            break;
+        if (s[i] == '[' && i + 1 < len && s[i + 1] == ':') {
+            const char *end = memchr(s + i + 2, ':', len - i - 2);
+            if (end != NULL && end + 1 < s + len && end[1] == ']') {
+                size_t n = end - (s + i + 2);
+                for (size_t k = 0; k < sizeof classes / sizeof *classes; k++)
+                    if (strlen(classes[k].name) == n
+                        && memcmp(classes[k].name, s + i + 2, n) == 0)
+                        for (int c = 0; c < 256; c++)
+                            if (classes[k].is(c))
+                                set_add(set, c);
+                i = end + 1 - s;
+                continue;
+            }
+        }
+        unsigned char lo = s[i];
+        if (lo == '\\' && i + 1 < len)
+            lo = s[++i];
+        unsigned char hi = lo;
+        if (i + 2 < len && s[i + 1] == '-' && s[i + 2] != ']') {
+            i += 2;
+            hi = s[i];
+            if (hi == '\\' && i + 1 < len)
+                hi = s[++i];
+        }
+        for (unsigned c = lo; c <= hi; c++)
+            set_add(set, c);
+    }
+    if (i == len)
+        return 0;
+    if (negate)
+        for (int k = 0; k < 4; k++)
+            set->bits[k] = ~set->bits[k];
+    return i + 1;
+}
+
+/* Append an element, merging a literal into a literal before it. */
+static void
+add_elem(struct pattern *p, size_t *cap, uint8_t kind, uint32_t arg, uint32_t len)
+{
+    if (kind == ELEM_LITERAL && p->nelems > 0
+        && p->elems[p->nelems - 1].kind == ELEM_LITERAL) {
+        p->elems[p->nelems - 1].len += len;
+        return;
+    }
+    /* ** is * */
+    if (kind == ELEM_STAR && p->nelems > 0 && p->elems[p->nelems - 1].kind == ELEM_STAR)
+        return;
+    if (p->nelems == *cap) {
+        *cap = *cap ? 2 * *cap : 8;
+        p->elems = realloc(p->elems, *cap * sizeof *p->elems);
+        if (p->elems == NULL)
+            utils_fatal_error("Could not compile pattern: ");
+    }
+    p->elems[p->nelems++] = (struct elem) { kind, arg, len };
+}
+
+/* Fill in the matcher of p, or of its reverse. */
+static void
+build_shift_and(const struct pattern *p, struct shift_and *sa, bool reverse)
+{
+    memset(sa, 0, sizeof *sa);
+    size_t pos = 0;
+    for (size_t k = 0; k < p->nelems; k++) {
+        const struct elem *el = &p->elems[reverse ? p->nelems - 1 - k : k];
+        switch (el->kind) {
+        case ELEM_STAR:
+            if (pos == 0)
+                sa->lead = true;
+            else
+                sa->loops |= (uint64_t) 1 << (pos - 1);
+            break;
+        case ELEM_LITERAL:
+            for (uint32_t j = 0; j < el->len; j++) {
+                unsigned char c = p->lit[el->arg + (reverse ? el->len - 1 - j : j)];
+                sa->masks[c] |= (uint64_t) 1 << pos++;
+            }
+            break;
+        case ELEM_ANY:
+        case ELEM_SET:
+            for (int c = 0; c < 256; c++)
+                if (el->kind == ELEM_ANY || set_has(&p->sets[el->arg], c))
+                    sa->masks[c] |= (uint64_t) 1 << pos;
+            pos++;
+            break;
+        }
+    }
+}
+
+struct pattern *
+pattern_compile(const char *s, size_t len, int flags)
+{
+    struct pattern *p = calloc(1, sizeof *p);
+    if (p == NULL || (p->lit = malloc(len + 1)) == NULL)
+        utils_fatal_error("Could not compile pattern: ");
+    p->flags = flags;
+
+    size_t cap = 0, nlit = 0;
+    for (size_t i = 0; i < len; ) {
+        char c = s[i];
+        if (c == '*') {
+            add_elem(p, &cap, ELEM_STAR, 0, 0);
+            i++;
+        } else if (c == '?') {
+            add_elem(p, &cap, ELEM_ANY, 0, 0);
+            i++;
+        } else if (c == '[') {
+            struct byteset set;
+            size_t end = parse_set(s, len, i, &set);
+            if (end == 0) {
+                p->lit[nlit] = c;
+                add_elem(p, &cap, ELEM_LITERAL, nlit++, 1);
+                i++;
+                continue;
+            }
+            p->sets = realloc(p->sets, (p->nsets + 1) * sizeof *p->sets);
+            if (p->sets == NULL)
+                utils_fatal_error("Could not compile pattern: ");
+            p->sets[p->nsets] = set;
+            add_elem(p, &cap, ELEM_SET, p->nsets++, 1);
+            i = end;
+        } else {
+            if (c == '\\' && i + 1 < len)
+                c = s[++i];
+            p->lit[nlit] = c;
+            add_elem(p, &cap, ELEM_LITERAL, nlit++, 1);
+            i++;
+        }
+    }
+
+    for (size_t k = 0; k < p->nelems; k++)
+        p->npos += p->elems[k].kind == ELEM_LITERAL ? p->elems[k].len
+                 : p->elems[k].kind != ELEM_STAR;
+    if (p->npos <= SHIFT_AND_MAX) {
+        if ((p->sa = malloc(2 * sizeof *p->sa)) == NULL)
+            utils_fatal_error("Could not compile pattern: ");
+        build_shift_and(p, &p->sa[0], false);
+        build_shift_and(p, &p->sa[1], true);
+    }
+    return p;
+}
+
+/* The state after reading byte c in state d; start is set if nothing
+ * was read, or the pattern starts with a *. */
+static inline uint64_t
+shift_and_step(const struct shift_and *sa, uint64_t d, bool start, unsigned char c)
+{
+    return (((d << 1) | start) & sa->masks[c]) | (d & sa->loops);
+}
+
+/* Is the pattern matched in state d, after reading n bytes? */
+static inline bool
+shift_and_accepts(const struct pattern *p, const struct shift_and *sa, uint64_t d, size_t n)
+{
+    if (p->npos == 0)
+        return n == 0 || sa->lead;
+    return d >> (p->npos - 1) & 1;
+}
+
+/* Match the len bytes at s, read backwards if reverse, against p,
+ * which has a matcher.  If prefix is set, the bytes need only start
+ * with a match; the length of the shortest, or if longest is set the
+ * longest, is stored in *n.  Returns whether there is a match. */
+static bool
+shift_and_match(const struct pattern *p, const char *s, size_t len, bool reverse,
+                bool prefix, bool longest, size_t *n)
+{
+    const struct shift_and *sa = &p->sa[reverse];
+    const unsigned char *u = (const unsigned char *) s;
+    uint64_t d = 0;
+    bool found = false;
+    for (size_t i = 0; ; i++) {
+        if (prefix && shift_and_accepts(p, sa, d, i)) {
+            *n = i;
+            found = true;
+            if (!longest)
+                break;
+        }
+        if (i == len)
+            return prefix ? found : shift_and_accepts(p, sa, d, i);
+        d = shift_and_step(sa, d, i == 0 || sa->lead, u[reverse ? len - 1 - i : i]);
+        if (d == 0 && !sa->lead)
+            break;
+    }
+    return found;
+}
+
+/* Match the len bytes at s against p, by backtracking to the last *. */
+static bool
+backtrack_match(const struct pattern *p, const char *s, size_t len)
+{
+    size_t e = 0, pos = 0;
+    size_t star = SIZE_MAX, starpos = 0;    /* the element after the last *, and
+                                               where the * stopped */
+    for (;;) {
+        if (e < p->nelems) {
+            const struct elem *el = &p->elems[e];
+            switch (el->kind) {
+            case ELEM_STAR:
+                if (++e == p->nelems)
+                    return true;
+                star = e;
+                starpos = pos;
+                continue;
+            case ELEM_LITERAL:
+                if (len - pos >= el->len && memcmp(s + pos, p->lit + el->arg, el->len) == 0) {
+                    pos += el->len;
+                    e++;
+                    continue;
+                }
+                break;
+            case ELEM_ANY:
+                if (pos < len) {
+                    pos++;
+                    e++;
+                    continue;
+                }
+                break;
+            case ELEM_SET:
+                if (pos < len && set_has(&p->sets[el->arg], s[pos])) {
+                    pos++;
+                    e++;
+                    continue;
+                }
+                break;
+            }
+        } else if (pos == len) {
+            return true;
+        }
+
+        /* let the last * absorb one more byte */
+        if (star == SIZE_MAX || starpos == len)
+            return false;
+        e = star;
+        pos = ++starpos;
+    }
+}
+
+bool
+pattern_match(const struct pattern *p, const char *s, size_t len)
+{
+    /* only a literal . matches a leading one */
+    if ((p->flags & PATTERN_PERIOD) && len > 0 && s[0] == '.'
+        && (p->nelems == 0 || p->elems[0].kind != ELEM_LITERAL || p->lit[p->elems[0].arg] != '.'))
+        return false;
+
+    if (p->nelems == 1 && p->elems[0].kind == ELEM_LITERAL)
+        return len == p->elems[0].len && memcmp(s, p->lit, len) == 0;
+    if (p->sa != NULL)
+        return shift_and_match(p, s, len, false, false, false, NULL);
+    return backtrack_match(p, s, len);
+}
+
+bool
+pattern_prefix(const struct pattern *p, const char *s, size_t len, bool longest, size_t *n)
+{
+    if (p->sa != NULL)
+        return shift_and_match(p, s, len, false, true, longest, n);
+    for (size_t k = 0; k <= len; k++) {
+        size_t m = longest ? len - k : k;
+        if (backtrack_match(p, s, m)) {
+            *n = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+pattern_suffix(const struct pattern *p, const char *s, size_t len, bool longest, size_t *n)
+{
+    if (p->sa != NULL)
+        return shift_and_match(p, s, len, true, true, longest, n);
+    for (size_t k = 0; k <= len; k++) {
+        size_t m = longest ? len - k : k;
+        if (backtrack_match(p, s + len - m, m)) {
+            *n = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+pattern_free(struct pattern *p)
+{
+    if (p == NULL)
+        return;
+    free(p->elems);
+    free(p->lit);
+    free(p->sets);
+    free(p->sa);
+    free(p);
+}
+
+bool
+pattern_has_magic(const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        switch (s[i]) {
+        case '\\':
+            i++;
+            break;
+        case '*':
+        case '?':
+            return true;
+        case '[': {
+            struct byteset set;
+            if (parse_set(s, len, i, &set) != 0)
+                return true;
+            break;
+        }
+        }
+    }
+    return false;
+}
+
+size_t
+pattern_unquote(const char *s, size_t len, char *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\\' && i + 1 < len)
+            i++;
+        out[n++] = s[i];
+    }
+    return n;
+}
@@ -0,0 +1,49 @@
+#ifndef __PATTERN_H
+#define __PATTERN_H
+/*
+ * Shell patterns, as used in pathname expansion, case, [[ == ]], and
+ * ${name#pattern}.
+ *
+ * A pattern is compiled once into a sequence of elements: literal
+ * runs, ?, *, and bracket expressions, each of which is a set of 256
+ * bytes.  A backslash quotes the character that follows it; quoted
+ * pattern characters match themselves.  Patterns of up to 64 bytes
+ * other than stars are matched in a single pass over the string,
+ * without backtracking.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Compile flags */
+#define PATTERN_PERIOD  1   /* a leading . must be matched by a literal ., as
+                               in the components of pathnames */
+
+struct pattern;
+
+/* Compile the len bytes of pattern at s. */
+struct pattern *pattern_compile(const char *s, size_t len, int flags);
+
+/* Does p match all len bytes at s? */
+bool pattern_match(const struct pattern *p, const char *s, size_t len);
+
+/*
+ * Does p match a prefix (a suffix) of the len bytes at s?  If so, the
+ * length of the shortest, or if longest is set the longest, such
+ * prefix (suffix) is stored in *n.
+ */
+bool pattern_prefix(const struct pattern *p, const char *s, size_t len, bool longest,
+                    size_t *n);
+bool pattern_suffix(const struct pattern *p, const char *s, size_t len, bool longest,
+                    size_t *n);
+
+void pattern_free(struct pattern *p);
+
+/* Do the len bytes at s contain an unquoted *, ?, or [...], without
+ * which a pattern only matches itself? */
+bool pattern_has_magic(const char *s, size_t len);
+
+/* Copy the len bytes of pattern at s to out, removing the backslashes
+ * that quote characters; returns the length of the result. */
+size_t pattern_unquote(const char *s, size_t len, char *out);
+
+#endif /* __PATTERN_H */
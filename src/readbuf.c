@@ -0,0 +1,261 @@
+/*
+ * Buffered input for the read and mapfile builtins, see readbuf.h.
+ */
+#define _GNU_SOURCE    1
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "readbuf.h"
+#include "utils.h"
+
+enum readbuf_kind {
+    READBUF_NONE,           /* nothing is buffered, the descriptor is yet to be looked at */
+    READBUF_SEEKABLE,
+    READBUF_PIPE,
+    READBUF_UNBUFFERED,
+};
+
+struct readbuf {
+    enum readbuf_kind kind;
+    char *buf;
+    size_t cap;
+    size_t pos, end;        /* buf[pos .. end) are read but not consumed */
+    size_t chunk;           /* bytes to read next */
+};
+
+static struct readbuf *bufs;            /* indexed by descriptor */
+static int nbufs;
+static int nactive;                     /* of bufs whose kind is not READBUF_NONE */
+
+/* The private pipe pipes are peeked into, and the process it belongs
+ * to, as a forked child must not share its parent's. */
+static int peek_fds[2] = { -1, -1 };
+static pid_t peek_owner;
+
+static struct readbuf *
+get_readbuf(int fd)
+{
+    if (fd >= nbufs) {
+        int n = nbufs ? nbufs : 16;
+        while (n <= fd)
+            n *= 2;
+        if ((bufs = realloc(bufs, n * sizeof *bufs)) == NULL)
+            utils_fatal_error("Could not allocate input buffers: ");
+        memset(bufs + nbufs, 0, (n - nbufs) * sizeof *bufs);
+        nbufs = n;
+    }
+    return &bufs[fd];
+}
+
+/* Move fd out of the way of redirections, like the shell's copies of
+ * redirected descriptors. */
+static int
+move_high(int fd)
+{
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    close(fd);
+    return high;
+}
+
+/* Make peek_fds this process's private pipe; returns false if it
+ * cannot be created. */
+static bool
+open_peek_pipe(void)
+{
+    pid_t self = getpid();
+    if (peek_fds[0] != -1 && peek_owner == self)
+        return true;
+    if (peek_fds[0] != -1) {
+        close(peek_fds[0]);
+        close(peek_fds[1]);
+        peek_fds[0] = peek_fds[1] = -1;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        return false;
+    peek_fds[0] = move_high(fds[0]);
+    peek_fds[1] = move_high(fds[1]);
+    if (peek_fds[0] == -1 || peek_fds[1] == -1) {
+        close(peek_fds[0]);
+        close(peek_fds[1]);
+        peek_fds[0] = peek_fds[1] = -1;
+        return false;
+    }
+    peek_owner = self;
+    return true;
+}
+
+static ssize_t
+read_retrying(int fd, char *buf, size_t len)
+{
+    ssize_t n;
+    while ((n = read(fd, buf, len)) == -1 && errno == EINTR)
+        continue;
+    return n;
+}
+
+/* Read from a pipe the bytes consumed since it was last peeked at,
+ * which are still in it. */
+static void
+drain(struct readbuf *rb, int fd)
+{
+    size_t left = rb->pos;
+    while (left > 0) {
+        ssize_t n = read_retrying(fd, rb->buf, left);
+        if (n <= 0)
+            break;
+        left -= n;
+    }
+    rb->pos = rb->end = 0;
+}
+
+/* Peek at what is in the pipe fd; returns the number of bytes now
+ * buffered, 0 at end of file, or -1 with errno set. */
+static ssize_t
+peek_pipe(struct readbuf *rb, int fd)
+{
+    drain(rb, fd);
+    if (!open_peek_pipe())
+        return -1;
+    ssize_t n;
+    while ((n = tee(fd, peek_fds[1], rb->chunk, 0)) == -1 && errno == EINTR)
+        continue;
+    if (n <= 0)
+        return n;
+    for (ssize_t got = 0; got < n; ) {
+        ssize_t m = read_retrying(peek_fds[0], rb->buf + got, n - got);
+        if (m <= 0)
+            utils_fatal_error("Could not read from private pipe: ");
+        got += m;
+    }
+    return n;
+}
+
+/* Read more into rb, whose bytes are all consumed. */
+static ssize_t
+fill(struct readbuf *rb, int fd)
+{
+    if (rb->cap < rb->chunk) {
+        if ((rb->buf = realloc(rb->buf, rb->chunk)) == NULL)
+            utils_fatal_error("Could not allocate input buffer: ");
+        rb->cap = rb->chunk;
+    }
+
+    ssize_t n;
+    switch (rb->kind) {
+    case READBUF_PIPE:
+        n = peek_pipe(rb, fd);
+        if (n != -1 || errno != EINVAL)
+            break;
+        /* e.g., the pipe is in non-blocking mode */
+        rb->kind = READBUF_UNBUFFERED;
+        /* fall through */
+    case READBUF_UNBUFFERED:
+        n = read_retrying(fd, rb->buf, 1);
+        break;
+    default:
+        n = read_retrying(fd, rb->buf, rb->chunk);
+        break;
+    }
+    rb->pos = 0;
+    rb->end = n > 0 ? n : 0;
+    if (rb->chunk < READBUF_MAX)
+        rb->chunk *= 2;
+    return n;
+}
+
+ssize_t
+readbuf_peek(int fd, const char **p)
+{
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    struct readbuf *rb = get_readbuf(fd);
+    if (rb->pos == rb->end) {
+        if (rb->kind == READBUF_NONE) {
+            struct stat st;
+            if (fstat(fd, &st) == -1)
+                return -1;
+            if (S_ISREG(st.st_mode))
+                rb->kind = READBUF_SEEKABLE;
+            else if (S_ISFIFO(st.st_mode))
+                rb->kind = READBUF_PIPE;
+            else
+                rb->kind = READBUF_UNBUFFERED;
+            rb->chunk = READBUF_MIN;
+            nactive++;
+        }
+        ssize_t n = fill(rb, fd);
+        if (n <= 0)
+            return n;
+    }
+    *p = rb->buf + rb->pos;
+    return rb->end - rb->pos;
+}
+
+void
+readbuf_consume(int fd, size_t n)
+{
+    bufs[fd].pos += n;
+}
+
+char *
+readbuf_slurp(int fd, size_t *len)
+{
+    readbuf_sync(fd);
+    size_t cap = READBUF_MAX, n = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t at = lseek(fd, 0, SEEK_CUR);
+        /* and a byte more, to see the end of the file */
+        if (at != -1 && st.st_size >= at)
+            cap = st.st_size - at + 1;
+    }
+    char *buf = malloc(cap);
+    if (buf == NULL)
+        utils_fatal_error("Could not allocate input buffer: ");
+    for (;;) {
+        if (n == cap && (buf = realloc(buf, cap *= 2)) == NULL)
+            utils_fatal_error("Could not allocate input buffer: ");
+        ssize_t m = read_retrying(fd, buf + n, cap - n);
+        if (m == -1) {
+            int err = errno;
+            free(buf);
+            errno = err;
+            return NULL;
+        }
+        if (m == 0)
+            break;
+        n += m;
+    }
+    *len = n;
+    return buf;
+}
+
+void
+readbuf_sync(int fd)
+{
+    if (fd < 0 || fd >= nbufs || bufs[fd].kind == READBUF_NONE)
+        return;
+    struct readbuf *rb = &bufs[fd];
+    if (rb->kind == READBUF_SEEKABLE && rb->end > rb->pos)
+        lseek(fd, -(off_t) (rb->end - rb->pos), SEEK_CUR);
+    else if (rb->kind == READBUF_PIPE)
+        drain(rb, fd);
+    rb->pos = rb->end = 0;
+    rb->kind = READBUF_NONE;
+    nactive--;
+}
+
+void
+readbuf_sync_all(void)
+{
+    for (int fd = 0; nactive > 0 && fd < nbufs; fd++)
+        readbuf_sync(fd);
+}
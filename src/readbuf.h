@@ -0,0 +1,58 @@
+#ifndef __READBUF_H
+#define __READBUF_H
+/*
+ * Buffered input for the read and mapfile builtins.
+ *
+ * Each descriptor read from has a buffer of its own, which is kept
+ * consistent with what the rest of the world sees of the descriptor
+ * by syncing it before anything else can read from the descriptor:
+ * before a process is started, before the descriptor is redirected
+ * or restored, and before the shell exits.
+ *
+ *  - A regular file is read in chunks that grow to READBUF_MAX; a
+ *    sync seeks back over the bytes read but not consumed.
+ *  - A pipe is peeked at with tee(2), into a private pipe from which
+ *    the bytes are then read, so that they stay in the pipe until
+ *    consumed; a sync, or the next peek, reads as many bytes from
+ *    the pipe as were consumed, leaving the rest to whoever reads
+ *    from it next.
+ *  - Anything else, e.g., a terminal or a socket, is read one byte
+ *    at a time, as it cannot be given back.
+ *
+ * A sync drops the buffer, and the next read starts with a small
+ * chunk again, so that a loop that runs a command for every line of
+ * a file does not read far ahead for every line.
+ */
+#include <stddef.h>
+#include <sys/types.h>
+
+#define READBUF_MIN     4096
+#define READBUF_MAX     (256 * 1024)
+
+/*
+ * Point *p at the bytes buffered for fd, reading more if none are,
+ * and return their number, which is 0 at end of file, or -1 with
+ * errno set if the read failed.  The bytes are consumed only by
+ * readbuf_consume.
+ */
+ssize_t readbuf_peek(int fd, const char **p);
+
+/* Consume the first n of the bytes readbuf_peek returned for fd. */
+void readbuf_consume(int fd, size_t n);
+
+/*
+ * Read all that is left to read from fd, including what is buffered
+ * for it, into a single allocation that the caller frees, storing
+ * its size in *len; what is left of a regular file is read into one
+ * of just the right size.  Returns NULL, with errno set, if the read
+ * failed.
+ */
+char *readbuf_slurp(int fd, size_t *len);
+
+/* Give back what is buffered for fd. */
+void readbuf_sync(int fd);
+
+/* Give back what is buffered for any descriptor. */
+void readbuf_sync_all(void);
+
+#endif /* __READBUF_H */
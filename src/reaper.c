@@ -0,0 +1,76 @@
+/*
+ * Reaping of child processes through a signalfd, see reaper.h.
+ */
+#define _GNU_SOURCE    1
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+#include "reaper.h"
+#include "spawn.h"
+#include "utils.h"
+
+static int sigfd = -1;
+static reaper_handler_t reaper_handler;
+
+void
+reaper_init(reaper_handler_t handler)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigfd == -1)
+        utils_fatal_error("Could not create signalfd: ");
+    reaper_handler = handler;
+}
+
+/* Reap every child that has changed state.  Pending SIGCHLDs are
+ * consumed first, so that a child exiting after the waitpid loop
+ * makes sigfd readable again. */
+static void
+reap_children(void)
+{
+    struct signalfd_siginfo info[16];
+    while (read(sigfd, info, sizeof info) > 0)
+        continue;
+
+    pid_t child;
+    int status;
+    while ((child = waitpid(-1, &status, WUNTRACED|WNOHANG)) > 0)
+        reaper_handler(child, status);
+    spawn_collect_statuses(reaper_handler);
+}
+
+bool
+reaper_wait(int fd)
+{
+    /* statuses the zygote sent while a command was being spawned */
+    if (spawn_collect_statuses(reaper_handler))
+        return false;
+
+    /* poll ignores the entries whose fd is -1 */
+    struct pollfd fds[3] = {
+        { .fd = sigfd, .events = POLLIN },
+        { .fd = spawn_status_fd(), .events = POLLIN },
+        { .fd = fd, .events = POLLIN },
+    };
+
+    while (poll(fds, 3, -1) == -1) {
+        if (errno != EINTR)
+            utils_fatal_error("poll failed: ");
+    }
+
+    if ((fds[0].revents | fds[1].revents) != 0)
+        reap_children();
+    return fd != -1 && fds[2].revents != 0;
+}
+
+void
+reaper_poll(void)
+{
+    reap_children();
+}
@@ -0,0 +1,36 @@
+#ifndef __REAPER_H
+#define __REAPER_H
+/*
+ * An event loop for reaping child processes.
+ *
+ * SIGCHLD is received through a signalfd rather than a signal handler,
+ * so waiting for children can be combined with waiting for other file
+ * descriptors, and children are reaped, in the order in which they
+ * changed state, by the main program and not in signal context.
+ * A single signalfd covers all children, however many there are.
+ * Processes started through the spawn zygote are its children; their
+ * statuses arrive over its socket and are handled just the same.
+ *
+ * SIGCHLD must stay blocked from reaper_init on, so that no signal
+ * handler reaps children behind the reaper's back.
+ */
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Called for each child that changed state, with its waitpid status. */
+typedef void (*reaper_handler_t)(pid_t pid, int status);
+
+/* Set up the signalfd; handler is called for every child reaped. */
+void reaper_init(reaper_handler_t handler);
+
+/*
+ * Block until at least one child has changed state or, if fd is not -1,
+ * until fd is readable.  All children that changed state are reaped.
+ * Returns true if fd is readable.
+ */
+bool reaper_wait(int fd);
+
+/* Reap all children that have changed state without blocking. */
+void reaper_poll(void);
+
+#endif /* __REAPER_H */
@@ -0,0 +1,107 @@
+/*
+ * Regular expressions, see regcache.h.
+ *
+ * The cache is a tommy_hashdyn keyed by the text of the regexes, and
+ * a list of its entries from the most to the least recently used,
+ * whose tail is evicted when the cache is full.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "regcache.h"
+#include "utils.h"
+#include "tommyds/tommyhashdyn.h"
+#include "tommyds/tommyhash.h"
+#include "tommyds/tommylist.h"
+
+#define REGEX_CACHE_SIZE    64
+
+struct cached_regex {
+    tommy_node node;        /* in cache */
+    tommy_node lru;         /* in recent */
+    char *text;             /* key */
+    size_t len;
+    struct regex *regex;
+};
+
+static tommy_hashdyn cache;
+static tommy_list recent;
+static size_t ncached;
+static bool initialized;
+
+struct regex *
+regex_compile(const char *s, size_t len)
+{
+    struct regex *re = calloc(1, sizeof *re);
+    char *text = malloc(len + 1);
+    if (re == NULL || text == NULL)
+        utils_fatal_error("Could not compile regex: ");
+    memcpy(text, s, len);
+    text[len] = '\0';
+    re->valid = regcomp(&re->re, text, REG_EXTENDED) == 0;
+    if (re->valid)
+        re->nsub = re->re.re_nsub;
+    free(text);
+    return re;
+}
+
+void
+regex_free(struct regex *re)
+{
+    if (re == NULL)
+        return;
+    if (re->valid)
+        regfree(&re->re);
+    free(re);
+}
+
+struct key {
+    const char *text;
+    size_t len;
+};
+
+static int
+compare_regex(const void *arg, const void *obj)
+{
+    const struct key *key = arg;
+    const struct cached_regex *c = obj;
+    return key->len != c->len || memcmp(key->text, c->text, c->len) != 0;
+}
+
+const struct regex *
+regex_cached(const char *s, size_t len)
+{
+    if (!initialized) {
+        tommy_hashdyn_init(&cache);
+        tommy_list_init(&recent);
+        initialized = true;
+    }
+    struct key key = { s, len };
+    tommy_hash_t hash = tommy_hash_u32(0, s, len);
+    struct cached_regex *c = tommy_hashdyn_search(&cache, compare_regex, &key, hash);
+    if (c != NULL) {
+        tommy_list_remove_existing(&recent, &c->lru);
+        tommy_list_insert_head(&recent, &c->lru, c);
+        return c->regex;
+    }
+
+    if (ncached == REGEX_CACHE_SIZE) {
+        struct cached_regex *old = tommy_list_tail(&recent)->data;
+        tommy_list_remove_existing(&recent, &old->lru);
+        tommy_hashdyn_remove_existing(&cache, &old->node);
+        regex_free(old->regex);
+        free(old->text);
+        free(old);
+        ncached--;
+    }
+    if ((c = malloc(sizeof *c)) == NULL || (c->text = malloc(len + 1)) == NULL)
+        utils_fatal_error("Could not cache regex: ");
+    memcpy(c->text, s, len);
+    c->text[len] = '\0';
+    c->len = len;
+    c->regex = regex_compile(s, len);
+    tommy_hashdyn_insert(&cache, &c->node, c, hash);
+    tommy_list_insert_head(&recent, &c->lru, c);
+    ncached++;
+    return c->regex;
+}
@@ -0,0 +1,33 @@
+#ifndef __REGCACHE_H
+#define __REGCACHE_H
+/*
+ * Regular expressions, as matched by [[ string =~ regex ]].
+ *
+ * A regex is compiled once.  The interpreter keeps the compiled form
+ * of a static regex with the program; those that are only known once
+ * expanded are looked up in a cache of the most recently used ones,
+ * keyed by their text, so a loop that matches against the same $re
+ * compiles it only the first time.
+ */
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct regex {
+    regex_t re;
+    bool valid;             /* it compiled; an invalid regex is an error */
+    size_t nsub;            /* its parenthesized subexpressions */
+};
+
+/* Compile the len bytes at s, in POSIX extended syntax.  The result
+ * is never NULL, but may not be valid. */
+struct regex *regex_compile(const char *s, size_t len);
+
+void regex_free(struct regex *re);
+
+/* Return the compiled form of the len bytes at s, from the cache if
+ * it is there.  It belongs to the cache, and remains valid until the
+ * next call. */
+const struct regex *regex_cached(const char *s, size_t len);
+
+#endif /* __REGCACHE_H */
@@ -0,0 +1,279 @@
+/*
+ * The script cache, see scriptcache.h.
+ *
+ * An entry is created as an unnamed file in the cache directory
+ * (O_TMPFILE) and linked under its name only once the script has
+ * run to its end, so entries are never seen partially written, and
+ * a script that is interrupted leaves nothing behind.  An entry
+ * starts with a header recording its key; the images follow.
+ *
+ * The counters live in the file "stats" in the cache directory,
+ * which is mapped shared and updated atomically, so concurrent
+ * invocations count correctly.
+ */
+#define _GNU_SOURCE    1
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scriptcache.h"
+#include "tommyds/tommyhash.h"
+#include "utils.h"
+
+#define CACHE_MAGIC 0x4353424d      /* "MBSC" */
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t nprogs;
+    uint64_t key[2];
+    uint64_t size;          /* of the script */
+};
+
+/* The counters in the stats file. */
+struct cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+struct script_cache {
+    char *path;             /* of the entry */
+    int fd;                 /* of the new entry on a miss, else -1 */
+    bool failed;            /* writing the new entry failed */
+    struct cache_header header;
+    char *map;              /* the entry on a hit */
+    size_t mapsize;
+    size_t off;             /* of the next image in map */
+    uint32_t next;          /* index of the next program */
+};
+
+/* Hash what the compiled form of a script depends on besides the
+ * script: the layout of the IR, how scripts are split into programs,
+ * and the grammar. */
+static uint64_t
+version_hash(const TSLanguage *lang)
+{
+    uint32_t counts[] = {
+        IR_VERSION, ts_language_abi_version(lang),
+        ts_language_symbol_count(lang), ts_language_field_count(lang),
+    };
+    uint64_t h = tommy_hash_u64(0, counts, sizeof counts);
+    for (uint32_t i = 0; i < counts[2]; i++) {
+        const char *name = ts_language_symbol_name(lang, i);
+        if (name != NULL)
+            h = tommy_hash_u64(h, name, strlen(name) + 1);
+    }
+    for (uint32_t i = 1; i <= counts[3]; i++) {
+        const char *name = ts_language_field_name_for_id(lang, i);
+        if (name != NULL)
+            h = tommy_hash_u64(h, name, strlen(name) + 1);
+    }
+    return h;
+}
+
+/* Compute a 128-bit key from two 64-bit hashes with different seeds. */
+static void
+compute_key(uint64_t key[2], const TSLanguage *lang, const char *text, size_t size)
+{
+    uint64_t version = version_hash(lang);
+    key[0] = tommy_hash_u64(version, text, size);
+    key[1] = tommy_hash_u64(~version, text, size);
+}
+
+static void
+count(const char *dir, bool hit)
+{
+    char *path;
+    if (asprintf(&path, "%s/stats", dir) == -1)
+        return;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    free(path);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0
+        && (st.st_size >= (off_t) sizeof(struct cache_stats)
+            || ftruncate(fd, sizeof(struct cache_stats)) == 0)) {
+        struct cache_stats *stats = mmap(NULL, sizeof *stats, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED, fd, 0);
+        if (stats != MAP_FAILED) {
+            __atomic_add_fetch(hit ? &stats->hits : &stats->misses, 1, __ATOMIC_RELAXED);
+            munmap(stats, sizeof *stats);
+        }
+    }
+    close(fd);
+}
+
+bool
+script_cache_stats(const char *dir, uint64_t *hits, uint64_t *misses)
+{
+    char *path;
+    if (asprintf(&path, "%s/stats", dir) == -1)
+        return false;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    if (fd == -1)
+        return false;
+
+    struct cache_stats stats;
+    bool ok = pread(fd, &stats, sizeof stats, 0) == sizeof stats;
+    close(fd);
+    if (ok) {
+        *hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+        *misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    }
+    return ok;
+}
+
+/* Map the entry at c->path; return false unless it is one for the
+ * key in c->header and all its images are valid. */
+static bool
+map_entry(struct script_cache *c)
+{
+    int fd = open(c->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(struct cache_header)) {
+        close(fd);
+        return false;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    struct cache_header h;
+    memcpy(&h, map, sizeof h);
+    bool valid = h.magic == CACHE_MAGIC && h.size == c->header.size
+        && memcmp(h.key, c->header.key, sizeof h.key) == 0;
+
+    /* check all images now so that none fails after others ran */
+    size_t off = sizeof h;
+    for (uint32_t i = 0; valid && i < h.nprogs; i++) {
+        size_t size;
+        struct ir_program *prog = ir_load(map + off, st.st_size - off, &size);
+        valid = prog != NULL;
+        if (valid) {
+            ir_free(prog);
+            off += size;
+        }
+    }
+    if (!valid || off != (size_t) st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    c->map = map;
+    c->mapsize = st.st_size;
+    c->off = sizeof h;
+    c->header.nprogs = h.nprogs;
+    return true;
+}
+
+static bool
+write_fully(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+struct script_cache *
+script_cache_open(const char *dir, const TSLanguage *lang, const char *text, size_t size)
+{
+    struct script_cache *c = calloc(1, sizeof *c);
+    if (c == NULL)
+        utils_fatal_error("Could not allocate script cache: ");
+    c->fd = -1;
+    c->header.magic = CACHE_MAGIC;
+    c->header.size = size;
+    compute_key(c->header.key, lang, text, size);
+    if (asprintf(&c->path, "%s/%016llx%016llx.ir", dir,
+                 (unsigned long long) c->header.key[0],
+                 (unsigned long long) c->header.key[1]) == -1) {
+        free(c);
+        return NULL;
+    }
+
+    if (map_entry(c)) {
+        count(dir, true);
+        return c;
+    }
+
+    c->fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    if (c->fd == -1) {
+        free(c->path);
+        free(c);
+        return NULL;
+    }
+    c->failed = !write_fully(c->fd, &c->header, sizeof c->header);
+    count(dir, false);
+    return c;
+}
+
+bool
+script_cache_hit(const struct script_cache *c)
+{
+    return c->map != NULL;
+}
+
+struct ir_program *
+script_cache_next(struct script_cache *c)
+{
+    if (c->next == c->header.nprogs)
+        return NULL;
+    size_t size;
+    struct ir_program *prog = ir_load(c->map + c->off, c->mapsize - c->off, &size);
+    c->off += size;
+    c->next++;
+    return prog;
+}
+
+void
+script_cache_add(struct script_cache *c, const struct ir_program *prog)
+{
+    if (c->failed)
+        return;
+    size_t size;
+    void *image = ir_image(prog, &size);
+    c->failed = !write_fully(c->fd, image, size);
+    free(image);
+    c->header.nprogs++;
+}
+
+void
+script_cache_close(struct script_cache *c, bool complete)
+{
+    if (c->map != NULL)
+        munmap(c->map, c->mapsize);
+
+    if (c->fd != -1) {
+        if (complete && !c->failed
+            && pwrite(c->fd, &c->header, sizeof c->header, 0) == sizeof c->header) {
+            /* publish the entry; if another invocation was first, keep its */
+            char *proc;
+            if (asprintf(&proc, "/proc/self/fd/%d", c->fd) != -1) {
+                linkat(AT_FDCWD, proc, AT_FDCWD, c->path, AT_SYMLINK_FOLLOW);
+                free(proc);
+            }
+        }
+        close(c->fd);
+    }
+    free(c->path);
+    free(c);
+}
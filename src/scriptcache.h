@@ -0,0 +1,52 @@
+#ifndef __SCRIPTCACHE_H
+#define __SCRIPTCACHE_H
+/*
+ * A persistent cache of compiled scripts.
+ *
+ * The cache is a directory holding one file per script, named by a
+ * hash of the script's contents, of the IR version, and of the
+ * grammar the script was parsed with.  The file holds the images
+ * (see ir_image) of the programs the script was compiled into, in
+ * the order in which they ran.  On a hit, the file is mapped and the
+ * programs are run from the mapping without parsing anything.
+ *
+ * The directory must be writable only by those trusted to supply
+ * the programs that run; images are checked for consistency, not
+ * for authenticity.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tree_sitter/api.h>
+
+#include "ir.h"
+
+struct script_cache;
+
+/*
+ * Look up the script of size bytes at text, compiled with the
+ * grammar lang, in the cache directory dir, counting a hit or a
+ * miss.  Return NULL if dir cannot be used.
+ */
+struct script_cache *script_cache_open(const char *dir, const TSLanguage *lang,
+                                       const char *text, size_t size);
+
+/* Was the script found? */
+bool script_cache_hit(const struct script_cache *c);
+
+/* On a hit, return the script's next program, to be freed with
+ * ir_free, or NULL after the last one. */
+struct ir_program *script_cache_next(struct script_cache *c);
+
+/* On a miss, append prog to the script's entry. */
+void script_cache_add(struct script_cache *c, const struct ir_program *prog);
+
+/* Done with c.  On a miss, the entry is added to the cache if
+ * complete, that is, if every program of the script was added. */
+void script_cache_close(struct script_cache *c, bool complete);
+
+/* Retrieve the counters of the cache directory dir; return false if
+ * it has none. */
+bool script_cache_stats(const char *dir, uint64_t *hits, uint64_t *misses);
+
+#endif /* __SCRIPTCACHE_H */
@@ -0,0 +1,744 @@
+/*
+ * Starting external commands, see spawn.h.
+ *
+ * The clone and fork backends run the same trampoline in the child.
+ * A clone child shares the memory of its parent, which is suspended
+ * until the child execs or exits, so the trampoline makes nothing but
+ * system calls.  Signals are blocked around the clone so that none of
+ * the shell's handlers can run in the child before it has reset them;
+ * glibc's posix_spawn does the same.
+ *
+ * The zygote talks to the shell over a SOCK_SEQPACKET socket pair.
+ * A request carries the descriptors the child gets from the shell
+ * (SCM_RIGHTS): those a script can name, 0 to 9, that are inheritable,
+ * and those the file actions copy.  The zygote first recreates them
+ * at their numbers in the shell, then performs the request's actions,
+ * then closes those that were close-on-exec in the shell, so that the
+ * child sees what it would have seen had the shell spawned it.  The
+ * zygote answers each request with a ZYGOTE_SPAWNED message and
+ * reports every change of state of its children with a ZYGOTE_STATUS
+ * message; the shell queues the latter until the reaper collects them.
+ * The zygote leaves the leader of the newest process group a zombie,
+ * after reporting its exit, until a request names another group, lest
+ * the group vanish before the rest of a pipeline joins it; the shell
+ * likewise reaps its own children only once a pipeline has started.
+ * The zygote runs in the directory the shell started in.
+ */
+#define _GNU_SOURCE    1
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "spawn.h"
+#include "utils.h"
+
+extern char **environ;
+
+static enum spawn_backend backend = SPAWN_POSIX;
+
+static const char *const backend_names[] = {
+    [SPAWN_POSIX] = "posix",
+    [SPAWN_CLONE] = "clone",
+    [SPAWN_FORK]  = "fork",
+    [SPAWN_ZYGOTE] = "zygote",
+};
+
+#define NBACKENDS (sizeof backend_names / sizeof backend_names[0])
+
+/* The stack of clone children; as the parent waits for each child to
+ * exec, one stack serves them all. */
+#define CLONE_STACK_SIZE (64 * 1024)
+static alignas(16) char clone_stack[CLONE_STACK_SIZE];
+
+/* What the trampoline runs, and how it reports failure. */
+struct trampoline {
+    const struct spawn_request *req;
+    int err;                /* set by the child if it could not exec */
+    int errfd;              /* if not -1, where the child writes err */
+};
+
+/* Reset the dispositions of signals that have handlers. */
+static void
+reset_signals(void)
+{
+    struct sigaction dfl = { .sa_handler = SIG_DFL };
+    for (int sig = 1; sig < NSIG; sig++) {
+        struct sigaction old;
+        if (sigaction(sig, NULL, &old) == 0
+            && old.sa_handler != SIG_IGN && old.sa_handler != SIG_DFL)
+            sigaction(sig, &dfl, NULL);
+    }
+}
+
+static int
+run_trampoline(void *arg)
+{
+    struct trampoline *t = arg;
+    const struct spawn_request *req = t->req;
+
+    reset_signals();
+    if (setpgid(0, req->pgid) == -1)
+        goto fail;
+    for (int i = 0; i < req->nactions; i++) {
+        const struct spawn_action *a = &req->actions[i];
+        if (a->fd == -1)
+            close(a->newfd);
+        else if (a->fd == a->newfd)
+            fcntl(a->fd, F_SETFD, 0);   /* keep it open across exec */
+        else if (dup2(a->fd, a->newfd) == -1)
+            goto fail;
+    }
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    execve(req->file, req->argv, req->envp);
+
+fail:
+    t->err = errno;
+    if (t->errfd != -1)
+        write(t->errfd, &t->err, sizeof t->err);
+    _exit(127);
+}
+
+static int
+spawn_posix(const struct spawn_request *req, pid_t *pid)
+{
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    for (int i = 0; i < req->nactions; i++) {
+        const struct spawn_action *a = &req->actions[i];
+        if (a->fd == -1)
+            posix_spawn_file_actions_addclose(&fa, a->newfd);
+        else
+            posix_spawn_file_actions_adddup2(&fa, a->fd, a->newfd);
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, req->pgid);
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+
+    int err = posix_spawn(pid, req->file, &fa, &attr, req->argv, req->envp);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+    return err;
+}
+
+static int
+spawn_clone(const struct spawn_request *req, pid_t *pid)
+{
+    struct trampoline t = { .req = req, .errfd = -1 };
+    sigset_t all, old;
+    sigfillset(&all);
+    sigprocmask(SIG_SETMASK, &all, &old);
+    pid_t child = clone(run_trampoline, clone_stack + CLONE_STACK_SIZE,
+                        CLONE_VM | CLONE_VFORK | SIGCHLD, &t);
+    int err = child == -1 ? errno : t.err;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    if (err != 0) {
+        if (child != -1)
+            waitpid(child, NULL, 0);
+        return err;
+    }
+    *pid = child;
+    return 0;
+}
+
+static int
+spawn_fork(const struct spawn_request *req, pid_t *pid)
+{
+    /* the write end is closed by a successful exec */
+    int errpipe[2];
+    if (pipe2(errpipe, O_CLOEXEC) == -1)
+        return errno;
+
+    pid_t child = fork();
+    if (child == 0) {
+        struct trampoline t = { .req = req, .errfd = errpipe[1] };
+        run_trampoline(&t);
+    }
+    int err = child == -1 ? errno : 0;
+    close(errpipe[1]);
+    if (child != -1) {
+        ssize_t n;
+        while ((n = read(errpipe[0], &err, sizeof err)) == -1 && errno == EINTR)
+            continue;
+        if (n != sizeof err)
+            err = 0;
+        else
+            waitpid(child, NULL, 0);
+    }
+    close(errpipe[0]);
+
+    if (err == 0)
+        *pid = child;
+    return err;
+}
+
+/*
+ * The zygote.
+ */
+#define ZYGOTE_MAX_MSG (128 * 1024)     /* larger requests are spawned directly */
+#define ZYGOTE_MAX_FDS (10 + 64)
+#define ZYGOTE_SCRIPT_FDS 10            /* 0 to 9 */
+
+struct zygote_request {
+    int32_t pgid;
+    uint32_t nfds;          /* followed by struct zygote_fd fds[nfds], */
+    uint32_t nactions;      /* struct spawn_action actions[nactions], */
+    uint32_t argc, envc;    /* and the file, argv and envp strings */
+};
+
+/* A descriptor passed along with a request. */
+struct zygote_fd {
+    int32_t fd;             /* its number in the shell */
+    int32_t cloexec;        /* it was close-on-exec in the shell */
+};
+
+enum zygote_reply_kind {
+    ZYGOTE_SPAWNED,         /* value is 0 or the error number */
+    ZYGOTE_STATUS,          /* value is the wait status of pid */
+};
+
+struct zygote_reply {
+    int32_t kind;
+    int32_t pid;
+    int32_t value;
+};
+
+/* The zygote's children. */
+struct zygote_child {
+    pid_t pid;
+    bool reported;          /* its exit was reported, it is still a zombie */
+};
+
+static struct zygote_child *children;
+static size_t nchildren, capchildren;
+static pid_t leader;        /* of the newest process group, not reaped */
+
+static int zygote_sock = -1;    /* the shell's end, -1 if there is no zygote */
+
+/* Statuses received, but not yet collected. */
+static struct zygote_reply *queued;
+static size_t nqueued, capqueued;
+
+/* Send msg with the descriptors fds[0 .. nfds). */
+static bool
+send_with_fds(int sock, const void *msg, size_t len, const int *fds, int nfds)
+{
+    struct iovec iov = { (void *) msg, len };
+    union {
+        char buf[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1 };
+    if (nfds > 0) {
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+        memcpy(CMSG_DATA(cm), fds, nfds * sizeof(int));
+    }
+
+    ssize_t n;
+    while ((n = sendmsg(sock, &mh, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+        continue;
+    return n == (ssize_t) len;
+}
+
+/* Send the zygote's answer; if the shell is gone, so is the zygote. */
+static void
+zygote_reply(int sock, enum zygote_reply_kind kind, pid_t pid, int value)
+{
+    struct zygote_reply r = { kind, pid, value };
+    if (!send_with_fds(sock, &r, sizeof r, NULL, 0))
+        _exit(0);
+}
+
+/* The wait status waitpid would have returned for what info reports. */
+static int
+wait_status(const siginfo_t *info)
+{
+    switch (info->si_code) {
+    case CLD_EXITED:
+        return W_EXITCODE(info->si_status, 0);
+    case CLD_KILLED:
+        return info->si_status;
+    case CLD_DUMPED:
+        return info->si_status | WCOREFLAG;
+    default:
+        return W_STOPCODE(info->si_status);
+    }
+}
+
+/* Report the children that changed state, reaping all but leader. */
+static void
+reap_zygote_children(int sock)
+{
+    for (size_t i = 0; i < nchildren; ) {
+        struct zygote_child *c = &children[i];
+        siginfo_t info = { .si_pid = 0 };
+        if (c->pid == leader) {
+            /* report its exit but leave it a zombie */
+            if (!c->reported
+                && waitid(P_PID, c->pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0
+                && info.si_pid != 0) {
+                c->reported = true;
+                zygote_reply(sock, ZYGOTE_STATUS, c->pid, wait_status(&info));
+            } else if (!c->reported
+                       && waitid(P_PID, c->pid, &info, WSTOPPED | WNOHANG) == 0
+                       && info.si_pid != 0)
+                zygote_reply(sock, ZYGOTE_STATUS, c->pid, wait_status(&info));
+            i++;
+            continue;
+        }
+
+        int status;
+        if (waitpid(c->pid, &status, WUNTRACED | WNOHANG) <= 0) {
+            i++;
+            continue;
+        }
+        if (!c->reported)
+            zygote_reply(sock, ZYGOTE_STATUS, c->pid, status);
+        if (WIFSTOPPED(status))
+            i++;
+        else
+            *c = children[--nchildren];
+    }
+}
+
+static void
+close_fds(const int *fds, int nfds)
+{
+    for (int i = 0; i < nfds; i++)
+        close(fds[i]);
+}
+
+/* Carry out the request of len bytes in msg, whose descriptors are
+ * fds[0 .. nfds), and answer it. */
+static void
+zygote_spawn(int sock, char *msg, size_t len, int *fds, int nfds)
+{
+    struct zygote_request h;
+    memcpy(&h, msg, sizeof h);
+    const struct zygote_fd *zfds = (const void *) (msg + sizeof h);
+    const struct spawn_action *actions = (const void *) (zfds + h.nfds);
+    char *s = (char *) (actions + h.nactions);
+    if ((int) h.nfds != nfds || h.nactions > ZYGOTE_MAX_FDS || s > msg + len) {
+        zygote_reply(sock, ZYGOTE_SPAWNED, 0, EINVAL);
+        close_fds(fds, nfds);
+        return;
+    }
+
+    char *argv[h.argc + 1], *envp[h.envc + 1];
+    const char *file = s;
+    s += strlen(s) + 1;
+    for (uint32_t i = 0; i < h.argc; i++, s += strlen(s) + 1)
+        argv[i] = s;
+    argv[h.argc] = NULL;
+    for (uint32_t i = 0; i < h.envc; i++, s += strlen(s) + 1)
+        envp[i] = s;
+    envp[h.envc] = NULL;
+
+    /* move what was received above every number the child uses */
+    int low = ZYGOTE_SCRIPT_FDS;
+    for (int i = 0; i < nfds; i++)
+        if (zfds[i].fd >= low)
+            low = zfds[i].fd + 1;
+    for (uint32_t i = 0; i < h.nactions; i++)
+        if (actions[i].newfd >= low)
+            low = actions[i].newfd + 1;
+    for (int i = 0; i < nfds; i++) {
+        int fd = fcntl(fds[i], F_DUPFD_CLOEXEC, low);
+        close(fds[i]);
+        fds[i] = fd;
+    }
+
+    struct spawn_action all[2 * nfds + 3 + h.nactions];
+    int n = 0;
+    bool given[3] = { false, false, false };
+    for (int i = 0; i < nfds; i++) {
+        all[n++] = (struct spawn_action) { fds[i], zfds[i].fd };
+        if (zfds[i].fd < 3)
+            given[zfds[i].fd] = true;
+    }
+    for (int fd = 0; fd < 3; fd++)
+        if (!given[fd])
+            all[n++] = (struct spawn_action) { -1, fd };    /* the zygote's own */
+    memcpy(all + n, actions, h.nactions * sizeof *actions);
+    n += h.nactions;
+    for (int i = 0; i < nfds; i++) {
+        bool target = false;
+        for (uint32_t j = 0; j < h.nactions; j++)
+            target |= actions[j].newfd == zfds[i].fd;
+        if (zfds[i].cloexec && !target)
+            all[n++] = (struct spawn_action) { -1, zfds[i].fd };
+    }
+
+    struct spawn_request req = {
+        .file = file, .argv = argv, .envp = envp, .pgid = h.pgid,
+        .actions = all, .nactions = n,
+    };
+    if (leader != 0 && h.pgid != leader) {
+        leader = 0;
+        reap_zygote_children(sock);
+    }
+    pid_t pid = 0;
+    int err = spawn_posix(&req, &pid);
+    if (err == 0) {
+        if (nchildren == capchildren) {
+            capchildren = capchildren ? 2 * capchildren : 16;
+            children = realloc(children, capchildren * sizeof *children);
+            if (children == NULL)
+                _exit(1);
+        }
+        children[nchildren++] = (struct zygote_child) { pid, false };
+        if (h.pgid == 0)
+            leader = pid;
+    }
+    zygote_reply(sock, ZYGOTE_SPAWNED, pid, err);
+    close_fds(fds, nfds);
+}
+
+/* The zygote's main loop: serve requests and report on children
+ * until the shell closes its end. */
+static void
+zygote_main(int sock)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    int sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    /* hold on to none of the shell's standard descriptors */
+    int null = open("/dev/null", O_RDWR);
+    for (int fd = 0; fd < 3; fd++)
+        dup2(null, fd);
+    if (null > 2)
+        close(null);
+
+    static char msg[ZYGOTE_MAX_MSG];
+    for (;;) {
+        struct pollfd pfds[2] = { { sock, POLLIN, 0 }, { sigfd, POLLIN, 0 } };
+        if (poll(pfds, 2, -1) == -1)
+            continue;
+
+        if (pfds[1].revents & POLLIN) {
+            struct signalfd_siginfo info[16];
+            while (read(sigfd, info, sizeof info) > 0)
+                continue;
+            reap_zygote_children(sock);
+        }
+        if (pfds[0].revents == 0)
+            continue;
+
+        union {
+            char buf[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = { msg, sizeof msg };
+        struct msghdr mh = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = control.buf, .msg_controllen = sizeof control.buf,
+        };
+        ssize_t len = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+        if (len == 0 || (len == -1 && errno != EINTR))
+            _exit(0);
+        if (len < (ssize_t) sizeof(struct zygote_request))
+            continue;
+
+        int fds[ZYGOTE_MAX_FDS], nfds = 0;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm != NULL; cm = CMSG_NXTHDR(&mh, cm))
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                nfds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(fds, CMSG_DATA(cm), nfds * sizeof(int));
+            }
+        zygote_spawn(sock, msg, len, fds, nfds);
+    }
+}
+
+static bool
+start_zygote(void)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+        return false;
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        /* keep out of the way of signals sent to the shell's group */
+        setpgid(0, 0);
+        close(sv[0]);
+        zygote_main(sv[1]);
+    }
+    close(sv[1]);
+    zygote_sock = sv[0];
+    return true;
+}
+
+/* Receive one message from the zygote, queueing it if it is a status;
+ * returns false if none is available and !block. */
+static bool
+receive_reply(struct zygote_reply *r, bool block)
+{
+    ssize_t n;
+    while ((n = recv(zygote_sock, r, sizeof *r, block ? 0 : MSG_DONTWAIT)) == -1
+           && errno == EINTR)
+        continue;
+    if (n != sizeof *r) {
+        if (n == 0 || (n == -1 && errno != EAGAIN))
+            utils_fatal_error("Lost the zygote: ");
+        return false;
+    }
+
+    if (r->kind == ZYGOTE_STATUS) {
+        if (nqueued == capqueued) {
+            capqueued = capqueued ? 2 * capqueued : 16;
+            queued = realloc(queued, capqueued * sizeof *queued);
+            if (queued == NULL)
+                utils_fatal_error("Could not queue child status: ");
+        }
+        queued[nqueued++] = *r;
+    }
+    return true;
+}
+
+/* Add fd, if it is open, to the descriptors sent with a request. */
+static void
+add_request_fd(int fd, struct zygote_fd *zfds, int *fds, uint32_t *nfds, bool inheritable)
+{
+    for (uint32_t i = 0; i < *nfds; i++)
+        if (zfds[i].fd == fd)
+            return;
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1 || (inheritable && (flags & FD_CLOEXEC)))
+        return;
+    zfds[*nfds] = (struct zygote_fd) { fd, (flags & FD_CLOEXEC) != 0 };
+    fds[(*nfds)++] = fd;
+}
+
+static int
+spawn_zygote(const struct spawn_request *req, pid_t *pid)
+{
+    struct zygote_fd zfds[ZYGOTE_MAX_FDS];
+    int fds[ZYGOTE_MAX_FDS];
+    uint32_t nfds = 0;
+    if (req->nactions > ZYGOTE_MAX_FDS - ZYGOTE_SCRIPT_FDS)
+        return spawn_posix(req, pid);
+    for (int fd = 0; fd < ZYGOTE_SCRIPT_FDS; fd++)
+        add_request_fd(fd, zfds, fds, &nfds, true);
+    for (int i = 0; i < req->nactions; i++)
+        if (req->actions[i].fd != -1)
+            add_request_fd(req->actions[i].fd, zfds, fds, &nfds, false);
+
+    struct zygote_request h = { .pgid = req->pgid, .nfds = nfds, .nactions = req->nactions };
+    size_t len = sizeof h + nfds * sizeof *zfds + req->nactions * sizeof *req->actions
+                 + strlen(req->file) + 1;
+    for (char **a = req->argv; *a != NULL; a++, h.argc++)
+        len += strlen(*a) + 1;
+    for (char **e = req->envp; *e != NULL; e++, h.envc++)
+        len += strlen(*e) + 1;
+    if (len > ZYGOTE_MAX_MSG)
+        return spawn_posix(req, pid);
+
+    char *msg = malloc(len), *p = msg;
+    if (msg == NULL)
+        return ENOMEM;
+    memcpy(p, &h, sizeof h);
+    p += sizeof h;
+    memcpy(p, zfds, nfds * sizeof *zfds);
+    p += nfds * sizeof *zfds;
+    if (req->nactions > 0)
+        memcpy(p, req->actions, req->nactions * sizeof *req->actions);
+    p += req->nactions * sizeof *req->actions;
+    p = stpcpy(p, req->file) + 1;
+    for (char **a = req->argv; *a != NULL; a++)
+        p = stpcpy(p, *a) + 1;
+    for (char **e = req->envp; *e != NULL; e++)
+        p = stpcpy(p, *e) + 1;
+
+    /* make room for the zygote's messages so that it cannot block
+     * sending while we block sending to it */
+    struct zygote_reply r;
+    while (receive_reply(&r, false))
+        continue;
+    bool sent = send_with_fds(zygote_sock, msg, len, fds, nfds);
+    free(msg);
+    if (!sent)
+        utils_fatal_error("Could not send to the zygote: ");
+
+    do
+        receive_reply(&r, true);
+    while (r.kind != ZYGOTE_SPAWNED);
+    if (r.value == 0)
+        *pid = r.pid;
+    return r.value;
+}
+
+int
+spawn_status_fd(void)
+{
+    return zygote_sock;
+}
+
+bool
+spawn_collect_statuses(void (*handler)(pid_t pid, int status))
+{
+    if (zygote_sock == -1)
+        return false;
+    struct zygote_reply r;
+    while (receive_reply(&r, false))
+        continue;
+
+    /* the handler may spawn more processes, which may queue more */
+    bool any = nqueued > 0;
+    for (size_t i = 0; i < nqueued; i++)
+        handler(queued[i].pid, queued[i].value);
+    nqueued = 0;
+    return any;
+}
+
+void
+spawn_forget_zygote(void)
+{
+    if (zygote_sock != -1) {
+        close(zygote_sock);
+        zygote_sock = -1;
+        nqueued = 0;
+    }
+    if (backend == SPAWN_ZYGOTE)
+        backend = SPAWN_POSIX;
+}
+
+int
+spawn(const struct spawn_request *req, pid_t *pid)
+{
+    switch (backend) {
+    case SPAWN_CLONE:
+        return spawn_clone(req, pid);
+    case SPAWN_FORK:
+        return spawn_fork(req, pid);
+    case SPAWN_ZYGOTE:
+        return spawn_zygote(req, pid);
+    default:
+        return spawn_posix(req, pid);
+    }
+}
+
+void
+spawn_set_backend(enum spawn_backend b)
+{
+    if (b == SPAWN_ZYGOTE && zygote_sock == -1 && !start_zygote()) {
+        utils_error("Could not start the zygote: ");
+        b = SPAWN_POSIX;
+    }
+    backend = b;
+}
+
+int
+spawn_backend_by_name(const char *name)
+{
+    for (size_t i = 0; i < NBACKENDS; i++)
+        if (strcmp(name, backend_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* Wait for the zygote's child pid to exit, dropping other statuses. */
+static void
+wait_zygote_child(pid_t pid)
+{
+    for (;;) {
+        for (size_t i = 0; i < nqueued; i++)
+            if (queued[i].pid == pid && !WIFSTOPPED(queued[i].value)) {
+                nqueued = 0;
+                return;
+            }
+        nqueued = 0;
+        struct zygote_reply r;
+        receive_reply(&r, true);
+    }
+}
+
+/* Return the average time in microseconds to spawn and reap file. */
+static double
+time_spawns(const char *file, int n)
+{
+    char *argv[] = { (char *) file, NULL };
+    struct spawn_request req = { .file = file, .argv = argv, .envp = environ };
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < n; i++) {
+        pid_t pid;
+        int err = spawn(&req, &pid);
+        if (err != 0) {
+            errno = err;
+            utils_fatal_error("Could not spawn %s: ", file);
+        }
+        if (backend == SPAWN_ZYGOTE)
+            wait_zygote_child(pid);
+        else
+            waitpid(pid, NULL, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / n;
+}
+
+void
+spawn_benchmark(const char *file, FILE *out)
+{
+    static const size_t heap_mb[] = { 0, 64, 256, 1024 };
+    enum { SPAWNS = 200 };
+
+    fprintf(out, "microseconds per spawn of %s\nheap MB", file);
+    for (size_t b = 0; b < NBACKENDS; b++)
+        fprintf(out, "%10s", backend_names[b]);
+    fprintf(out, "\n");
+
+    enum spawn_backend saved = backend;
+    size_t grown = 0;
+    for (size_t i = 0; i < sizeof heap_mb / sizeof heap_mb[0]; i++) {
+        /* grow the heap by touching every page of more memory */
+        size_t more = (heap_mb[i] - grown) << 20;
+        if (more > 0) {
+            char *p = mmap(NULL, more, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                break;
+            memset(p, 1, more);
+            grown = heap_mb[i];
+        }
+
+        fprintf(out, "%7zu", grown);
+        for (size_t b = 0; b < NBACKENDS; b++) {
+            spawn_set_backend(b);
+            fprintf(out, "%10.1f", time_spawns(file, SPAWNS));
+            fflush(out);
+        }
+        fprintf(out, "\n");
+    }
+    backend = saved;
+}
@@ -0,0 +1,87 @@
+#ifndef __SPAWN_H
+#define __SPAWN_H
+/*
+ * Starting external commands.
+ *
+ * A spawn request describes the program to run, its descriptors and
+ * its process group; a backend creates the process:
+ *
+ *  - posix_spawn, the default;
+ *  - clone with CLONE_VM | CLONE_VFORK, whose child runs a small
+ *    trampoline on a stack of its own and shares the shell's memory
+ *    until it execs, so that nothing is copied however large the
+ *    shell grows;
+ *  - fork, which copies the shell's page tables;
+ *  - a zygote, a helper process forked when the backend is selected,
+ *    at startup, while the shell is still small.  The shell sends it
+ *    requests over a socket, passing the descriptors the child needs
+ *    along with them, and the zygote spawns the child and reports
+ *    its pid, and later every change of its state, back.  Processes
+ *    started through the zygote are thus its children rather than
+ *    the shell's; see spawn_collect_statuses.
+ *
+ * Every backend gives the child default signal dispositions and an
+ * empty signal mask, joins it to the process group, then performs
+ * the file actions in order before exec'ing the program.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+enum spawn_backend {
+    SPAWN_POSIX,
+    SPAWN_CLONE,
+    SPAWN_FORK,
+    SPAWN_ZYGOTE,
+};
+
+/* What the child does to its descriptors before exec'ing. */
+struct spawn_action {
+    int fd;                 /* dup'ed to newfd, or -1 to close newfd */
+    int newfd;
+};
+
+struct spawn_request {
+    const char *file;       /* path of the program */
+    char **argv;
+    char **envp;
+    pid_t pgid;             /* process group to join, 0 for a new one */
+    const struct spawn_action *actions;
+    int nactions;
+};
+
+/*
+ * Start a process as described by req, storing its pid in *pid.
+ * Returns 0, or the error number of what failed, in which case no
+ * process is left behind.
+ */
+int spawn(const struct spawn_request *req, pid_t *pid);
+
+/* Select the backend used by spawn, starting the zygote if it is
+ * selected for the first time. */
+void spawn_set_backend(enum spawn_backend backend);
+
+/* The descriptor that becomes readable when processes started by the
+ * zygote change state, or -1 if there is no zygote. */
+int spawn_status_fd(void);
+
+/* Call handler with the pid and wait status of each process started
+ * by the zygote that changed state; returns whether there were any. */
+bool spawn_collect_statuses(void (*handler)(pid_t pid, int status));
+
+/* To be called in every child the shell forks: a zygote serves only
+ * the process that started it. */
+void spawn_forget_zygote(void);
+
+/* Return the backend called name, or -1 if there is none. */
+int spawn_backend_by_name(const char *name);
+
+/*
+ * Measure how long starting and reaping file takes with each backend
+ * as the heap of this process grows, and print a table to out.  The
+ * memory is never given back, and the children are waited for
+ * directly, so SIGCHLD must not be handled otherwise.
+ */
+void spawn_benchmark(const char *file, FILE *out);
+
+#endif /* __SPAWN_H */
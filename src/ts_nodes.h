@@ -0,0 +1,511 @@
+/*
+ * Generated by scripts/gen_ts_nodes.py from tree-sitter-bash's
+ * node-types.json and grammar.json.  Do not edit.
+ *
+ * Include ts_symbols.h, which has no include guard, before this file.
+ */
+#ifndef _TS_NODES_H
+#define _TS_NODES_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <tree_sitter/api.h>
+
+/* Field ids; tree-sitter numbers fields in sorted order. */
+enum ts_field_identifiers {
+  field_alternative = 1,
+  field_argument = 2,
+  field_body = 3,
+  field_condition = 4,
+  field_consequence = 5,
+  field_descriptor = 6,
+  field_destination = 7,
+  field_fallthrough = 8,
+  field_index = 9,
+  field_initializer = 10,
+  field_left = 11,
+  field_name = 12,
+  field_operator = 13,
+  field_redirect = 14,
+  field_right = 15,
+  field_termination = 16,
+  field_update = 17,
+  field_value = 18,
+  field_variable = 19,
+};
+
+#define TS_FIELD_COUNT 19
+
+/* Size of a table indexed by the symbols of ts_symbol_identifiers. */
+#define TS_SYMBOL_COUNT 280
+
+/* X(type) for every named node type that has a symbol sym_<type>. */
+#define TS_NAMED_NODE_TYPES(X) \
+    X(ansi_c_string) \
+    X(arithmetic_expansion) \
+    X(array) \
+    X(binary_expression) \
+    X(brace_expression) \
+    X(c_style_for_statement) \
+    X(case_item) \
+    X(case_statement) \
+    X(command) \
+    X(command_name) \
+    X(command_substitution) \
+    X(comment) \
+    X(compound_statement) \
+    X(concatenation) \
+    X(declaration_command) \
+    X(do_group) \
+    X(elif_clause) \
+    X(else_clause) \
+    X(expansion) \
+    X(extglob_pattern) \
+    X(file_descriptor) \
+    X(file_redirect) \
+    X(for_statement) \
+    X(function_definition) \
+    X(heredoc_body) \
+    X(heredoc_content) \
+    X(heredoc_end) \
+    X(heredoc_redirect) \
+    X(heredoc_start) \
+    X(herestring_redirect) \
+    X(if_statement) \
+    X(list) \
+    X(negated_command) \
+    X(number) \
+    X(parenthesized_expression) \
+    X(pipeline) \
+    X(postfix_expression) \
+    X(process_substitution) \
+    X(program) \
+    X(raw_string) \
+    X(redirected_statement) \
+    X(regex) \
+    X(simple_expansion) \
+    X(string) \
+    X(string_content) \
+    X(subscript) \
+    X(subshell) \
+    X(ternary_expression) \
+    X(test_command) \
+    X(test_operator) \
+    X(translated_string) \
+    X(unary_expression) \
+    X(unset_command) \
+    X(variable_assignment) \
+    X(variable_assignments) \
+    X(variable_name) \
+    X(while_statement) \
+    X(word) \
+
+
+/* X(type) for named node types that only exist as aliases. */
+#define TS_ALIAS_NODE_TYPES(X) \
+    X(special_variable_name) \
+
+
+/* X(name) for every field. */
+#define TS_FIELDS(X) \
+    X(alternative) \
+    X(argument) \
+    X(body) \
+    X(condition) \
+    X(consequence) \
+    X(descriptor) \
+    X(destination) \
+    X(fallthrough) \
+    X(index) \
+    X(initializer) \
+    X(left) \
+    X(name) \
+    X(operator) \
+    X(redirect) \
+    X(right) \
+    X(termination) \
+    X(update) \
+    X(value) \
+    X(variable) \
+
+
+/* Is symbol a subtype of _expression? */
+static inline bool
+ts_is_expression(TSSymbol symbol)
+{
+    switch (symbol) {
+    case sym_ansi_c_string:
+    case sym_arithmetic_expansion:
+    case sym_binary_expression:
+    case sym_brace_expression:
+    case sym_command_substitution:
+    case sym_concatenation:
+    case sym_expansion:
+    case sym_number:
+    case sym_parenthesized_expression:
+    case sym_postfix_expression:
+    case sym_process_substitution:
+    case sym_raw_string:
+    case sym_simple_expansion:
+    case sym_string:
+    case sym_ternary_expression:
+    case sym_translated_string:
+    case sym_unary_expression:
+    case sym_word:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Is symbol a subtype of _primary_expression? */
+static inline bool
+ts_is_primary_expression(TSSymbol symbol)
+{
+    switch (symbol) {
+    case sym_ansi_c_string:
+    case sym_arithmetic_expansion:
+    case sym_brace_expression:
+    case sym_command_substitution:
+    case sym_expansion:
+    case sym_number:
+    case sym_process_substitution:
+    case sym_raw_string:
+    case sym_simple_expansion:
+    case sym_string:
+    case sym_translated_string:
+    case sym_word:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Is symbol a subtype of _statement? */
+static inline bool
+ts_is_statement(TSSymbol symbol)
+{
+    switch (symbol) {
+    case sym_c_style_for_statement:
+    case sym_case_statement:
+    case sym_command:
+    case sym_compound_statement:
+    case sym_declaration_command:
+    case sym_for_statement:
+    case sym_function_definition:
+    case sym_if_statement:
+    case sym_list:
+    case sym_negated_command:
+    case sym_pipeline:
+    case sym_redirected_statement:
+    case sym_subshell:
+    case sym_test_command:
+    case sym_unset_command:
+    case sym_variable_assignment:
+    case sym_variable_assignments:
+    case sym_while_statement:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Typed field accessors. */
+static inline TSNode
+ts_binary_expression_left(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_left);
+}
+
+static inline TSNode
+ts_binary_expression_operator(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_operator);
+}
+
+static inline TSNode
+ts_binary_expression_right(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_right);
+}
+
+static inline TSNode
+ts_c_style_for_statement_body(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_body);
+}
+
+static inline TSNode
+ts_c_style_for_statement_condition(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_condition);
+}
+
+static inline TSNode
+ts_c_style_for_statement_initializer(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_initializer);
+}
+
+static inline TSNode
+ts_c_style_for_statement_update(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_update);
+}
+
+static inline TSNode
+ts_case_item_fallthrough(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_fallthrough);
+}
+
+static inline TSNode
+ts_case_item_termination(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_termination);
+}
+
+static inline TSNode
+ts_case_item_value(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_value);
+}
+
+static inline TSNode
+ts_case_statement_value(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_value);
+}
+
+static inline TSNode
+ts_command_argument(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_argument);
+}
+
+static inline TSNode
+ts_command_name(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_name);
+}
+
+static inline TSNode
+ts_command_redirect(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_redirect);
+}
+
+static inline TSNode
+ts_command_substitution_redirect(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_redirect);
+}
+
+static inline TSNode
+ts_expansion_operator(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_operator);
+}
+
+static inline TSNode
+ts_file_redirect_descriptor(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_descriptor);
+}
+
+static inline TSNode
+ts_file_redirect_destination(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_destination);
+}
+
+static inline TSNode
+ts_for_statement_body(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_body);
+}
+
+static inline TSNode
+ts_for_statement_value(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_value);
+}
+
+static inline TSNode
+ts_for_statement_variable(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_variable);
+}
+
+static inline TSNode
+ts_function_definition_body(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_body);
+}
+
+static inline TSNode
+ts_function_definition_name(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_name);
+}
+
+static inline TSNode
+ts_function_definition_redirect(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_redirect);
+}
+
+static inline TSNode
+ts_heredoc_redirect_argument(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_argument);
+}
+
+static inline TSNode
+ts_heredoc_redirect_descriptor(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_descriptor);
+}
+
+static inline TSNode
+ts_heredoc_redirect_operator(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_operator);
+}
+
+static inline TSNode
+ts_heredoc_redirect_redirect(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_redirect);
+}
+
+static inline TSNode
+ts_heredoc_redirect_right(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_right);
+}
+
+static inline TSNode
+ts_herestring_redirect_descriptor(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_descriptor);
+}
+
+static inline TSNode
+ts_if_statement_condition(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_condition);
+}
+
+static inline TSNode
+ts_postfix_expression_operator(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_operator);
+}
+
+static inline TSNode
+ts_redirected_statement_body(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_body);
+}
+
+static inline TSNode
+ts_redirected_statement_redirect(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_redirect);
+}
+
+static inline TSNode
+ts_subscript_index(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_index);
+}
+
+static inline TSNode
+ts_subscript_name(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_name);
+}
+
+static inline TSNode
+ts_ternary_expression_alternative(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_alternative);
+}
+
+static inline TSNode
+ts_ternary_expression_condition(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_condition);
+}
+
+static inline TSNode
+ts_ternary_expression_consequence(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_consequence);
+}
+
+static inline TSNode
+ts_unary_expression_operator(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_operator);
+}
+
+static inline TSNode
+ts_variable_assignment_name(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_name);
+}
+
+static inline TSNode
+ts_variable_assignment_value(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_value);
+}
+
+static inline TSNode
+ts_while_statement_body(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_body);
+}
+
+static inline TSNode
+ts_while_statement_condition(TSNode self)
+{
+    return ts_node_child_by_field_id(self, field_condition);
+}
+
+/*
+ * Verify the constants above against the language linked into
+ * the program.  Reports each mismatch to stderr.
+ */
+static inline bool
+ts_nodes_check(const TSLanguage *language)
+{
+    bool ok = ts_language_field_count(language) == TS_FIELD_COUNT;
+#define CHECK_FIELD(name) \
+    if (ts_language_field_id_for_name(language, #name, strlen(#name)) != field_##name) { \
+        fprintf(stderr, "field `%s' has changed\n", #name); \
+        ok = false; \
+    }
+#define CHECK_SYMBOL(type) \
+    if (ts_language_symbol_for_name(language, #type, strlen(#type), true) != sym_##type) { \
+        fprintf(stderr, "node type `%s' has changed\n", #type); \
+        ok = false; \
+    }
+#define CHECK_ALIAS(type) \
+    if (ts_language_symbol_for_name(language, #type, strlen(#type), true) == 0) { \
+        fprintf(stderr, "node type `%s' is gone\n", #type); \
+        ok = false; \
+    }
+    TS_FIELDS(CHECK_FIELD)
+    TS_NAMED_NODE_TYPES(CHECK_SYMBOL)
+    TS_ALIAS_NODE_TYPES(CHECK_ALIAS)
+#undef CHECK_FIELD
+#undef CHECK_SYMBOL
+#undef CHECK_ALIAS
+    return ok;
+}
+
+#endif /* _TS_NODES_H */
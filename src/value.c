@@ -0,0 +1,105 @@
+/*
+ * Reference-counted and interned strings, see value.h.
+ *
+ * Interned values are kept in a tommy_hashdyn; each sits in an
+ * allocation of its own that also holds its node.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "tommyds/tommyhashdyn.h"
+#include "tommyds/tommyhash.h"
+#include "utils.h"
+#include "value.h"
+
+struct interned {
+    tommy_node node;
+    struct value value;     /* must be last, its string follows */
+};
+
+static tommy_hashdyn interned;
+static bool initialized;
+
+/* The len bytes of the string to intern. */
+struct intern_key {
+    const char *s;
+    size_t len;
+};
+
+static void
+init_value(struct value *v, const char *s, size_t len, uint32_t refs)
+{
+    v->refs = refs;
+    v->len = len;
+    v->hashed = false;
+    memcpy(v->str, s, len);
+    v->str[len] = '\0';
+}
+
+struct value *
+value_new(const char *s, size_t len)
+{
+    struct value *v = malloc(sizeof *v + len + 1);
+    if (v == NULL)
+        utils_fatal_error("Could not allocate value: ");
+    init_value(v, s, len, 1);
+    return v;
+}
+
+uint32_t
+value_hash(struct value *v)
+{
+    if (!v->hashed) {
+        v->hash = tommy_hash_u32(0, v->str, v->len);
+        v->hashed = true;
+    }
+    return v->hash;
+}
+
+void
+value_unref(struct value *v)
+{
+    if (v != NULL && v->refs != VALUE_INTERNED && --v->refs == 0)
+        free(v);
+}
+
+static int
+compare_interned(const void *arg, const void *obj)
+{
+    const struct intern_key *key = arg;
+    const struct value *v = &((const struct interned *) obj)->value;
+    return v->len != key->len || memcmp(v->str, key->s, key->len) != 0;
+}
+
+struct value *
+value_intern(const char *s, size_t len)
+{
+    if (!initialized) {
+        tommy_hashdyn_init(&interned);
+        initialized = true;
+    }
+
+    struct intern_key key = { s, len };
+    tommy_hash_t hash = tommy_hash_u32(0, s, len);
+    struct interned *i = tommy_hashdyn_search(&interned, compare_interned, &key, hash);
+    if (i == NULL) {
+        i = malloc(sizeof *i + len + 1);
+        if (i == NULL)
+            utils_fatal_error("Could not allocate value: ");
+        init_value(&i->value, s, len, VALUE_INTERNED);
+        i->value.hash = hash;
+        i->value.hashed = true;
+        tommy_hashdyn_insert(&interned, &i->node, i, hash);
+    }
+    return &i->value;
+}
+
+void
+value_done(void)
+{
+    if (initialized) {
+        tommy_hashdyn_foreach(&interned, free);
+        tommy_hashdyn_done(&interned);
+        initialized = false;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef __VALUE_H
+#define __VALUE_H
+/*
+ * Immutable, reference-counted strings, the values of shell variables.
+ *
+ * A value records its length and, once asked for, its hash, so that
+ * neither is ever computed twice.  Assigning a variable's value to
+ * another variable, or placing it in an argv vector, takes another
+ * reference rather than copying the bytes; nothing ever modifies a
+ * value, so it can be shared freely.
+ *
+ * Interned values are canonical: there is exactly one for each
+ * distinct string, so two interned values are equal if and only if
+ * they are the same pointer.  Variable names are interned.  Interned
+ * values live until value_done and are not reference counted.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct value {
+    uint32_t refs;          /* VALUE_INTERNED for interned values */
+    uint32_t len;           /* of str, excluding the terminating zero */
+    uint32_t hash;          /* valid if hashed */
+    bool hashed;
+    char str[];             /* zero-terminated */
+};
+
+#define VALUE_INTERNED UINT32_MAX
+
+/* Return a new value holding the len bytes at s, with one reference. */
+struct value *value_new(const char *s, size_t len);
+
+/* Return the canonical value holding the len bytes at s. */
+struct value *value_intern(const char *s, size_t len);
+
+/* Return the hash of v, computing it on first use. */
+uint32_t value_hash(struct value *v);
+
+static inline struct value *
+value_ref(struct value *v)
+{
+    if (v->refs != VALUE_INTERNED)
+        v->refs++;
+    return v;
+}
+
+/* Drop a reference to v, freeing it with the last one.  v may be NULL. */
+void value_unref(struct value *v);
+
+/* Free all interned values. */
+void value_done(void);
+
+#endif /* __VALUE_H */
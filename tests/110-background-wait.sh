@@ -0,0 +1,27 @@
+#
+# Commands run in the background with &, collected with wait
+#
+sleep 0.2 && echo second &
+echo first
+wait
+echo after wait
+
+for i in 1 2 3
+do
+    /bin/sh -c "exit $i" &
+done
+wait $!
+echo "wait for last: $?"
+wait
+echo "wait for all: $?"
+
+for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
+do
+    for j in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
+    do
+        true &
+    done
+done
+wait
+echo "400 workers done"
+
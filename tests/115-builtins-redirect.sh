@@ -0,0 +1,26 @@
+#
+# Builtins honor redirections and report an exit status
+#
+out=/tmp/minibash-115.tmp
+echo hello > $out
+echo world >> $out
+cat < $out
+printf '%s=%d\n' a 1 b 2 2>&1
+ls /nonexistent-115 2> $out
+test -s $out && echo "stderr captured"
+if true; then echo inside; fi > $out
+cat $out
+cat <<< "here string"
+cat <<EOF2
+here document for $out
+EOF2
+[ "$out" != "" ]
+echo "test: $?"
+[ 2 -gt 3 ]
+echo "test: $?"
+expr 6 \* 7
+expr 1 = 2
+echo "expr: $?"
+: > $out
+test -s $out || echo "truncated"
+rm $out
@@ -0,0 +1,39 @@
+#
+# The command location cache: hash, hash -r, type -P, and invalidation
+#
+dir=/tmp/minibash-116
+/bin/mkdir -p $dir/a $dir/b
+/bin/printf '#!/bin/sh\necho "b/hello $1"\n' > $dir/b/hello
+/bin/chmod +x $dir/b/hello
+PATH="$dir/a:$dir/b"
+
+hash
+hello 1
+hello 2
+hash
+type -P hello
+type hello
+hash -t hello
+hash -r
+hash
+hash hello
+hash
+
+# a command added to an earlier directory takes precedence
+/bin/cp $dir/b/hello $dir/a/hello
+/bin/sed -i s,b/,a/, $dir/a/hello
+hello 3
+hash -t hello
+
+# and a removed one is searched for again
+/bin/rm $dir/a/hello
+hello 4
+hash -t hello
+/bin/rm -r $dir
+hello 5
+echo "status $?"
+
+# an assignment to PATH is seen at once
+PATH=/nonexistent-116
+type -P ls; echo "type $?"
+hash ls 2>/dev/null; echo "hash $?"
@@ -0,0 +1,14 @@
+# the status of a pipeline is that of its last stage
+false | true
+echo $?
+true | false
+echo $?
+# ! negates the whole pipeline
+! true | false
+echo $?
+# |& applies after the stage's own redirections
+echo visible 2>/dev/null |& tr a-z A-Z
+ls /nonexistent-dir |& wc -l
+echo one two | tr a-z A-Z > pipeout
+cat pipeout
+rm pipeout
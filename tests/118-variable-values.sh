@@ -0,0 +1,5 @@
+x=hello; y=$x; echo $y "$y"
+e=; echo a $e b "$e" c
+for i in one two "$x"; do z=$i; echo $z; done
+w=$(x=inner; echo $x); echo $w $x
+i=0; for a in 1 2 3 4 5 6 7 8 9 10; do b=$a; c=$b; done; echo $c
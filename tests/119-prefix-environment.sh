@@ -0,0 +1,7 @@
+A=1 B=2 printenv A B
+A=1 A=2 printenv A
+printenv A || echo unset
+HOME=/elsewhere
+printenv HOME
+HOME=/prefix printenv HOME
+printenv HOME
@@ -0,0 +1,37 @@
+f() { echo "f: $1 $2 ($#) [$@]"; }
+f a b
+f
+x=global
+g() { local x=local y; echo "g: $x [$y]"; h; x=changed; }
+h() { echo "h sees $x"; }
+g
+echo "after: $x"
+fact() {
+    if [ $1 -le 1 ]; then echo 1; return; fi
+    local n=$1
+    local r=$(fact $(expr $n - 1))
+    expr $n \* $r
+}
+fact 6
+r() { return 7; echo no; }
+r; echo "status $?"
+loop() { for i in 1 2 3; do if [ $i = 2 ]; then return 4; fi; echo i$i; done; echo no; }
+loop; echo "status $?"
+count() { if [ $1 -gt 0 ]; then count $(expr $1 - 1); fi; c=$1; }
+count 20; echo "c=$c"
+V=pre f x
+echo "V=[$V]"
+f | cat
+p() { echo "$1"; q one; echo "$1"; }
+q() { echo "q $1 $2"; }
+p outer
+echo "quoted $x and $c"
+n() { echo "n $#"; }
+args() { n "$@"; n $@; n "$*"; n "x$@y"; for a in "$@"; do echo "[$a]"; done; echo "$#: ${*}"; }
+args a "b c" ""
+args
+n "$@"
+echo "top $#"
+pass() { args "$@" extra; IFS=:; echo "$*"; IFS=' 	
+'; }
+pass 1 "2 3"
@@ -0,0 +1,29 @@
+echo $((1+2*3)) $(( (1+2)*3 )) $((7/2)) $((-7/2)) $((-7%3)) $((1<<4)) $((256>>2))
+echo $((2**3**2)) $((-2**2)) $((0x1f)) $((010)) $((8#17)) $((16#ff)) $((2#101))
+echo $((1?2:3)) $((0?2:3)) $((1&&0)) $((0||5)) $((!5)) $((~5)) $((5>3)) $((2!=2))
+echo $((0 && 1/0)) $((1 || 1/0)) $((1,2,3)) $[3+4] "$((3*4))"
+echo $((9223372036854775807 + 1)) $((2**63)) $((1 << 65))
+x=5; echo $((x++)) $x $((++x)) $((x--)) $((--x)) $x
+echo $((x+=3)) $((x-=1)) $((x*=2)) $((x/=3)) $((x%=4)) $((x<<=2)) $((x|=1)) $((x^=3))
+a=b=3; echo $a $b
+x="1+2"; echo $((x*3)) $(($x*3))
+a=3; b=a; c=b; echo $((c+1))
+q=-5; echo $(($q*2)) $((2-$q)) $((2- -5))
+echo $((1 + $(echo 2)))
+s=" 12 "; echo $((s+1)) $((unset_var+1))
+i=0; while ((i < 5)); do echo -n "$i "; ((i++)); done; echo
+for ((j=0; j<10; j++)); do if ((j==2)); then continue; fi; if ((j==4)); then break; fi; echo -n "j$j "; done; echo
+for ((;;)); do break; done; echo "status $?"
+for ((k=0; k<3; k+=1)); do false; done; echo "status $?"
+(( 0 )); echo "status $?"
+(( 7 )); echo "status $?"
+let a=4 b=a*2; echo $a $b $?
+let 0; echo "status $?"
+declare -i n=3+4; echo $n; n=n*2; echo $n; n+=1; echo $n
+str=a; str+=b; str+=$((1+1)); echo $str
+f() { local -i z=10; z=z+5; echo $z; }
+f
+echo $((1/0))
+echo "after the error"
+((1/0)); echo "status $?"
+let 1/0; echo "status $?"
@@ -0,0 +1,30 @@
+echo "default IFS: ${#IFS}"; printf '%q\n' "$IFS"
+x="a b  c"
+printf "[%s]" $x; echo
+printf "[%s]" "$x"; echo
+printf "[%s]" x$x $x$x; echo
+x="  lead trail  "
+printf "[%s]" $x ${x}z; echo
+e=""
+printf "[%s]" $e; echo
+printf "[%s]" "$e" $e""; echo
+x="a "
+printf "[%s]" $x""; echo
+printf "[%s]" $(printf 'one\ntwo  three\n\n'); echo
+for w in $(echo 1 2 3) four "$x"; do echo "w=$w"; done
+echo $(echo a; echo b) | wc -w
+IFS=:
+x="a::b:"
+printf "[%s]" $x; echo
+x=":a"
+printf "[%s]" $x; echo
+IFS=" :"
+y="a : b"
+printf "[%s]" $y a$y; echo
+IFS=,
+printf "[%s]" $(echo a,b,,c) $((12)); echo
+IFS=
+x="a b"
+printf "[%s]" $x; echo
+IFS="$(printf ' \t\n')"
+printf "[%s]" $x; echo
@@ -0,0 +1,19 @@
+mkdir -p glob-test/a/b glob-test/a-c glob-test/e
+touch glob-test/a/b/f1 glob-test/a/b/f2 glob-test/a-c/x glob-test/.hid
+touch 'glob-test/x*y' glob-test/xay 'glob-test/b[1]' glob-test/b1
+echo glob-test/*
+echo glob-test/.*
+echo glob-test/*/ glob-test/*/*/
+echo glob-test/a*/* glob-test/a/b/f?
+echo "glob-test/*" glob-test/\* glob-test/x\*y glob-test/x"*"y glob-test/x[*]y
+d=glob-test
+x="*"
+echo $d/$x "$d/$x"
+z='glob-test/a/*'
+echo $z "$d/a/"*
+echo $d/b[1] $d/b\[1] "$d/b["1] $d/a/[b] $d/x[]
+echo $d/nomatch* glob-test/e/*
+for f in glob-test/a*/* $d/b*; do echo "[$f]"; done
+touch glob-test/e/new
+echo glob-test/e/*
+rm -rf glob-test
@@ -0,0 +1,47 @@
+for x in app.log a.txt "b c" x foo/bar.tar.gz '*' ''; do
+  case $x in
+    a*|"b c") echo "1 $x" ;;
+    *.log) echo "2 $x" ;&
+    x) echo "3 $x" ;;
+    *.tar.*) echo "tar $x" ;;&
+    foo/*) echo "foo $x" ;;
+    "*") echo "star" ;;
+    *) echo "other [$x]" ;;
+  esac
+done
+case abc in ab) echo no ;; esac; echo "st=$?"
+false; case abc in abc) ;; esac; echo "st=$?"
+p='a*'
+case abc in $p) echo dyn-unquoted ;; esac
+case abc in "$p") echo wrong ;; *) echo quoted-literal ;; esac
+case 'a*' in "$p") echo quoted-ok ;; esac
+case 'a*' in a\*) echo esc-ok ;; esac
+case 'a?' in 'a?') echo sq-ok ;; esac
+x=hello.world.tar.gz
+echo ${x#*.} ${x##*.} ${x%.*} ${x%%.*} ${x#hello} ${x%"gz"} ${x#nomatch} ${x##*} ${x%%*}X
+echo "${x#*.}" ${x%.[a-z]z} ${x##*"."} ${x#\*}
+y=/usr/local/bin/tool
+echo ${y##*/} ${y%/*} ${y#/} ${y#$p}
+q=lo
+echo ${x#hel$q} ${x%${q}*} ${u#a}X
+[[ $x == *.gz ]] && echo m1
+[[ $x != *.gz ]] || echo m2
+[[ $x = hello* ]] && [[ $y == /usr/* ]] && echo m3
+[[ $x == "*.gz" ]] || echo m4
+[[ ! $x == *.zip ]] && echo m5
+[[ ( $x == h* ) ]] && echo m6
+[[ -n $x && -z $u ]] && echo m7
+[[ $u ]] || echo m8
+[[ abc < abd ]] && echo m9
+[[ 10 -gt 9 ]] && echo m10
+z="a b"
+[[ $z == "a b" ]] && echo m11
+[[ $z == a\ b ]] && echo m12
+[[ $x == $p ]] || echo m13
+[[ abc == $p ]] && echo m14
+[[ abc == "$p" ]] || echo m15
+f() { case $1 in -v) echo verbose; return 3 ;; esac; echo after; }
+f -v; echo "rc=$?"; f x
+for i in 1 2 3; do case $i in 2) continue ;; 3) break ;; esac; echo "i=$i"; done
+w='*.txt'
+case x.txt in $w) echo w-ok ;; esac
@@ -0,0 +1,14 @@
+x="2024-01-15 ERROR disk full"
+[[ $x =~ ^[0-9]{4}-[0-9]{2} ]] && echo "m1 $BASH_REMATCH"
+[[ $x =~ (ERROR|WARN)\ (.*)$ ]] && echo "m2 [$BASH_REMATCH]"
+[[ $x =~ WARN ]] || echo "m3 [$BASH_REMATCH] $?"
+re='E[A-Z]+'
+[[ $x =~ $re ]] && echo "m4 $BASH_REMATCH"
+[[ $x =~ "$re" ]] || echo "m5 quoted is literal"
+[[ 'a.c' =~ "a.c" ]] && echo "m6"
+[[ 'abc' =~ "a.c" ]] || echo "m7"
+[[ 'abc' =~ a.c ]] && echo "m8 $BASH_REMATCH"
+[[ 'a+b' =~ a\+b ]] && echo "m9 $BASH_REMATCH"
+for r in 'b+' 'c$' '^a' 'b+' 'z'; do [[ abbc =~ $r ]] && echo "$r -> $BASH_REMATCH" || echo "$r no"; done
+re='('; [[ a =~ $re ]]; echo "inv $?"
+[[ a =~ $re ]] && echo yes || echo "no $?"
@@ -0,0 +1,18 @@
+read a b <<< "  hello   world  again  "; echo "[$a][$b]"
+read <<< "  raw  line  "; echo "[$REPLY]"
+IFS=: read a b <<< "x:y:"; echo "[$a][$b]"
+IFS=": " read a b c <<< "  x :: y  "; echo "[$a][$b][$c]"
+IFS= read a <<< "  one  "; echo "[$a]"
+read a b <<< "a\ b c"; echo "[$a][$b]"
+printf 'x\\ y z\n' | { read -r a b; echo "[$a][$b]"; }
+printf 'a\\\nb c\n' | { read a b; echo "[$a][$b]"; }
+printf 'abc' | { read a; echo "$? [$a]"; }
+printf 'abcdef\n' | { read -n 3 a; read b; echo "[$a][$b]"; }
+printf 'a:b;c' | { read -d ';' a; echo "$? [$a]"; read b; echo "$? [$b]"; }
+seq 5 > read-test.txt
+{ read x; cat; } < read-test.txt
+seq 5 | { read x; read y; echo "$x$y"; cat; }
+while read l; do echo "<$l>"; head -n 1; done < read-test.txt
+seq 6 | while read l; do echo "<$l>"; head -n 1; done
+n=0; while read -r l; do n=$((n + l)); done < read-test.txt; echo $n
+rm read-test.txt
@@ -0,0 +1,108 @@
+mkdir -p array-test
+touch array-test/notes.txt array-test/log array-test/other
+printf 'one\ntwo two\n\nfour\nfive' > array-test/lines.txt
+nargs() { echo "nargs $#"; }
+a=(x "y z" '' w)
+echo "${#a[@]}" "${a[1]}" "${a[-1]}" "${#a[1]}" "${#a}"
+for e in "${a[@]}"; do echo "[$e]"; done
+for e in ${a[@]}; do echo "<$e>"; done
+echo "${a[*]}"
+IFS=:
+echo "${a[*]}"
+IFS=' 	
+'
+echo "${!a[@]}"
+a[7]=seven
+echo "${!a[@]}" "${#a[@]}"
+a+=(eight nine)
+echo "${!a[@]}"
+echo "${a[8]} ${a[9]}"
+a[1]+=!
+echo "${a[1]}"
+b=("${a[@]}")
+echo "${#b[@]} ${b[4]}"
+nargs "x${a[@]}y"
+
+e=()
+nargs "${e[@]}"
+
+nargs "${e[*]}"
+
+s=scalar
+echo "${s[0]} ${#s[@]} ${!s[@]} [${s[1]}]"
+s[2]=two
+echo "${s[@]}" "${!s[@]}"
+i=2
+(( c[i] = 5, c[i+1] = c[i] * 2, c[0]++ , ++c[0] ))
+echo "${c[@]}" "${!c[@]}"
+echo $(( c[2] + c[3] )) $(( c[-1] ))
+(( c[2] += 10 ))
+echo "${c[2]}"
+n=(3 1 2)
+echo $(( n[0] * n[1] + n[2] ))
+x=$(( ${n[0]} + 1 ))
+echo $x
+declare -a d
+echo "${#d[@]}"
+declare -a d2=(p q r)
+echo "${d2[@]}"
+f() {
+  local -a loc=(1 2 3)
+  local b=("${b[@]}" new)
+  echo "in: ${loc[@]} ${#b[@]}"
+  loc[5]=z
+  echo "${!loc[@]}"
+}
+f
+echo "out: ${#loc[@]} ${#b[@]}"
+echo $(n[0]=9; echo ${n[0]}) ${n[0]}
+mapfile L < array-test/lines.txt
+echo "${#L[@]}"
+printf '<%s>' "${L[@]}"; echo
+mapfile -t L < array-test/lines.txt
+printf '<%s>' "${L[@]}"; echo
+readarray -t -s 1 -n 2 M < array-test/lines.txt
+printf '<%s>' "${M[@]}"; echo "${#M[@]}"
+mapfile -t -O 3 M < array-test/lines.txt
+echo "${!M[@]}"
+printf '<%s>' "${M[@]}"; echo
+mapfile < array-test/lines.txt
+echo "${#MAPFILE[@]} ${MAPFILE[1]}"
+printf 'a:b:c' | { mapfile -t -d : P; printf '<%s>' "${P[@]}"; echo; }
+printf 'x\ny\nz\n' | { mapfile -t -n 1 Q; read r; echo "${Q[@]} $r"; cat; }
+{ mapfile -t -n 2 R; mapfile -t S; echo "${R[@]} | ${S[@]}"; } < array-test/lines.txt
+mapfile -t E < /dev/null
+echo "empty ${#E[@]}"
+read -a W <<< "  alpha beta   gamma  "
+echo "${#W[@]} ${W[2]}"
+IFS=: read -a W2 <<< "a::b:"
+echo "${#W2[@]}"; printf '<%s>' "${W2[@]}"; echo
+IFS=: read -ra W3 <<< 'a\:b:c'
+printf '<%s>' "${W3[@]}"; echo
+IFS=: 
+f=(a:b "c d")
+nargs ${f[@]}
+printf '<%s>' ${f[@]}; echo
+IFS=' 	
+'
+g=("array-test/*.txt" "array-test/l*")
+printf '<%s>' ${g[@]}; echo
+printf '<%s>' "${g[@]}"; echo
+c=(1 2 3)
+echo $(c[1]=changed; echo "${c[@]}") "${c[@]}"
+echo "$(c+=(4); echo ${#c[@]})" "${#c[@]}"
+x=$(( c[1] * 10 ))
+echo $x
+v=scal
+v+=(more)
+echo "${v[@]}" "${#v[@]}"
+h=(z)
+h=
+echo "${#h[@]}" "[${h[0]}]"
+for i in 0 1 2; do k[i]=$((i*i)); done
+echo "${k[@]}"
+echo "${k[ 1 + 1 ]}" "${k[$i]}"
+echo done
+[[ "abc-123" =~ ([a-z]+)-([0-9]+)(x)? ]] && echo "${BASH_REMATCH[@]}" "${#BASH_REMATCH[@]}" "$BASH_REMATCH" "${BASH_REMATCH[2]}"
+[[ "zzz" =~ ([0-9]+) ]] || echo "nomatch ${#BASH_REMATCH[@]}"
+rm -r array-test
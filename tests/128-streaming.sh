@@ -0,0 +1,31 @@
+#
+# Scripts are run as they are read, files in windows of 64 KiB;
+# a statement that spans the end of a window runs only once it is
+# read in full, whether the script is a file or piped in
+#
+shell=$(/bin/sh -c 'readlink /proc/$PPID/exe')
+script=/tmp/minibash-128.sh
+
+# Write a script of filler statements followed by text, such that
+# byte 65536 falls at offset $2 within the text, and run it.
+boundary() {
+    fill=$((65536 - $2))
+    i=0
+    while [ $i -lt $((fill / 11 - 1)) ]; do
+        echo 'n=$((n+1))'
+        i=$((i+1))
+    done > $script
+    printf "#%$((fill % 11 + 9))s\n" '' >> $script
+    printf '%s\necho "filler $n"\n' "$1" >> $script
+    wc -c < $script
+    $shell $script
+    cat $script | $shell
+}
+
+boundary 'if [ 1 -gt 0 ]; then echo if ok; fi' 5
+boundary 'while [ $n -gt 0 ]; do echo while $n; n=0; done' 8
+boundary 'cat <<EOF
+here document
+spanning the window
+EOF' 15
+rm $script
@@ -0,0 +1,45 @@
+#
+# $(...) whose body only runs builtins runs in the shell itself, but
+# as if in a subshell: loop control and variables do not leak out of
+# it.  Other bodies run in a child process.
+#
+for i in 1 2 3; do
+    x=$(echo a$i; break; echo b)
+    echo "break $i $x"
+done
+for i in 1 2; do
+    x=$(for j in 1 2; do echo j$j; continue; echo never; done; continue; echo after)
+    echo "continue $i $x"
+done
+i=0
+while [ $i -lt 2 ]; do
+    i=$((i+1))
+    x=$(break)
+    y=$(continue)
+    echo "while $i"
+done
+
+# variables, including integer ones and those set by let and (( ))
+x=outer
+declare -i n=1
+y=$(x=inner; n=2+3; let m=4*5; (( k = 6 * 7 )); echo $x $n $m $k)
+echo "$y [$x] [$n] [$m] [$k]"
+y=$(n=n+1; n+=1; echo $n)
+echo "$y [$n]"
+y=$(for x in a b; do z=$x; done; echo $x $z)
+echo "$y [$x] [$z]"
+
+# an external command or a redirection makes it run in a child
+read -r shell rest < /proc/self/stat
+where() {
+    [ "$1" = "$shell" ] && echo "$2 in the shell" || echo "$2 in a child"
+}
+where $(read -r p rest < /proc/self/stat; echo $p) redirection
+where $(/bin/sh -c 'echo $PPID'; :) external
+y=$(x=child; /bin/echo external $x)
+echo "$y [$x]"
+out=/tmp/minibash-129.tmp
+y=$(x=child; echo to-file > $out; echo $x)
+echo "$y [$x]"
+cat $out
+rm $out